@@ -341,6 +341,7 @@ extern "C"
   extern uint32_t DAP_ExecuteCommand(const uint8_t *request, uint8_t *response);
 
   extern void DAP_Setup(void);
+  extern void DAP_SetClock(uint32_t clock);
 
 // Configurable delay for clock generation
 #ifndef DELAY_SLOW_CYCLES
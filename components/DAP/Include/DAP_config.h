@@ -39,6 +39,7 @@ This information includes:
 
 #include "esp32s3/rom/gpio.h"
 #include "driver/gpio.h"
+#include "soc/gpio_reg.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -197,6 +198,11 @@ of the same I/O port. The following SWDIO I/O Pin functions are provided:
 #define PIN_LED_CONNECTED GPIO_NUM_17
 #define PIN_LED_RUNNING GPIO_NUM_18
 
+// The pin functions below only touch GPIO registers, no driver calls, they are
+// inlined into the IRAM resident transfer path (linker.lf). Direction changes
+// flip the output enable, the input buffer stays on from PORT_SWD_SETUP.
+// GPIO_IN_REG and GPIO_OUT_W1TS_REG cover GPIO0-31, keep the pins in that range.
+
 /** Setup JTAG I/O pins: TCK, TMS, TDI, TDO, nTRST, and nRESET.
 Configures the DAP Hardware I/O pins for JTAG mode:
  - TCK, TMS, TDI, nTRST, nRESET to output mode and set to high level.
@@ -247,7 +253,7 @@ __STATIC_INLINE void PORT_OFF(void)
 */
 __STATIC_FORCEINLINE uint32_t PIN_SWCLK_TCK_IN(void)
 {
-    return (uint32_t)gpio_get_level(PIN_SWCLK);
+    return (READ_PERI_REG(GPIO_IN_REG) >> PIN_SWCLK) & 0x1;
 }
 
 /** SWCLK/TCK I/O pin: Set Output to High.
@@ -274,7 +280,7 @@ __STATIC_FORCEINLINE void     PIN_SWCLK_TCK_CLR(void)
 */
 __STATIC_FORCEINLINE uint32_t PIN_SWDIO_TMS_IN(void)
 {
-    return gpio_get_level(PIN_SWDIO);
+    return (READ_PERI_REG(GPIO_IN_REG) >> PIN_SWDIO) & 0x1;
 }
 
 /** SWDIO/TMS I/O pin: Set Output to High.
@@ -298,7 +304,7 @@ __STATIC_FORCEINLINE void     PIN_SWDIO_TMS_CLR(void)
 */
 __STATIC_FORCEINLINE uint32_t PIN_SWDIO_IN(void)
 {
-    return (uint32_t)gpio_get_level(PIN_SWDIO);
+    return (READ_PERI_REG(GPIO_IN_REG) >> PIN_SWDIO) & 0x1;
 }
 
 /** SWDIO I/O pin: Set Output (used in SWD mode only).
@@ -322,7 +328,7 @@ called prior \ref PIN_SWDIO_OUT function calls.
 */
 __STATIC_FORCEINLINE void     PIN_SWDIO_OUT_ENABLE(void)
 {
-    gpio_set_direction(PIN_SWDIO, GPIO_MODE_OUTPUT);
+    WRITE_PERI_REG(GPIO_ENABLE_W1TS_REG, (0x1 << PIN_SWDIO));
 }
 
 /** SWDIO I/O pin: Switch to Input mode (used in SWD mode only).
@@ -331,7 +337,7 @@ called prior \ref PIN_SWDIO_IN function calls.
 */
 __STATIC_FORCEINLINE void     PIN_SWDIO_OUT_DISABLE(void)
 {
-	gpio_set_direction(PIN_SWDIO, GPIO_MODE_INPUT);
+	WRITE_PERI_REG(GPIO_ENABLE_W1TC_REG, (0x1 << PIN_SWDIO));
 }
 
 
@@ -392,7 +398,7 @@ __STATIC_FORCEINLINE void     PIN_nTRST_OUT(uint32_t bit)
 */
 __STATIC_FORCEINLINE uint32_t PIN_nRESET_IN(void)
 {
-	return (uint32_t)gpio_get_level(PIN_nRESET);
+	return (READ_PERI_REG(GPIO_IN_REG) >> PIN_nRESET) & 0x1;
 }
 
 /** nRESET I/O pin: Set Output.
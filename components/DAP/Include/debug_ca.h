@@ -89,7 +89,9 @@ extern "C" {
 #define CSW_HPROT      0x02000000  // User/Privilege Control
 #define CSW_MSTRTYPE   0x20000000  // Master Type Mask
 #define CSW_MSTRCORE   0x00000000  // Master Type: Core
+#ifndef CSW_MSTRDBG
 #define CSW_MSTRDBG    0x60000000  // Master Type: Debug
+#endif
 #define CSW_RESERVED   0x01000000  // Reserved Value
 
 // Core Debug Register Address Offsets
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Arbiter for the SWD port, shared by the CMSIS-DAP command path, the
+ * programmer and the watch engine. The lock is recursive, the owner may
+ * take it again.
+ */
+void swd_bus_init(void);
+uint8_t swd_bus_lock(uint32_t timeout_ms);
+void swd_bus_unlock(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,1581 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "debug_cm.h"
+#include "flash_blob.h"
+#include "swd_host.h"
+
+// Debug Port Register Addresses, same values as DAP.h
+#ifndef DP_IDCODE
+#define DP_IDCODE 0x00U    // IDCODE Register (SW Read only)
+#define DP_ABORT 0x00U     // Abort Register (SW Write only)
+#define DP_CTRL_STAT 0x04U // Control & Status
+#define DP_SELECT 0x08U    // Select Register (JTAG R/W & SW W)
+#define DP_RDBUFF 0x0CU    // Read Buffer (Read Only)
+#endif
+
+#ifndef NVIC_Addr
+#define NVIC_Addr (0xe000e000)
+#define DBG_Addr (0xe000edf0)
+#endif
+
+/*
+ * SWD host engine shared by the C API in swd_host.cpp and by SWDIface.
+ *
+ * The engine is templated on a transport policy so that the hot loops
+ * (block transfers, polling) call the wire directly instead of going through
+ * a virtual function for every word. A transport must provide:
+ *
+ *   bool init(void);
+ *   bool off(void);
+ *   uint8_t transfer(uint32_t request, uint32_t *data);
+ *   void swj_sequence(uint32_t count, const uint8_t *data);
+ *   void set_target_reset(uint8_t asserted);
+ *   void msleep(uint32_t ms);
+ *   uint32_t retry_count(void);   // WAIT retries of one transfer
+ */
+template <class Transport>
+class SWDEngine
+{
+public:
+    enum transfer_err_def
+    {
+        TRANSFER_OK = 0x01,
+        TRANSFER_WAIT = 0x02,
+        TRANSFER_FAULT = 0x04,
+        TRANSFER_ERROR = 0x08,
+        TRANSFER_MISMATCH = 0x10
+    };
+
+    typedef struct
+    {
+        uint32_t transfers; // issued, WAIT retries not counted
+        uint32_t saved;     // SELECT, CSW, TAR and RDBUFF transfers left out
+    } transfer_stat_t;
+
+    SWDEngine() = default;
+
+    Transport &get_transport(void) { return _transport; }
+
+    bool init(void) { return _transport.init(); }
+    bool off(void) { return _transport.off(); }
+    void msleep(uint32_t ms) { _transport.msleep(ms); }
+
+    bool init_debug(void);
+    bool connect(uint32_t *idcode);
+    transfer_err_def transfer_retry(uint32_t req, uint32_t *data);
+    bool read_dp(uint8_t adr, uint32_t *val);
+    bool write_dp(uint8_t adr, uint32_t val);
+    bool read_ap(uint32_t adr, uint32_t *val);
+    bool write_ap(uint32_t adr, uint32_t val);
+    bool set_target_state(target_state_t state);
+    bool set_target_state_hw(target_state_t state);
+    bool read_memory(uint32_t address, uint8_t *data, uint32_t size);
+    bool write_memory(uint32_t address, uint8_t *data, uint32_t size);
+    bool read_words(const uint32_t *addr, uint32_t *val, uint32_t count);
+    bool flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t *result = nullptr);
+
+    bool write_block(uint32_t address, uint8_t *data, uint32_t size);
+    bool read_block(uint32_t address, uint8_t *data, uint32_t size);
+    bool read_word(uint32_t addr, uint32_t *val);
+    bool write_word(uint32_t addr, uint32_t val);
+    bool read_byte(uint32_t addr, uint8_t *val);
+    bool write_byte(uint32_t addr, uint8_t val);
+    bool read_core_register(uint32_t n, uint32_t *val);
+    bool write_core_register(uint32_t n, uint32_t val);
+    bool wait_until_halted(void);
+
+    // MEM-AP pushed transfers (CTRL/STAT TRNMODE), the comparison runs in the AP
+    void set_pushed_compare(bool enable);
+    bool pushed_supported(void);
+    bool verify_memory_pushed(uint32_t address, const uint8_t *data, uint32_t size, bool *match);
+    bool poll_word_pushed(uint32_t addr, uint32_t value, uint32_t lanes, uint32_t count, bool *matched);
+
+    // Transaction state: SELECT, CSW and TAR are tracked, AP writes are posted
+    bool sync(void);
+    void invalidate(void);
+    void reset_transfer_stat(void);
+    const transfer_stat_t &get_transfer_stat(void) { return _stat; }
+
+private:
+    typedef struct
+    {
+        uint32_t select;
+        uint32_t csw;
+        uint32_t tar;     // MEM-AP 0 TAR, follows the auto-increment
+        bool tar_valid;
+        bool posted;      // an AP write has not been checked yet
+    } dap_state_t;
+
+    typedef struct
+    {
+        uint32_t r[16];
+        uint32_t xpsr;
+    } debug_state_t;
+
+    // SWD register access
+    static constexpr uint32_t SWD_REG_AP = 1;
+    static constexpr uint32_t SWD_REG_DP = 0;
+    static constexpr uint32_t SWD_REG_R = (1 << 1);
+    static constexpr uint32_t SWD_REG_W = (0 << 1);
+    static constexpr uint32_t SWD_REG_ADR(uint32_t a) { return a & 0x0c; }
+
+    static constexpr uint32_t DCRDR = 0xE000EDF8;
+    static constexpr uint32_t DCRSR = 0xE000EDF4;
+    static constexpr uint32_t DHCSR = 0xE000EDF0;
+    static constexpr uint32_t REGWnR = (1 << 16);
+
+    // AP CSW register, base value
+    static constexpr uint32_t CSW_VALUE = (CSW_RESERVED | CSW_MSTRDBG | CSW_HPROT | CSW_DBGSTAT | CSW_SADDRINC);
+    static constexpr uint32_t CSW_VALUE_NOINC = (CSW_RESERVED | CSW_MSTRDBG | CSW_HPROT | CSW_DBGSTAT | CSW_NADDRINC);
+
+    // DP CTRL/STAT with debug and system powered up
+    static constexpr uint32_t CTRL_STAT_VALUE = (CSYSPWRUPREQ | CDBGPWRUPREQ);
+
+    // Pushed compares issued between two STICKYCMP checks
+    static constexpr uint32_t PUSHED_POLL_BATCH = 8;
+
+    // Pushed compares of DHCSR before wait_until_halted() falls back to readback
+    static constexpr uint32_t PUSHED_HALT_POLLS = 4 * PUSHED_POLL_BATCH;
+
+    static constexpr uint32_t MAX_TIMEOUT = 100000;
+
+    //! This can vary from target to target and should be in the structure or flash blob
+    static constexpr uint32_t TARGET_AUTO_INCREMENT_PAGE_SIZE = 1024;
+
+    Transport _transport;
+    dap_state_t _dap_state = {0xffffffff, 0xffffffff, 0, false, false};
+    transfer_stat_t _stat = {0, 0};
+    int8_t _pushed_support = -1; // -1: unknown, 0: no, 1: yes
+    bool _pushed_compare = false;
+
+    bool set_tar(uint32_t addr);
+    void advance_tar(uint32_t count);
+    bool write_word_sync(uint32_t addr, uint32_t val);
+    bool read_data(uint32_t addr, uint32_t *val);
+    bool write_data(uint32_t address, uint32_t data);
+    bool write_debug_state(debug_state_t *state);
+    bool wait_until_halted_after_reset(void);
+    bool swd_reset(void);
+    bool swd_switch(uint16_t val);
+    bool read_idcode(uint32_t *id);
+    bool jtag_to_swd(void);
+    bool power_up_debug(void);
+    bool pushed_end(uint32_t *status);
+};
+
+template <class Transport>
+inline typename SWDEngine<Transport>::transfer_err_def SWDEngine<Transport>::transfer_retry(uint32_t req, uint32_t *data)
+{
+    uint32_t retry = _transport.retry_count();
+    uint8_t ack = TRANSFER_OK;
+
+    _stat.transfers++;
+
+    for (uint32_t i = 0; i <= retry; i++)
+    {
+        ack = _transport.transfer(req, data);
+
+        if (ack != TRANSFER_WAIT)
+        {
+            break;
+        }
+    }
+
+    if (ack != TRANSFER_OK)
+    {
+        // a failed access may or may not have moved TAR
+        _dap_state.tar_valid = false;
+    }
+    else if ((req & SWD_REG_R) && ((req & SWD_REG_AP) || (SWD_REG_ADR(req) == DP_RDBUFF)))
+    {
+        // AP reads and RDBUFF wait for the posted writes before them
+        _dap_state.posted = false;
+    }
+
+    return static_cast<transfer_err_def>(ack);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::read_dp(uint8_t adr, uint32_t *val)
+{
+    uint32_t req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(adr);
+
+    return (transfer_retry(req, val) == TRANSFER_OK);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::write_dp(uint8_t adr, uint32_t val)
+{
+    uint32_t req = 0;
+
+    if (adr == DP_SELECT)
+    {
+        if (_dap_state.select == val)
+        {
+            _stat.saved++;
+            return true;
+        }
+
+        _dap_state.select = val;
+    }
+
+    req = SWD_REG_DP | SWD_REG_W | SWD_REG_ADR(adr);
+
+    return (transfer_retry(req, &val) == TRANSFER_OK);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::read_ap(uint32_t adr, uint32_t *val)
+{
+    uint32_t req = 0;
+    uint32_t apsel = adr & 0xff000000;
+    uint32_t bank_sel = adr & APBANKSEL;
+
+    if (!write_dp(DP_SELECT, apsel | bank_sel))
+    {
+        return false;
+    }
+
+    if (adr == AP_DRW)
+    {
+        _dap_state.tar_valid = false;
+    }
+
+    req = SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(adr);
+    // first dummy read
+    transfer_retry(req, nullptr);
+
+    return (transfer_retry(req, val) == TRANSFER_OK);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::write_ap(uint32_t adr, uint32_t val)
+{
+    uint32_t req = 0;
+    uint32_t apsel = adr & 0xff000000;
+    uint32_t bank_sel = adr & APBANKSEL;
+
+    if (!write_dp(DP_SELECT, apsel | bank_sel))
+    {
+        return false;
+    }
+
+    if (adr == AP_CSW)
+    {
+        if (_dap_state.csw == val)
+        {
+            _stat.saved++;
+            return true;
+        }
+
+        _dap_state.csw = val;
+    }
+
+    req = SWD_REG_AP | SWD_REG_W | SWD_REG_ADR(adr);
+
+    if (transfer_retry(req, &val) != TRANSFER_OK)
+    {
+        if (adr == AP_CSW)
+        {
+            _dap_state.csw = 0xffffffff;
+        }
+
+        return false;
+    }
+
+    if (adr == AP_TAR)
+    {
+        _dap_state.tar = val;
+        _dap_state.tar_valid = true;
+    }
+    else if (adr == AP_DRW)
+    {
+        _dap_state.tar_valid = false;
+    }
+
+    // posted, the next AP read or sync() reports a fault
+    _dap_state.posted = true;
+    _stat.saved++;
+
+    return true;
+}
+
+// Complete the posted AP writes, a fault of any of them fails the RDBUFF read.
+template <class Transport>
+inline bool SWDEngine<Transport>::sync(void)
+{
+    uint32_t req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+
+    if (!_dap_state.posted)
+    {
+        return true;
+    }
+
+    return (transfer_retry(req, nullptr) == TRANSFER_OK);
+}
+
+// Forget the tracked state, another master (the CMSIS-DAP command path) has used the DP.
+template <class Transport>
+inline void SWDEngine<Transport>::invalidate(void)
+{
+    _dap_state.select = 0xffffffff;
+    _dap_state.csw = 0xffffffff;
+    _dap_state.tar_valid = false;
+    _dap_state.posted = false;
+}
+
+template <class Transport>
+inline void SWDEngine<Transport>::reset_transfer_stat(void)
+{
+    _stat.transfers = 0;
+    _stat.saved = 0;
+}
+
+// Write TAR unless it already holds addr, e.g. the auto-increment of the last access.
+template <class Transport>
+inline bool SWDEngine<Transport>::set_tar(uint32_t addr)
+{
+    uint32_t req = SWD_REG_AP | SWD_REG_W | AP_TAR;
+
+    if (_dap_state.tar_valid && (_dap_state.tar == addr))
+    {
+        _stat.saved++;
+        return true;
+    }
+
+    if (transfer_retry(req, &addr) != TRANSFER_OK)
+    {
+        return false;
+    }
+
+    _dap_state.tar = addr;
+    _dap_state.tar_valid = true;
+
+    return true;
+}
+
+// Follow TAR over count DRW accesses. The increment is only defined inside the
+// auto increment page, TAR is unknown once it leaves it.
+template <class Transport>
+inline void SWDEngine<Transport>::advance_tar(uint32_t count)
+{
+    uint32_t tar = _dap_state.tar;
+
+    if ((_dap_state.csw & CSW_ADDRINC) != CSW_SADDRINC)
+    {
+        return;
+    }
+
+    _dap_state.tar += count << (_dap_state.csw & CSW_SIZE);
+
+    if ((tar ^ _dap_state.tar) & ~(TARGET_AUTO_INCREMENT_PAGE_SIZE - 1))
+    {
+        _dap_state.tar_valid = false;
+    }
+}
+
+// Write 32-bit word aligned values to target memory using address auto-increment.
+// size is in bytes.
+template <class Transport>
+inline bool SWDEngine<Transport>::write_block(uint32_t address, uint8_t *data, uint32_t size)
+{
+    uint32_t req = 0;
+    uint32_t size_in_words = size / sizeof(uint32_t);
+
+    if (size == 0)
+    {
+        return false;
+    }
+
+    // CSW register
+    if (!write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
+    {
+        return false;
+    }
+
+    if (!set_tar(address))
+    {
+        return false;
+    }
+
+    // DRW write
+    req = SWD_REG_AP | SWD_REG_W | AP_DRW;
+    for (uint32_t i = 0; i < size_in_words; i++)
+    {
+        if (transfer_retry(req, reinterpret_cast<uint32_t *>(data)) != TRANSFER_OK)
+        {
+            return false;
+        }
+
+        data += sizeof(uint32_t);
+    }
+
+    advance_tar(size_in_words);
+
+    // posted, no dummy read
+    _dap_state.posted = true;
+    _stat.saved++;
+
+    return true;
+}
+
+// Read 32-bit word aligned values from target memory using address auto-increment.
+// size is in bytes.
+template <class Transport>
+inline bool SWDEngine<Transport>::read_block(uint32_t address, uint8_t *data, uint32_t size)
+{
+    uint32_t req = 0;
+    uint32_t size_in_words = size / sizeof(uint32_t);
+
+    if (size == 0)
+    {
+        return false;
+    }
+
+    if (!write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
+    {
+        return false;
+    }
+
+    if (!set_tar(address))
+    {
+        return false;
+    }
+
+    advance_tar(size_in_words);
+
+    // read data
+    req = SWD_REG_AP | SWD_REG_R | AP_DRW;
+    // initiate first read, data comes back in next read
+    if (transfer_retry(req, nullptr) != TRANSFER_OK)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < (size_in_words - 1); i++)
+    {
+        if (transfer_retry(req, reinterpret_cast<uint32_t *>(data)) != TRANSFER_OK)
+        {
+            return false;
+        }
+
+        data += sizeof(uint32_t);
+    }
+
+    // read last word
+    req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+
+    return (transfer_retry(req, reinterpret_cast<uint32_t *>(data)) == TRANSFER_OK);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::read_data(uint32_t addr, uint32_t *val)
+{
+    uint32_t req = 0;
+
+    // put addr in TAR register
+    if (!set_tar(addr))
+    {
+        return false;
+    }
+
+    // read data
+    req = SWD_REG_AP | SWD_REG_R | AP_DRW;
+    if (transfer_retry(req, nullptr) != TRANSFER_OK)
+    {
+        return false;
+    }
+
+    advance_tar(1);
+
+    // dummy read
+    req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+
+    return (transfer_retry(req, val) == TRANSFER_OK);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::write_data(uint32_t address, uint32_t data)
+{
+    uint32_t req = 0;
+
+    // put addr in TAR register
+    if (!set_tar(address))
+    {
+        return false;
+    }
+
+    // write data
+    req = SWD_REG_AP | SWD_REG_W | AP_DRW;
+    if (transfer_retry(req, &data) != TRANSFER_OK)
+    {
+        return false;
+    }
+
+    advance_tar(1);
+
+    // posted, no dummy read
+    _dap_state.posted = true;
+    _stat.saved++;
+
+    return true;
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::read_word(uint32_t addr, uint32_t *val)
+{
+    if (!write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
+    {
+        return false;
+    }
+
+    return read_data(addr, val);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::write_word(uint32_t addr, uint32_t val)
+{
+    if (!write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
+    {
+        return false;
+    }
+
+    return write_data(addr, val);
+}
+
+// Word write that completes before returning, for state changes: resets, the
+// transport going off and the sticky error checks that follow.
+template <class Transport>
+inline bool SWDEngine<Transport>::write_word_sync(uint32_t addr, uint32_t val)
+{
+    return write_word(addr, val) && sync();
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::read_byte(uint32_t addr, uint8_t *val)
+{
+    uint32_t tmp = 0;
+
+    if (!write_ap(AP_CSW, CSW_VALUE | CSW_SIZE8))
+    {
+        return false;
+    }
+
+    if (!read_data(addr, &tmp))
+    {
+        return false;
+    }
+
+    *val = (uint8_t)(tmp >> ((addr & 0x03) << 3));
+    return true;
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::write_byte(uint32_t addr, uint8_t val)
+{
+    uint32_t tmp = 0;
+
+    if (!write_ap(AP_CSW, CSW_VALUE | CSW_SIZE8))
+    {
+        return false;
+    }
+
+    tmp = val << ((addr & 0x03) << 3);
+
+    return write_data(addr, tmp);
+}
+
+// Read unaligned data from target memory.
+// size is in bytes.
+template <class Transport>
+inline bool SWDEngine<Transport>::read_memory(uint32_t address, uint8_t *data, uint32_t size)
+{
+    uint32_t n = 0;
+
+    // Read bytes until word aligned
+    while ((size > 0) && (address & 0x3))
+    {
+        if (!read_byte(address, data))
+        {
+            return false;
+        }
+
+        address++;
+        data++;
+        size--;
+    }
+
+    // Read word aligned blocks
+    while (size > 3)
+    {
+        // Limit to auto increment page size
+        n = TARGET_AUTO_INCREMENT_PAGE_SIZE - (address & (TARGET_AUTO_INCREMENT_PAGE_SIZE - 1));
+
+        if (size < n)
+        {
+            n = size & 0xFFFFFFFC; // Only count complete words remaining
+        }
+
+        if (!read_block(address, data, n))
+        {
+            return false;
+        }
+
+        address += n;
+        data += n;
+        size -= n;
+    }
+
+    // Read remaining bytes
+    while (size > 0)
+    {
+        if (!read_byte(address, data))
+        {
+            return false;
+        }
+
+        address++;
+        data++;
+        size--;
+    }
+
+    return true;
+}
+
+// Read count words from scattered, word aligned addresses. Each AP read is posted,
+// so the data of word i arrives with the request of word i + 1, and one RDBUFF read
+// collects the last word. TAR is only written when addr[i] does not follow
+// addr[i - 1] in the same auto increment page: 1 transfer per word for
+// sequential runs, 2 for unrelated addresses.
+template <class Transport>
+inline bool SWDEngine<Transport>::read_words(const uint32_t *addr, uint32_t *val, uint32_t count)
+{
+    uint32_t req = 0;
+
+    if (count == 0)
+    {
+        return true;
+    }
+
+    if (!write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!set_tar(addr[i] & ~0x03U))
+        {
+            return false;
+        }
+
+        // initiate read i, collect read i - 1
+        req = SWD_REG_AP | SWD_REG_R | AP_DRW;
+        if (transfer_retry(req, (i > 0) ? &val[i - 1] : nullptr) != TRANSFER_OK)
+        {
+            return false;
+        }
+
+        advance_tar(1);
+    }
+
+    // read last word
+    req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+
+    return (transfer_retry(req, &val[count - 1]) == TRANSFER_OK);
+}
+
+// Write unaligned data to target memory.
+// size is in bytes.
+template <class Transport>
+inline bool SWDEngine<Transport>::write_memory(uint32_t address, uint8_t *data, uint32_t size)
+{
+    uint32_t n = 0;
+
+    // Write bytes until word aligned
+    while ((size > 0) && (address & 0x3))
+    {
+        if (!write_byte(address, *data))
+        {
+            return false;
+        }
+
+        address++;
+        data++;
+        size--;
+    }
+
+    // Write word aligned blocks
+    while (size > 3)
+    {
+        // Limit to auto increment page size
+        n = TARGET_AUTO_INCREMENT_PAGE_SIZE - (address & (TARGET_AUTO_INCREMENT_PAGE_SIZE - 1));
+
+        if (size < n)
+        {
+            n = size & 0xFFFFFFFC; // Only count complete words remaining
+        }
+
+        if (!write_block(address, data, n))
+        {
+            return false;
+        }
+
+        address += n;
+        data += n;
+        size -= n;
+    }
+
+    // Write remaining bytes
+    while (size > 0)
+    {
+        if (!write_byte(address, *data))
+        {
+            return false;
+        }
+
+        address++;
+        data++;
+        size--;
+    }
+
+    // the blocks and bytes are posted, report a fault of any of them
+    return sync();
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::read_core_register(uint32_t n, uint32_t *val)
+{
+    int i = 0;
+    int timeout = 100;
+
+    if (!write_word(DCRSR, n))
+    {
+        return false;
+    }
+
+    // wait for S_REGRDY
+    for (i = 0; i < timeout; i++)
+    {
+        if (!read_word(DHCSR, val))
+        {
+            return false;
+        }
+
+        if (*val & S_REGRDY)
+        {
+            break;
+        }
+    }
+
+    if (i == timeout)
+    {
+        return false;
+    }
+
+    return read_word(DCRDR, val);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::write_core_register(uint32_t n, uint32_t val)
+{
+    int timeout = 100;
+
+    if (!write_word(DCRDR, val))
+    {
+        return false;
+    }
+
+    if (!write_word(DCRSR, n | REGWnR))
+    {
+        return false;
+    }
+
+    // wait for S_REGRDY
+    for (int i = 0; i < timeout; i++)
+    {
+        if (!read_word(DHCSR, &val))
+        {
+            return false;
+        }
+
+        if (val & S_REGRDY)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::write_debug_state(debug_state_t *state)
+{
+    uint32_t i = 0;
+    uint32_t status = 0;
+
+    if (!write_dp(DP_SELECT, 0))
+    {
+        return false;
+    }
+
+    // R0, R1, R2, R3
+    for (i = 0; i < 4; i++)
+    {
+        if (!write_core_register(i, state->r[i]))
+        {
+            return false;
+        }
+    }
+
+    // R9
+    if (!write_core_register(9, state->r[9]))
+    {
+        return false;
+    }
+
+    // R13, R14, R15
+    for (i = 13; i < 16; i++)
+    {
+        if (!write_core_register(i, state->r[i]))
+        {
+            return false;
+        }
+    }
+
+    // xPSR
+    if (!write_core_register(16, state->xpsr))
+    {
+        return false;
+    }
+
+    if (!write_word_sync(DBG_HCSR, DBGKEY | C_DEBUGEN))
+    {
+        return false;
+    }
+
+    // check status
+    if (!read_dp(DP_CTRL_STAT, &status))
+    {
+        return false;
+    }
+
+    if (status & (STICKYERR | WDATAERR))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::wait_until_halted(void)
+{
+    // Wait for target to stop
+    uint32_t val = 0;
+    bool matched = false;
+
+    // S_REGRDY stays set after the register writes of the syscall, S_SLEEP and S_LOCKUP are clear.
+    // A miss costs at most PUSHED_HALT_POLLS compares, the readback loop below still decides.
+    if (_pushed_compare && pushed_supported())
+    {
+        if (poll_word_pushed(DBG_HCSR, S_REGRDY | S_HALT, MASKLANE2, PUSHED_HALT_POLLS, &matched) && matched)
+        {
+            return true;
+        }
+    }
+
+    for (uint32_t i = 0; i < MAX_TIMEOUT; i++)
+    {
+        if (!read_word(DBG_HCSR, &val))
+        {
+            return false;
+        }
+
+        if (val & S_HALT)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::wait_until_halted_after_reset(void)
+{
+    uint32_t val = 0;
+
+    do
+    {
+        if (!read_word(DBG_HCSR, &val))
+        {
+            return false;
+        }
+    } while ((val & S_HALT) == 0);
+
+    return true;
+}
+
+template <class Transport>
+inline void SWDEngine<Transport>::set_pushed_compare(bool enable)
+{
+    _pushed_compare = enable;
+}
+
+// Probe once per init_debug whether the DP implements TRNMODE.
+// Minimal DPs (MINDP) keep the field RAZ/WI, in which case readback is used.
+template <class Transport>
+inline bool SWDEngine<Transport>::pushed_supported(void)
+{
+    uint32_t status = 0;
+
+    if (_pushed_support >= 0)
+    {
+        return (_pushed_support == 1);
+    }
+
+    _pushed_support = 0;
+
+    if (!write_dp(DP_SELECT, 0))
+    {
+        return false;
+    }
+
+    if (!write_dp(DP_CTRL_STAT, CTRL_STAT_VALUE | MASKLANE | TRNVERIFY))
+    {
+        return false;
+    }
+
+    if (!read_dp(DP_CTRL_STAT, &status))
+    {
+        return false;
+    }
+
+    if ((status & TRNMODE) == TRNVERIFY)
+    {
+        _pushed_support = 1;
+    }
+
+    write_dp(DP_CTRL_STAT, CTRL_STAT_VALUE | MASKLANE | TRNNORMAL);
+
+    return (_pushed_support == 1);
+}
+
+// Leave pushed mode: wait for the last AP access, fetch CTRL/STAT and clear the sticky flags.
+template <class Transport>
+inline bool SWDEngine<Transport>::pushed_end(uint32_t *status)
+{
+    uint32_t req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+
+    // RDBUFF may FAULT once STICKYCMP is set, CTRL/STAT is what counts
+    transfer_retry(req, nullptr);
+
+    // a compare stops the AP part way through the batch
+    _dap_state.tar_valid = false;
+    _dap_state.posted = false;
+
+    if (!read_dp(DP_CTRL_STAT, status))
+    {
+        return false;
+    }
+
+    if (*status & (STICKYCMP | STICKYERR))
+    {
+        if (!write_dp(DP_ABORT, STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR))
+        {
+            return false;
+        }
+    }
+
+    return write_dp(DP_CTRL_STAT, CTRL_STAT_VALUE | MASKLANE | TRNNORMAL);
+}
+
+// Pushed verify: every DRW write makes the AP read the word and compare it, a mismatch sets STICKYCMP.
+// No read data travels back. address and size must be word aligned.
+template <class Transport>
+inline bool SWDEngine<Transport>::verify_memory_pushed(uint32_t address, const uint8_t *data, uint32_t size, bool *match)
+{
+    uint32_t req = 0;
+    uint32_t word = 0;
+    uint32_t status = 0;
+    uint32_t n = 0;
+
+    *match = true;
+
+    if ((address & 0x03) || (size & 0x03) || !pushed_supported())
+    {
+        return false;
+    }
+
+    while (size > 0)
+    {
+        // Limit to auto increment page size
+        n = TARGET_AUTO_INCREMENT_PAGE_SIZE - (address & (TARGET_AUTO_INCREMENT_PAGE_SIZE - 1));
+
+        if (size < n)
+        {
+            n = size;
+        }
+
+        if (!write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
+        {
+            return false;
+        }
+
+        if (!set_tar(address))
+        {
+            return false;
+        }
+
+        if (!write_dp(DP_CTRL_STAT, CTRL_STAT_VALUE | MASKLANE | TRNVERIFY))
+        {
+            return false;
+        }
+
+        req = SWD_REG_AP | SWD_REG_W | AP_DRW;
+        for (uint32_t i = 0; i < n; i += sizeof(uint32_t))
+        {
+            memcpy(&word, data + i, sizeof(word));
+
+            // AP accesses FAULT after a mismatch, stop and let CTRL/STAT tell
+            if (transfer_retry(req, &word) != TRANSFER_OK)
+            {
+                break;
+            }
+        }
+
+        if (!pushed_end(&status))
+        {
+            return false;
+        }
+
+        if (status & STICKYERR)
+        {
+            return false;
+        }
+
+        if (status & STICKYCMP)
+        {
+            *match = false;
+            return true;
+        }
+
+        address += n;
+        data += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+// Pushed compare: write the expected value up to count times, the AP re-reads addr each time
+// and sets STICKYCMP when the byte lanes selected by lanes (MASKLANEx) are equal.
+template <class Transport>
+inline bool SWDEngine<Transport>::poll_word_pushed(uint32_t addr, uint32_t value, uint32_t lanes, uint32_t count, bool *matched)
+{
+    uint32_t req = 0;
+    uint32_t status = 0;
+    uint32_t done = 0;
+    uint32_t ack = TRANSFER_OK;
+
+    *matched = false;
+
+    if (!pushed_supported())
+    {
+        return false;
+    }
+
+    if (!write_ap(AP_CSW, CSW_VALUE_NOINC | CSW_SIZE32))
+    {
+        return false;
+    }
+
+    if (!set_tar(addr))
+    {
+        return false;
+    }
+
+    while (done < count)
+    {
+        if (!write_dp(DP_CTRL_STAT, CTRL_STAT_VALUE | (lanes & MASKLANE) | TRNCOMPARE))
+        {
+            return false;
+        }
+
+        req = SWD_REG_AP | SWD_REG_W | AP_DRW;
+        for (uint32_t i = 0; (i < PUSHED_POLL_BATCH) && (done < count); i++, done++)
+        {
+            uint32_t expect = value;
+
+            ack = transfer_retry(req, &expect);
+            if (ack != TRANSFER_OK)
+            {
+                break;
+            }
+        }
+
+        if (!pushed_end(&status))
+        {
+            return false;
+        }
+
+        if (status & STICKYCMP)
+        {
+            *matched = true;
+            break;
+        }
+
+        if ((status & STICKYERR) || (ack != TRANSFER_OK))
+        {
+            return false;
+        }
+    }
+
+    return write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t *result)
+{
+    debug_state_t state = {{0}, 0};
+
+    // Call flash algorithm function on target and wait for result.
+    state.r[0] = arg1;                         // R0: Argument 1
+    state.r[1] = arg2;                         // R1: Argument 2
+    state.r[2] = arg3;                         // R2: Argument 3
+    state.r[3] = arg4;                         // R3: Argument 4
+    state.r[9] = sysCallParam->static_base;    // SB: Static Base
+    state.r[13] = sysCallParam->stack_pointer; // SP: Stack Pointer
+    state.r[14] = sysCallParam->breakpoint;    // LR: Exit Point
+    state.r[15] = entry;                       // PC: Entry Point
+    state.xpsr = 0x01000000;                   // xPSR: T = 1, ISR = 0
+
+    if (!write_debug_state(&state))
+    {
+        return false;
+    }
+
+    if (!wait_until_halted())
+    {
+        return false;
+    }
+
+    if (!read_core_register(0, &state.r[0]))
+    {
+        return false;
+    }
+
+    if (result)
+    {
+        *result = state.r[0];
+    }
+
+    // Flash functions return false if successful.
+    return (state.r[0] == 0);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::swd_reset(void)
+{
+    uint8_t tmp_in[8];
+
+    for (uint32_t i = 0; i < sizeof(tmp_in); i++)
+    {
+        tmp_in[i] = 0xff;
+    }
+
+    _transport.swj_sequence(51, tmp_in);
+
+    return true;
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::swd_switch(uint16_t val)
+{
+    uint8_t tmp_in[2] = {0};
+
+    tmp_in[0] = val & 0xff;
+    tmp_in[1] = (val >> 8) & 0xff;
+    _transport.swj_sequence(16, tmp_in);
+
+    return true;
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::read_idcode(uint32_t *id)
+{
+    uint8_t req = 0x00;
+
+    _transport.swj_sequence(8, &req);
+
+    return read_dp(DP_IDCODE, id);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::jtag_to_swd(void)
+{
+    uint32_t tmp = 0;
+
+    if (!swd_reset())
+    {
+        return false;
+    }
+
+    if (!swd_switch(0xE79E))
+    {
+        return false;
+    }
+
+    if (!swd_reset())
+    {
+        return false;
+    }
+
+    return read_idcode(&tmp);
+}
+
+// Switch the line to SWD and read DP IDCODE, without powering up the debug domain.
+template <class Transport>
+inline bool SWDEngine<Transport>::connect(uint32_t *idcode)
+{
+    invalidate();
+
+    if (!swd_reset())
+    {
+        return false;
+    }
+
+    if (!swd_switch(0xE79E))
+    {
+        return false;
+    }
+
+    if (!swd_reset())
+    {
+        return false;
+    }
+
+    return read_idcode(idcode);
+}
+
+// Clear sticky errors and request debug/system power, shared by init_debug and the DEBUG state.
+template <class Transport>
+inline bool SWDEngine<Transport>::power_up_debug(void)
+{
+    if (!write_dp(DP_ABORT, STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR))
+    {
+        return false;
+    }
+
+    // Ensure CTRL/STAT register selected in DPBANKSEL
+    if (!write_dp(DP_SELECT, 0))
+    {
+        return false;
+    }
+
+    // Power up
+    return write_dp(DP_CTRL_STAT, CSYSPWRUPREQ | CDBGPWRUPREQ);
+}
+
+template <class Transport>
+inline bool SWDEngine<Transport>::init_debug(void)
+{
+    int i = 0;
+    uint32_t tmp = 0;
+    int timeout = 100;
+
+    // init dap state with fake values
+    invalidate();
+    _pushed_support = -1;
+
+    _transport.init();
+
+    // call a target dependant function
+    // this function can do several stuff before really initing the debug
+    // target_before_init_debug();
+
+    if (!jtag_to_swd())
+    {
+        return false;
+    }
+
+    if (!power_up_debug())
+    {
+        return false;
+    }
+
+    for (i = 0; i < timeout; i++)
+    {
+        if (!read_dp(DP_CTRL_STAT, &tmp))
+        {
+            return false;
+        }
+
+        if ((tmp & (CDBGPWRUPACK | CSYSPWRUPACK)) == (CDBGPWRUPACK | CSYSPWRUPACK))
+        {
+            // Break from loop if powerup is complete
+            break;
+        }
+    }
+
+    if (i == timeout)
+    {
+        // Unable to powerup DP
+        return false;
+    }
+
+    if (!write_dp(DP_CTRL_STAT, CSYSPWRUPREQ | CDBGPWRUPREQ | TRNNORMAL | MASKLANE))
+    {
+        return false;
+    }
+
+    // call a target dependant function:
+    // some target can enter in a lock state, this function can unlock these targets
+    // target_unlock_sequence();
+
+    return write_dp(DP_SELECT, 0);
+}
+
+// Reset the target through SYSRESETREQ (software reset).
+template <class Transport>
+inline bool SWDEngine<Transport>::set_target_state(target_state_t state)
+{
+    uint32_t val = 0;
+
+    /* Calling swd_init prior to enterring RUN state causes operations to fail. */
+    if (state != RUN)
+    {
+        _transport.init();
+    }
+
+    switch (state)
+    {
+    case RESET_HOLD:
+        _transport.set_target_reset(1);
+        break;
+
+    case RESET_RUN:
+        // Enable debug and halt the core (DHCSR <- 0xA05F0003)
+        if (!write_word_sync(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT))
+        {
+            return false;
+        }
+
+        // Wait until core is halted
+        if (!wait_until_halted_after_reset())
+        {
+            return false;
+        }
+
+        // Perform a soft reset
+        if (!read_word(NVIC_AIRCR, &val))
+        {
+            return false;
+        }
+
+        if (!write_word_sync(NVIC_AIRCR, VECTKEY | (val & SCB_AIRCR_PRIGROUP_Msk) | SYSRESETREQ))
+        {
+            return false;
+        }
+
+        _transport.msleep(20);
+        _transport.off();
+        break;
+
+    case RESET_PROGRAM:
+        if (!init_debug())
+        {
+            return false;
+        }
+
+        // Enable debug and halt the core (DHCSR <- 0xA05F0003)
+        if (!write_word_sync(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT))
+        {
+            return false;
+        }
+
+        // Wait until core is halted
+        if (!wait_until_halted_after_reset())
+        {
+            return false;
+        }
+
+        // Enable halt on reset
+        if (!write_word_sync(DBG_EMCR, VC_CORERESET))
+        {
+            return false;
+        }
+
+        // Perform a soft reset
+        if (!read_word(NVIC_AIRCR, &val))
+        {
+            return false;
+        }
+
+        _transport.msleep(1);
+
+        if (!write_word_sync(NVIC_AIRCR, VECTKEY | (val & SCB_AIRCR_PRIGROUP_Msk) | SYSRESETREQ))
+        {
+            return false;
+        }
+
+        _transport.msleep(20);
+
+        if (!wait_until_halted_after_reset())
+        {
+            return false;
+        }
+
+        // Disable halt on reset
+        if (!write_word_sync(DBG_EMCR, 0))
+        {
+            return false;
+        }
+        break;
+
+    case NO_DEBUG:
+        if (!write_word_sync(DBG_HCSR, DBGKEY))
+        {
+            return false;
+        }
+        break;
+
+    case DEBUG:
+        if (!jtag_to_swd())
+        {
+            return false;
+        }
+
+        if (!power_up_debug())
+        {
+            return false;
+        }
+
+        // Enable debug
+        if (!write_word_sync(DBG_HCSR, DBGKEY | C_DEBUGEN))
+        {
+            return false;
+        }
+        break;
+
+    case HALT:
+        if (!init_debug())
+        {
+            return false;
+        }
+
+        // Enable debug and halt the core (DHCSR <- 0xA05F0003)
+        if (!write_word_sync(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT))
+        {
+            return false;
+        }
+
+        // Wait until core is halted
+        if (!wait_until_halted_after_reset())
+        {
+            return false;
+        }
+        break;
+
+    case RUN:
+        if (!write_word_sync(DBG_HCSR, DBGKEY))
+        {
+            return false;
+        }
+
+        _transport.off();
+        break;
+
+    case POST_FLASH_RESET:
+        // This state should be handled in target_reset.c, nothing needs to be done here.
+        break;
+
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+// Reset the target through the nRESET pin (hardware reset).
+template <class Transport>
+inline bool SWDEngine<Transport>::set_target_state_hw(target_state_t state)
+{
+    int8_t ap_retries = 2;
+
+    switch (state)
+    {
+    case RESET_RUN:
+        _transport.init();
+        _transport.set_target_reset(1);
+        _transport.msleep(20);
+        _transport.set_target_reset(0);
+        _transport.msleep(20);
+        _transport.off();
+        break;
+
+    case RESET_PROGRAM:
+        _transport.init();
+
+        if (!init_debug())
+        {
+            return false;
+        }
+
+        // Enable debug
+        while (!write_word_sync(DBG_HCSR, DBGKEY | C_DEBUGEN))
+        {
+            if (--ap_retries <= 0)
+            {
+                return false;
+            }
+
+            // Target is in invalid state?
+            _transport.set_target_reset(1);
+            _transport.msleep(20);
+            _transport.set_target_reset(0);
+            _transport.msleep(20);
+        }
+
+        // Enable halt on reset
+        if (!write_word_sync(DBG_EMCR, VC_CORERESET))
+        {
+            return false;
+        }
+
+        // Reset again
+        _transport.set_target_reset(1);
+        _transport.msleep(20);
+        _transport.set_target_reset(0);
+        _transport.msleep(20);
+
+        if (!wait_until_halted_after_reset())
+        {
+            return false;
+        }
+
+        // Disable halt on reset
+        if (!write_word_sync(DBG_EMCR, 0))
+        {
+            return false;
+        }
+        break;
+
+    default:
+        return set_target_state(state);
+    }
+
+    return true;
+}
@@ -0,0 +1,922 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <cstdint>
+#include "swd_engine.h"
+#include "debug_ca.h"
+
+/*
+ * ARMv7-A/R debug on top of an SWDEngine.
+ *
+ * The core debug registers (debug_ca.h) sit behind an APB-AP at a SoC
+ * specific base address, e.g. 0x80090000 on Zynq-7000 or 0x82150000 on
+ * i.MX6. A halted core executes ARM instructions written to DBGITR and
+ * exchanges data with the debugger through DBGDTRRX/DBGDTRTX. Block memory
+ * accesses use the DCC fast mode: one latched LDC/STC is re-issued for
+ * every DBGDTR access, so a word costs a single AP transfer.
+ *
+ * Memory and register accesses use R0 and R1 as scratch registers.
+ */
+template <class Transport>
+class CortexAEngine
+{
+public:
+    explicit CortexAEngine(SWDEngine<Transport> &engine)
+        : _engine(engine)
+    {
+    }
+
+    SWDEngine<Transport> &get_engine(void) { return _engine; }
+
+    void configure(uint8_t ap, uint32_t debug_base);
+    bool init_debug(void);
+    bool set_target_state(target_state_t state);
+    bool halt(void);
+    bool run(void);
+    bool wait_until_halted(void);
+    bool read_core_register(uint32_t n, uint32_t *val);
+    bool write_core_register(uint32_t n, uint32_t val);
+    bool read_memory(uint32_t address, uint8_t *data, uint32_t size);
+    bool write_memory(uint32_t address, uint8_t *data, uint32_t size);
+    bool read_words(const uint32_t *addr, uint32_t *val, uint32_t count);
+    bool flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t *result = nullptr);
+
+    static constexpr uint32_t REG_PC = 15;
+    static constexpr uint32_t REG_CPSR = 16;
+
+private:
+    // SWD register access, same encoding as SWDEngine
+    static constexpr uint32_t SWD_REG_AP = 1;
+    static constexpr uint32_t SWD_REG_DP = 0;
+    static constexpr uint32_t SWD_REG_R = (1 << 1);
+    static constexpr uint32_t SWD_REG_W = (0 << 1);
+    static constexpr uint32_t SWD_REG_ADR(uint32_t a) { return a & 0x0c; }
+
+    // APB-AP CSW: DbgSwEnable, 32-bit, no increment
+    static constexpr uint32_t APB_CSW_VALUE = (0x80000000 | CSW_SIZE32 | CSW_NADDRINC);
+
+    // Debug register offsets from the debug base
+    static constexpr uint32_t DTRRX_OFS = DBGDTRRX - DEBUG_REGSITER_BASE;
+    static constexpr uint32_t DRCR_OFS = DBGDRCR - DEBUG_REGSITER_BASE;
+    static constexpr uint32_t OSLAR_OFS = DBGOSLAR - DEBUG_REGSITER_BASE;
+    static constexpr uint32_t LAR_OFS = DBGLAR - DEBUG_REGSITER_BASE;
+
+    // With TAR at DBGDTRRX the banked data registers map DBGDTRRX..DBGDTRTX
+    static constexpr uint32_t AP_DTRRX = AP_BD0;
+    static constexpr uint32_t AP_ITR = AP_BD1;
+    static constexpr uint32_t AP_DSCR = AP_BD2;
+    static constexpr uint32_t AP_DTRTX = AP_BD3;
+
+    // DBGDSCR
+    static constexpr uint32_t DSCR_HALTED = (1 << 0);
+    static constexpr uint32_t DSCR_RESTARTED = (1 << 1);
+    static constexpr uint32_t DSCR_SDABORT = (1 << 6);
+    static constexpr uint32_t DSCR_ADABORT = (1 << 7);
+    static constexpr uint32_t DSCR_ITREN = (1 << 13);
+    static constexpr uint32_t DSCR_HDBGEN = (1 << 14);
+    static constexpr uint32_t DSCR_DCC_MASK = (3 << 20);
+    static constexpr uint32_t DSCR_DCC_NONBLOCKING = (0 << 20);
+    static constexpr uint32_t DSCR_DCC_FAST = (2 << 20);
+    static constexpr uint32_t DSCR_INSTR_COMPL = (1 << 24);
+    static constexpr uint32_t DSCR_TXFULL = (1 << 29);
+
+    // DBGDRCR
+    static constexpr uint32_t DRCR_HRQ = (1 << 0);
+    static constexpr uint32_t DRCR_RRQ = (1 << 1);
+    static constexpr uint32_t DRCR_CSE = (1 << 2);
+
+    static constexpr uint32_t LAR_KEY = 0xC5ACCE55;
+
+    // ARM instructions issued through DBGITR
+    static constexpr uint32_t INSTR_MCR_DTRTX(uint32_t n) { return 0xEE000E15 | (n << 12); } // MCR p14,0,Rn,c0,c5,0
+    static constexpr uint32_t INSTR_MRC_DTRRX(uint32_t n) { return 0xEE100E15 | (n << 12); } // MRC p14,0,Rn,c0,c5,0
+    static constexpr uint32_t INSTR_MOV_R0_PC = 0xE1A0000F;
+    static constexpr uint32_t INSTR_MOV_PC_R0 = 0xE1A0F000;
+    static constexpr uint32_t INSTR_MRS_R0_CPSR = 0xE10F0000;
+    static constexpr uint32_t INSTR_MSR_CPSR_R0 = 0xE12FF000; // MSR CPSR_fsxc,R0
+    static constexpr uint32_t INSTR_ISB = 0xEE070F95;         // MCR p15,0,R0,c7,c5,4
+    static constexpr uint32_t INSTR_STC_R0 = 0xECA05E01;      // STC p14,c5,[R0],#4
+    static constexpr uint32_t INSTR_LDC_R0 = 0xECB05E01;      // LDC p14,c5,[R0],#4
+    static constexpr uint32_t INSTR_STRB_R1 = 0xE4C01001;     // STRB R1,[R0],#1
+    static constexpr uint32_t INSTR_LDRB_R1 = 0xE4D01001;     // LDRB R1,[R0],#1
+
+    // Supervisor mode, IRQ and FIQ masked, ARM state
+    static constexpr uint32_t CPSR_SYSCALL = 0x1D3;
+    static constexpr uint32_t CPSR_T = (1 << 5);
+
+    static constexpr uint32_t MAX_TIMEOUT = 100000;
+    static constexpr uint32_t MAX_POLL = 100;
+
+    SWDEngine<Transport> &_engine;
+    uint32_t _apsel = 0x01000000;
+    uint32_t _debug_base = 0x80090000;
+    uint32_t _tar = 0xffffffff;
+
+    bool ap_read(uint32_t adr, uint32_t *val);
+    bool ap_write(uint32_t adr, uint32_t val);
+    bool set_tar(uint32_t addr);
+    bool read_dbg(uint32_t ofs, uint32_t *val);
+    bool write_dbg(uint32_t ofs, uint32_t val);
+    bool read_dscr(uint32_t *dscr);
+    bool write_dscr(uint32_t dscr);
+    bool wait_dscr(uint32_t mask, uint32_t *dscr);
+    bool set_dcc_mode(uint32_t mode);
+    bool exec_instr(uint32_t instr);
+    bool check_abort(void);
+    bool write_words_fast(uint32_t address, const uint8_t *data, uint32_t count);
+    bool read_words_fast(uint32_t address, uint8_t *data, uint32_t count);
+    bool write_byte(uint32_t address, uint8_t val);
+    bool read_byte(uint32_t address, uint8_t *val);
+};
+
+template <class Transport>
+inline void CortexAEngine<Transport>::configure(uint8_t ap, uint32_t debug_base)
+{
+    _apsel = static_cast<uint32_t>(ap) << 24;
+    _debug_base = debug_base;
+    _tar = 0xffffffff;
+}
+
+// Single AP read, the posted result is collected from RDBUFF. SWDEngine::read_ap
+// reads the register twice, which would consume a DBGDTRTX word.
+template <class Transport>
+inline bool CortexAEngine<Transport>::ap_read(uint32_t adr, uint32_t *val)
+{
+    if (!_engine.write_dp(DP_SELECT, _apsel | (adr & APBANKSEL)))
+    {
+        return false;
+    }
+
+    if (_engine.transfer_retry(SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(adr), nullptr) != SWDEngine<Transport>::TRANSFER_OK)
+    {
+        return false;
+    }
+
+    return (_engine.transfer_retry(SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF), val) == SWDEngine<Transport>::TRANSFER_OK);
+}
+
+// Posted AP write, faults show up as sticky errors on the next read. The engine
+// keeps its SELECT, CSW and TAR state in step when the APB-AP is AP 0.
+template <class Transport>
+inline bool CortexAEngine<Transport>::ap_write(uint32_t adr, uint32_t val)
+{
+    return _engine.write_ap(_apsel | adr, val);
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::set_tar(uint32_t addr)
+{
+    if (_tar == addr)
+    {
+        return true;
+    }
+
+    if (!ap_write(AP_TAR, addr))
+    {
+        _tar = 0xffffffff;
+        return false;
+    }
+
+    _tar = addr;
+
+    return true;
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::read_dbg(uint32_t ofs, uint32_t *val)
+{
+    if (!set_tar(_debug_base + ofs))
+    {
+        return false;
+    }
+
+    return ap_read(AP_DRW, val);
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::write_dbg(uint32_t ofs, uint32_t val)
+{
+    if (!set_tar(_debug_base + ofs))
+    {
+        return false;
+    }
+
+    return ap_write(AP_DRW, val);
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::read_dscr(uint32_t *dscr)
+{
+    if (!set_tar(_debug_base + DTRRX_OFS))
+    {
+        return false;
+    }
+
+    return ap_read(AP_DSCR, dscr);
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::write_dscr(uint32_t dscr)
+{
+    if (!set_tar(_debug_base + DTRRX_OFS))
+    {
+        return false;
+    }
+
+    return ap_write(AP_DSCR, dscr);
+}
+
+// Poll DBGDSCR until all bits of mask are set
+template <class Transport>
+inline bool CortexAEngine<Transport>::wait_dscr(uint32_t mask, uint32_t *dscr)
+{
+    for (uint32_t i = 0; i < MAX_POLL; i++)
+    {
+        if (!read_dscr(dscr))
+        {
+            return false;
+        }
+
+        if ((*dscr & mask) == mask)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::set_dcc_mode(uint32_t mode)
+{
+    uint32_t dscr = 0;
+
+    // The previous instruction must have completed before the mode changes
+    if (!wait_dscr(DSCR_INSTR_COMPL, &dscr))
+    {
+        return false;
+    }
+
+    if ((dscr & DSCR_DCC_MASK) == mode)
+    {
+        return true;
+    }
+
+    return write_dscr((dscr & ~DSCR_DCC_MASK) | mode);
+}
+
+// Execute one ARM instruction in debug state (non-blocking DCC mode)
+template <class Transport>
+inline bool CortexAEngine<Transport>::exec_instr(uint32_t instr)
+{
+    uint32_t dscr = 0;
+
+    if (!set_tar(_debug_base + DTRRX_OFS))
+    {
+        return false;
+    }
+
+    if (!ap_write(AP_ITR, instr))
+    {
+        return false;
+    }
+
+    return wait_dscr(DSCR_INSTR_COMPL, &dscr);
+}
+
+// Report and clear sticky aborts raised by instructions issued since the last check
+template <class Transport>
+inline bool CortexAEngine<Transport>::check_abort(void)
+{
+    uint32_t dscr = 0;
+
+    if (!read_dscr(&dscr))
+    {
+        return false;
+    }
+
+    if (dscr & (DSCR_SDABORT | DSCR_ADABORT))
+    {
+        write_dbg(DRCR_OFS, DRCR_CSE);
+        return false;
+    }
+
+    return true;
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::read_core_register(uint32_t n, uint32_t *val)
+{
+    uint32_t dscr = 0;
+
+    if (n == REG_PC)
+    {
+        // Reads PC + 8 in ARM state, + 4 in Thumb state
+        if (!exec_instr(INSTR_MOV_R0_PC))
+        {
+            return false;
+        }
+        n = 0;
+    }
+    else if (n == REG_CPSR)
+    {
+        if (!exec_instr(INSTR_MRS_R0_CPSR))
+        {
+            return false;
+        }
+        n = 0;
+    }
+    else if (n > 14)
+    {
+        return false;
+    }
+
+    if (!exec_instr(INSTR_MCR_DTRTX(n)))
+    {
+        return false;
+    }
+
+    if (!wait_dscr(DSCR_TXFULL, &dscr))
+    {
+        return false;
+    }
+
+    return ap_read(AP_DTRTX, val);
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::write_core_register(uint32_t n, uint32_t val)
+{
+    uint32_t r = (n > 14) ? 0 : n;
+
+    if (n > REG_CPSR)
+    {
+        return false;
+    }
+
+    if (!set_tar(_debug_base + DTRRX_OFS))
+    {
+        return false;
+    }
+
+    if (!ap_write(AP_DTRRX, val))
+    {
+        return false;
+    }
+
+    if (!exec_instr(INSTR_MRC_DTRRX(r)))
+    {
+        return false;
+    }
+
+    if (n == REG_PC)
+    {
+        return exec_instr(INSTR_MOV_PC_R0);
+    }
+
+    if (n == REG_CPSR)
+    {
+        if (!exec_instr(INSTR_MSR_CPSR_R0))
+        {
+            return false;
+        }
+
+        return exec_instr(INSTR_ISB);
+    }
+
+    return true;
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::init_debug(void)
+{
+    uint32_t dscr = 0;
+
+    _tar = 0xffffffff;
+
+    if (!_engine.init_debug())
+    {
+        return false;
+    }
+
+    if (!ap_write(AP_CSW, APB_CSW_VALUE))
+    {
+        return false;
+    }
+
+    // Unlock the memory mapped interface and clear the OS lock
+    if (!write_dbg(LAR_OFS, LAR_KEY))
+    {
+        return false;
+    }
+
+    if (!write_dbg(OSLAR_OFS, 0))
+    {
+        return false;
+    }
+
+    if (!read_dscr(&dscr))
+    {
+        return false;
+    }
+
+    // Halting debug mode, so that BKPT enters debug state
+    return write_dscr(dscr | DSCR_HDBGEN);
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::wait_until_halted(void)
+{
+    uint32_t dscr = 0;
+
+    for (uint32_t i = 0; i < MAX_TIMEOUT; i++)
+    {
+        if (!read_dscr(&dscr))
+        {
+            return false;
+        }
+
+        if (dscr & DSCR_HALTED)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::halt(void)
+{
+    uint32_t dscr = 0;
+
+    if (!write_dbg(DRCR_OFS, DRCR_HRQ))
+    {
+        return false;
+    }
+
+    if (!wait_until_halted())
+    {
+        return false;
+    }
+
+    if (!read_dscr(&dscr))
+    {
+        return false;
+    }
+
+    // Enable instruction transfer, DCC in non-blocking mode
+    dscr = (dscr & ~DSCR_DCC_MASK) | DSCR_ITREN | DSCR_DCC_NONBLOCKING;
+
+    return write_dscr(dscr);
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::run(void)
+{
+    uint32_t dscr = 0;
+
+    if (!set_dcc_mode(DSCR_DCC_NONBLOCKING))
+    {
+        return false;
+    }
+
+    if (!read_dscr(&dscr))
+    {
+        return false;
+    }
+
+    if (!write_dscr(dscr & ~DSCR_ITREN))
+    {
+        return false;
+    }
+
+    if (!write_dbg(DRCR_OFS, DRCR_RRQ | DRCR_CSE))
+    {
+        return false;
+    }
+
+    return wait_dscr(DSCR_RESTARTED, &dscr);
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::set_target_state(target_state_t state)
+{
+    uint32_t dscr = 0;
+
+    switch (state)
+    {
+    case RESET_HOLD:
+        return _engine.set_target_state(RESET_HOLD);
+
+    case RESET_PROGRAM:
+        // No SYSRESETREQ on these cores, pulse nRESET and halt the core as soon as it is up
+        if (!_engine.set_target_state_hw(RESET_RUN))
+        {
+            return false;
+        }
+
+        if (!init_debug())
+        {
+            return false;
+        }
+
+        return halt();
+
+    case RESET_RUN:
+        return _engine.set_target_state_hw(RESET_RUN);
+
+    case NO_DEBUG:
+        if (!read_dscr(&dscr))
+        {
+            return false;
+        }
+
+        return write_dscr(dscr & ~DSCR_HDBGEN);
+
+    case DEBUG:
+        return init_debug();
+
+    case HALT:
+        if (!init_debug())
+        {
+            return false;
+        }
+
+        return halt();
+
+    case RUN:
+        if (!run())
+        {
+            return false;
+        }
+
+        _engine.off();
+        break;
+
+    case POST_FLASH_RESET:
+        break;
+
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+// Stream words to memory through DBGDTRRX with STC latched in DBGITR
+template <class Transport>
+inline bool CortexAEngine<Transport>::write_words_fast(uint32_t address, const uint8_t *data, uint32_t count)
+{
+    uint32_t val = 0;
+
+    if (!write_core_register(0, address))
+    {
+        return false;
+    }
+
+    if (!set_dcc_mode(DSCR_DCC_FAST))
+    {
+        return false;
+    }
+
+    if (!ap_write(AP_ITR, INSTR_STC_R0))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        memcpy(&val, data + (i * 4), sizeof(val));
+
+        if (!ap_write(AP_DTRRX, val))
+        {
+            set_dcc_mode(DSCR_DCC_NONBLOCKING);
+            return false;
+        }
+    }
+
+    if (!set_dcc_mode(DSCR_DCC_NONBLOCKING))
+    {
+        return false;
+    }
+
+    return check_abort();
+}
+
+// Stream words from memory through DBGDTRTX, every read re-issues the latched LDC
+template <class Transport>
+inline bool CortexAEngine<Transport>::read_words_fast(uint32_t address, uint8_t *data, uint32_t count)
+{
+    uint32_t req = SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(AP_DTRTX);
+    uint32_t dscr = 0;
+    uint32_t val = 0;
+
+    if (!write_core_register(0, address))
+    {
+        return false;
+    }
+
+    // The first word is loaded in non-blocking mode
+    if (!exec_instr(INSTR_LDC_R0))
+    {
+        return false;
+    }
+
+    if (count > 1)
+    {
+        if (!set_dcc_mode(DSCR_DCC_FAST))
+        {
+            return false;
+        }
+
+        if (!ap_write(AP_ITR, INSTR_LDC_R0))
+        {
+            return false;
+        }
+
+        // AP reads are posted, each one returns the word of the previous read
+        if (_engine.transfer_retry(req, nullptr) != SWDEngine<Transport>::TRANSFER_OK)
+        {
+            set_dcc_mode(DSCR_DCC_NONBLOCKING);
+            return false;
+        }
+
+        for (uint32_t i = 1; i < count - 1; i++)
+        {
+            if (_engine.transfer_retry(req, &val) != SWDEngine<Transport>::TRANSFER_OK)
+            {
+                set_dcc_mode(DSCR_DCC_NONBLOCKING);
+                return false;
+            }
+
+            memcpy(data, &val, sizeof(val));
+            data += 4;
+        }
+
+        if (_engine.transfer_retry(SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF), &val) != SWDEngine<Transport>::TRANSFER_OK)
+        {
+            set_dcc_mode(DSCR_DCC_NONBLOCKING);
+            return false;
+        }
+
+        memcpy(data, &val, sizeof(val));
+        data += 4;
+
+        if (!set_dcc_mode(DSCR_DCC_NONBLOCKING))
+        {
+            return false;
+        }
+    }
+
+    // The last LDC has filled DBGDTRTX, unless it aborted
+    if (!check_abort())
+    {
+        return false;
+    }
+
+    if (!wait_dscr(DSCR_TXFULL, &dscr))
+    {
+        return false;
+    }
+
+    if (!ap_read(AP_DTRTX, &val))
+    {
+        return false;
+    }
+
+    memcpy(data, &val, sizeof(val));
+
+    return true;
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::write_byte(uint32_t address, uint8_t val)
+{
+    if (!write_core_register(0, address))
+    {
+        return false;
+    }
+
+    if (!write_core_register(1, val))
+    {
+        return false;
+    }
+
+    if (!exec_instr(INSTR_STRB_R1))
+    {
+        return false;
+    }
+
+    return check_abort();
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::read_byte(uint32_t address, uint8_t *val)
+{
+    uint32_t tmp = 0;
+
+    if (!write_core_register(0, address))
+    {
+        return false;
+    }
+
+    if (!exec_instr(INSTR_LDRB_R1))
+    {
+        return false;
+    }
+
+    if (!check_abort())
+    {
+        return false;
+    }
+
+    if (!read_core_register(1, &tmp))
+    {
+        return false;
+    }
+
+    *val = static_cast<uint8_t>(tmp);
+
+    return true;
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::write_memory(uint32_t address, uint8_t *data, uint32_t size)
+{
+    uint32_t n = 0;
+
+    // Write bytes until word aligned
+    while ((size > 0) && (address & 0x3))
+    {
+        if (!write_byte(address, *data))
+        {
+            return false;
+        }
+
+        address++;
+        data++;
+        size--;
+    }
+
+    n = size & ~0x3;
+
+    if (n > 0)
+    {
+        if (!write_words_fast(address, data, n / 4))
+        {
+            return false;
+        }
+
+        address += n;
+        data += n;
+        size -= n;
+    }
+
+    while (size > 0)
+    {
+        if (!write_byte(address, *data))
+        {
+            return false;
+        }
+
+        address++;
+        data++;
+        size--;
+    }
+
+    return true;
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::read_memory(uint32_t address, uint8_t *data, uint32_t size)
+{
+    uint32_t n = 0;
+
+    // Read bytes until word aligned
+    while ((size > 0) && (address & 0x3))
+    {
+        if (!read_byte(address, data))
+        {
+            return false;
+        }
+
+        address++;
+        data++;
+        size--;
+    }
+
+    n = size & ~0x3;
+
+    if (n > 0)
+    {
+        if (!read_words_fast(address, data, n / 4))
+        {
+            return false;
+        }
+
+        address += n;
+        data += n;
+        size -= n;
+    }
+
+    while (size > 0)
+    {
+        if (!read_byte(address, data))
+        {
+            return false;
+        }
+
+        address++;
+        data++;
+        size--;
+    }
+
+    return true;
+}
+
+template <class Transport>
+inline bool CortexAEngine<Transport>::read_words(const uint32_t *addr, uint32_t *val, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!read_words_fast(addr[i], reinterpret_cast<uint8_t *>(&val[i]), 1))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Run a flash algorithm function. The algorithm returns to sysCallParam->breakpoint,
+// which must hold a BKPT of the entry's instruction set (the CMSIS blob header does).
+template <class Transport>
+inline bool CortexAEngine<Transport>::flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t *result)
+{
+    uint32_t r0 = 0;
+    const uint32_t regs[][2] = {
+        {0, arg1},                         // R0: Argument 1
+        {1, arg2},                         // R1: Argument 2
+        {2, arg3},                         // R2: Argument 3
+        {3, arg4},                         // R3: Argument 4
+        {9, sysCallParam->static_base},    // SB: Static Base
+        {13, sysCallParam->stack_pointer}, // SP: Stack Pointer
+        {14, sysCallParam->breakpoint},    // LR: Exit Point
+    };
+
+    // CPSR and PC go through R0, and SP/LR are banked per mode, so they come first
+    if (!write_core_register(REG_CPSR, CPSR_SYSCALL | ((entry & 1) ? CPSR_T : 0)))
+    {
+        return false;
+    }
+
+    if (!write_core_register(REG_PC, entry & ~1))
+    {
+        return false;
+    }
+
+    for (auto &reg : regs)
+    {
+        if (!write_core_register(reg[0], reg[1]))
+        {
+            return false;
+        }
+    }
+
+    if (!run())
+    {
+        return false;
+    }
+
+    if (!wait_until_halted())
+    {
+        return false;
+    }
+
+    if (!halt())
+    {
+        return false;
+    }
+
+    if (!read_core_register(0, &r0))
+    {
+        return false;
+    }
+
+    if (result)
+    {
+        *result = r0;
+    }
+
+    // Flash functions return false if successful.
+    return (r0 == 0);
+}
@@ -28,9 +28,20 @@ typedef enum
     FLASHALGO_RETURN_POINTER
 } flash_algo_return_t;
 
+typedef struct
+{
+    uint32_t clock;       // SWJ clock frequency in Hertz
+    uint8_t idle_cycles;  // Idle cycles after transfer
+    uint16_t retry_count; // Number of retries after WAIT response
+    uint16_t match_retry; // Number of retries if read value does not match
+    uint8_t turnaround;   // Turnaround period
+    uint8_t data_phase;   // Always generate Data Phase
+} swd_config_t;
+
 uint8_t swd_init(void);
 uint8_t swd_off(void);
 uint8_t swd_init_debug(void);
+void swd_invalidate(void);
 uint8_t swd_read_dp(uint8_t adr, uint32_t *val);
 uint8_t swd_write_dp(uint8_t adr, uint32_t val);
 uint8_t swd_read_ap(uint32_t adr, uint32_t *val);
@@ -41,6 +52,10 @@ uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t e
 void swd_set_target_reset(uint8_t asserted);
 uint8_t swd_set_target_state_hw(target_state_t state);
 uint8_t swd_set_target_state_sw(target_state_t state);
+void swd_config_default(swd_config_t *cfg);
+void swd_config_save(swd_config_t *cfg);
+void swd_config_apply(const swd_config_t *cfg);
+uint32_t swd_config_calibrate(const uint32_t *clocks, uint32_t count);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "swd_engine.h"
+
+/*
+ * Simulated SWD target, usable on the host or on the device without wires.
+ *
+ * Models the DP (IDCODE, CTRL/STAT power handshake, SELECT, RDBUFF), a MEM-AP
+ * with posted reads and TAR auto-increment, a flat RAM window and a core that
+ * halts immediately when asked to run (DHCSR.S_HALT, S_REGRDY). Pushed verify
+ * and pushed compare are honoured, with AP accesses FAULTing while a sticky
+ * flag is set. set_wait() makes the next transfers answer WAIT.
+ */
+template <uint32_t RAM_BASE = 0x20000000, uint32_t RAM_SIZE = 0x4000>
+class SimTransport
+{
+public:
+    SimTransport()
+    {
+        memset(_ram, 0, sizeof(_ram));
+        memset(_core, 0, sizeof(_core));
+    }
+
+    uint8_t *ram(void) { return _ram; }
+    uint32_t transfer_count(void) const { return _transfer_count; }
+    void set_retry_count(uint32_t retry) { _retry_count = retry; }
+    void set_wait(uint32_t count) { _wait = count; }
+
+    bool init(void) { return true; }
+    bool off(void) { return true; }
+    void swj_sequence(uint32_t count, const uint8_t *data)
+    {
+        (void)count;
+        (void)data;
+    }
+
+    void set_target_reset(uint8_t asserted)
+    {
+        (void)asserted;
+    }
+
+    void msleep(uint32_t ms)
+    {
+        (void)ms;
+    }
+
+    uint32_t retry_count(void)
+    {
+        return _retry_count;
+    }
+
+    uint8_t transfer(uint32_t request, uint32_t *data)
+    {
+        uint32_t adr = request & 0x0c;
+        uint32_t value = 0;
+        bool rnw = (request & 0x02) != 0;
+
+        _transfer_count++;
+
+        if (_wait)
+        {
+            _wait--;
+            return 0x02;
+        }
+
+        if ((request & 0x01) && (_ctrl_stat & (STICKYCMP | STICKYERR)))
+        {
+            return 0x04;
+        }
+
+        if (request & 0x01)
+        {
+            // AP access, reads are posted: return the previous result
+            value = _posted;
+
+            if (rnw)
+            {
+                _posted = ap_read(adr);
+            }
+            else
+            {
+                ap_write(adr, *data);
+            }
+        }
+        else
+        {
+            if (rnw)
+            {
+                value = dp_read(adr);
+            }
+            else
+            {
+                dp_write(adr, *data);
+            }
+        }
+
+        if (rnw && (data != nullptr))
+        {
+            *data = value;
+        }
+
+        return 0x01;
+    }
+
+private:
+    uint8_t _ram[RAM_SIZE];
+    uint32_t _core[17];
+    uint32_t _ctrl_stat = 0;
+    uint32_t _select = 0;
+    uint32_t _posted = 0;
+    uint32_t _csw = 0;
+    uint32_t _tar = 0;
+    uint32_t _dhcsr = 0;
+    uint32_t _dcrdr = 0;
+    uint32_t _transfer_count = 0;
+    uint32_t _retry_count = 100;
+    uint32_t _wait = 0;
+
+    uint32_t dp_read(uint32_t adr)
+    {
+        switch (adr)
+        {
+        case 0x00:
+            return 0x2ba01477;
+        case 0x04:
+            return _ctrl_stat;
+        case 0x0c:
+        {
+            uint32_t value = _posted;
+            _posted = 0;
+            return value;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    void dp_write(uint32_t adr, uint32_t value)
+    {
+        switch (adr)
+        {
+        case 0x00:
+            if (value & STKCMPCLR)
+            {
+                _ctrl_stat &= ~STICKYCMP;
+            }
+            if (value & STKERRCLR)
+            {
+                _ctrl_stat &= ~STICKYERR;
+            }
+            break;
+        case 0x04:
+            _ctrl_stat = (_ctrl_stat & (STICKYCMP | STICKYERR)) | (value & ~(STICKYCMP | STICKYERR | CDBGPWRUPACK | CSYSPWRUPACK));
+            if (value & CDBGPWRUPREQ)
+            {
+                _ctrl_stat |= CDBGPWRUPACK;
+            }
+            if (value & CSYSPWRUPREQ)
+            {
+                _ctrl_stat |= CSYSPWRUPACK;
+            }
+            break;
+        case 0x08:
+            _select = value;
+            break;
+        default:
+            break;
+        }
+    }
+
+    uint32_t ap_read(uint32_t adr)
+    {
+        uint32_t value = 0;
+
+        switch (adr)
+        {
+        case AP_CSW:
+            return _csw;
+        case AP_TAR:
+            return _tar;
+        case AP_DRW:
+            value = mem_read(_tar & ~0x03U);
+            if ((_csw & CSW_ADDRINC) != CSW_SADDRINC)
+            {
+                return value;
+            }
+            if ((_csw & CSW_SIZE) == CSW_SIZE8)
+            {
+                _tar += 1;
+            }
+            else
+            {
+                _tar += 4;
+            }
+            return value;
+        default:
+            return 0;
+        }
+    }
+
+    void ap_write(uint32_t adr, uint32_t value)
+    {
+        switch (adr)
+        {
+        case AP_CSW:
+            _csw = value;
+            break;
+        case AP_TAR:
+            _tar = value;
+            break;
+        case AP_DRW:
+            if (_ctrl_stat & TRNMODE)
+            {
+                pushed(value);
+            }
+            else if ((_csw & CSW_SIZE) == CSW_SIZE8)
+            {
+                uint32_t shift = (_tar & 0x03) << 3;
+                uint32_t word = mem_read(_tar & ~0x03U);
+                word = (word & ~(0xffU << shift)) | (value & (0xffU << shift));
+                mem_write(_tar & ~0x03U, word);
+                _tar += 1;
+            }
+            else
+            {
+                mem_write(_tar, value);
+                _tar += ((_csw & CSW_ADDRINC) == CSW_SADDRINC) ? 4 : 0;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void pushed(uint32_t value)
+    {
+        uint32_t mask = 0;
+        uint32_t current = mem_read(_tar & ~0x03U);
+
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            if (_ctrl_stat & (MASKLANE0 << i))
+            {
+                mask |= (0xffU << (i * 8));
+            }
+        }
+
+        if ((_ctrl_stat & TRNMODE) == TRNVERIFY)
+        {
+            if ((current & mask) != (value & mask))
+            {
+                _ctrl_stat |= STICKYCMP;
+            }
+        }
+        else if ((current & mask) == (value & mask))
+        {
+            _ctrl_stat |= STICKYCMP;
+        }
+
+        if ((_csw & CSW_ADDRINC) == CSW_SADDRINC)
+        {
+            _tar += 4;
+        }
+    }
+
+    uint32_t mem_read(uint32_t addr)
+    {
+        uint32_t value = 0;
+
+        if ((addr >= RAM_BASE) && (addr + 4 <= RAM_BASE + RAM_SIZE))
+        {
+            memcpy(&value, &_ram[addr - RAM_BASE], sizeof(value));
+            return value;
+        }
+
+        switch (addr)
+        {
+        case DBG_HCSR:
+            return _dhcsr | S_REGRDY;
+        case DBG_CRDR:
+            return _dcrdr;
+        default:
+            return 0;
+        }
+    }
+
+    void mem_write(uint32_t addr, uint32_t value)
+    {
+        if ((addr >= RAM_BASE) && (addr + 4 <= RAM_BASE + RAM_SIZE))
+        {
+            memcpy(&_ram[addr - RAM_BASE], &value, sizeof(value));
+            return;
+        }
+
+        switch (addr)
+        {
+        case DBG_HCSR:
+            // the simulated core halts as soon as it is debugged, or returns from a call
+            _dhcsr = (value & 0xffff) | ((value & C_DEBUGEN) ? S_HALT : 0);
+            break;
+        case DBG_CRSR:
+            if ((value & 0x1f) <= 16)
+            {
+                if (value & (1 << 16))
+                {
+                    _core[value & 0x1f] = _dcrdr;
+                }
+                else
+                {
+                    _dcrdr = _core[value & 0x1f];
+                }
+            }
+            break;
+        case DBG_CRDR:
+            _dcrdr = value;
+            break;
+        default:
+            break;
+        }
+    }
+};
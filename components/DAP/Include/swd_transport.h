@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <cstdint>
+#include "DAP_config.h"
+#include "DAP.h"
+#include "swd_host.h"
+#include "swd_engine.h"
+
+/*
+ * Transport over the bit-bang SWD port in SW_DP.c.
+ */
+class DapTransport
+{
+public:
+    // DAP_Data (clock, retry, turnaround) is left as configured, see swd_config_apply()
+    bool init(void)
+    {
+        PORT_SWD_SETUP();
+        return true;
+    }
+
+    bool off(void)
+    {
+        PORT_OFF();
+        return true;
+    }
+
+    uint8_t transfer(uint32_t request, uint32_t *data)
+    {
+        return SWD_Transfer(request, data);
+    }
+
+    void swj_sequence(uint32_t count, const uint8_t *data)
+    {
+        SWJ_Sequence(count, data);
+    }
+
+    void set_target_reset(uint8_t asserted)
+    {
+        swd_set_target_reset(asserted);
+    }
+
+    void msleep(uint32_t ms)
+    {
+        vTaskDelay(ms / portTICK_PERIOD_MS);
+    }
+
+    uint32_t retry_count(void)
+    {
+        return DAP_Data.transfer.retry_count;
+    }
+};
+
+/*
+ * Instantiated once in swd_host.cpp, which linker.lf maps to IRAM, so the
+ * programmer's SWD path does not run from flash in the other components.
+ */
+extern template class SWDEngine<DapTransport>;
+
+/*
+ * Engine instance behind the C API in swd_host.h.
+ */
+SWDEngine<DapTransport> &swd_host_engine(void);
@@ -409,6 +409,20 @@ static void Set_DAP_Clock_Delay(uint32_t clock) {
 }
 
 
+// Set SWJ clock frequency outside of a DAP command
+//   clock:    requested SWJ frequency in Hertz
+//   return:   void
+void DAP_SetClock(uint32_t clock) {
+  if (clock == 0U) {
+    return;
+  }
+
+  DAP_Data.nominal_clock = clock;
+
+  Set_DAP_Clock_Delay(clock);
+}
+
+
 // Process SWJ Clock command and prepare response
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "swd_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static SemaphoreHandle_t s_bus_mutex = NULL;
+
+void swd_bus_init(void)
+{
+    if (s_bus_mutex == NULL)
+    {
+        s_bus_mutex = xSemaphoreCreateRecursiveMutex();
+    }
+}
+
+uint8_t swd_bus_lock(uint32_t timeout_ms)
+{
+    TickType_t ticks = (timeout_ms != portMAX_DELAY) ? (pdMS_TO_TICKS(timeout_ms)) : (portMAX_DELAY);
+
+    if (s_bus_mutex == NULL)
+    {
+        return 0;
+    }
+
+    return (xSemaphoreTakeRecursive(s_bus_mutex, ticks) == pdTRUE);
+}
+
+void swd_bus_unlock(void)
+{
+    if (s_bus_mutex != NULL)
+    {
+        xSemaphoreGiveRecursive(s_bus_mutex);
+    }
+}
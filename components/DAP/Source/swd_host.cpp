@@ -0,0 +1,166 @@
+/**
+ * @file    swd_host.cpp
+ * @brief   Host driver for accessing the DAP, C API over SWDEngine
+ */
+
+#include "swd_host.h"
+#include "swd_transport.h"
+
+template class SWDEngine<DapTransport>;
+
+SWDEngine<DapTransport> &swd_host_engine(void)
+{
+    static SWDEngine<DapTransport> engine;
+    return engine;
+}
+
+uint8_t swd_init(void)
+{
+    return swd_host_engine().init();
+}
+
+uint8_t swd_off(void)
+{
+    return swd_host_engine().off();
+}
+
+uint8_t swd_init_debug(void)
+{
+    return swd_host_engine().init_debug();
+}
+
+// Forget the cached SELECT, CSW and TAR, e.g. after commands of an attached debugger.
+void swd_invalidate(void)
+{
+    swd_host_engine().invalidate();
+}
+
+// Read debug port register.
+uint8_t swd_read_dp(uint8_t adr, uint32_t *val)
+{
+    return swd_host_engine().read_dp(adr, val);
+}
+
+// Write debug port register
+uint8_t swd_write_dp(uint8_t adr, uint32_t val)
+{
+    return swd_host_engine().write_dp(adr, val);
+}
+
+// Read access port register.
+uint8_t swd_read_ap(uint32_t adr, uint32_t *val)
+{
+    return swd_host_engine().read_ap(adr, val);
+}
+
+// Write access port register
+uint8_t swd_write_ap(uint32_t adr, uint32_t val)
+{
+    return swd_host_engine().write_ap(adr, val);
+}
+
+// Read unaligned data from target memory.
+// size is in bytes.
+uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size)
+{
+    return swd_host_engine().read_memory(address, data, size);
+}
+
+// Write unaligned data to target memory.
+// size is in bytes.
+uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size)
+{
+    return swd_host_engine().write_memory(address, data, size);
+}
+
+uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4)
+{
+    return swd_host_engine().flash_syscall_exec(sysCallParam, entry, arg1, arg2, arg3, arg4);
+}
+
+__attribute__((weak)) void swd_set_target_reset(uint8_t asserted)
+{
+    (asserted) ? PIN_nRESET_OUT(0) : PIN_nRESET_OUT(1);
+}
+
+uint8_t swd_set_target_state_hw(target_state_t state)
+{
+    return swd_host_engine().set_target_state_hw(state);
+}
+
+uint8_t swd_set_target_state_sw(target_state_t state)
+{
+    return swd_host_engine().set_target_state(state);
+}
+
+void swd_config_default(swd_config_t *cfg)
+{
+    cfg->clock = DAP_DEFAULT_SWJ_CLOCK;
+    cfg->idle_cycles = 0U;
+    cfg->retry_count = 100U;
+    cfg->match_retry = 0U;
+    cfg->turnaround = 1U;
+    cfg->data_phase = 0U;
+}
+
+// Capture the transfer settings currently held in DAP_Data, e.g. those of an attached debugger.
+void swd_config_save(swd_config_t *cfg)
+{
+    cfg->clock = DAP_Data.nominal_clock;
+    cfg->idle_cycles = DAP_Data.transfer.idle_cycles;
+    cfg->retry_count = DAP_Data.transfer.retry_count;
+    cfg->match_retry = DAP_Data.transfer.match_retry;
+    cfg->turnaround = DAP_Data.swd_conf.turnaround;
+    cfg->data_phase = DAP_Data.swd_conf.data_phase;
+}
+
+void swd_config_apply(const swd_config_t *cfg)
+{
+    DAP_Data.transfer.idle_cycles = cfg->idle_cycles;
+    DAP_Data.transfer.retry_count = cfg->retry_count;
+    DAP_Data.transfer.match_retry = cfg->match_retry;
+    DAP_Data.swd_conf.turnaround = cfg->turnaround;
+    DAP_Data.swd_conf.data_phase = cfg->data_phase;
+    DAP_SetClock(cfg->clock);
+}
+
+// Try the clocks in order (fastest first) and return the first one at which
+// IDCODE reads back consistently, 0 if none works. DAP_Data is left at that clock.
+uint32_t swd_config_calibrate(const uint32_t *clocks, uint32_t count)
+{
+    SWDEngine<DapTransport> &engine = swd_host_engine();
+    uint32_t first = 0;
+    uint32_t id = 0;
+    uint32_t i = 0;
+    uint32_t n = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        DAP_SetClock(clocks[i]);
+        engine.init();
+
+        for (n = 0; n < 8; n++)
+        {
+            if (!engine.connect(&id) || (id == 0) || (id == 0xffffffff))
+            {
+                break;
+            }
+
+            if (n == 0)
+            {
+                first = id;
+            }
+            else if (id != first)
+            {
+                break;
+            }
+        }
+
+        if (n == 8)
+        {
+            return clocks[i];
+        }
+    }
+
+    return 0;
+}
@@ -11,6 +11,7 @@
 
 #include <string>
 #include "flash_accessor.h"
+#include "program_pipeline.h"
 #include "program_iface.h"
 #include "ff.h"
 
@@ -18,13 +19,16 @@ class BinaryProgram : public ProgramIface
 {
 protected:
     FlashAccessor &_flash_accessor;
+    ProgramPipeline &_pipeline;
     uint32_t _program_addr;
 
 public:
     BinaryProgram();
     virtual ~BinaryProgram();
     virtual bool init(const FlashIface::target_cfg_t &cfg, uint32_t program_start_addr = 0) override;
+    virtual bool prepare(size_t image_size) override;
     virtual bool write(uint8_t *data, size_t len) override;
+    virtual bool flush(void) override;
     virtual size_t get_program_address(void) override;
     virtual void clean(void) override;
 };
\ No newline at end of file
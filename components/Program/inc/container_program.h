@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <vector>
+#include "bin_program.h"
+#include "hash_engine.h"
+#include "image_container.h"
+#include "kernels.h"
+
+/*
+ * Streaming reader of the image container (image_container.h).
+ *
+ * Header and tables are read first and checked against their CRC, then every
+ * payload block is decoded, checked against its CRC and queued on the
+ * pipeline. The erase is planned from the extent table: every run of blocks
+ * is erased before its first write. With diff enabled the target CRC of every
+ * block is read up front and only the sectors holding a changed block are
+ * erased and programmed.
+ */
+class ContainerProgram : public BinaryProgram
+{
+private:
+    typedef enum
+    {
+        STATE_HEADER,
+        STATE_TABLES,
+        STATE_PAYLOAD,
+        STATE_DONE,
+        STATE_ERROR,
+    } state_t;
+
+    static constexpr uint32_t _block_size_min = 256;
+    static constexpr uint32_t _block_size_max = 4096;
+    static constexpr uint32_t _tables_size_max = 32 * 1024;
+
+    state_t _state;
+    image_container_header_t _header;
+    std::vector<uint8_t> _tables;
+    const image_container_extent_t *_extents;
+    const image_container_block_t *_blocks;
+    const image_container_patch_t *_patches;
+    std::vector<bool> _program; // block differs from the target, or no diff
+    uint32_t _fill;             // bytes of the current header, tables or block
+    uint32_t _block;
+    uint32_t _extent; // extent of _block
+    uint32_t _erased_end;
+    uint32_t _unchanged;
+    bool _diff;
+    HashEngine _sha;
+    KERNEL_ALIGN uint8_t _stored[_block_size_max];
+    KERNEL_ALIGN uint8_t _decoded[_block_size_max];
+
+    uint32_t consume(uint8_t *dst, uint32_t size, const uint8_t *data, uint32_t len);
+    bool check_header(void);
+    bool check_tables(void);
+    bool plan_diff(void);
+    bool erase_run(uint32_t block);
+    bool write_block(void);
+    uint32_t block_addr(uint32_t block, uint32_t extent);
+    uint32_t block_size(uint32_t block, uint32_t extent);
+    uint32_t find_extent(uint32_t block);
+    bool patched(uint32_t addr, uint32_t size);
+    void apply_patches(uint32_t addr, uint32_t size);
+
+public:
+    ContainerProgram();
+    void set_diff(bool diff);
+    uint32_t get_unchanged_blocks(void);
+    virtual bool init(const FlashIface::target_cfg_t &cfg, uint32_t program_addr = 0) override;
+    virtual bool prepare(size_t image_size) override;
+    virtual bool write(uint8_t *data, size_t len) override;
+    virtual bool flush(void) override;
+    virtual void clean(void) override;
+    static bool read_header(const std::string &path, image_container_header_t &header);
+};
@@ -8,21 +8,31 @@ class FileProgrammer
 public:
     using progress_changed_cb_t = std::function<void(int progress)>;
 
+    typedef enum
+    {
+        IMAGE_BIN,
+        IMAGE_HEX,
+        IMAGE_CONTAINER
+    } image_format_t;
+
 private:
     ProgramIface &_binary_program;
     ProgramIface &_hex_program;
+    ProgramIface &_container_program;
     int _program_progress;
     progress_changed_cb_t _progress_changed_cb;
 
     static constexpr int _buf_size = 256;
+    static constexpr uint32_t _image_chunk_size = 4096;
     uint8_t _buffer[_buf_size];
 
     ProgramIface *selcet_program_iface(const std::string &path);
     void set_program_progress(int progress);
 
 public:
-    FileProgrammer(ProgramIface &binary_program, ProgramIface &hex_program);
+    FileProgrammer(ProgramIface &binary_program, ProgramIface &hex_program, ProgramIface &container_program);
     bool program(const std::string &path, FlashIface::target_cfg_t &cfg, uint32_t program_addr = 0);
+    bool program(const uint8_t *image, uint32_t size, image_format_t format, FlashIface::target_cfg_t &cfg, uint32_t program_addr = 0);
     int get_program_progress(void);
     void register_progress_changed_callback(const progress_changed_cb_t &func);
     static bool is_exist(const char *path);
@@ -9,10 +9,23 @@
  */
 #pragma once
 
+#include <functional>
 #include "target_flash.h"
 
 class FlashAccessor : public TargetFlash
 {
+public:
+    typedef std::function<bool(void)> slow_down_cb_t; // lower the SWD clock, false when it cannot go lower
+
+    typedef struct
+    {
+        uint32_t errors;         // failed erase/program operations
+        uint32_t reconnects;     // successful recover() runs
+        uint32_t recovered;      // operations that passed on a retry
+        uint32_t sector_retries; // sectors erased again to redo a block
+        uint32_t clock_drops;
+    } recovery_stat_t;
+
 private:
     static constexpr uint32_t _page_size = 1024;
     FlashIface::state_t _flash_state;
@@ -22,17 +35,29 @@ private:
     uint32_t _current_write_block_size;
     uint32_t _current_sector_addr;
     uint32_t _current_sector_size;
+    uint32_t _erased_start; // sectors starting in [_erased_start, _erased_end) are already erased
+    uint32_t _erased_end;
     bool _page_buf_empty;
-    uint8_t _page_buffer[_page_size];
+    uint8_t _retries;
+    slow_down_cb_t _slow_down;
+    recovery_stat_t _recovery;
+    KERNEL_ALIGN uint8_t _page_buffer[_page_size];
 
     FlashAccessor();
     FlashIface::err_t flush_current_block(uint32_t addr);
     FlashIface::err_t setup_next_sector(uint32_t addr);
+    FlashIface::err_t erase_sector(uint32_t addr);
+    FlashIface::err_t program_block(uint32_t addr, const uint8_t *buf, uint32_t size);
+    bool recover_attempt(uint8_t attempt);
 
 public:
     ~FlashAccessor() = default;
     static FlashAccessor &get_instance();
     FlashIface::err_t init(const target_cfg_t &cfg);
+    void set_recovery(uint8_t retries, const slow_down_cb_t &slow_down = nullptr);
+    const recovery_stat_t &get_recovery_stat(void) const;
+    FlashIface::err_t erase(uint32_t addr, uint32_t size);
     FlashIface::err_t write(uint32_t addr, const uint8_t *data, uint32_t size);
+    FlashIface::err_t checksum(uint32_t addr, uint32_t size, uint32_t &crc);
     FlashIface::err_t uninit();
 };
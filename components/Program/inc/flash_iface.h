@@ -107,6 +107,7 @@ public:
     virtual err_t flash_uninit(void) = 0;
     virtual err_t flash_program_page(uint32_t addr, const uint8_t *buf, uint32_t size) = 0;
     virtual err_t flash_erase_sector(uint32_t sector) = 0;
+    virtual err_t flash_erase_range(uint32_t addr, uint32_t size) = 0;
     virtual err_t flash_erase_chip(void) = 0;
     virtual uint32_t flash_program_page_min_size(uint32_t addr) = 0;
     virtual uint32_t flash_erase_sector_size(uint32_t addr) = 0;
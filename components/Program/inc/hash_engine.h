@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#ifdef ESP_PLATFORM
+#include "mbedtls/sha256.h"
+#endif
+
+/*
+ * Streaming content hash.
+ *
+ * update() reads the caller's buffer in place, so ring slots and upload
+ * buffers can be hashed where they are. On the device SHA-256 runs through
+ * mbedtls, which drives the SHA peripheral (DMA for large blocks on the
+ * ESP32-S3); host builds use the software implementation below. CRC32 is the
+ * table driven kernel_crc32 everywhere. HASH_SHA256_SOFT is the software
+ * SHA-256 on every build, the device benchmark measures the peripheral
+ * against it.
+ */
+class HashEngine
+{
+public:
+    typedef enum
+    {
+        HASH_SHA256,
+        HASH_CRC32,
+        HASH_SHA256_SOFT
+    } algo_t;
+
+    static constexpr size_t max_digest_size = 32;
+
+    explicit HashEngine(algo_t algo = HASH_SHA256);
+    ~HashEngine();
+    HashEngine(const HashEngine &) = delete;
+    HashEngine &operator=(const HashEngine &) = delete;
+
+    void begin(void);
+    void update(const uint8_t *data, size_t len);
+    size_t finish(uint8_t *digest); // returns digest_size()
+    size_t digest_size(void) const;
+    algo_t get_algo(void) const;
+
+    static std::string to_hex(const uint8_t *digest, size_t len);
+
+private:
+    algo_t _algo;
+    uint32_t _crc;
+
+#ifdef ESP_PLATFORM
+    mbedtls_sha256_context _sha;
+#endif
+
+    typedef struct
+    {
+        uint32_t state[8];
+        uint64_t length;
+        uint8_t block[64];
+        size_t used;
+    } sha256_t;
+
+    sha256_t _soft;
+
+    void soft_begin(void);
+    void soft_update(const uint8_t *data, size_t len);
+    void soft_finish(uint8_t *digest);
+    static void sha256_transform(uint32_t *state, const uint8_t *block);
+};
@@ -25,5 +25,6 @@ private:
 public:
     HexProgram();
     virtual bool init(const FlashIface::target_cfg_t &cfg, uint32_t program_addr) override;
+    virtual bool prepare(size_t image_size) override;
     virtual bool write(uint8_t *data, size_t len) override;
 };
\ No newline at end of file
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Probe image container (.dapi), little endian:
+ *
+ *   header | extents[extent_num] | blocks[block_num] | patches[patch_num] | payload
+ *
+ * Extents are sorted by address and do not overlap. Every extent is cut into
+ * blocks of block_size bytes from its start, the last one may be shorter, and
+ * the blocks of all extents are numbered in order. The payload holds the
+ * blocks back to back, each one raw or as an LZ4 block when that is smaller
+ * (stored_size below the decoded size).
+ *
+ * Block CRCs and the SHA-256 cover the image before patches are applied.
+ * header.crc is kernel_crc32() over the header up to the crc field, chained
+ * over the three tables.
+ */
+#define IMAGE_CONTAINER_MAGIC 0x49504144 // "DAPI"
+#define IMAGE_CONTAINER_VERSION 1
+#define IMAGE_CONTAINER_ALGO_LEN 32
+#define IMAGE_CONTAINER_PATCH_LEN 8
+#define IMAGE_CONTAINER_FLAG_LZ4 (1 << 0) // some blocks are compressed
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t flags;
+    uint32_t block_size; // power of two
+    uint32_t extent_num;
+    uint32_t block_num;
+    uint32_t patch_num;
+    uint32_t image_size;   // sum of the extent sizes
+    uint32_t payload_size; // sum of the stored block sizes
+    uint32_t ram_addr;     // of the algorithm, 0 if not set
+    char algorithm[IMAGE_CONTAINER_ALGO_LEN];
+    uint8_t sha256[32]; // of the extents in order
+    uint32_t crc;
+} image_container_header_t;
+
+typedef struct
+{
+    uint32_t addr;
+    uint32_t size;
+    uint32_t block; // index of its first block
+} image_container_extent_t;
+
+typedef struct
+{
+    uint32_t crc; // kernel_crc32 of the decoded block
+    uint32_t stored_size;
+} image_container_block_t;
+
+/* Bytes replaced while programming, e.g. a serial number or a calibration word */
+typedef struct
+{
+    uint32_t addr;
+    uint32_t size;
+    uint8_t data[IMAGE_CONTAINER_PATCH_LEN];
+} image_container_patch_t;
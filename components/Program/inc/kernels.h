@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Byte loop kernels of the programming path.
+ *
+ * With PROGRAMMER_KERNEL_PIE on the ESP32-S3, blank check and compare run on
+ * the PIE 128-bit vector unit when the buffers allow it. Everything else (and
+ * every other build, the host included) uses portable word-wide code. Buffers
+ * that are 16 byte aligned get the most out of the vector path.
+ */
+#define KERNEL_ALIGN __attribute__((aligned(16)))
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* Turn the vector path on or off, returns true if it is in use afterwards.
+     * It is on by default where it exists and passes its self test. */
+    bool kernel_set_vector(bool enable);
+
+    /* true if all size bytes are 0xFF */
+    bool kernel_is_blank(const uint8_t *data, uint32_t size);
+
+    /* true if a and b hold the same size bytes */
+    bool kernel_equal(const uint8_t *a, const uint8_t *b, uint32_t size);
+
+    /* IEEE 802.3 CRC32 (zlib compatible), start with crc = 0 and chain the result */
+    uint32_t kernel_crc32(uint32_t crc, const uint8_t *data, uint32_t size);
+
+    /* Sum of all bytes modulo 256 */
+    uint8_t kernel_sum8(const uint8_t *data, uint32_t size);
+
+    /* Decode up to count bytes from 2 * count ASCII hex digits, stops at the first
+     * pair that is not a valid hex digit pair. Returns the number of bytes decoded. */
+    uint32_t kernel_hex_decode(const uint8_t *hex, uint8_t *bin, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * LZ4 block format (no frame), enough for the image container: blocks are at
+ * most 64 KB and decoded independently, so no history is kept between them.
+ */
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* Returns the decoded size, -1 if the input is malformed or does not fit into dst */
+    int32_t lz4_block_decode(const uint8_t *src, uint32_t src_size, uint8_t *dst, uint32_t dst_size);
+
+    /* Greedy encoder. Returns the encoded size, 0 if src is larger than 64 KB or the result does not fit into dst */
+    uint32_t lz4_block_encode(const uint8_t *src, uint32_t src_size, uint8_t *dst, uint32_t dst_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /*
+     * Placement policy of the large buffers.
+     *
+     * MEM_TIER_FAST is internal, DMA capable RAM: buffers that DMA or the SWD
+     * and USB paths touch on every transfer. MEM_TIER_BULK is PSRAM when the
+     * module has it: staging buffers that are filled once and read in order,
+     * upload chunks, flash algorithm blobs, serial rings. Without PSRAM, or
+     * once it is full, a bulk request falls back to internal RAM only while
+     * the largest free internal block stays above CONFIG_MEM_TIER_INTERNAL_RESERVE,
+     * bulk traffic never fragments the heap Wi-Fi, lwIP and the task stacks
+     * live on.
+     *
+     * Each tier has a budget (CONFIG_MEM_TIER_*_BUDGET, 0: unlimited), requests
+     * beyond it fail instead of starving the rest of the system. Blocks are
+     * 16 byte aligned (KERNEL_ALIGN).
+     */
+    typedef enum
+    {
+        MEM_TIER_FAST,
+        MEM_TIER_BULK,
+        MEM_TIER_NUM,
+    } mem_tier_t;
+
+    typedef struct
+    {
+        size_t budget; // bytes, 0: unlimited
+        size_t used;
+        size_t peak;
+        uint32_t allocs; // live blocks
+        uint32_t failures;
+        uint32_t fallbacks; // bulk blocks placed in internal RAM
+    } mem_tier_stat_t;
+
+    void mem_tier_init(void);
+    void *mem_tier_alloc(mem_tier_t tier, size_t size);
+    void mem_tier_free(void *ptr);
+    void mem_tier_get_stat(mem_tier_t tier, mem_tier_stat_t *stat);
+    void mem_tier_report(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,7 +7,9 @@ class ProgramIface
 public:
     virtual ~ProgramIface() = default;
     virtual bool init(const FlashIface::target_cfg_t &cfg, uint32_t program_start_addr = 0) = 0;
+    virtual bool prepare(size_t image_size) { return true; } // image length known before the first write
     virtual bool write(uint8_t *data, size_t len) = 0;
+    virtual bool flush(void) = 0; // wait until everything written is programmed
     virtual size_t get_program_address(void) = 0;
     virtual void clean(void) = 0;
 };
\ No newline at end of file
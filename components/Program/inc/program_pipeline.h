@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "flash_accessor.h"
+#include "spsc_queue.h"
+#include "hash_engine.h"
+
+/*
+ * Two stage programming pipeline.
+ *
+ * The decode stage (the caller of write(), hex parsing included) hands decoded
+ * extents to the SWD stage, a task of its own that feeds them to the
+ * FlashAccessor. On a dual core chip it is pinned to the other core, on a
+ * single core the stages interleave. The stages are connected by a bounded SPSC ring, the time
+ * each stage spends waiting for the other is accumulated so the bottleneck of
+ * a job shows up in get_stats().
+ *
+ * Until start() is called, write() programs synchronously on the caller.
+ */
+class ProgramPipeline
+{
+public:
+    typedef struct
+    {
+        uint32_t extents;
+        uint32_t bytes;
+        uint64_t decode_stall_us; // decode stage waiting for a free slot: SWD bound
+        uint64_t swd_stall_us;    // SWD stage waiting for data: decode bound
+        uint64_t swd_busy_us;
+        uint32_t crc32; // of the programmed data in the order it was written
+    } stats_t;
+
+private:
+    static constexpr uint32_t _extent_size = 256;
+    static constexpr uint32_t _extent_count = 8;
+
+    typedef struct
+    {
+        uint32_t addr;
+        uint32_t size;
+        uint8_t data[_extent_size];
+    } extent_t;
+
+    FlashAccessor &_flash_accessor;
+    SpscQueue<extent_t, _extent_count> _queue;
+    TaskHandle_t _task;
+    TaskHandle_t _producer;
+    std::atomic<bool> _active;
+    std::atomic<bool> _failed;
+    stats_t _stats;
+    HashEngine _crc;
+
+    ProgramPipeline();
+    static void swd_stage(void *arg);
+
+public:
+    static ProgramPipeline &get_instance();
+    bool start(int core);
+    void begin(void);
+    bool write(uint32_t addr, const uint8_t *data, uint32_t size);
+    bool drain(void);
+    bool flush(void);
+    stats_t get_stats(void);
+};
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Bounded single producer, single consumer ring of N slots.
+ *
+ * Slots are filled and drained in place: the producer fills back() and calls
+ * push(), the consumer reads front() and calls pop(). Neither side ever blocks,
+ * back() and front() return nullptr when the ring is full or empty.
+ */
+template <class T, uint32_t N>
+class SpscQueue
+{
+    static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+public:
+    T *back(void)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+
+        if (head - _tail.load(std::memory_order_acquire) == N)
+        {
+            return nullptr;
+        }
+
+        return &_slots[head & (N - 1)];
+    }
+
+    void push(void)
+    {
+        _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    T *front(void)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+
+        if (_head.load(std::memory_order_acquire) == tail)
+        {
+            return nullptr;
+        }
+
+        return &_slots[tail & (N - 1)];
+    }
+
+    void pop(void)
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Safe on either side
+    bool empty(void) const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T _slots[N];
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _tail{0};
+};
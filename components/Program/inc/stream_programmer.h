@@ -22,5 +22,6 @@ public:
     ~StreamProgrammer();
     bool init(StreamProgrammer::Mode mode, FlashIface::target_cfg_t &cfg, uint32_t program_addr = 0);
     bool write(uint8_t *data, size_t len);
+    bool flush(void);
     void clean(void);
 };
@@ -10,6 +10,8 @@
 #pragma once
 
 #include <cstdint>
+#include "swd_engine.h"
+#include "swd_engine_ca.h"
 
 class SWDIface
 {
@@ -49,50 +51,178 @@ public:
     virtual void msleep(uint32_t ms) = 0;
     virtual bool init(void) = 0;
     virtual bool off(void) = 0;
-    virtual transfer_err_def transer(uint32_t request, uint32_t *data) = 0;
-    virtual void swj_sequence(uint32_t count, const uint8_t *data) = 0;
-    virtual void set_target_reset(uint8_t asserted) = 0;
-
-    bool init_debug(void);
-    transfer_err_def transfer_retry(uint32_t req, uint32_t *data);
-    bool read_dp(uint8_t adr, uint32_t *val);
-    bool write_dp(uint8_t adr, uint32_t val);
-    bool read_ap(uint32_t adr, uint32_t *val);
-    bool write_ap(uint32_t adr, uint32_t val);
-    bool set_target_state(target_state_t state);
-    bool read_memory(uint32_t address, uint8_t *data, uint32_t size);
-    bool write_memory(uint32_t address, uint8_t *data, uint32_t size);
-    bool flash_syscall_exec(const syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4);
-
-protected:
-    typedef struct
+    virtual bool init_debug(void) = 0;
+    virtual bool read_dp(uint8_t adr, uint32_t *val) = 0;
+    virtual bool write_dp(uint8_t adr, uint32_t val) = 0;
+    virtual bool read_ap(uint32_t adr, uint32_t *val) = 0;
+    virtual bool write_ap(uint32_t adr, uint32_t val) = 0;
+    virtual bool set_target_state(target_state_t state) = 0;
+    virtual bool read_memory(uint32_t address, uint8_t *data, uint32_t size) = 0;
+    virtual bool write_memory(uint32_t address, uint8_t *data, uint32_t size) = 0;
+    virtual bool read_words(const uint32_t *addr, uint32_t *val, uint32_t count) = 0; // pipelined, sequential words skip TAR
+    virtual bool flash_syscall_exec(const syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t *result = nullptr) = 0; // result: R0 on return
+    virtual void set_pushed_compare(bool enable) = 0;
+    virtual bool verify_memory_pushed(uint32_t address, const uint8_t *data, uint32_t size, bool *match) = 0;
+};
+
+/*
+ * SWDIface on top of an SWDEngine. Dispatch is virtual per operation only,
+ * the word level loops inside the engine call the transport directly.
+ */
+template <class Transport>
+class SWDHost : public SWDIface
+{
+public:
+    explicit SWDHost(SWDEngine<Transport> &engine)
+        : _engine(engine)
     {
-        uint32_t select;
-        uint32_t csw;
-    } dap_state_t;
+    }
 
-    typedef struct
+    SWDEngine<Transport> &get_engine(void) { return _engine; }
+
+    virtual void msleep(uint32_t ms) override
+    {
+        _engine.msleep(ms);
+    }
+
+    virtual bool init(void) override
+    {
+        return _engine.init();
+    }
+
+    virtual bool off(void) override
+    {
+        return _engine.off();
+    }
+
+    virtual bool init_debug(void) override
+    {
+        return _engine.init_debug();
+    }
+
+    virtual bool read_dp(uint8_t adr, uint32_t *val) override
     {
-        uint32_t r[16];
-        uint32_t xpsr;
-    } debug_state_t;
-
-    dap_state_t _dap_state;
-
-    bool write_block(uint32_t address, uint8_t *data, uint32_t size);
-    bool read_block(uint32_t address, uint8_t *data, uint32_t size);
-    bool read_data(uint32_t addr, uint32_t *val);
-    bool write_data(uint32_t address, uint32_t data);
-    bool read_word(uint32_t addr, uint32_t *val);
-    bool write_word(uint32_t addr, uint32_t val);
-    bool read_byte(uint32_t addr, uint8_t *val);
-    bool write_byte(uint32_t addr, uint8_t val);
-    bool read_core_register(uint32_t n, uint32_t *val);
-    bool write_core_register(uint32_t n, uint32_t val);
-    bool write_debug_state(debug_state_t *state);
-    bool wait_until_halted(void);
-    bool swd_reset(void);
-    bool swd_switch(uint16_t val);
-    bool read_idcode(uint32_t *id);
-    bool jtag_to_swd(void);
+        return _engine.read_dp(adr, val);
+    }
+
+    virtual bool write_dp(uint8_t adr, uint32_t val) override
+    {
+        return _engine.write_dp(adr, val);
+    }
+
+    virtual bool read_ap(uint32_t adr, uint32_t *val) override
+    {
+        return _engine.read_ap(adr, val);
+    }
+
+    virtual bool write_ap(uint32_t adr, uint32_t val) override
+    {
+        return _engine.write_ap(adr, val);
+    }
+
+    virtual bool set_target_state(target_state_t state) override
+    {
+        return _engine.set_target_state(static_cast<::target_state_t>(state));
+    }
+
+    virtual bool read_memory(uint32_t address, uint8_t *data, uint32_t size) override
+    {
+        return _engine.read_memory(address, data, size);
+    }
+
+    virtual bool write_memory(uint32_t address, uint8_t *data, uint32_t size) override
+    {
+        return _engine.write_memory(address, data, size);
+    }
+
+    virtual bool read_words(const uint32_t *addr, uint32_t *val, uint32_t count) override
+    {
+        return _engine.read_words(addr, val, count);
+    }
+
+    virtual bool flash_syscall_exec(const syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t *result = nullptr) override
+    {
+        program_syscall_t syscall = {sysCallParam->breakpoint, sysCallParam->static_base, sysCallParam->stack_pointer};
+
+        return _engine.flash_syscall_exec(&syscall, entry, arg1, arg2, arg3, arg4, result);
+    }
+
+    virtual void set_pushed_compare(bool enable) override
+    {
+        _engine.set_pushed_compare(enable);
+    }
+
+    virtual bool verify_memory_pushed(uint32_t address, const uint8_t *data, uint32_t size, bool *match) override
+    {
+        return _engine.verify_memory_pushed(address, data, size, match);
+    }
+
+private:
+    SWDEngine<Transport> &_engine;
+};
+
+/*
+ * SWDIface for ARMv7-A/R targets, debug registers behind an APB-AP. Raw DP/AP
+ * access and the transport go to the shared engine, the target side through
+ * CortexAEngine. Pushed verify is a MEM-AP feature, readback is used instead.
+ */
+template <class Transport>
+class SWDHostCA : public SWDHost<Transport>
+{
+public:
+    typedef SWDIface::target_state_t target_state_t;
+
+    explicit SWDHostCA(SWDEngine<Transport> &engine)
+        : SWDHost<Transport>(engine), _ca(engine)
+    {
+    }
+
+    void configure(uint8_t ap, uint32_t debug_base)
+    {
+        _ca.configure(ap, debug_base);
+    }
+
+    virtual bool init_debug(void) override
+    {
+        return _ca.init_debug();
+    }
+
+    virtual bool set_target_state(target_state_t state) override
+    {
+        return _ca.set_target_state(static_cast<::target_state_t>(state));
+    }
+
+    virtual bool read_memory(uint32_t address, uint8_t *data, uint32_t size) override
+    {
+        return _ca.read_memory(address, data, size);
+    }
+
+    virtual bool write_memory(uint32_t address, uint8_t *data, uint32_t size) override
+    {
+        return _ca.write_memory(address, data, size);
+    }
+
+    virtual bool read_words(const uint32_t *addr, uint32_t *val, uint32_t count) override
+    {
+        return _ca.read_words(addr, val, count);
+    }
+
+    virtual bool flash_syscall_exec(const SWDIface::syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t *result = nullptr) override
+    {
+        program_syscall_t syscall = {sysCallParam->breakpoint, sysCallParam->static_base, sysCallParam->stack_pointer};
+
+        return _ca.flash_syscall_exec(&syscall, entry, arg1, arg2, arg3, arg4, result);
+    }
+
+    virtual void set_pushed_compare(bool enable) override
+    {
+    }
+
+    virtual bool verify_memory_pushed(uint32_t address, const uint8_t *data, uint32_t size, bool *match) override
+    {
+        return false;
+    }
+
+private:
+    CortexAEngine<Transport> _ca;
 };
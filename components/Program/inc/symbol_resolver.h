@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <map>
+#include "elf.h"
+
+class SymbolResolver
+{
+public:
+    typedef struct
+    {
+        uint32_t address;
+        uint32_t size;
+    } symbol_t;
+
+private:
+    bool read_string(FILE *fp, Elf_Shdr &str_shdr, uint32_t offset, std::string &str);
+
+public:
+    SymbolResolver() = default;
+    /* Fill in the address and size of every name already present in symbols, names not found are left untouched */
+    bool resolve(const std::string &path, std::map<std::string, symbol_t> &symbols);
+};
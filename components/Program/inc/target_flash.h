@@ -11,10 +11,21 @@
 
 #include <cstdint>
 #include "flash_iface.h"
+#include "kernels.h"
 
 class TargetFlash : public FlashIface
 {
 private:
+    static constexpr uint32_t _erase_batch_max = 32;          // sectors per syscall
+    static constexpr uint32_t _erase_batch_bytes = 64 * 1024; // keeps one syscall within the halt timeout
+    static constexpr uint32_t _erase_code_size = 36;
+    static const uint16_t _erase_batch_code[_erase_code_size / 2];
+    static constexpr uint32_t _crc_chunk_bytes = 32 * 1024; // keeps one syscall within the halt timeout
+    static constexpr uint32_t _crc_code_size = 52;
+    static constexpr uint32_t _crc_blob_size = _crc_code_size + 17 * sizeof(uint32_t); // code, nibble table, result
+    static const uint16_t _crc_code[_crc_code_size / 2];
+    static const uint32_t _crc_table[16];
+
     SWDIface *_swd;
     const target_cfg_t *_flash_cfg;
     FlashIface::func_t _last_func_type;
@@ -22,21 +33,36 @@ private:
     FlashIface::state_t _flash_state;
     uint32_t _flash_start_addr;
     const region_info_t *_default_flash_region;
-    uint8_t _verify_buf[256];
+    KERNEL_ALIGN uint8_t _verify_buf[256];
+    bool _pushed_verify;
+    uint32_t _erase_batch[_erase_code_size / sizeof(uint32_t) + _erase_batch_max];
 
     err_t flash_func_start(FlashIface::func_t func);
+    bool flash_algo_intact(const program_target_t *flash);
+    err_t flash_erase_batch(const program_target_t *flash, uint32_t count);
+    uint32_t flash_erase_batch_capacity(const program_target_t *flash);
+    err_t flash_crc32_readback(uint32_t addr, uint32_t size, uint32_t *crc);
     const FlashIface::program_target_t *get_flash_algo(uint32_t addr);
 
+protected:
+    err_t flash_verify_readback(uint32_t addr, const uint8_t *buf, uint32_t size);
+    bool flash_readback_state(uint32_t addr, const uint8_t *buf, uint32_t size, bool *match, bool *blank);
+    err_t flash_program_resume(uint32_t addr, const uint8_t *buf, uint32_t size);
+    bool recover(void);
+
 public:
     TargetFlash();
+    void set_pushed_verify(bool enable);
     virtual void swd_init(SWDIface &swd) override;
     virtual err_t flash_init(const target_cfg_t &cfg) override;
     virtual err_t flash_uninit(void) override;
     virtual err_t flash_program_page(uint32_t adr, const uint8_t *buf, uint32_t size) override;
     virtual err_t flash_erase_sector(uint32_t addr) override;
+    virtual err_t flash_erase_range(uint32_t addr, uint32_t size) override;
     virtual err_t flash_erase_chip(void) override;
     virtual uint32_t flash_program_page_min_size(uint32_t addr) override;
     virtual uint32_t flash_erase_sector_size(uint32_t addr) override;
     virtual uint8_t flash_busy(void) override;
     virtual err_t flash_algo_set(uint32_t addr) override;
+    err_t flash_crc32(uint32_t addr, uint32_t size, uint32_t *crc);
 };
\ No newline at end of file
@@ -10,18 +10,22 @@
 #pragma once
 
 #include "swd_iface.h"
+#include "swd_transport.h"
 
-class TargetSWD : public SWDIface
+class TargetSWD : public SWDHost<DapTransport>
 {
 private:
-    TargetSWD() = default;
+    TargetSWD();
 
 public:
     static TargetSWD &get_instance();
-    virtual void msleep(uint32_t ms) override;
-    virtual bool init(void) override;
-    virtual bool off(void) override;
-    virtual transfer_err_def transer(uint32_t request, uint32_t *data) override;
-    virtual void swj_sequence(uint32_t count, const uint8_t *data) override;
-    virtual void set_target_reset(uint8_t asserted) override;
+};
+
+class TargetSWDCA : public SWDHostCA<DapTransport>
+{
+private:
+    TargetSWDCA();
+
+public:
+    static TargetSWDCA &get_instance();
 };
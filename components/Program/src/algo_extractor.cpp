@@ -14,6 +14,7 @@
 #include <algorithm>
 #include "log.h"
 #include "algo_extractor.h"
+#include "mem_tier.h"
 
 #define TAG "algo_extractor"
 
@@ -162,7 +163,11 @@ bool AlgoExtractor::extract_flash_algo(FILE *fp, Elf_Shdr &code_scn, FlashIface:
 {
     fseek(fp, code_scn.sh_offset, SEEK_SET);
     target.algo_size = sizeof(_flash_bolb_header) + code_scn.sh_size;
-    target.algo_blob = new uint32_t[target.algo_size / sizeof(uint32_t)];
+    // copied to the target once per job, a staging buffer
+    target.algo_blob = static_cast<uint32_t *>(mem_tier_alloc(MEM_TIER_BULK, target.algo_size));
+    if (!target.algo_blob)
+        throw std::runtime_error("no memory for the flash algo");
+
     memcpy(target.algo_blob, _flash_bolb_header, sizeof(_flash_bolb_header));
 
     if (fread(target.algo_blob + sizeof(_flash_bolb_header) / sizeof(uint32_t), 1, code_scn.sh_size, fp) != code_scn.sh_size)
@@ -247,7 +252,7 @@ bool AlgoExtractor::extract(const std::string &path, FlashIface::program_target_
 
         if (target.algo_blob)
         {
-            delete[] target.algo_blob;
+            mem_tier_free(target.algo_blob);
             target.algo_blob = nullptr;
         }
     }
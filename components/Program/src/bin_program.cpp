@@ -15,6 +15,7 @@
 
 BinaryProgram::BinaryProgram()
     : _flash_accessor(FlashAccessor::get_instance()),
+      _pipeline(ProgramPipeline::get_instance()),
       _program_addr(0)
 {
     _flash_accessor.swd_init(TargetSWD::get_instance());
@@ -36,12 +37,31 @@ bool BinaryProgram::init(const FlashIface::target_cfg_t &cfg, uint32_t program_a
     _program_addr = program_addr;
     LOG_INFO("Starting to program bin at 0x%lx", _program_addr);
 
-    return (_flash_accessor.init(cfg) == FlashIface::ERR_NONE);
+    if (_flash_accessor.init(cfg) != FlashIface::ERR_NONE)
+    {
+        return false;
+    }
+
+    _pipeline.begin();
+
+    return true;
+}
+
+bool BinaryProgram::prepare(size_t image_size)
+{
+    // Nothing has been queued yet, the pipeline is idle
+    if (image_size && (_flash_accessor.erase(_program_addr, image_size) != FlashIface::ERR_NONE))
+    {
+        LOG_ERROR("Failed to erase 0x%lx, size %u", _program_addr, image_size);
+        return false;
+    }
+
+    return true;
 }
 
 bool BinaryProgram::write(uint8_t *data, size_t len)
 {
-    if (FlashIface::ERR_NONE != _flash_accessor.write(_program_addr, data, len))
+    if (!_pipeline.write(_program_addr, data, len))
     {
         LOG_ERROR("Failed to write data at:%lx", _program_addr);
         return false;
@@ -52,6 +72,11 @@ bool BinaryProgram::write(uint8_t *data, size_t len)
     return true;
 }
 
+bool BinaryProgram::flush(void)
+{
+    return _pipeline.flush();
+}
+
 size_t BinaryProgram::get_program_address(void)
 {
     return _program_addr;
@@ -59,6 +84,7 @@ size_t BinaryProgram::get_program_address(void)
 
 void BinaryProgram::clean()
 {
+    _pipeline.flush();
     _program_addr = 0;
     _flash_accessor.uninit();
 }
\ No newline at end of file
@@ -0,0 +1,547 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "log.h"
+#include "container_program.h"
+#include "lz4_block.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#define TAG "container_prog"
+
+#define ROUND_DOWN(value, boundary) ((value) - ((value) % (boundary)))
+
+ContainerProgram::ContainerProgram()
+    : BinaryProgram(),
+      _state(STATE_HEADER),
+      _extents(nullptr),
+      _blocks(nullptr),
+      _patches(nullptr),
+      _fill(0),
+      _block(0),
+      _extent(0),
+      _erased_end(0),
+      _unchanged(0),
+      _diff(false),
+      _sha(HashEngine::HASH_SHA256)
+{
+    memset(&_header, 0, sizeof(_header));
+}
+
+/* Diff programming for the next job: blocks whose target CRC already matches are skipped */
+void ContainerProgram::set_diff(bool diff)
+{
+    _diff = diff;
+}
+
+uint32_t ContainerProgram::get_unchanged_blocks(void)
+{
+    return _unchanged;
+}
+
+bool ContainerProgram::read_header(const std::string &path, image_container_header_t &header)
+{
+    FILE *fp = fopen(path.c_str(), "r");
+    bool ret = false;
+
+    if (!fp)
+    {
+        return false;
+    }
+
+    ret = (fread(&header, 1, sizeof(header), fp) == sizeof(header)) && (header.magic == IMAGE_CONTAINER_MAGIC);
+    fclose(fp);
+
+    // the name is shown and used as a path, keep it terminated
+    header.algorithm[IMAGE_CONTAINER_ALGO_LEN - 1] = '\0';
+
+    return ret;
+}
+
+bool ContainerProgram::init(const FlashIface::target_cfg_t &cfg, uint32_t program_addr)
+{
+    _state = STATE_HEADER;
+    _fill = 0;
+    _block = 0;
+    _extent = 0;
+    _erased_end = 0;
+    _unchanged = 0;
+    _program_addr = 0;
+    _sha.begin();
+
+    if (_flash_accessor.init(cfg) != FlashIface::ERR_NONE)
+    {
+        return false;
+    }
+
+    _pipeline.begin();
+
+    return true;
+}
+
+// The erase is planned from the extent table, not from the container size
+bool ContainerProgram::prepare(size_t image_size)
+{
+    return true;
+}
+
+uint32_t ContainerProgram::consume(uint8_t *dst, uint32_t size, const uint8_t *data, uint32_t len)
+{
+    uint32_t n = std::min(size - _fill, len);
+
+    memcpy(dst + _fill, data, n);
+    _fill += n;
+
+    return n;
+}
+
+bool ContainerProgram::write(uint8_t *data, size_t len)
+{
+    uint32_t n = 0;
+
+    while ((len > 0) && (_state != STATE_ERROR))
+    {
+        switch (_state)
+        {
+        case STATE_HEADER:
+            n = consume(reinterpret_cast<uint8_t *>(&_header), sizeof(_header), data, len);
+
+            if (_fill == sizeof(_header))
+            {
+                _fill = 0;
+                _state = check_header() ? STATE_TABLES : STATE_ERROR;
+            }
+            break;
+
+        case STATE_TABLES:
+            n = consume(_tables.data(), _tables.size(), data, len);
+
+            if (_fill == _tables.size())
+            {
+                _fill = 0;
+                _state = (check_tables() && (!_diff || plan_diff())) ? STATE_PAYLOAD : STATE_ERROR;
+            }
+            break;
+
+        case STATE_PAYLOAD:
+            n = consume(_stored, _blocks[_block].stored_size, data, len);
+
+            if (_fill < _blocks[_block].stored_size)
+            {
+                break;
+            }
+
+            _fill = 0;
+
+            if (!write_block())
+            {
+                _state = STATE_ERROR;
+                break;
+            }
+
+            if (++_block == _header.block_num)
+            {
+                _state = STATE_DONE;
+                break;
+            }
+
+            while (((_extent + 1) < _header.extent_num) && (_block >= _extents[_extent + 1].block))
+            {
+                _extent++;
+            }
+            break;
+
+        default:
+            // padding after the payload
+            n = len;
+            break;
+        }
+
+        data += n;
+        len -= n;
+    }
+
+    return (_state != STATE_ERROR);
+}
+
+bool ContainerProgram::flush(void)
+{
+    uint8_t digest[32];
+
+    if (_state != STATE_DONE)
+    {
+        LOG_ERROR("Container ends at block %ld of %ld", _block, _header.block_num);
+        _pipeline.flush();
+        return false;
+    }
+
+    _sha.finish(digest);
+
+    if (memcmp(digest, _header.sha256, sizeof(digest)))
+    {
+        LOG_ERROR("Container SHA-256 mismatch");
+        _pipeline.flush();
+        return false;
+    }
+
+    if (_diff)
+    {
+        LOG_INFO("%ld of %ld blocks unchanged", _unchanged, _header.block_num);
+    }
+
+    return _pipeline.flush();
+}
+
+void ContainerProgram::clean(void)
+{
+    BinaryProgram::clean();
+
+    std::vector<uint8_t>().swap(_tables);
+    std::vector<bool>().swap(_program);
+    _extents = nullptr;
+    _blocks = nullptr;
+    _patches = nullptr;
+}
+
+bool ContainerProgram::check_header(void)
+{
+    uint64_t tables_size = 0;
+
+    if ((_header.magic != IMAGE_CONTAINER_MAGIC) || (_header.version != IMAGE_CONTAINER_VERSION) || (_header.header_size != sizeof(_header)))
+    {
+        LOG_ERROR("Not a version %d container", IMAGE_CONTAINER_VERSION);
+        return false;
+    }
+
+    if ((_header.block_size < _block_size_min) || (_header.block_size > _block_size_max) || (_header.block_size & (_header.block_size - 1)))
+    {
+        LOG_ERROR("Unsupported block size %ld", _header.block_size);
+        return false;
+    }
+
+    tables_size = static_cast<uint64_t>(_header.extent_num) * sizeof(image_container_extent_t) +
+                  static_cast<uint64_t>(_header.block_num) * sizeof(image_container_block_t) +
+                  static_cast<uint64_t>(_header.patch_num) * sizeof(image_container_patch_t);
+
+    if (!_header.extent_num || !_header.block_num || (tables_size > _tables_size_max))
+    {
+        LOG_ERROR("Container tables too large or empty");
+        return false;
+    }
+
+    _header.algorithm[IMAGE_CONTAINER_ALGO_LEN - 1] = '\0';
+    LOG_INFO("Container: %ld bytes in %ld extents, %ld blocks, %ld patches, algorithm %s",
+             _header.image_size, _header.extent_num, _header.block_num, _header.patch_num, _header.algorithm);
+
+    _tables.resize(tables_size);
+
+    return true;
+}
+
+bool ContainerProgram::check_tables(void)
+{
+    uint32_t crc = kernel_crc32(0, reinterpret_cast<const uint8_t *>(&_header), offsetof(image_container_header_t, crc));
+    uint32_t block = 0;
+    uint32_t image_size = 0;
+    uint32_t payload_size = 0;
+    uint32_t end = 0;
+
+    if (kernel_crc32(crc, _tables.data(), _tables.size()) != _header.crc)
+    {
+        LOG_ERROR("Container header CRC mismatch");
+        return false;
+    }
+
+    _extents = reinterpret_cast<const image_container_extent_t *>(_tables.data());
+    _blocks = reinterpret_cast<const image_container_block_t *>(_extents + _header.extent_num);
+    _patches = reinterpret_cast<const image_container_patch_t *>(_blocks + _header.block_num);
+
+    for (uint32_t e = 0; e < _header.extent_num; e++)
+    {
+        const image_container_extent_t &extent = _extents[e];
+
+        if (!extent.size || (extent.block != block) || (e && (extent.addr < end)) || ((extent.addr + extent.size) < extent.addr))
+        {
+            LOG_ERROR("Invalid extent %ld", e);
+            return false;
+        }
+
+        end = extent.addr + extent.size;
+        image_size += extent.size;
+
+        for (block = extent.block; (block < _header.block_num) && (block_addr(block, e) < end); block++)
+        {
+            if (!_blocks[block].stored_size || (_blocks[block].stored_size > block_size(block, e)))
+            {
+                LOG_ERROR("Invalid block %ld", block);
+                return false;
+            }
+
+            payload_size += _blocks[block].stored_size;
+        }
+    }
+
+    if ((block != _header.block_num) || (image_size != _header.image_size) || (payload_size != _header.payload_size))
+    {
+        LOG_ERROR("Container tables do not match the header");
+        return false;
+    }
+
+    for (uint32_t p = 0; p < _header.patch_num; p++)
+    {
+        const image_container_patch_t &patch = _patches[p];
+        bool inside = false;
+
+        for (uint32_t e = 0; !inside && (e < _header.extent_num); e++)
+        {
+            inside = (patch.addr >= _extents[e].addr) && ((patch.addr + patch.size) <= (_extents[e].addr + _extents[e].size));
+        }
+
+        if (!patch.size || (patch.size > IMAGE_CONTAINER_PATCH_LEN) || !inside)
+        {
+            LOG_ERROR("Invalid patch at 0x%lx", patch.addr);
+            return false;
+        }
+    }
+
+    _program.assign(_header.block_num, true);
+
+    return true;
+}
+
+uint32_t ContainerProgram::block_addr(uint32_t block, uint32_t extent)
+{
+    return _extents[extent].addr + (block - _extents[extent].block) * _header.block_size;
+}
+
+uint32_t ContainerProgram::block_size(uint32_t block, uint32_t extent)
+{
+    return std::min(_header.block_size, _extents[extent].addr + _extents[extent].size - block_addr(block, extent));
+}
+
+uint32_t ContainerProgram::find_extent(uint32_t block)
+{
+    uint32_t lo = 0;
+    uint32_t hi = _header.extent_num;
+
+    // last extent starting at or before the block
+    while ((hi - lo) > 1)
+    {
+        uint32_t mid = (lo + hi) / 2;
+
+        if (_extents[mid].block <= block)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+bool ContainerProgram::patched(uint32_t addr, uint32_t size)
+{
+    for (uint32_t p = 0; p < _header.patch_num; p++)
+    {
+        if ((_patches[p].addr < (addr + size)) && ((_patches[p].addr + _patches[p].size) > addr))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Read the target CRC of every block before the first write. A changed block
+ * pulls in every block sharing an erase sector with it, those are erased too.
+ * Patched blocks are always programmed, their CRC is of the unpatched data.
+ */
+bool ContainerProgram::plan_diff(void)
+{
+    std::vector<bool> changed(_header.block_num, false);
+    uint32_t extent = 0;
+
+    for (uint32_t block = 0; block < _header.block_num; block++)
+    {
+        uint32_t addr = 0;
+        uint32_t size = 0;
+        uint32_t crc = 0;
+
+        extent = find_extent(block);
+        addr = block_addr(block, extent);
+        size = block_size(block, extent);
+
+        if (patched(addr, size))
+        {
+            changed[block] = true;
+            continue;
+        }
+
+        if (_flash_accessor.checksum(addr, size, crc) != FlashIface::ERR_NONE)
+        {
+            LOG_ERROR("Failed to read the target CRC at 0x%lx", addr);
+            return false;
+        }
+
+        changed[block] = (crc != _blocks[block].crc);
+    }
+
+    _program.assign(_header.block_num, false);
+
+    for (uint32_t block = 0; block < _header.block_num; block++)
+    {
+        uint32_t addr = 0;
+        uint32_t end = 0;
+        uint32_t sector_start = 0;
+        uint32_t sector_end = 0;
+        uint32_t sector_size = 0;
+
+        if (!changed[block])
+        {
+            continue;
+        }
+
+        extent = find_extent(block);
+        addr = block_addr(block, extent);
+        end = addr + block_size(block, extent);
+
+        sector_size = _flash_accessor.flash_erase_sector_size(addr);
+        sector_start = sector_size ? ROUND_DOWN(addr, sector_size) : addr;
+        sector_size = _flash_accessor.flash_erase_sector_size(end - 1);
+        sector_end = sector_size ? (ROUND_DOWN(end - 1, sector_size) + sector_size) : end;
+
+        for (uint32_t prev = block; prev-- > 0;)
+        {
+            uint32_t e = find_extent(prev);
+
+            if ((block_addr(prev, e) + block_size(prev, e)) <= sector_start)
+                break;
+
+            _program[prev] = true;
+        }
+
+        for (uint32_t next = block; next < _header.block_num; next++)
+        {
+            if (block_addr(next, find_extent(next)) >= sector_end)
+                break;
+
+            _program[next] = true;
+        }
+    }
+
+    _unchanged = std::count(_program.begin(), _program.end(), false);
+
+    return true;
+}
+
+/*
+ * Erase the run of programmed blocks starting at block, up to the next skipped
+ * block or the end of its extent. A sector already erased for the previous
+ * run is left alone, it holds data of that run.
+ */
+bool ContainerProgram::erase_run(uint32_t block)
+{
+    uint32_t start = block_addr(block, _extent);
+    uint32_t end = start;
+    uint32_t sector_size = 0;
+
+    while ((block < _header.block_num) && (find_extent(block) == _extent) && _program[block])
+    {
+        end = block_addr(block, _extent) + block_size(block, _extent);
+        block++;
+    }
+
+    start = std::max(start, _erased_end);
+    if (start >= end)
+    {
+        return true;
+    }
+
+    // the SWD stage owns the accessor while anything is queued
+    if (!_pipeline.drain())
+    {
+        return false;
+    }
+
+    if (_flash_accessor.erase(start, end - start) != FlashIface::ERR_NONE)
+    {
+        LOG_ERROR("Failed to erase 0x%lx, size %ld", start, end - start);
+        return false;
+    }
+
+    sector_size = _flash_accessor.flash_erase_sector_size(end - 1);
+    _erased_end = sector_size ? (ROUND_DOWN(end - 1, sector_size) + sector_size) : end;
+
+    return true;
+}
+
+void ContainerProgram::apply_patches(uint32_t addr, uint32_t size)
+{
+    for (uint32_t p = 0; p < _header.patch_num; p++)
+    {
+        const image_container_patch_t &patch = _patches[p];
+        uint32_t start = std::max(patch.addr, addr);
+        uint32_t end = std::min(patch.addr + patch.size, addr + size);
+
+        if (start < end)
+        {
+            memcpy(_decoded + (start - addr), patch.data + (start - patch.addr), end - start);
+        }
+    }
+}
+
+bool ContainerProgram::write_block(void)
+{
+    const image_container_block_t &block = _blocks[_block];
+    uint32_t addr = block_addr(_block, _extent);
+    uint32_t size = block_size(_block, _extent);
+    bool run_start = (_block == _extents[_extent].block) || !_program[_block - 1];
+
+    if (block.stored_size == size)
+    {
+        memcpy(_decoded, _stored, size);
+    }
+    else if (lz4_block_decode(_stored, block.stored_size, _decoded, size) != static_cast<int32_t>(size))
+    {
+        LOG_ERROR("Block %ld does not decode", _block);
+        return false;
+    }
+
+    if (kernel_crc32(0, _decoded, size) != block.crc)
+    {
+        LOG_ERROR("Block %ld CRC mismatch", _block);
+        return false;
+    }
+
+    _sha.update(_decoded, size);
+
+    if (!_program[_block])
+    {
+        return true;
+    }
+
+    if (run_start && !erase_run(_block))
+    {
+        return false;
+    }
+
+    apply_patches(addr, size);
+
+    if (!_pipeline.write(addr, _decoded, size))
+    {
+        LOG_ERROR("Failed to write data at:%lx", addr);
+        return false;
+    }
+
+    _program_addr = addr + size;
+
+    return true;
+}
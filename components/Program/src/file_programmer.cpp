@@ -5,8 +5,8 @@
 
 #define TAG "file_programmer"
 
-FileProgrammer::FileProgrammer(ProgramIface &binary_program, ProgramIface &hex_program)
-    : _binary_program(binary_program), _hex_program(hex_program), _program_progress(0), _progress_changed_cb(nullptr)
+FileProgrammer::FileProgrammer(ProgramIface &binary_program, ProgramIface &hex_program, ProgramIface &container_program)
+    : _binary_program(binary_program), _hex_program(hex_program), _container_program(container_program), _program_progress(0), _progress_changed_cb(nullptr)
 {
 }
 
@@ -32,6 +32,10 @@ ProgramIface *FileProgrammer::selcet_program_iface(const std::string &path)
     {
         return &_binary_program;
     }
+    else if (compare_extension(path.c_str(), ".dapi"))
+    {
+        return &_container_program;
+    }
 
     return nullptr;
 }
@@ -73,6 +77,13 @@ bool FileProgrammer::program(const std::string &path, FlashIface::target_cfg_t &
         return false;
     }
 
+    if (iface->prepare(file_size) != true)
+    {
+        fclose(fp);
+        iface->clean();
+        return false;
+    }
+
     while (feof(fp) == 0)
     {
         rd_size = fread(_buffer, 1, sizeof(_buffer), fp);
@@ -91,8 +102,65 @@ bool FileProgrammer::program(const std::string &path, FlashIface::target_cfg_t &
         }
     }
 
-    set_program_progress(100);
     fclose(fp);
+
+    if (iface->flush() != true)
+    {
+        iface->clean();
+        LOG_ERROR("Failed to program %s", path.c_str());
+        return false;
+    }
+
+    set_program_progress(100);
+    iface->clean();
+
+    return true;
+}
+
+// Program an image that is already in memory, e.g. memory mapped from flash
+bool FileProgrammer::program(const uint8_t *image, uint32_t size, image_format_t format, FlashIface::target_cfg_t &cfg, uint32_t program_addr)
+{
+    uint32_t offset = 0;
+    uint32_t len = 0;
+    ProgramIface *iface = (format == IMAGE_HEX) ? (&_hex_program) : ((format == IMAGE_CONTAINER) ? (&_container_program) : (&_binary_program));
+
+    set_program_progress(0);
+
+    if (iface->init(cfg, program_addr) != true)
+    {
+        return false;
+    }
+
+    if (iface->prepare(size) != true)
+    {
+        iface->clean();
+        return false;
+    }
+
+    while (offset < size)
+    {
+        len = ((size - offset) < _image_chunk_size) ? (size - offset) : (_image_chunk_size);
+
+        // The programs only read the data, the mapping may be read-only
+        if (iface->write(const_cast<uint8_t *>(image + offset), len) != true)
+        {
+            iface->clean();
+            LOG_ERROR("Failed to write image at:%x", iface->get_program_address());
+            return false;
+        }
+
+        offset += len;
+        set_program_progress(offset * 100 / size);
+    }
+
+    if (iface->flush() != true)
+    {
+        iface->clean();
+        LOG_ERROR("Failed to program image");
+        return false;
+    }
+
+    set_program_progress(100);
     iface->clean();
 
     return true;
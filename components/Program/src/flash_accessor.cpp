@@ -24,9 +24,14 @@ FlashAccessor::FlashAccessor()
       _current_write_block_size(0),
       _current_sector_addr(0),
       _current_sector_size(0),
-      _page_buf_empty(true)
+      _erased_start(0),
+      _erased_end(0),
+      _page_buf_empty(true),
+      _retries(0),
+      _slow_down(nullptr)
 {
     memset(_page_buffer, 0xff, sizeof(_page_buffer));
+    memset(&_recovery, 0, sizeof(_recovery));
 }
 
 FlashAccessor &FlashAccessor::get_instance()
@@ -35,6 +40,106 @@ FlashAccessor &FlashAccessor::get_instance()
     return instance;
 }
 
+void FlashAccessor::set_recovery(uint8_t retries, const slow_down_cb_t &slow_down)
+{
+    _retries = retries;
+    _slow_down = slow_down;
+}
+
+const FlashAccessor::recovery_stat_t &FlashAccessor::get_recovery_stat(void) const
+{
+    return _recovery;
+}
+
+// Reconnect before a retry, from the second retry on at a lower clock if possible
+bool FlashAccessor::recover_attempt(uint8_t attempt)
+{
+    LOG_WARN("Retry %d of %d", attempt + 1, _retries);
+
+    if ((attempt > 0) && _slow_down && _slow_down())
+    {
+        _recovery.clock_drops++;
+    }
+
+    if (!recover())
+    {
+        return false;
+    }
+
+    _recovery.reconnects++;
+
+    return true;
+}
+
+FlashIface::err_t FlashAccessor::erase_sector(uint32_t addr)
+{
+    FlashIface::err_t status = flash_erase_sector(addr);
+
+    if (ERR_NONE == status)
+    {
+        return ERR_NONE;
+    }
+
+    _recovery.errors++;
+
+    for (uint8_t attempt = 0; attempt < _retries; attempt++)
+    {
+        if (recover_attempt(attempt) && (ERR_NONE == (status = flash_erase_sector(addr))))
+        {
+            _recovery.recovered++;
+            return ERR_NONE;
+        }
+    }
+
+    return status;
+}
+
+/*
+ * A failed program may leave the block partly written. After a reconnect only
+ * the chunks still blank are programmed; a block covering a whole sector is
+ * erased and programmed again, larger sectors would lose the blocks before it.
+ */
+FlashIface::err_t FlashAccessor::program_block(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    FlashIface::err_t status = flash_program_page(addr, buf, size);
+
+    if (ERR_NONE == status)
+    {
+        return ERR_NONE;
+    }
+
+    _recovery.errors++;
+
+    for (uint8_t attempt = 0; attempt < _retries; attempt++)
+    {
+        if (!recover_attempt(attempt))
+        {
+            continue;
+        }
+
+        status = flash_program_resume(addr, buf, size);
+
+        if ((ERR_WRITE_VERIFY == status) && (addr == _current_sector_addr) && (_current_write_block_size == _current_sector_size))
+        {
+            _recovery.sector_retries++;
+            status = flash_erase_sector(_current_sector_addr);
+
+            if (ERR_NONE == status)
+            {
+                status = flash_program_page(addr, buf, size);
+            }
+        }
+
+        if (ERR_NONE == status)
+        {
+            _recovery.recovered++;
+            return ERR_NONE;
+        }
+    }
+
+    return status;
+}
+
 FlashIface::err_t FlashAccessor::flush_current_block(uint32_t addr)
 {
     FlashIface::err_t status = ERR_NONE;
@@ -42,10 +147,11 @@ FlashIface::err_t FlashAccessor::flush_current_block(uint32_t addr)
     // Write out current buffer if there is data in it
     if (!_page_buf_empty)
     {
-        status = flash_program_page(_current_write_block_addr, _page_buffer, _current_write_block_size);
-        _page_buf_empty = true;
+        status = program_block(_current_write_block_addr, _page_buffer, _current_write_block_size);
     }
 
+    _page_buf_empty = true;
+
     // Setup for next block
     memset(_page_buffer, 0xFF, _current_write_block_size);
 
@@ -88,13 +194,16 @@ FlashIface::err_t FlashAccessor::setup_next_sector(uint32_t addr)
         return status;
     }
 
-    // Erase the current sector
-    status = flash_erase_sector(_current_sector_addr);
-    if (ERR_NONE != status)
+    // Erase the current sector, unless erase() already did
+    if ((_current_sector_addr < _erased_start) || (_current_sector_addr >= _erased_end))
     {
-        LOG_ERROR("Flash sector erase failed");
-        flash_uninit();
-        return status;
+        status = erase_sector(_current_sector_addr);
+        if (ERR_NONE != status)
+        {
+            LOG_ERROR("Flash sector erase failed");
+            flash_uninit();
+            return status;
+        }
     }
 
     // Clear out buffer in case block size changed
@@ -120,7 +229,10 @@ FlashIface::err_t FlashAccessor::init(const target_cfg_t &cfg)
     _current_write_block_size = 0;
     _current_sector_addr = 0;
     _current_sector_size = 0;
+    _erased_start = 0;
+    _erased_end = 0;
     _last_packet_addr = 0;
+    memset(&_recovery, 0, sizeof(_recovery));
 
     // Initialize flash
     status = flash_init(cfg);
@@ -136,6 +248,49 @@ FlashIface::err_t FlashAccessor::init(const target_cfg_t &cfg)
     return status;
 }
 
+/*
+ * Erase the sectors of a known image range up front, a few syscalls instead of one per sector.
+ * While a sector is being written the range must start after it, its buffered block is kept.
+ */
+FlashIface::err_t FlashAccessor::erase(uint32_t addr, uint32_t size)
+{
+    uint32_t sector_size = 0;
+    FlashIface::err_t status = ERR_NONE;
+
+    if ((_flash_state != FLASH_STATE_OPEN) || (_current_sector_valid && (addr < (_current_sector_addr + _current_sector_size))))
+    {
+        return ERR_INTERNAL;
+    }
+
+    sector_size = flash_erase_sector_size(addr);
+    if (!sector_size || !size)
+    {
+        return ERR_INTERNAL;
+    }
+
+    status = flash_erase_range(addr, size);
+    if (ERR_NONE != status)
+    {
+        LOG_ERROR("Flash range erase failed");
+        _recovery.errors++;
+
+        // Leave the erase to setup_next_sector(), one sector at a time with retries
+        if (_retries && recover_attempt(0))
+        {
+            return ERR_NONE;
+        }
+
+        flash_uninit();
+        _flash_state = FLASH_STATE_ERROR;
+        return status;
+    }
+
+    _erased_start = ROUND_DOWN(addr, sector_size);
+    _erased_end = addr + size;
+
+    return ERR_NONE;
+}
+
 FlashIface::err_t FlashAccessor::write(uint32_t packet_addr, const uint8_t *data, uint32_t size)
 {
     uint32_t page_buf_left = 0;
@@ -233,6 +388,43 @@ FlashIface::err_t FlashAccessor::write(uint32_t packet_addr, const uint8_t *data
     return status;
 }
 
+// CRC32 of a target range, computed on the target, chained on crc like kernel_crc32()
+FlashIface::err_t FlashAccessor::checksum(uint32_t addr, uint32_t size, uint32_t &crc)
+{
+    uint32_t value = crc;
+    FlashIface::err_t status = ERR_NONE;
+
+    if ((_flash_state != FLASH_STATE_OPEN) || _current_sector_valid)
+    {
+        return ERR_INTERNAL;
+    }
+
+    status = flash_crc32(addr, size, &value);
+
+    if (ERR_NONE != status)
+    {
+        _recovery.errors++;
+
+        for (uint8_t attempt = 0; attempt < _retries; attempt++)
+        {
+            value = crc;
+
+            if (recover_attempt(attempt) && (ERR_NONE == (status = flash_crc32(addr, size, &value))))
+            {
+                _recovery.recovered++;
+                break;
+            }
+        }
+    }
+
+    if (ERR_NONE == status)
+    {
+        crc = value;
+    }
+
+    return status;
+}
+
 FlashIface::err_t FlashAccessor::uninit()
 {
     FlashIface::err_t flash_write_ret = ERR_NONE;
@@ -252,6 +444,9 @@ FlashIface::err_t FlashAccessor::uninit()
     // Close flash interface (even if there was an error during program_page)
     flash_uninit_ret = flash_uninit();
 
+    LOG_INFO("Recovery: %ld errors, %ld reconnects, %ld recovered, %ld sector retries, %ld clock drops",
+             _recovery.errors, _recovery.reconnects, _recovery.recovered, _recovery.sector_retries, _recovery.clock_drops);
+
     // Reset variables to catch accidental use
     memset(_page_buffer, 0xFF, sizeof(_page_buffer));
 
@@ -261,6 +456,8 @@ FlashIface::err_t FlashAccessor::uninit()
     _current_write_block_size = 0;
     _current_sector_addr = 0;
     _current_sector_size = 0;
+    _erased_start = 0;
+    _erased_end = 0;
     _last_packet_addr = 0;
     _flash_state = FLASH_STATE_CLOSED;
 
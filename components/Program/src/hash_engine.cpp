@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "hash_engine.h"
+#include "kernels.h"
+#include <cstring>
+
+HashEngine::HashEngine(algo_t algo)
+    : _algo(algo), _crc(0)
+{
+#ifdef ESP_PLATFORM
+    mbedtls_sha256_init(&_sha);
+#endif
+    begin();
+}
+
+HashEngine::~HashEngine()
+{
+#ifdef ESP_PLATFORM
+    mbedtls_sha256_free(&_sha);
+#endif
+}
+
+HashEngine::algo_t HashEngine::get_algo(void) const
+{
+    return _algo;
+}
+
+size_t HashEngine::digest_size(void) const
+{
+    return (_algo == HASH_SHA256) ? 32 : 4;
+}
+
+std::string HashEngine::to_hex(const uint8_t *digest, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+
+    hex.reserve(len * 2);
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hex.push_back(digits[digest[i] >> 4]);
+        hex.push_back(digits[digest[i] & 0x0F]);
+    }
+
+    return hex;
+}
+
+void HashEngine::begin(void)
+{
+    _crc = 0;
+
+#ifdef ESP_PLATFORM
+    if (_algo == HASH_SHA256)
+    {
+        mbedtls_sha256_starts(&_sha, 0);
+        return;
+    }
+#endif
+
+    soft_begin();
+}
+
+void HashEngine::update(const uint8_t *data, size_t len)
+{
+    if (_algo == HASH_CRC32)
+    {
+        _crc = kernel_crc32(_crc, data, len);
+        return;
+    }
+
+#ifdef ESP_PLATFORM
+    if (_algo == HASH_SHA256)
+    {
+        mbedtls_sha256_update(&_sha, data, len);
+        return;
+    }
+#endif
+
+    soft_update(data, len);
+}
+
+size_t HashEngine::finish(uint8_t *digest)
+{
+    if (_algo == HASH_CRC32)
+    {
+        // big endian, the way CRC32 digests are usually printed
+        digest[0] = _crc >> 24;
+        digest[1] = _crc >> 16;
+        digest[2] = _crc >> 8;
+        digest[3] = _crc;
+        return 4;
+    }
+
+#ifdef ESP_PLATFORM
+    if (_algo == HASH_SHA256)
+    {
+        mbedtls_sha256_finish(&_sha, digest);
+        return 32;
+    }
+#endif
+
+    soft_finish(digest);
+
+    return 32;
+}
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+void HashEngine::sha256_transform(uint32_t *state, const uint8_t *block)
+{
+    static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    uint32_t w[64];
+    uint32_t s[8];
+
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (block[i * 4] << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    memcpy(s, state, sizeof(s));
+
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t t1 = s[7] + (ROR(s[4], 6) ^ ROR(s[4], 11) ^ ROR(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + k[i] + w[i];
+        uint32_t t2 = (ROR(s[0], 2) ^ ROR(s[0], 13) ^ ROR(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+
+        memmove(&s[1], &s[0], sizeof(uint32_t) * 7);
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        state[i] += s[i];
+    }
+}
+
+void HashEngine::soft_begin(void)
+{
+    static const uint32_t init[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    memcpy(_soft.state, init, sizeof(init));
+    _soft.length = 0;
+    _soft.used = 0;
+}
+
+void HashEngine::soft_update(const uint8_t *data, size_t len)
+{
+    _soft.length += len;
+
+    if (_soft.used > 0)
+    {
+        size_t fill = ((64 - _soft.used) < len) ? (64 - _soft.used) : len;
+
+        memcpy(&_soft.block[_soft.used], data, fill);
+        _soft.used += fill;
+        data += fill;
+        len -= fill;
+
+        if (_soft.used < 64)
+            return;
+
+        sha256_transform(_soft.state, _soft.block);
+        _soft.used = 0;
+    }
+
+    // whole blocks straight from the caller's buffer
+    for (; len >= 64; len -= 64, data += 64)
+    {
+        sha256_transform(_soft.state, data);
+    }
+
+    memcpy(_soft.block, data, len);
+    _soft.used = len;
+}
+
+void HashEngine::soft_finish(uint8_t *digest)
+{
+    uint64_t bits = _soft.length * 8;
+
+    _soft.block[_soft.used++] = 0x80;
+
+    if (_soft.used > 56)
+    {
+        memset(&_soft.block[_soft.used], 0, 64 - _soft.used);
+        sha256_transform(_soft.state, _soft.block);
+        _soft.used = 0;
+    }
+
+    memset(&_soft.block[_soft.used], 0, 56 - _soft.used);
+
+    for (int i = 0; i < 8; i++)
+    {
+        _soft.block[56 + i] = bits >> (56 - i * 8);
+    }
+
+    sha256_transform(_soft.state, _soft.block);
+
+    for (int i = 0; i < 8; i++)
+    {
+        digest[i * 4] = _soft.state[i] >> 24;
+        digest[i * 4 + 1] = _soft.state[i] >> 16;
+        digest[i * 4 + 2] = _soft.state[i] >> 8;
+        digest[i * 4 + 3] = _soft.state[i];
+    }
+}
@@ -25,6 +25,7 @@
 
 #include <string.h>
 #include "hex_parser.h"
+#include "kernels.h"
 
 typedef enum
 {
@@ -63,14 +64,7 @@ static uint8_t ctoh(char c)
  */
 static uint8_t validate_checksum(hex_line_t *record)
 {
-    uint8_t result = 0, i = 0;
-
-    for (; i < (record->byte_count + 5); i++)
-    {
-        result += record->buf[i];
-    }
-
-    return (result == 0);
+    return (kernel_sum8(record->buf, record->byte_count + 5) == 0);
 }
 
 void reset_hex_parser(hex_parser_t *parser)
@@ -240,6 +234,18 @@ hex_parse_status_t parse_hex_blob(hex_parser_t *parser, const uint8_t *hex_blob,
             }
             else
             {
+                // Once the byte count is known, decode the record up to its last byte in one go,
+                // the last byte goes through the state machine. Leave at least one char for it.
+                if ((parser->idx > 0) && ((uint32_t)parser->line.byte_count + 5 <= sizeof(hex_line_t)) && (parser->idx < parser->line.byte_count + 4))
+                {
+                    uint32_t count = parser->line.byte_count + 4 - parser->idx;
+                    uint32_t avail = (uint32_t)(end - hex_blob - 1) / 2;
+
+                    count = kernel_hex_decode(hex_blob, &parser->line.buf[parser->idx], (count < avail) ? count : avail);
+                    parser->idx += count;
+                    hex_blob += count * 2;
+                }
+
                 if (parser->idx < sizeof(hex_line_t))
                 {
                     parser->line.buf[parser->idx] = ctoh((uint8_t)(*hex_blob)) << 4;
@@ -21,7 +21,21 @@ bool HexProgram::init(const FlashIface::target_cfg_t &cfg, uint32_t program_addr
 {
     _program_addr = 0;
     reset_hex_parser(&_hex_parser);
-    return (_flash_accessor.init(cfg) == FlashIface::ERR_NONE);
+
+    if (_flash_accessor.init(cfg) != FlashIface::ERR_NONE)
+    {
+        return false;
+    }
+
+    _pipeline.begin();
+
+    return true;
+}
+
+// The records carry their own addresses, sectors are erased as they are reached
+bool HexProgram::prepare(size_t image_size)
+{
+    return true;
 }
 
 bool HexProgram::write(uint8_t *data, size_t len)
@@ -66,7 +80,7 @@ bool HexProgram::write_hex(const uint8_t *hex_data, uint32_t size, uint32_t &dec
             if (bin_buf_written > 0)
             {
                 decode_size += bin_buf_written;
-                if (FlashIface::ERR_NONE != _flash_accessor.write(bin_start_address, _decode_buffer, bin_buf_written))
+                if (!_pipeline.write(bin_start_address, _decode_buffer, bin_buf_written))
                 {
                     return false;
                 }
@@ -79,7 +93,7 @@ bool HexProgram::write_hex(const uint8_t *hex_data, uint32_t size, uint32_t &dec
             if (bin_buf_written > 0)
             {
                 decode_size += bin_buf_written;
-                if (FlashIface::ERR_NONE != _flash_accessor.write(bin_start_address, _decode_buffer, bin_buf_written))
+                if (!_pipeline.write(bin_start_address, _decode_buffer, bin_buf_written))
                 {
                     return false;
                 }
@@ -94,7 +108,7 @@ bool HexProgram::write_hex(const uint8_t *hex_data, uint32_t size, uint32_t &dec
             if (bin_buf_written > 0)
             {
                 decode_size += bin_buf_written;
-                if (FlashIface::ERR_NONE != _flash_accessor.write(bin_start_address, _decode_buffer, bin_buf_written))
+                if (!_pipeline.write(bin_start_address, _decode_buffer, bin_buf_written))
                 {
                     return false;
                 }
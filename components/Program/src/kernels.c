@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include <string.h>
+#include "kernels.h"
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && CONFIG_PROGRAMMER_KERNEL_PIE
+#define KERNEL_USE_PIE 1
+#else
+#define KERNEL_USE_PIE 0
+#endif
+
+static inline uint32_t load32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+#if KERNEL_USE_PIE
+/*
+ * PIE path of blank check and compare.
+ *
+ * The compiler knows nothing of the q registers and IDF 5.1 does not save
+ * them on a context switch. Each block function therefore saves the q
+ * registers it uses on entry and restores them on exit, in the same asm
+ * statement. The scheduler of the core is suspended around each chunk, so
+ * no task switch can happen mid-kernel. The first use runs a self test of
+ * known answers and of the q register restore. If the test fails, the
+ * portable code is used from then on.
+ *
+ * CRC32, SUM8 and hex decode have no vector path:
+ * - CRC32 is one table lookup per byte, each step depends on the last. PIE
+ *   has neither a carry-less multiply for folding nor a gather.
+ * - SUM8 and hex decode run on one hex record at a time, mostly 16 or 32
+ *   data bytes at an arbitrary offset in the line. That is below
+ *   KERNEL_PIE_MIN, where the alignment prologue, the q save and the
+ *   scheduler suspension cost more than the word loop.
+ * Cycle figures of every kernel come from the "bench-kernels" query.
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Shorter buffers stay on the word loop
+#define KERNEL_PIE_MIN 64
+
+// 16 byte blocks per scheduler suspension, 1 KiB
+#define KERNEL_PIE_CHUNK 64
+
+static int8_t s_pie = -1; // -1: not tested yet, 0: portable, 1: PIE
+
+/* AND of blocks * 16 bytes at p (16 byte aligned), reduced to 32 bits */
+static uint32_t pie_and_blocks(const uint8_t *p, uint32_t blocks)
+{
+    uint8_t save[32] KERNEL_ALIGN;
+    uint8_t *s = save;
+    uint32_t r0, r1, r2, r3;
+
+    __asm__ volatile(
+        "ee.vst.128.ip q0, %[s], 16\n"
+        "ee.vst.128.ip q1, %[s], 16\n"
+        "ee.vld.128.ip q0, %[p], 16\n"
+        "addi %[n], %[n], -1\n"
+        "beqz %[n], 2f\n"
+        "1:\n"
+        "ee.vld.128.ip q1, %[p], 16\n"
+        "addi %[n], %[n], -1\n"
+        "ee.andq q0, q0, q1\n"
+        "bnez %[n], 1b\n"
+        "2:\n"
+        "ee.movi.32.a q0, %[r0], 0\n"
+        "ee.movi.32.a q0, %[r1], 1\n"
+        "ee.movi.32.a q0, %[r2], 2\n"
+        "ee.movi.32.a q0, %[r3], 3\n"
+        "addi %[s], %[s], -32\n"
+        "ee.vld.128.ip q0, %[s], 16\n"
+        "ee.vld.128.ip q1, %[s], 16\n"
+        : [p] "+r"(p), [n] "+r"(blocks), [s] "+r"(s), [r0] "=&r"(r0), [r1] "=&r"(r1), [r2] "=&r"(r2), [r3] "=&r"(r3)
+        :
+        : "memory");
+
+    return r0 & r1 & r2 & r3;
+}
+
+/* OR of (a ^ b) over blocks * 16 bytes, a and b 16 byte aligned, reduced to 32 bits */
+static uint32_t pie_diff_blocks(const uint8_t *a, const uint8_t *b, uint32_t blocks)
+{
+    uint8_t save[48] KERNEL_ALIGN;
+    uint8_t *s = save;
+    uint32_t r0, r1, r2, r3;
+
+    __asm__ volatile(
+        "ee.vst.128.ip q0, %[s], 16\n"
+        "ee.vst.128.ip q1, %[s], 16\n"
+        "ee.vst.128.ip q2, %[s], 16\n"
+        "ee.zero.q q2\n"
+        "1:\n"
+        "ee.vld.128.ip q0, %[a], 16\n"
+        "ee.vld.128.ip q1, %[b], 16\n"
+        "addi %[n], %[n], -1\n"
+        "ee.xorq q0, q0, q1\n"
+        "ee.orq q2, q2, q0\n"
+        "bnez %[n], 1b\n"
+        "ee.movi.32.a q2, %[r0], 0\n"
+        "ee.movi.32.a q2, %[r1], 1\n"
+        "ee.movi.32.a q2, %[r2], 2\n"
+        "ee.movi.32.a q2, %[r3], 3\n"
+        "addi %[s], %[s], -48\n"
+        "ee.vld.128.ip q0, %[s], 16\n"
+        "ee.vld.128.ip q1, %[s], 16\n"
+        "ee.vld.128.ip q2, %[s], 16\n"
+        : [a] "+r"(a), [b] "+r"(b), [n] "+r"(blocks), [s] "+r"(s), [r0] "=&r"(r0), [r1] "=&r"(r1), [r2] "=&r"(r2), [r3] "=&r"(r3)
+        :
+        : "memory");
+
+    return r0 | r1 | r2 | r3;
+}
+
+static void pie_load_q(const uint8_t *p)
+{
+    __asm__ volatile(
+        "ee.vld.128.ip q0, %[p], 16\n"
+        "ee.vld.128.ip q1, %[p], 16\n"
+        "ee.vld.128.ip q2, %[p], 16\n"
+        : [p] "+r"(p)
+        :
+        : "memory");
+}
+
+static void pie_store_q(uint8_t *p)
+{
+    __asm__ volatile(
+        "ee.vst.128.ip q0, %[p], 16\n"
+        "ee.vst.128.ip q1, %[p], 16\n"
+        "ee.vst.128.ip q2, %[p], 16\n"
+        : [p] "+r"(p)
+        :
+        : "memory");
+}
+
+/* Results against known answers, and q0-q2 as they were before the kernels */
+static bool pie_selftest(void)
+{
+    uint8_t a[64] KERNEL_ALIGN;
+    uint8_t b[64] KERNEL_ALIGN;
+    uint8_t q_in[48] KERNEL_ALIGN;
+    uint8_t q_out[48] KERNEL_ALIGN;
+    bool ok = true;
+
+    memset(a, 0xFF, sizeof(a));
+    memset(b, 0xFF, sizeof(b));
+
+    for (uint32_t i = 0; i < sizeof(q_in); i++)
+    {
+        q_in[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    vTaskSuspendAll();
+    pie_load_q(q_in);
+
+    ok = ok && (pie_and_blocks(a, 4) == 0xFFFFFFFF);
+    ok = ok && (pie_diff_blocks(a, b, 4) == 0);
+    a[37] = 0xFE;
+    ok = ok && (pie_and_blocks(a, 4) != 0xFFFFFFFF);
+    ok = ok && (pie_diff_blocks(a, b, 4) != 0);
+    b[37] = 0xFE;
+    ok = ok && (pie_diff_blocks(a, b, 4) == 0);
+
+    pie_store_q(q_out);
+    xTaskResumeAll();
+
+    return ok && !memcmp(q_in, q_out, sizeof(q_in));
+}
+
+static bool pie_enabled(void)
+{
+    if (s_pie < 0)
+    {
+        s_pie = pie_selftest() ? 1 : 0;
+    }
+
+    return (s_pie > 0);
+}
+
+static bool pie_is_blank(const uint8_t *p, uint32_t blocks)
+{
+    uint32_t n = 0;
+    uint32_t acc = 0xFFFFFFFF;
+
+    for (; (blocks > 0) && (acc == 0xFFFFFFFF); blocks -= n, p += n * 16)
+    {
+        n = (blocks < KERNEL_PIE_CHUNK) ? (blocks) : (KERNEL_PIE_CHUNK);
+
+        vTaskSuspendAll();
+        acc = pie_and_blocks(p, n);
+        xTaskResumeAll();
+    }
+
+    return (acc == 0xFFFFFFFF);
+}
+
+static bool pie_equal(const uint8_t *a, const uint8_t *b, uint32_t blocks)
+{
+    uint32_t n = 0;
+    uint32_t diff = 0;
+
+    for (; (blocks > 0) && (diff == 0); blocks -= n, a += n * 16, b += n * 16)
+    {
+        n = (blocks < KERNEL_PIE_CHUNK) ? (blocks) : (KERNEL_PIE_CHUNK);
+
+        vTaskSuspendAll();
+        diff = pie_diff_blocks(a, b, n);
+        xTaskResumeAll();
+    }
+
+    return (diff == 0);
+}
+#endif
+
+bool kernel_set_vector(bool enable)
+{
+#if KERNEL_USE_PIE
+    s_pie = (enable && pie_selftest()) ? 1 : 0;
+
+    return (s_pie > 0);
+#else
+    (void)enable;
+
+    return false;
+#endif
+}
+
+bool kernel_is_blank(const uint8_t *data, uint32_t size)
+{
+    uint32_t acc = 0xFFFFFFFF;
+
+    while ((size > 0) && ((uintptr_t)data & 0x0F))
+    {
+        if (*data++ != 0xFF)
+            return false;
+        size--;
+    }
+
+#if KERNEL_USE_PIE
+    if ((size >= KERNEL_PIE_MIN) && pie_enabled())
+    {
+        if (!pie_is_blank(data, size / 16))
+            return false;
+
+        data += size & ~0x0FU;
+        size &= 0x0F;
+    }
+#endif
+
+    for (; size >= 4; size -= 4, data += 4)
+    {
+        acc &= load32(data);
+    }
+
+    while (size-- > 0)
+    {
+        acc &= 0xFFFFFF00 | *data++;
+    }
+
+    return (acc == 0xFFFFFFFF);
+}
+
+bool kernel_equal(const uint8_t *a, const uint8_t *b, uint32_t size)
+{
+    uint32_t diff = 0;
+
+    while ((size > 0) && ((uintptr_t)a & 0x0F))
+    {
+        if (*a++ != *b++)
+            return false;
+        size--;
+    }
+
+#if KERNEL_USE_PIE
+    if ((size >= KERNEL_PIE_MIN) && !((uintptr_t)b & 0x0F) && pie_enabled())
+    {
+        if (!pie_equal(a, b, size / 16))
+            return false;
+
+        a += size & ~0x0FU;
+        b += size & ~0x0FU;
+        size &= 0x0F;
+    }
+#endif
+
+    for (; size >= 4; size -= 4, a += 4, b += 4)
+    {
+        diff |= load32(a) ^ load32(b);
+    }
+
+    while (size-- > 0)
+    {
+        diff |= *a++ ^ *b++;
+    }
+
+    return (diff == 0);
+}
+
+uint32_t kernel_crc32(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    /* Byte table in rodata, no init race between the cores */
+    static const uint32_t table[256] = {
+        0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+        0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+        0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+        0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
+        0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
+        0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+        0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
+        0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924, 0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
+        0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+        0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
+        0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E, 0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
+        0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+        0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
+        0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0, 0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
+        0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+        0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
+        0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A, 0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
+        0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+        0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
+        0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC, 0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
+        0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+        0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
+        0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236, 0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
+        0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+        0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
+        0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38, 0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
+        0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+        0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
+        0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2, 0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
+        0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+        0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
+        0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D};
+
+    crc = ~crc;
+
+    while (size-- > 0)
+    {
+        crc = table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+uint8_t kernel_sum8(const uint8_t *data, uint32_t size)
+{
+    uint32_t sum = 0;
+
+    /* Add the bytes in two 16 bit lanes, 128 words cannot overflow a lane */
+    while (size >= 4)
+    {
+        uint32_t lanes = 0;
+        uint32_t words = size / 4;
+
+        if (words > 128)
+            words = 128;
+
+        for (uint32_t i = 0; i < words; i++, data += 4)
+        {
+            uint32_t value = load32(data);
+            lanes += (value & 0x00FF00FF) + ((value >> 8) & 0x00FF00FF);
+        }
+
+        sum += (lanes & 0xFFFF) + (lanes >> 16);
+        size -= words * 4;
+    }
+
+    while (size-- > 0)
+    {
+        sum += *data++;
+    }
+
+    return (uint8_t)sum;
+}
+
+/* 0x00-0x0F for hex digits, 0xFF otherwise */
+static inline uint8_t hex_value(uint8_t c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+
+    c |= 0x20;
+
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+
+    return 0xFF;
+}
+
+uint32_t kernel_hex_decode(const uint8_t *hex, uint8_t *bin, uint32_t count)
+{
+    uint32_t i = 0;
+
+    for (; i < count; i++, hex += 2)
+    {
+        uint8_t high = hex_value(hex[0]);
+        uint8_t low = hex_value(hex[1]);
+
+        if ((high | low) & 0xF0)
+            break;
+
+        bin[i] = (high << 4) | low;
+    }
+
+    return i;
+}
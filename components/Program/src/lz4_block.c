@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include <string.h>
+#include "lz4_block.h"
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_MFLIMIT 12       // a match starts at least this far from the end
+#define LZ4_LAST_LITERALS 5  // and the last bytes are always literals
+#define LZ4_MAX_INPUT 65536
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 12
+
+static inline uint32_t load32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t lz4_hash(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/* Extension bytes of a length field, 255 each and the rest */
+static uint32_t read_length(const uint8_t **ip, const uint8_t *iend, uint32_t len)
+{
+    uint32_t b = 255;
+
+    while (b == 255)
+    {
+        if (*ip >= iend)
+        {
+            return UINT32_MAX;
+        }
+
+        b = *(*ip)++;
+        len += b;
+    }
+
+    return len;
+}
+
+static uint8_t *write_length(uint8_t *op, uint32_t len)
+{
+    for (len -= 15; len >= 255; len -= 255)
+    {
+        *op++ = 255;
+    }
+
+    *op++ = (uint8_t)len;
+
+    return op;
+}
+
+int32_t lz4_block_decode(const uint8_t *src, uint32_t src_size, uint8_t *dst, uint32_t dst_size)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + src_size;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_size;
+
+    while (ip < iend)
+    {
+        uint32_t token = *ip++;
+        uint32_t len = token >> 4;
+        uint32_t offset = 0;
+        const uint8_t *match = NULL;
+
+        if (len == 15)
+        {
+            len = read_length(&ip, iend, len);
+        }
+
+        if ((len > (uint32_t)(iend - ip)) || (len > (uint32_t)(oend - op)))
+        {
+            return -1;
+        }
+
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+
+        // the last sequence has no match
+        if (ip == iend)
+        {
+            break;
+        }
+
+        if ((iend - ip) < 2)
+        {
+            return -1;
+        }
+
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if ((offset == 0) || (offset > (uint32_t)(op - dst)))
+        {
+            return -1;
+        }
+
+        len = token & 0x0f;
+        if (len == 15)
+        {
+            len = read_length(&ip, iend, len);
+        }
+
+        len += LZ4_MIN_MATCH;
+        if (len > (uint32_t)(oend - op))
+        {
+            return -1;
+        }
+
+        // byte by byte, the match may overlap what it produces
+        for (match = op - offset; len > 0; len--)
+        {
+            *op++ = *match++;
+        }
+    }
+
+    return (int32_t)(op - dst);
+}
+
+/* One sequence, match_len 0 for the closing literals. NULL if it does not fit. */
+static uint8_t *emit_sequence(uint8_t *op, uint8_t *oend, const uint8_t *literal, uint32_t literal_len, uint32_t offset, uint32_t match_len)
+{
+    uint32_t worst = 1 + literal_len / 255 + 1 + literal_len + 2 + match_len / 255 + 1;
+    uint8_t *token = op;
+
+    if ((uint32_t)(oend - op) < worst)
+    {
+        return NULL;
+    }
+
+    *op++ = (uint8_t)(((literal_len < 15) ? (literal_len) : (15)) << 4);
+
+    if (literal_len >= 15)
+    {
+        op = write_length(op, literal_len);
+    }
+
+    memcpy(op, literal, literal_len);
+    op += literal_len;
+
+    if (match_len == 0)
+    {
+        return op;
+    }
+
+    *op++ = (uint8_t)(offset & 0xff);
+    *op++ = (uint8_t)(offset >> 8);
+
+    match_len -= LZ4_MIN_MATCH;
+    *token |= (uint8_t)((match_len < 15) ? (match_len) : (15));
+
+    if (match_len >= 15)
+    {
+        op = write_length(op, match_len);
+    }
+
+    return op;
+}
+
+/* The hash table is 8 KB of stack, the encoder is meant for the host converter */
+uint32_t lz4_block_encode(const uint8_t *src, uint32_t src_size, uint8_t *dst, uint32_t dst_size)
+{
+    uint16_t table[1 << LZ4_HASH_BITS];
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_size;
+    uint32_t anchor = 0;
+    uint32_t ip = 0;
+
+    if (src_size > LZ4_MAX_INPUT)
+    {
+        return 0;
+    }
+
+    memset(table, 0, sizeof(table));
+
+    while ((src_size > LZ4_MFLIMIT) && (ip < src_size - LZ4_MFLIMIT))
+    {
+        uint32_t value = load32(src + ip);
+        uint32_t hash = lz4_hash(value);
+        uint32_t candidate = table[hash];
+        uint32_t len = LZ4_MIN_MATCH;
+        uint32_t max_len = src_size - LZ4_LAST_LITERALS - ip;
+
+        table[hash] = (uint16_t)ip;
+
+        if ((candidate >= ip) || ((ip - candidate) > LZ4_MAX_OFFSET) || (load32(src + candidate) != value))
+        {
+            ip++;
+            continue;
+        }
+
+        while ((len < max_len) && (src[candidate + len] == src[ip + len]))
+        {
+            len++;
+        }
+
+        op = emit_sequence(op, oend, src + anchor, ip - anchor, ip - candidate, len);
+        if (op == NULL)
+        {
+            return 0;
+        }
+
+        ip += len;
+        anchor = ip;
+    }
+
+    op = emit_sequence(op, oend, src + anchor, src_size - anchor, 0, 0);
+
+    return (op == NULL) ? (0) : ((uint32_t)(op - dst));
+}
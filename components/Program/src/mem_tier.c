@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "mem_tier.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#define TAG "mem_tier"
+
+#define MEM_TIER_ALIGN 16
+#define MEM_TIER_MAGIC 0x4D540000
+#define MEM_TIER_CAPS_FAST (MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT)
+#define MEM_TIER_CAPS_INTERNAL (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define MEM_TIER_CAPS_PSRAM (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+/* Kept in front of every block, one alignment unit so the data stays aligned */
+typedef struct
+{
+    uint32_t tag; // MEM_TIER_MAGIC | tier
+    uint32_t size;
+    uint32_t reserved[2];
+} mem_tier_hdr_t;
+
+static const char *s_tier_name[MEM_TIER_NUM] = {"fast", "bulk"};
+static mem_tier_stat_t s_stat[MEM_TIER_NUM];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_psram = false;
+
+void mem_tier_init(void)
+{
+    memset(s_stat, 0, sizeof(s_stat));
+    s_stat[MEM_TIER_FAST].budget = CONFIG_MEM_TIER_FAST_BUDGET * 1024;
+    s_stat[MEM_TIER_BULK].budget = CONFIG_MEM_TIER_BULK_BUDGET * 1024;
+    s_psram = (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0);
+}
+
+/* Reserve size bytes of the budget up front, the heap is not called with the lock held */
+static bool mem_tier_charge(mem_tier_t tier, size_t size)
+{
+    mem_tier_stat_t *stat = &s_stat[tier];
+    bool ret = false;
+
+    taskENTER_CRITICAL(&s_lock);
+    if ((stat->budget == 0) || (stat->used + size <= stat->budget))
+    {
+        stat->used += size;
+        stat->peak = (stat->used > stat->peak) ? (stat->used) : (stat->peak);
+        stat->allocs++;
+        ret = true;
+    }
+    else
+    {
+        stat->failures++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    return ret;
+}
+
+static void mem_tier_refund(mem_tier_t tier, size_t size, bool failed)
+{
+    mem_tier_stat_t *stat = &s_stat[tier];
+
+    taskENTER_CRITICAL(&s_lock);
+    stat->used -= size;
+    stat->allocs--;
+    stat->failures += failed ? 1 : 0;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static void *mem_tier_alloc_bulk(size_t size)
+{
+    void *ptr = NULL;
+
+    if (s_psram)
+    {
+        ptr = heap_caps_aligned_alloc(MEM_TIER_ALIGN, size, MEM_TIER_CAPS_PSRAM);
+    }
+
+    // internal RAM only while a reserve of unfragmented memory is left
+    if (!ptr && (heap_caps_get_largest_free_block(MEM_TIER_CAPS_INTERNAL) >= size + CONFIG_MEM_TIER_INTERNAL_RESERVE))
+    {
+        ptr = heap_caps_aligned_alloc(MEM_TIER_ALIGN, size, MEM_TIER_CAPS_INTERNAL);
+
+        if (ptr)
+        {
+            taskENTER_CRITICAL(&s_lock);
+            s_stat[MEM_TIER_BULK].fallbacks++;
+            taskEXIT_CRITICAL(&s_lock);
+        }
+    }
+
+    return ptr;
+}
+
+void *mem_tier_alloc(mem_tier_t tier, size_t size)
+{
+    mem_tier_hdr_t *hdr = NULL;
+    size_t total = sizeof(mem_tier_hdr_t) + size;
+
+    if ((tier >= MEM_TIER_NUM) || (size == 0) || (size > UINT32_MAX - sizeof(mem_tier_hdr_t)))
+    {
+        return NULL;
+    }
+
+    if (!mem_tier_charge(tier, size))
+    {
+        ESP_LOGW(TAG, "%s tier over budget, %u bytes requested", s_tier_name[tier], size);
+        return NULL;
+    }
+
+    if (tier == MEM_TIER_FAST)
+    {
+        hdr = (mem_tier_hdr_t *)heap_caps_aligned_alloc(MEM_TIER_ALIGN, total, MEM_TIER_CAPS_FAST);
+    }
+    else
+    {
+        hdr = (mem_tier_hdr_t *)mem_tier_alloc_bulk(total);
+    }
+
+    if (!hdr)
+    {
+        mem_tier_refund(tier, size, true);
+        ESP_LOGW(TAG, "No %s memory for %u bytes, %u internal bytes free in blocks of up to %u", s_tier_name[tier], size,
+                 heap_caps_get_free_size(MEM_TIER_CAPS_INTERNAL), heap_caps_get_largest_free_block(MEM_TIER_CAPS_INTERNAL));
+        return NULL;
+    }
+
+    hdr->tag = MEM_TIER_MAGIC | tier;
+    hdr->size = size;
+
+    return hdr + 1;
+}
+
+void mem_tier_free(void *ptr)
+{
+    mem_tier_hdr_t *hdr = NULL;
+    mem_tier_t tier = MEM_TIER_FAST;
+
+    if (!ptr)
+    {
+        return;
+    }
+
+    hdr = (mem_tier_hdr_t *)ptr - 1;
+    tier = (mem_tier_t)(hdr->tag & 0xffff);
+
+    if (((hdr->tag & 0xffff0000) != MEM_TIER_MAGIC) || (tier >= MEM_TIER_NUM))
+    {
+        ESP_LOGE(TAG, "Not a tier block: %p", ptr);
+        abort();
+    }
+
+    mem_tier_refund(tier, hdr->size, false);
+    hdr->tag = 0;
+    heap_caps_free(hdr);
+}
+
+void mem_tier_get_stat(mem_tier_t tier, mem_tier_stat_t *stat)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *stat = s_stat[tier];
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void mem_tier_report(void)
+{
+    mem_tier_stat_t stat;
+
+    ESP_LOGI(TAG, "internal: %u of %u bytes free, largest block %u, lowest %u",
+             heap_caps_get_free_size(MEM_TIER_CAPS_INTERNAL), heap_caps_get_total_size(MEM_TIER_CAPS_INTERNAL),
+             heap_caps_get_largest_free_block(MEM_TIER_CAPS_INTERNAL), heap_caps_get_minimum_free_size(MEM_TIER_CAPS_INTERNAL));
+
+    if (s_psram)
+    {
+        ESP_LOGI(TAG, "psram: %u of %u bytes free, largest block %u",
+                 heap_caps_get_free_size(MALLOC_CAP_SPIRAM), heap_caps_get_total_size(MALLOC_CAP_SPIRAM),
+                 heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+    }
+    else
+    {
+        ESP_LOGW(TAG, "No PSRAM, bulk buffers share internal RAM");
+    }
+
+    for (int i = 0; i < MEM_TIER_NUM; i++)
+    {
+        mem_tier_get_stat((mem_tier_t)i, &stat);
+        ESP_LOGI(TAG, "%s tier: %u used, %u peak, budget %u, %ld blocks, %ld failed, %ld in internal RAM", s_tier_name[i],
+                 stat.used, stat.peak, stat.budget, stat.allocs, stat.failures, stat.fallbacks);
+    }
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "log.h"
+#include "program_pipeline.h"
+#include "esp_timer.h"
+#include <cstring>
+
+#define TAG "pipeline"
+
+ProgramPipeline::ProgramPipeline()
+    : _flash_accessor(FlashAccessor::get_instance()),
+      _task(nullptr),
+      _producer(nullptr),
+      _active(false),
+      _failed(false),
+      _crc(HashEngine::HASH_CRC32)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+ProgramPipeline &ProgramPipeline::get_instance()
+{
+    static ProgramPipeline instance;
+    return instance;
+}
+
+bool ProgramPipeline::start(int core)
+{
+    if (_task)
+    {
+        return true;
+    }
+
+    return (xTaskCreatePinnedToCore(swd_stage, "prog_swd", 1024 * 4, this, 2, &_task, core) == pdPASS);
+}
+
+void ProgramPipeline::begin(void)
+{
+    memset(&_stats, 0, sizeof(_stats));
+    _crc.begin();
+    _producer = xTaskGetCurrentTaskHandle();
+    _failed = false;
+    _active = true;
+}
+
+void ProgramPipeline::swd_stage(void *arg)
+{
+    ProgramPipeline &obj = *reinterpret_cast<ProgramPipeline *>(arg);
+    extent_t *extent = nullptr;
+    int64_t start = 0;
+
+    for (;;)
+    {
+        extent = obj._queue.front();
+
+        if (!extent)
+        {
+            start = esp_timer_get_time();
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+            if (obj._active)
+                obj._stats.swd_stall_us += esp_timer_get_time() - start;
+
+            continue;
+        }
+
+        /* After a failure the rest of the job is drained without touching the target */
+        if (!obj._failed)
+        {
+            start = esp_timer_get_time();
+
+            if (obj._flash_accessor.write(extent->addr, extent->data, extent->size) != FlashIface::ERR_NONE)
+            {
+                LOG_ERROR("Failed to write data at:%lx", extent->addr);
+                obj._failed = true;
+            }
+
+            obj._stats.swd_busy_us += esp_timer_get_time() - start;
+        }
+
+        obj._queue.pop();
+
+        if (obj._producer)
+            xTaskNotifyGive(obj._producer);
+    }
+}
+
+bool ProgramPipeline::write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    extent_t *extent = nullptr;
+    uint32_t len = 0;
+    int64_t start = 0;
+
+    // hashed in place, before it is copied into the ring
+    _crc.update(data, size);
+
+    if (!_task)
+    {
+        return (_flash_accessor.write(addr, data, size) == FlashIface::ERR_NONE);
+    }
+
+    while (size > 0)
+    {
+        while ((extent = _queue.back()) == nullptr)
+        {
+            start = esp_timer_get_time();
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            _stats.decode_stall_us += esp_timer_get_time() - start;
+        }
+
+        if (_failed)
+        {
+            return false;
+        }
+
+        len = (size > _extent_size) ? _extent_size : size;
+        extent->addr = addr;
+        extent->size = len;
+        memcpy(extent->data, data, len);
+
+        _queue.push();
+        xTaskNotifyGive(_task);
+
+        _stats.extents++;
+        _stats.bytes += len;
+        addr += len;
+        data += len;
+        size -= len;
+    }
+
+    return true;
+}
+
+// Wait until everything queued is on the target, the job goes on. The accessor may be used directly afterwards.
+bool ProgramPipeline::drain(void)
+{
+    if (!_task || !_active)
+    {
+        return !_failed;
+    }
+
+    while (!_queue.empty())
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    return !_failed;
+}
+
+bool ProgramPipeline::flush(void)
+{
+    uint8_t digest[4];
+
+    _crc.finish(digest);
+    _stats.crc32 = (digest[0] << 24) | (digest[1] << 16) | (digest[2] << 8) | digest[3];
+
+    if (!_task || !_active)
+    {
+        return !_failed;
+    }
+
+    while (!_queue.empty())
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    _active = false;
+
+    LOG_INFO("%ld extents, crc32 %08lx, decode stall %llu ms, swd stall %llu ms, swd busy %llu ms",
+             _stats.extents, _stats.crc32, _stats.decode_stall_us / 1000, _stats.swd_stall_us / 1000, _stats.swd_busy_us / 1000);
+
+    return !_failed;
+}
+
+ProgramPipeline::stats_t ProgramPipeline::get_stats(void)
+{
+    return _stats;
+}
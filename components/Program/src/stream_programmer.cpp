@@ -52,6 +52,11 @@ bool StreamProgrammer::write(uint8_t *data, size_t len)
     return false;
 }
 
+bool StreamProgrammer::flush(void)
+{
+    return (_iface && _iface->flush());
+}
+
 void StreamProgrammer::clean(void)
 {
     if (_iface)
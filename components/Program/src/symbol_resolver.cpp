@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include <cstring>
+#include <stdexcept>
+#include "log.h"
+#include "symbol_resolver.h"
+
+#define TAG "symbol_resolver"
+
+bool SymbolResolver::read_string(FILE *fp, Elf_Shdr &str_shdr, uint32_t offset, std::string &str)
+{
+    int c_tmp = 0;
+    char buf[128] = {0};
+    uint32_t bytes_read = 0;
+
+    fseek(fp, str_shdr.sh_offset + offset, SEEK_SET);
+    while ((c_tmp = fgetc(fp)) != EOF && (c_tmp != '\0'))
+    {
+        if (bytes_read + 1 >= sizeof(buf))
+            return false;
+
+        buf[bytes_read++] = (char)c_tmp;
+    }
+
+    buf[bytes_read] = '\0';
+    str.assign(buf);
+
+    return true;
+}
+
+bool SymbolResolver::resolve(const std::string &path, std::map<std::string, symbol_t> &symbols)
+{
+    bool ret = false;
+    FILE *fp = nullptr;
+    Elf_Ehdr elf_hdr;
+    Elf_Shdr sym_shdr;
+    Elf_Shdr str_shdr;
+    Elf_Sym sym;
+    std::string name;
+    long cur_pos = 0;
+    uint32_t found = 0;
+
+    try
+    {
+        fp = fopen(path.c_str(), "r");
+        if (fp == nullptr)
+            throw std::runtime_error("open file failed: " + path);
+
+        if ((sizeof(Elf_Ehdr) != fread(&elf_hdr, 1, sizeof(Elf_Ehdr), fp)) || !IS_ELF(elf_hdr))
+            throw std::runtime_error("Invalid ELF file");
+
+        /* The symbol table names its string table through sh_link */
+        memset(&sym_shdr, 0, sizeof(sym_shdr));
+        for (int i = 0; i < elf_hdr.e_shnum; i++)
+        {
+            fseek(fp, elf_hdr.e_shoff + i * elf_hdr.e_shentsize, SEEK_SET);
+
+            if (sizeof(Elf_Shdr) != fread(&sym_shdr, 1, sizeof(Elf_Shdr), fp))
+                throw std::runtime_error("could not read section header");
+
+            if (sym_shdr.sh_type == SHT_SYMTAB)
+                break;
+        }
+
+        if (sym_shdr.sh_type != SHT_SYMTAB)
+            throw std::runtime_error("could not find symbol table");
+
+        fseek(fp, elf_hdr.e_shoff + sym_shdr.sh_link * elf_hdr.e_shentsize, SEEK_SET);
+        if (sizeof(Elf_Shdr) != fread(&str_shdr, 1, sizeof(Elf_Shdr), fp))
+            throw std::runtime_error("could not read string table");
+
+        fseek(fp, sym_shdr.sh_offset, SEEK_SET);
+        for (uint32_t i = 0; (i < sym_shdr.sh_size / sizeof(Elf_Sym)) && (found < symbols.size()); i++)
+        {
+            if (sizeof(Elf_Sym) != fread(&sym, 1, sizeof(Elf_Sym), fp))
+                break;
+
+            cur_pos = ftell(fp);
+
+            if ((ELF_ST_TYPE(sym.st_info) == STT_OBJECT) && read_string(fp, str_shdr, sym.st_name, name))
+            {
+                auto it = symbols.find(name);
+                if (it != symbols.end())
+                {
+                    it->second.address = sym.st_value;
+                    it->second.size = sym.st_size;
+                    found++;
+                }
+            }
+
+            fseek(fp, cur_pos, SEEK_SET);
+        }
+
+        ret = true;
+    }
+    catch (std::exception &e)
+    {
+        LOG_ERROR("%s", e.what());
+    }
+
+    if (fp)
+        fclose(fp);
+
+    return ret;
+}
@@ -13,6 +13,72 @@
 
 #define TAG "target_flash"
 #define DEFAULT_PROGRAM_PAGE_MIN_SIZE (256u)
+#define ROUND_DOWN(value, boundary) ((value) - ((value) % (boundary)))
+
+/*
+ * Erases a list of sectors in one syscall, downloaded to the program buffer
+ * with the list behind it. Thumb-1 only, so it runs on every Cortex-M and on
+ * Cortex-A in Thumb state.
+ * R0: sector list, R1: count, R2: EraseSector; returns 0 or failing index + 1.
+ */
+const uint16_t TargetFlash::_erase_batch_code[_erase_code_size / 2] = {
+    0xb5f0, // push {r4-r7, lr}
+    0x0004, // movs r4, r0
+    0x000d, // movs r5, r1
+    0x0016, // movs r6, r2
+    0x2700, // movs r7, #0
+    0x42af, // loop: cmp r7, r5
+    0xd206, // bhs done
+    0x00b8, // lsls r0, r7, #2
+    0x5820, // ldr r0, [r4, r0]
+    0x47b0, // blx r6
+    0x2800, // cmp r0, #0
+    0xd103, // bne fail
+    0x1c7f, // adds r7, #1
+    0xe7f6, // b loop
+    0x2000, // done: movs r0, #0
+    0xbdf0, // pop {r4-r7, pc}
+    0x1c78, // fail: adds r0, r7, #1
+    0xbdf0, // pop {r4-r7, pc}
+};
+
+/*
+ * CRC32 (zlib) of target memory, a nibble at a time with the table behind the
+ * code. Stores the result behind the table so R0 keeps the syscall status.
+ * R0: address, R1: size, R2: crc to chain, R3: table.
+ */
+const uint16_t TargetFlash::_crc_code[_crc_code_size / 2] = {
+    0xb530, // push {r4, r5, lr}
+    0x43d2, // mvns r2, r2
+    0x1841, // adds r1, r0, r1
+    0x4288, // loop: cmp r0, r1
+    0xd20f, // bhs done
+    0x7804, // ldrb r4, [r0]
+    0x3001, // adds r0, #1
+    0x4062, // eors r2, r4
+    0x250f, // movs r5, #15
+    0x4015, // ands r5, r2
+    0x00ad, // lsls r5, r5, #2
+    0x595d, // ldr r5, [r3, r5]
+    0x0912, // lsrs r2, r2, #4
+    0x406a, // eors r2, r5
+    0x250f, // movs r5, #15
+    0x4015, // ands r5, r2
+    0x00ad, // lsls r5, r5, #2
+    0x595d, // ldr r5, [r3, r5]
+    0x0912, // lsrs r2, r2, #4
+    0x406a, // eors r2, r5
+    0xe7ed, // b loop
+    0x43d2, // done: mvns r2, r2
+    0x641a, // str r2, [r3, #64]
+    0x2000, // movs r0, #0
+    0xbd30, // pop {r4, r5, pc}
+    0x46c0, // nop, the table is word aligned
+};
+
+const uint32_t TargetFlash::_crc_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
 
 TargetFlash::TargetFlash()
     : _swd(nullptr),
@@ -21,8 +87,173 @@ TargetFlash::TargetFlash()
       _current_flash_algo(nullptr),
       _flash_state(FLASH_STATE_CLOSED),
       _flash_start_addr(0),
-      _default_flash_region(nullptr)
+      _default_flash_region(nullptr),
+      _pushed_verify(false)
+{
+    memcpy(_erase_batch, _erase_batch_code, _erase_code_size);
+}
+
+// Verify and halt polling with MEM-AP pushed transfers, call after swd_init()
+void TargetFlash::set_pushed_verify(bool enable)
+{
+    _pushed_verify = enable;
+
+    if (_swd)
+    {
+        _swd->set_pushed_compare(enable);
+    }
+}
+
+FlashIface::err_t TargetFlash::flash_verify_readback(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    while (size > 0)
+    {
+        uint32_t verify_size = (size <= sizeof(_verify_buf)) ? (size) : (sizeof(_verify_buf));
+
+        if (!_swd->read_memory(addr, _verify_buf, verify_size))
+        {
+            LOG_ERROR("Error reading flash buffer");
+            return ERR_ALGO_DATA_SEQ;
+        }
+
+        if (!kernel_equal(buf, _verify_buf, verify_size))
+        {
+            LOG_ERROR("Verify error at addr 0x%08lx", addr);
+            return ERR_WRITE_VERIFY;
+        }
+
+        addr += verify_size;
+        buf += verify_size;
+        size -= verify_size;
+    }
+
+    return ERR_NONE;
+}
+
+// Compare flash content with buf, without logging, for recovery decisions
+bool TargetFlash::flash_readback_state(uint32_t addr, const uint8_t *buf, uint32_t size, bool *match, bool *blank)
+{
+    *match = true;
+    *blank = true;
+
+    while (size > 0)
+    {
+        uint32_t read_size = (size <= sizeof(_verify_buf)) ? (size) : (sizeof(_verify_buf));
+
+        if (!_swd->read_memory(addr, _verify_buf, read_size))
+        {
+            return false;
+        }
+
+        *match = *match && kernel_equal(buf, _verify_buf, read_size);
+        *blank = *blank && kernel_is_blank(_verify_buf, read_size);
+
+        addr += read_size;
+        buf += read_size;
+        size -= read_size;
+    }
+
+    return true;
+}
+
+// Program the chunks an interrupted flash_program_page left blank, chunks that already match are skipped
+FlashIface::err_t TargetFlash::flash_program_resume(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    bool match = false;
+    bool blank = false;
+    uint32_t chunk_size = 0;
+    err_t status = ERR_NONE;
+
+    if (!_current_flash_algo)
+    {
+        return ERR_ALGO_MISSING;
+    }
+
+    while (size > 0)
+    {
+        chunk_size = (size <= _current_flash_algo->program_buffer_size) ? (size) : (_current_flash_algo->program_buffer_size);
+
+        if (!flash_readback_state(addr, buf, chunk_size, &match, &blank))
+        {
+            return ERR_ALGO_DATA_SEQ;
+        }
+
+        if (!match)
+        {
+            // Partly programmed flash can only be fixed by an erase
+            if (!blank)
+            {
+                return ERR_WRITE_VERIFY;
+            }
+
+            status = flash_program_page(addr, buf, chunk_size);
+            if (status != ERR_NONE)
+            {
+                return status;
+            }
+        }
+
+        addr += chunk_size;
+        buf += chunk_size;
+        size -= chunk_size;
+    }
+
+    return ERR_NONE;
+}
+
+bool TargetFlash::flash_algo_intact(const program_target_t *flash)
 {
+    uint32_t addr = flash->algo_start;
+    uint32_t size = flash->algo_size;
+    uint32_t crc = 0;
+
+    while (size > 0)
+    {
+        uint32_t read_size = (size <= sizeof(_verify_buf)) ? (size) : (sizeof(_verify_buf));
+
+        if (!_swd->read_memory(addr, _verify_buf, read_size))
+        {
+            return false;
+        }
+
+        crc = kernel_crc32(crc, _verify_buf, read_size);
+        addr += read_size;
+        size -= read_size;
+    }
+
+    return (crc == kernel_crc32(0, reinterpret_cast<const uint8_t *>(flash->algo_blob), flash->algo_size));
+}
+
+/*
+ * Bring the target back after a transport error: reconnect (line reset, ABORT
+ * clears the sticky errors, debug power up, halt), download the algorithm
+ * again if its RAM image changed and run Init for the active function.
+ */
+bool TargetFlash::recover(void)
+{
+    FlashIface::func_t func = _last_func_type;
+
+    if (!_flash_cfg || !_swd->set_target_state(SWDIface::TARGET_HALT))
+    {
+        LOG_ERROR("Reconnect failed");
+        return false;
+    }
+
+    if (_current_flash_algo && !flash_algo_intact(_current_flash_algo))
+    {
+        LOG_WARN("Flash algo corrupted, download again");
+
+        if (!_swd->write_memory(_current_flash_algo->algo_start, (uint8_t *)_current_flash_algo->algo_blob, _current_flash_algo->algo_size))
+        {
+            LOG_ERROR("Error writing flash algo");
+            return false;
+        }
+    }
+
+    // The algorithm state is unknown, start the function over without UnInit
+    _last_func_type = FLASH_FUNC_NOP;
+
+    return (flash_func_start(func) == ERR_NONE);
 }
 
 const FlashIface::program_target_t *TargetFlash::get_flash_algo(uint32_t addr)
@@ -138,7 +369,6 @@ FlashIface::err_t TargetFlash::flash_uninit(void)
 FlashIface::err_t TargetFlash::flash_program_page(uint32_t addr, const uint8_t *buf, uint32_t size)
 {
     uint32_t write_size = 0;
-    uint32_t write_size_duplicated = 0;
     err_t status = ERR_NONE;
     const program_target_t *flash_algo = _current_flash_algo;
 
@@ -196,29 +426,21 @@ FlashIface::err_t TargetFlash::flash_program_page(uint32_t addr, const uint8_t *
             // Verify data flashed if verify function is not provided
             else
             {
-                write_size_duplicated = write_size;
+                bool match = false;
 
-                while (write_size_duplicated > 0)
+                // Pushed verify compares on the target side, readback is the fallback and locates mismatches
+                if (!_pushed_verify || !_swd->verify_memory_pushed(addr, buf, write_size, &match) || !match)
                 {
-                    uint32_t verify_size = (write_size_duplicated <= sizeof(_verify_buf)) ? (write_size_duplicated) : (sizeof(_verify_buf));
-
-                    if (!_swd->read_memory(addr, _verify_buf, verify_size))
+                    status = flash_verify_readback(addr, buf, write_size);
+                    if (status != ERR_NONE)
                     {
-                        LOG_ERROR("Error reading flash buffer");
-                        return ERR_ALGO_DATA_SEQ;
+                        return status;
                     }
-
-                    if (memcmp(buf, _verify_buf, verify_size) != 0)
-                    {
-                        LOG_ERROR("Verify error at addr 0x%08lx", addr);
-                        return ERR_WRITE_VERIFY;
-                    }
-
-                    addr += verify_size;
-                    buf += verify_size;
-                    size -= verify_size;
-                    write_size_duplicated -= verify_size;
                 }
+
+                addr += write_size;
+                buf += write_size;
+                size -= write_size;
             }
 
             // LOG_INFO("Write %ld bytes to 0x%08lx", write_size, addr - write_size);
@@ -270,6 +492,210 @@ FlashIface::err_t TargetFlash::flash_erase_sector(uint32_t addr)
     }
 }
 
+uint32_t TargetFlash::flash_erase_batch_capacity(const program_target_t *flash)
+{
+    uint32_t capacity = 0;
+
+    if (!flash->erase_sector || (flash->program_buffer_size <= _erase_code_size))
+    {
+        return 0;
+    }
+
+    capacity = (flash->program_buffer_size - _erase_code_size) / sizeof(uint32_t);
+
+    return (capacity < _erase_batch_max) ? capacity : _erase_batch_max;
+}
+
+// Sector addresses are in _erase_batch behind the helper code
+FlashIface::err_t TargetFlash::flash_erase_batch(const program_target_t *flash, uint32_t count)
+{
+    uint32_t failed = 0;
+    uint32_t *list = &_erase_batch[_erase_code_size / sizeof(uint32_t)];
+    err_t status = flash_func_start(FLASH_FUNC_ERASE);
+
+    if (status != ERR_NONE)
+    {
+        return status;
+    }
+
+    if (!_swd->write_memory(flash->program_buffer, reinterpret_cast<uint8_t *>(_erase_batch), _erase_code_size + count * sizeof(uint32_t)))
+    {
+        LOG_ERROR("Error writing erase list");
+        return ERR_ALGO_DATA_SEQ;
+    }
+
+    if (!_swd->flash_syscall_exec(&flash->sys_call_s, flash->program_buffer | 1, flash->program_buffer + _erase_code_size, count, flash->erase_sector, 0, &failed))
+    {
+        if (failed && (failed <= count))
+        {
+            LOG_ERROR("Erase sector 0x%08lx failed", list[failed - 1]);
+        }
+
+        return ERR_ERASE_SECTOR;
+    }
+
+    return ERR_NONE;
+}
+
+FlashIface::err_t TargetFlash::flash_erase_range(uint32_t addr, uint32_t size)
+{
+    uint32_t end = addr + size;
+    uint32_t limit = 0;
+    uint32_t count = 0;
+    uint32_t bytes = 0;
+    uint32_t capacity = 0;
+    uint32_t sector_size = 0;
+    uint32_t *list = &_erase_batch[_erase_code_size / sizeof(uint32_t)];
+    err_t status = ERR_NONE;
+
+    if (!_flash_cfg)
+    {
+        return ERR_FAILURE;
+    }
+
+    while (addr < end)
+    {
+        sector_size = flash_erase_sector_size(addr);
+        if (!sector_size)
+        {
+            return ERR_ERASE_SECTOR;
+        }
+
+        addr = ROUND_DOWN(addr, sector_size);
+
+        status = flash_algo_set(addr);
+        if (status != ERR_NONE)
+        {
+            return status;
+        }
+
+        // A batch stays inside one region, the algorithm was initialized for it
+        limit = end;
+        for (auto &flash_region : _flash_cfg->flash_regions)
+        {
+            if ((addr >= flash_region.start) && (addr < flash_region.end) && (flash_region.end < end))
+            {
+                limit = flash_region.end;
+                break;
+            }
+        }
+
+        capacity = flash_erase_batch_capacity(_current_flash_algo);
+
+        if (capacity < 2)
+        {
+            status = flash_erase_sector(addr);
+            if (status != ERR_NONE)
+            {
+                return status;
+            }
+
+            addr += sector_size;
+            continue;
+        }
+
+        count = 0;
+        bytes = 0;
+
+        while ((addr < limit) && (count < capacity) && (bytes < _erase_batch_bytes))
+        {
+            sector_size = flash_erase_sector_size(addr);
+            if (!sector_size)
+            {
+                break;
+            }
+
+            list[count++] = addr;
+            bytes += sector_size;
+            addr += sector_size;
+        }
+
+        status = flash_erase_batch(_current_flash_algo, count);
+        if (status != ERR_NONE)
+        {
+            return status;
+        }
+    }
+
+    return ERR_NONE;
+}
+
+FlashIface::err_t TargetFlash::flash_crc32_readback(uint32_t addr, uint32_t size, uint32_t *crc)
+{
+    while (size > 0)
+    {
+        uint32_t read_size = (size <= sizeof(_verify_buf)) ? (size) : (sizeof(_verify_buf));
+
+        if (!_swd->read_memory(addr, _verify_buf, read_size))
+        {
+            LOG_ERROR("Error reading flash buffer");
+            return ERR_ALGO_DATA_SEQ;
+        }
+
+        *crc = kernel_crc32(*crc, _verify_buf, read_size);
+        addr += read_size;
+        size -= read_size;
+    }
+
+    return ERR_NONE;
+}
+
+/*
+ * CRC32 of a flash range chained on *crc, same value as kernel_crc32. Runs on
+ * the target in the program buffer, only the result crosses SWD. Falls back
+ * to a readback when the buffer is too small for the helper.
+ */
+FlashIface::err_t TargetFlash::flash_crc32(uint32_t addr, uint32_t size, uint32_t *crc)
+{
+    uint32_t chunk_size = 0;
+    uint32_t blob[_crc_blob_size / sizeof(uint32_t)];
+    uint32_t table = 0;
+    err_t status = flash_algo_set(addr);
+
+    if (status != ERR_NONE)
+    {
+        return status;
+    }
+
+    if (_current_flash_algo->program_buffer_size < _crc_blob_size)
+    {
+        return flash_crc32_readback(addr, size, crc);
+    }
+
+    status = flash_func_start(FLASH_FUNC_VERIFY);
+    if (status != ERR_NONE)
+    {
+        return status;
+    }
+
+    memcpy(blob, _crc_code, _crc_code_size);
+    memcpy(&blob[_crc_code_size / sizeof(uint32_t)], _crc_table, sizeof(_crc_table));
+    table = _current_flash_algo->program_buffer + _crc_code_size;
+
+    if (!_swd->write_memory(_current_flash_algo->program_buffer, reinterpret_cast<uint8_t *>(blob), _crc_blob_size - sizeof(uint32_t)))
+    {
+        LOG_ERROR("Error writing crc helper");
+        return ERR_ALGO_DATA_SEQ;
+    }
+
+    while (size > 0)
+    {
+        chunk_size = (size <= _crc_chunk_bytes) ? (size) : (_crc_chunk_bytes);
+
+        if (!_swd->flash_syscall_exec(&_current_flash_algo->sys_call_s, _current_flash_algo->program_buffer | 1, addr, chunk_size, *crc, table) ||
+            !_swd->read_memory(table + sizeof(_crc_table), reinterpret_cast<uint8_t *>(crc), sizeof(uint32_t)))
+        {
+            LOG_ERROR("CRC at 0x%08lx failed", addr);
+            return ERR_ALGO_DATA_SEQ;
+        }
+
+        addr += chunk_size;
+        size -= chunk_size;
+    }
+
+    return ERR_NONE;
+}
+
 FlashIface::err_t TargetFlash::flash_erase_chip(void)
 {
     err_t status = ERR_NONE;
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "bench.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "kernels.h"
+#include "hash_engine.h"
+#include "sdkconfig.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#define TAG "bench"
+#define BENCH_ROUNDS 16
+#define BENCH_MAX_SIZE 4096
+#define BENCH_HASH_TOTAL (16 * 1024)
+
+static volatile uint32_t s_sink = 0;
+
+/* Cycles of one call of fn, the average of BENCH_ROUNDS */
+template <class Fn>
+static uint32_t bench_cycles(Fn fn)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+    {
+        s_sink += fn();
+    }
+
+    return (esp_cpu_get_cycle_count() - start) / BENCH_ROUNDS;
+}
+
+/* snprintf at buf + len, the result stays len once the buffer is full */
+static int bench_printf(char *buf, int size, int len, const char *fmt, ...)
+{
+    va_list args;
+
+    if (len >= size)
+        return len;
+
+    va_start(args, fmt);
+    len += vsnprintf(buf + len, size - len, fmt, args);
+    va_end(args);
+
+    return len;
+}
+
+/*
+ * {"vector": true, "sizes": [37, 256, 4096], "is_blank": [[portable, vector], ...], ..., "crc32": [portable, ...], ...}
+ * vector is null when the vector path is off or failed its self test.
+ */
+void bench_kernels(char *buf, int size, int &encode_len)
+{
+    static const uint32_t sizes[] = {37, 256, BENCH_MAX_SIZE};
+    static const char *scalar_names[] = {"crc32", "sum8", "hex_decode"};
+    const uint32_t count = sizeof(sizes) / sizeof(sizes[0]);
+    uint8_t *a = static_cast<uint8_t *>(heap_caps_aligned_alloc(16, BENCH_MAX_SIZE, MALLOC_CAP_INTERNAL));
+    uint8_t *b = static_cast<uint8_t *>(heap_caps_aligned_alloc(16, BENCH_MAX_SIZE, MALLOC_CAP_INTERNAL));
+    uint8_t *hex = static_cast<uint8_t *>(heap_caps_malloc(2 * BENCH_MAX_SIZE, MALLOC_CAP_INTERNAL));
+    uint32_t blank[3][2] = {{0}};
+    uint32_t equal[3][2] = {{0}};
+    uint32_t scalar[3][3] = {{0}};
+    bool vector = false;
+    int len = 0;
+
+    if (!a || !b || !hex)
+    {
+        heap_caps_free(a);
+        heap_caps_free(b);
+        heap_caps_free(hex);
+        encode_len = snprintf(buf, size, "{\"error\": \"no memory\"}");
+        return;
+    }
+
+    // blank and equal scan the whole buffer: all 0xFF, a == b
+    memset(a, 0xFF, BENCH_MAX_SIZE);
+    memset(b, 0xFF, BENCH_MAX_SIZE);
+    memset(hex, 'A', 2 * BENCH_MAX_SIZE);
+
+    vector = kernel_set_vector(true);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t n = sizes[i];
+
+        for (int v = 0; v < (vector ? 2 : 1); v++)
+        {
+            kernel_set_vector(v == 1);
+            blank[i][v] = bench_cycles([&] { return kernel_is_blank(a, n); });
+            equal[i][v] = bench_cycles([&] { return kernel_equal(a, b, n); });
+        }
+
+        scalar[0][i] = bench_cycles([&] { return kernel_crc32(0, a, n); });
+        scalar[1][i] = bench_cycles([&] { return kernel_sum8(a, n); });
+        scalar[2][i] = bench_cycles([&] { return kernel_hex_decode(hex, b, n); });
+    }
+
+    kernel_set_vector(vector);
+    heap_caps_free(a);
+    heap_caps_free(b);
+    heap_caps_free(hex);
+
+    len = bench_printf(buf, size, len, "{\"vector\": %s, \"sizes\": [%ld, %ld, %ld]", vector ? "true" : "false", sizes[0], sizes[1], sizes[2]);
+
+    for (int k = 0; k < 2; k++)
+    {
+        uint32_t(*cycles)[2] = k ? equal : blank;
+
+        len = bench_printf(buf, size, len, ", \"%s\": [", k ? "equal" : "is_blank");
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (vector)
+                len = bench_printf(buf, size, len, "%s[%ld, %ld]", i ? ", " : "", cycles[i][0], cycles[i][1]);
+            else
+                len = bench_printf(buf, size, len, "%s[%ld, null]", i ? ", " : "", cycles[i][0]);
+        }
+
+        len = bench_printf(buf, size, len, "]");
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        len = bench_printf(buf, size, len, ", \"%s\": [%ld, %ld, %ld]", scalar_names[k], scalar[k][0], scalar[k][1], scalar[k][2]);
+    }
+
+    len = bench_printf(buf, size, len, "}");
+
+    if (len >= size)
+        len = snprintf(buf, size, "{\"error\": \"buffer too small\"}");
+
+    encode_len = len;
+}
+
+/* Cycles per KiB of hashing BENCH_HASH_TOTAL bytes in updates of chunk bytes, finish included */
+static uint32_t bench_hash(HashEngine &hash, const uint8_t *data, uint32_t chunk)
+{
+    uint8_t digest[HashEngine::max_digest_size];
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    hash.begin();
+
+    for (uint32_t offset = 0; offset < BENCH_HASH_TOTAL; offset += chunk)
+    {
+        hash.update(data, chunk);
+    }
+
+    hash.finish(digest);
+
+    return (esp_cpu_get_cycle_count() - start) / (BENCH_HASH_TOTAL / 1024);
+}
+
+/*
+ * {"cpu_mhz": 240, "sizes": [64, 4096], "sha256": [..], "sha256_soft": [..], "crc32": [..]}
+ * sha256 goes through mbedtls, the SHA peripheral with CONFIG_MBEDTLS_HARDWARE_SHA.
+ */
+void bench_hashes(char *buf, int size, int &encode_len)
+{
+    static const uint32_t sizes[] = {64, BENCH_MAX_SIZE};
+    static const HashEngine::algo_t algos[] = {HashEngine::HASH_SHA256, HashEngine::HASH_SHA256_SOFT, HashEngine::HASH_CRC32};
+    static const char *names[] = {"sha256", "sha256_soft", "crc32"};
+    uint8_t *data = static_cast<uint8_t *>(heap_caps_malloc(BENCH_MAX_SIZE, MALLOC_CAP_INTERNAL));
+    int len = 0;
+
+    if (!data)
+    {
+        encode_len = snprintf(buf, size, "{\"error\": \"no memory\"}");
+        return;
+    }
+
+    for (uint32_t i = 0; i < BENCH_MAX_SIZE; i++)
+    {
+        data[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    len = bench_printf(buf, size, len, "{\"cpu_mhz\": %d, \"sizes\": [%ld, %ld]", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, sizes[0], sizes[1]);
+
+    for (int k = 0; k < 3; k++)
+    {
+        HashEngine hash(algos[k]);
+
+        len = bench_printf(buf, size, len, ", \"%s\": [%ld, %ld]", names[k], bench_hash(hash, data, sizes[0]), bench_hash(hash, data, sizes[1]));
+    }
+
+    heap_caps_free(data);
+    len = bench_printf(buf, size, len, "}");
+
+    if (len >= size)
+        len = snprintf(buf, size, "{\"error\": \"buffer too small\"}");
+
+    encode_len = len;
+}
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+/*
+ * On-device figures of the programming path, in CPU cycles, for the
+ * "bench-*" queries. Each call runs the benchmark in the calling task and
+ * reports JSON, the host side counterparts are in tools/probe.
+ */
+
+/* Byte loop kernels at hex record, verify chunk and sector sizes, portable and vector path */
+void bench_kernels(char *buf, int size, int &encode_len);
+
+/* SHA-256 on the peripheral and in software, and CRC32, in cycles per KiB */
+void bench_hashes(char *buf, int size, int &encode_len);
@@ -11,21 +11,61 @@
 #include "cdc_uart.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/ringbuf.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <stdio.h>
+
+#define CDC_UART_TX_CHUNK 256
 
 typedef struct
 {
+    RingbufHandle_t ring;
+    size_t size;
+    int port;
+    bool closing;
+    bool notify;
+} cdc_uart_tx_channel_t;
+
+typedef struct
+{
+    int index;
     uart_port_t uart;
+    TaskHandle_t tx_task;
+    cdc_uart_stat_t stat;
+} cdc_uart_port_t;
+
+typedef struct
+{
+    cdc_uart_port_t port[CDC_UART_PORT_NUM];
     cdc_uart_cb_t cb[CDC_UART_HANDLER_NUM];
+    cdc_uart_tx_channel_t tx[CDC_UART_TX_CHANNEL_NUM];
+    cdc_uart_tx_callback_t tx_func;
+    void *tx_usr_data;
 } cdc_uart_t;
 
 static cdc_uart_t s_cdc_uart = {0};
+static portMUX_TYPE s_tx_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE s_stat_lock = portMUX_INITIALIZER_UNLOCKED;
 static const char *TAG = "cdc_uart";
 static void cdc_uart_rx_task(void *param);
+static void cdc_uart_tx_task(void *param);
+
+static cdc_uart_port_t *cdc_uart_port(int port)
+{
+    if ((port < 0) || (port >= CDC_UART_PORT_NUM) || !s_cdc_uart.port[port].tx_task)
+    {
+        return NULL;
+    }
 
-bool cdc_uart_init(uart_port_t uart, gpio_num_t tx_pin, gpio_num_t rx_pin, int baudrate)
+    return &s_cdc_uart.port[port];
+}
+
+bool cdc_uart_init(int port, uart_port_t uart, gpio_num_t tx_pin, gpio_num_t rx_pin, int baudrate)
 {
     bool ret = false;
+    char name[configMAX_TASK_NAME_LEN];
+    cdc_uart_port_t *uart_port = NULL;
     uart_config_t uart_config = {
         .baud_rate = baudrate,
         .data_bits = UART_DATA_8_BITS,
@@ -35,30 +75,94 @@ bool cdc_uart_init(uart_port_t uart, gpio_num_t tx_pin, gpio_num_t rx_pin, int b
         .source_clk = UART_SCLK_DEFAULT,
     };
 
-    s_cdc_uart.uart = uart;
-    ret = (ESP_OK == uart_driver_install(s_cdc_uart.uart, 2 * 1024, 2 * 1024, 0, NULL, 0));
-    ret = ret && (ESP_OK == uart_param_config(s_cdc_uart.uart, &uart_config));
-    ret = ret && (ESP_OK == uart_set_pin(s_cdc_uart.uart, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    if ((port < 0) || (port >= CDC_UART_PORT_NUM) || s_cdc_uart.port[port].tx_task)
+    {
+        return false;
+    }
+
+    uart_port = &s_cdc_uart.port[port];
+    uart_port->index = port;
+    uart_port->uart = uart;
+    ret = (ESP_OK == uart_driver_install(uart, 2 * 1024, 2 * 1024, 0, NULL, 0));
+    ret = ret && (ESP_OK == uart_param_config(uart, &uart_config));
+    ret = ret && (ESP_OK == uart_set_pin(uart, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
 
+    /* The ports run at the same priorities, a busy console cannot starve the others */
     if (ret)
-        xTaskCreate(cdc_uart_rx_task, "cdc_uart_rx_task", 4096, (void *)&s_cdc_uart, 10, NULL);
+    {
+        snprintf(name, sizeof(name), "cdc_uart_rx%d", port);
+        xTaskCreate(cdc_uart_rx_task, name, 4096, (void *)uart_port, 10, NULL);
+        snprintf(name, sizeof(name), "cdc_uart_tx%d", port);
+        xTaskCreate(cdc_uart_tx_task, name, 3072, (void *)uart_port, 9, &uart_port->tx_task);
+        ESP_LOGI(TAG, "Port %d on UART%d, %d baud", port, uart, baudrate);
+    }
 
     return ret;
 }
 
-bool cdc_uart_set_baudrate(uint32_t baudrate)
+bool cdc_uart_set_baudrate(int port, uint32_t baudrate)
 {
-    return (ESP_OK == uart_set_baudrate(s_cdc_uart.uart, baudrate));
+    cdc_uart_port_t *uart_port = cdc_uart_port(port);
+
+    return uart_port && (ESP_OK == uart_set_baudrate(uart_port->uart, baudrate));
 }
 
-bool cdc_uart_get_baudrate(uint32_t *baudrate)
+bool cdc_uart_get_baudrate(int port, uint32_t *baudrate)
 {
-    return (ESP_OK == uart_get_baudrate(s_cdc_uart.uart, baudrate));
+    cdc_uart_port_t *uart_port = cdc_uart_port(port);
+
+    return uart_port && (ESP_OK == uart_get_baudrate(uart_port->uart, baudrate));
 }
 
-bool cdc_uart_write(const void *src, size_t size)
+bool cdc_uart_write(int port, const void *src, size_t size)
 {
-    return (0 <= uart_write_bytes(s_cdc_uart.uart, src, size));
+    cdc_uart_port_t *uart_port = cdc_uart_port(port);
+
+    return uart_port && (0 <= uart_write_bytes(uart_port->uart, src, size));
+}
+
+bool cdc_uart_get_stat(int port, cdc_uart_stat_t *stat)
+{
+    cdc_uart_port_t *uart_port = cdc_uart_port(port);
+
+    if (!uart_port)
+    {
+        return false;
+    }
+
+    taskENTER_CRITICAL(&s_stat_lock);
+    *stat = uart_port->stat;
+    taskEXIT_CRITICAL(&s_stat_lock);
+
+    return true;
+}
+
+void cdc_uart_get_status(char *buf, int size, int *encode_len)
+{
+    int len = snprintf(buf, size, "{\"ports\": [");
+    const char *sep = "";
+    cdc_uart_stat_t stat;
+
+    for (int i = 0; (i < CDC_UART_PORT_NUM) && (len < size); i++)
+    {
+        if (!cdc_uart_get_stat(i, &stat))
+        {
+            continue;
+        }
+
+        len += snprintf(buf + len, size - len, "%s{\"port\": %d, \"rx_bytes\": %ld, \"rx_chunks\": %ld, \"rx_latency_avg_us\": %llu, "
+                                               "\"rx_latency_max_us\": %ld, \"tx_bytes\": %ld, \"tx_busy_ms\": %llu}",
+                        sep, i, stat.rx_bytes, stat.rx_chunks, stat.rx_chunks ? (stat.rx_latency_us / stat.rx_chunks) : (0),
+                        stat.rx_latency_max_us, stat.tx_bytes, stat.tx_busy_us / 1000);
+        sep = ", ";
+    }
+
+    if (len < size)
+    {
+        len += snprintf(buf + len, size - len, "]}");
+    }
+
+    *encode_len = (len < size) ? (len) : (size - 1);
 }
 
 void cdc_uart_register_rx_handler(cdc_uart_handler_def handler, cdc_uart_rx_callback_t func, void *context)
@@ -72,6 +176,185 @@ void cdc_uart_register_rx_handler(cdc_uart_handler_def handler, cdc_uart_rx_call
     s_cdc_uart.cb[handler].usr_data = context;
 }
 
+void cdc_uart_register_tx_handler(cdc_uart_tx_callback_t func, void *context)
+{
+    s_cdc_uart.tx_usr_data = context;
+    s_cdc_uart.tx_func = func;
+}
+
+int cdc_uart_tx_open(int port, size_t size)
+{
+    int channel = -1;
+    RingbufHandle_t ring = NULL;
+
+    if (!cdc_uart_port(port))
+    {
+        return -1;
+    }
+
+    ring = xRingbufferCreate(size, RINGBUF_TYPE_BYTEBUF);
+    if (!ring)
+    {
+        return -1;
+    }
+
+    taskENTER_CRITICAL(&s_tx_lock);
+    for (int i = 0; i < CDC_UART_TX_CHANNEL_NUM; i++)
+    {
+        if (!s_cdc_uart.tx[i].ring)
+        {
+            s_cdc_uart.tx[i].ring = ring;
+            s_cdc_uart.tx[i].size = size;
+            s_cdc_uart.tx[i].port = port;
+            s_cdc_uart.tx[i].closing = false;
+            s_cdc_uart.tx[i].notify = false;
+            channel = i;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_tx_lock);
+
+    if (channel < 0)
+    {
+        ESP_LOGW(TAG, "No free TX channel");
+        vRingbufferDelete(ring);
+    }
+
+    return channel;
+}
+
+/* The TX task owns the ring from here on and frees it, pending bytes are dropped */
+void cdc_uart_tx_close(int channel)
+{
+    if ((channel < 0) || (channel >= CDC_UART_TX_CHANNEL_NUM) || !s_cdc_uart.tx[channel].ring)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_tx_lock);
+    s_cdc_uart.tx[channel].closing = true;
+    taskEXIT_CRITICAL(&s_tx_lock);
+
+    xTaskNotifyGive(s_cdc_uart.port[s_cdc_uart.tx[channel].port].tx_task);
+}
+
+/* Queue what fits without waiting, returns the number of bytes queued */
+size_t cdc_uart_tx_queue(int channel, const void *src, size_t size)
+{
+    size_t free_size = cdc_uart_tx_free(channel);
+
+    size = (size < free_size) ? size : free_size;
+
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    if (xRingbufferSend(s_cdc_uart.tx[channel].ring, src, size, 0) != pdTRUE)
+    {
+        return 0;
+    }
+
+    xTaskNotifyGive(s_cdc_uart.port[s_cdc_uart.tx[channel].port].tx_task);
+
+    return size;
+}
+
+size_t cdc_uart_tx_free(int channel)
+{
+    if ((channel < 0) || (channel >= CDC_UART_TX_CHANNEL_NUM) || !s_cdc_uart.tx[channel].ring || s_cdc_uart.tx[channel].closing)
+    {
+        return 0;
+    }
+
+    return xRingbufferGetCurFreeSize(s_cdc_uart.tx[channel].ring);
+}
+
+void cdc_uart_tx_notify(int channel)
+{
+    if ((channel < 0) || (channel >= CDC_UART_TX_CHANNEL_NUM) || !s_cdc_uart.tx[channel].ring)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_tx_lock);
+    s_cdc_uart.tx[channel].notify = true;
+    taskEXIT_CRITICAL(&s_tx_lock);
+
+    xTaskNotifyGive(s_cdc_uart.port[s_cdc_uart.tx[channel].port].tx_task);
+}
+
+static void cdc_uart_tx_task(void *param)
+{
+    bool pending = false;
+    bool released = false;
+    size_t len = 0;
+    int64_t start = 0;
+    uint8_t *item = NULL;
+    cdc_uart_port_t *uart_port = (cdc_uart_port_t *)param;
+    cdc_uart_t *cdc_uart = &s_cdc_uart;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        /* Round robin over the channels of the port, one chunk each, until all are empty */
+        do
+        {
+            pending = false;
+
+            for (int i = 0; i < CDC_UART_TX_CHANNEL_NUM; i++)
+            {
+                cdc_uart_tx_channel_t *tx = &cdc_uart->tx[i];
+
+                if (!tx->ring || (tx->port != uart_port->index))
+                {
+                    continue;
+                }
+
+                if (tx->closing)
+                {
+                    vRingbufferDelete(tx->ring);
+                    taskENTER_CRITICAL(&s_tx_lock);
+                    tx->ring = NULL;
+                    taskEXIT_CRITICAL(&s_tx_lock);
+                    continue;
+                }
+
+                item = (uint8_t *)xRingbufferReceiveUpTo(tx->ring, &len, 0, CDC_UART_TX_CHUNK);
+
+                if (item)
+                {
+                    start = esp_timer_get_time();
+                    uart_write_bytes(uart_port->uart, item, len);
+                    vRingbufferReturnItem(tx->ring, item);
+                    pending = true;
+
+                    taskENTER_CRITICAL(&s_stat_lock);
+                    uart_port->stat.tx_bytes += len;
+                    uart_port->stat.tx_busy_us += esp_timer_get_time() - start;
+                    taskEXIT_CRITICAL(&s_stat_lock);
+                }
+
+                released = false;
+                len = xRingbufferGetCurFreeSize(tx->ring);
+                taskENTER_CRITICAL(&s_tx_lock);
+                if (tx->notify && (len >= (tx->size * 3 / 4)))
+                {
+                    tx->notify = false;
+                    released = true;
+                }
+                taskEXIT_CRITICAL(&s_tx_lock);
+
+                if (released && cdc_uart->tx_func)
+                {
+                    cdc_uart->tx_func(cdc_uart->tx_usr_data, i);
+                }
+            }
+        } while (pending);
+    }
+}
+
 static void cdc_uart_rx_task(void *param)
 {
 #define RX_BUF_SIZE 64
@@ -79,13 +362,17 @@ static void cdc_uart_rx_task(void *param)
     int offset = 0;
     int need = 0;
     int read = 0;
+    int64_t first = 0;
+    int64_t last = 0;
+    bool idle = true;
+    uint32_t latency = 0;
     uint8_t data[RX_BUF_SIZE] = {0};
-    cdc_uart_t *cdc_uart = (cdc_uart_t *)param;
+    cdc_uart_port_t *uart_port = (cdc_uart_port_t *)param;
 
     for (;;)
     {
         need = RX_BUF_SIZE - offset;
-        read = uart_read_bytes(cdc_uart->uart, data + offset, need, pdMS_TO_TICKS(5));
+        read = uart_read_bytes(uart_port->uart, data + offset, need, pdMS_TO_TICKS(5));
 
         if (read < 0)
         {
@@ -93,18 +380,43 @@ static void cdc_uart_rx_task(void *param)
         }
         else
         {
+            first = ((offset == 0) && (read > 0)) ? (esp_timer_get_time()) : (first);
             offset += read;
 
+            // tell the handlers once when the output stopped, a held partial line can go out
+            if ((read == 0) && (offset == 0) && !idle && ((esp_timer_get_time() - last) >= (CDC_UART_RX_IDLE_MS * 1000LL)))
+            {
+                for (int i = 0; i < CDC_UART_HANDLER_NUM; i++)
+                {
+                    if (s_cdc_uart.cb[i].func)
+                    {
+                        s_cdc_uart.cb[i].func(s_cdc_uart.cb[i].usr_data, uart_port->index, data, 0);
+                    }
+                }
+
+                idle = true;
+            }
+
             if ((offset == RX_BUF_SIZE) || ((read == 0) && (offset > 0)))
             {
                 for (int i = 0; i < CDC_UART_HANDLER_NUM; i++)
                 {
                     if (s_cdc_uart.cb[i].func)
                     {
-                        s_cdc_uart.cb[i].func(s_cdc_uart.cb[i].usr_data, data, offset);
+                        s_cdc_uart.cb[i].func(s_cdc_uart.cb[i].usr_data, uart_port->index, data, offset);
                     }
                 }
 
+                latency = (uint32_t)(esp_timer_get_time() - first);
+                taskENTER_CRITICAL(&s_stat_lock);
+                uart_port->stat.rx_bytes += offset;
+                uart_port->stat.rx_chunks++;
+                uart_port->stat.rx_latency_us += latency;
+                uart_port->stat.rx_latency_max_us = (latency > uart_port->stat.rx_latency_max_us) ? (latency) : (uart_port->stat.rx_latency_max_us);
+                taskEXIT_CRITICAL(&s_stat_lock);
+
+                last = esp_timer_get_time();
+                idle = false;
                 offset = 0;
             }
         }
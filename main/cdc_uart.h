@@ -12,12 +12,23 @@
 
 #include "driver/uart.h"
 #include "driver/gpio.h"
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef void (*cdc_uart_rx_callback_t)(void *usr_data, uint8_t *data, size_t size);
+/*
+ * Bridge of CONFIG_CDC_UART_PORT_NUM target UARTs. Every port has its own RX
+ * and TX task, a slow consumer of one console does not hold up the others.
+ * Port n is USB CDC ACM n while the descriptor has that interface, and web
+ * serial /webserial_socket (port 0) or /webserial_socket<n>.
+ */
+#define CDC_UART_PORT_NUM CONFIG_CDC_UART_PORT_NUM
+#define CDC_UART_RX_IDLE_MS 50
+
+/* size 0 tells the port has been idle for CDC_UART_RX_IDLE_MS after output */
+typedef void (*cdc_uart_rx_callback_t)(void *usr_data, int port, uint8_t *data, size_t size);
 
 typedef struct
 {
@@ -25,6 +36,11 @@ typedef struct
     void *usr_data;
 } cdc_uart_cb_t;
 
+#define CDC_UART_TX_CHANNEL_NUM 8
+
+/* Called from the UART TX task when a channel asked for it has drained */
+typedef void (*cdc_uart_tx_callback_t)(void *usr_data, int channel);
+
 typedef enum
 {
     CDC_UART_USB_HANDLER,
@@ -32,11 +48,37 @@ typedef enum
     CDC_UART_HANDLER_NUM
 } cdc_uart_handler_def;
 
-bool cdc_uart_init(uart_port_t uart, gpio_num_t tx_pin, gpio_num_t rx_pin, int buadrate);
-bool cdc_uart_set_baudrate(uint32_t baudrate);
-bool cdc_uart_get_baudrate(uint32_t *baudrate);
-bool cdc_uart_write(const void *src, size_t size);
+/* Throughput and latency of a port, rx_latency is from the first byte of a chunk to its delivery */
+typedef struct
+{
+    uint32_t rx_bytes;
+    uint32_t rx_chunks;
+    uint64_t rx_latency_us; // sum over the chunks
+    uint32_t rx_latency_max_us;
+    uint32_t tx_bytes;
+    uint64_t tx_busy_us;    // time the TX task waited for the UART
+} cdc_uart_stat_t;
+
+bool cdc_uart_init(int port, uart_port_t uart, gpio_num_t tx_pin, gpio_num_t rx_pin, int buadrate);
+bool cdc_uart_set_baudrate(int port, uint32_t baudrate);
+bool cdc_uart_get_baudrate(int port, uint32_t *baudrate);
+bool cdc_uart_write(int port, const void *src, size_t size);
 void cdc_uart_register_rx_handler(cdc_uart_handler_def handler, cdc_uart_rx_callback_t func, void *context);
+bool cdc_uart_get_stat(int port, cdc_uart_stat_t *stat);
+void cdc_uart_get_status(char *buf, int size, int *encode_len);
+
+/*
+ * Non-blocking TX channels. Each producer owns a byte ring that the TX task
+ * of its port drains, so queueing never waits for the UART. After
+ * cdc_uart_tx_notify() the TX handler is called once the ring is back under
+ * 1/4 full.
+ */
+int cdc_uart_tx_open(int port, size_t size);
+void cdc_uart_tx_close(int channel);
+size_t cdc_uart_tx_queue(int channel, const void *src, size_t size);
+size_t cdc_uart_tx_free(int channel);
+void cdc_uart_tx_notify(int channel);
+void cdc_uart_register_tx_handler(cdc_uart_tx_callback_t func, void *context);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "dap_trace.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+
+static const uint32_t s_bounds_us[DAP_TRACE_BUCKET_NUM - 1] = {100, 1000, 5000, 20000};
+static dap_trace_stat_t s_stat;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void dap_trace_record(uint32_t us, bool flash_write)
+{
+    int bucket = 0;
+
+    while ((bucket < (DAP_TRACE_BUCKET_NUM - 1)) && (us >= s_bounds_us[bucket]))
+    {
+        bucket++;
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    s_stat.commands++;
+    s_stat.buckets[bucket]++;
+    s_stat.max_us = (us > s_stat.max_us) ? (us) : (s_stat.max_us);
+
+    if (flash_write)
+    {
+        s_stat.flash_writes++;
+        s_stat.max_flash_us = (us > s_stat.max_flash_us) ? (us) : (s_stat.max_flash_us);
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void dap_trace_reset(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    memset(&s_stat, 0, sizeof(s_stat));
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void dap_trace_get_stat(dap_trace_stat_t *stat)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *stat = s_stat;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void dap_trace_get_status(char *buf, int size, int *encode_len)
+{
+    dap_trace_stat_t stat;
+    int len = 0;
+
+    dap_trace_get_stat(&stat);
+    len = snprintf(buf, size, "{\"commands\": %ld, \"max_us\": %ld, \"flash_writes\": %ld, \"max_flash_us\": %ld, "
+                              "\"buckets_us\": [100, 1000, 5000, 20000], \"histogram\": [%ld, %ld, %ld, %ld, %ld]}",
+                   stat.commands, stat.max_us, stat.flash_writes, stat.max_flash_us,
+                   stat.buckets[0], stat.buckets[1], stat.buckets[2], stat.buckets[3], stat.buckets[4]);
+
+    *encode_len = (len < size) ? (len) : (size - 1);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Latency trace of the CMSIS-DAP commands of the host debugger: a histogram
+ * of the command times and the commands an internal flash write overlapped.
+ * With the storage hold in place that count only grows when a writer ran out
+ * of CONFIG_STORAGE_HOLD_MAX_MS and forced a write window.
+ */
+#define DAP_TRACE_BUCKET_NUM 5
+
+typedef struct
+{
+    uint32_t commands;
+    uint32_t flash_writes; // commands an internal flash write overlapped
+    uint32_t max_us;
+    uint32_t max_flash_us; // longest command an internal flash write overlapped
+    uint32_t buckets[DAP_TRACE_BUCKET_NUM]; // < 100 us, < 1 ms, < 5 ms, < 20 ms, longer
+} dap_trace_stat_t;
+
+void dap_trace_record(uint32_t us, bool flash_write);
+void dap_trace_reset(void);
+void dap_trace_get_stat(dap_trace_stat_t *stat);
+void dap_trace_get_status(char *buf, int size, int *encode_len);
+
+#ifdef __cplusplus
+}
+#endif
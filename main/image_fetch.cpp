@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "image_fetch.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "hash_engine.h"
+#include "storage_sched.h"
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+
+#define TAG "image_fetch"
+#define FETCH_BUF_SIZE 1024
+#define FETCH_TIMEOUT_MS 10000
+#define ETAG_MAX_LEN 128
+#define SHA256_HEX_LEN 64
+
+typedef struct
+{
+    char etag[ETAG_MAX_LEN];
+    char sha256[SHA256_HEX_LEN + 1];
+} image_meta_t;
+
+static uint8_t s_buf[FETCH_BUF_SIZE];
+
+static esp_err_t image_fetch_event_handler(esp_http_client_event_t *evt)
+{
+    image_meta_t *meta = reinterpret_cast<image_meta_t *>(evt->user_data);
+
+    if ((evt->event_id == HTTP_EVENT_ON_HEADER) && !strcasecmp(evt->header_key, "ETag"))
+    {
+        strncpy(meta->etag, evt->header_value, sizeof(meta->etag) - 1);
+        meta->etag[sizeof(meta->etag) - 1] = '\0';
+    }
+
+    return ESP_OK;
+}
+
+static bool image_meta_load(const std::string &path, image_meta_t &meta)
+{
+    FILE *fp = fopen((path + ".etag").c_str(), "r");
+
+    memset(&meta, 0, sizeof(meta));
+
+    if (!fp)
+    {
+        return false;
+    }
+
+    if (!fgets(meta.etag, sizeof(meta.etag), fp) || !fgets(meta.sha256, sizeof(meta.sha256), fp))
+    {
+        memset(&meta, 0, sizeof(meta));
+    }
+
+    fclose(fp);
+    meta.etag[strcspn(meta.etag, "\r\n")] = '\0';
+
+    return (meta.etag[0] != '\0');
+}
+
+static void image_meta_save(const std::string &path, const image_meta_t &meta)
+{
+    FILE *fp = fopen((path + ".etag").c_str(), "w");
+
+    if (fp)
+    {
+        fprintf(fp, "%s\n%s\n", meta.etag, meta.sha256);
+        fclose(fp);
+    }
+}
+
+/* Stream the body into a temporary file, hashing on the way */
+static image_fetch_err_def image_fetch_body(esp_http_client_handle_t client, const std::string &path, char *sha256)
+{
+    FILE *fp = nullptr;
+    int len = 0;
+    uint8_t hash[32];
+    HashEngine sha(HashEngine::HASH_SHA256);
+    image_fetch_err_def ret = IMAGE_FETCH_OK;
+
+    fp = fopen(path.c_str(), "w");
+    if (!fp)
+    {
+        ESP_LOGE(TAG, "Failed to open %s", path.c_str());
+        return IMAGE_FETCH_IO_ERROR;
+    }
+
+    for (;;)
+    {
+        len = esp_http_client_read(client, reinterpret_cast<char *>(s_buf), sizeof(s_buf));
+
+        if (len < 0)
+        {
+            ret = IMAGE_FETCH_HTTP_ERROR;
+            break;
+        }
+
+        if (len == 0)
+        {
+            if (!esp_http_client_is_complete_data_received(client))
+                ret = IMAGE_FETCH_HTTP_ERROR;
+            break;
+        }
+
+        /* Wait for the write window here, not inside FATFS with its lock held */
+        storage_write_wait();
+
+        if (fwrite(s_buf, 1, len, fp) != static_cast<size_t>(len))
+        {
+            ret = IMAGE_FETCH_IO_ERROR;
+            break;
+        }
+
+        sha.update(s_buf, len);
+    }
+
+    sha.finish(hash);
+    fclose(fp);
+
+    strcpy(sha256, HashEngine::to_hex(hash, sizeof(hash)).c_str());
+
+    return ret;
+}
+
+image_fetch_err_def image_fetch(const std::string &url, const std::string &path, const std::string &sha256)
+{
+    int status = 0;
+    image_meta_t cached;
+    image_meta_t fetched;
+    std::string part = path + ".part";
+    image_fetch_err_def ret = IMAGE_FETCH_OK;
+    esp_http_client_handle_t client = nullptr;
+    esp_http_client_config_t config = {};
+
+    memset(&fetched, 0, sizeof(fetched));
+
+    config.url = url.c_str();
+    config.timeout_ms = FETCH_TIMEOUT_MS;
+    config.event_handler = image_fetch_event_handler;
+    config.user_data = &fetched;
+
+    client = esp_http_client_init(&config);
+    if (!client)
+    {
+        return IMAGE_FETCH_HTTP_ERROR;
+    }
+
+    /* Only revalidate a cached copy that is still there and matches the expected digest */
+    if (image_meta_load(path, cached) && (sha256.empty() || !strcasecmp(sha256.c_str(), cached.sha256)))
+    {
+        FILE *fp = fopen(path.c_str(), "r");
+
+        if (fp)
+        {
+            fclose(fp);
+            esp_http_client_set_header(client, "If-None-Match", cached.etag);
+        }
+    }
+
+    if ((esp_http_client_open(client, 0) != ESP_OK) || (esp_http_client_fetch_headers(client) < 0))
+    {
+        ESP_LOGE(TAG, "Failed to connect %s", url.c_str());
+        esp_http_client_cleanup(client);
+        return IMAGE_FETCH_HTTP_ERROR;
+    }
+
+    status = esp_http_client_get_status_code(client);
+
+    if (status == 304)
+    {
+        ESP_LOGI(TAG, "%s not modified", url.c_str());
+        ret = IMAGE_FETCH_NOT_MODIFIED;
+    }
+    else if (status != 200)
+    {
+        ESP_LOGE(TAG, "%s: HTTP %d", url.c_str(), status);
+        ret = IMAGE_FETCH_HTTP_ERROR;
+    }
+    else
+    {
+        ret = image_fetch_body(client, part, fetched.sha256);
+    }
+
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    if (ret != IMAGE_FETCH_OK)
+    {
+        if (ret != IMAGE_FETCH_NOT_MODIFIED)
+            remove(part.c_str());
+        return ret;
+    }
+
+    if (!sha256.empty() && strcasecmp(sha256.c_str(), fetched.sha256))
+    {
+        ESP_LOGE(TAG, "SHA-256 mismatch, expected %s, got %s", sha256.c_str(), fetched.sha256);
+        remove(part.c_str());
+        return IMAGE_FETCH_HASH_MISMATCH;
+    }
+
+    /* FATFS rename does not replace an existing file */
+    remove(path.c_str());
+    remove((path + ".etag").c_str());
+
+    if (rename(part.c_str(), path.c_str()) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to rename %s", part.c_str());
+        remove(part.c_str());
+        return IMAGE_FETCH_IO_ERROR;
+    }
+
+    if (fetched.etag[0] != '\0')
+    {
+        image_meta_save(path, fetched);
+    }
+
+    ESP_LOGI(TAG, "%s fetched, sha256 %s", url.c_str(), fetched.sha256);
+
+    return IMAGE_FETCH_OK;
+}
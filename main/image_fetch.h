@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <string>
+
+/*
+ * Pull-mode image fetch. The image at url is cached at path, the ETag and the
+ * SHA-256 of the cached copy are kept next to it in "<path>.etag". A request
+ * for a cached image sends If-None-Match, so an unchanged image costs one 304.
+ *
+ * sha256 is the expected digest as 64 hex characters, empty to skip the check.
+ * A fresh download is written to "<path>.part" and only replaces the cached
+ * copy when the digest matches.
+ */
+typedef enum
+{
+    IMAGE_FETCH_OK,
+    IMAGE_FETCH_NOT_MODIFIED,
+    IMAGE_FETCH_HTTP_ERROR,
+    IMAGE_FETCH_IO_ERROR,
+    IMAGE_FETCH_HASH_MISMATCH
+} image_fetch_err_def;
+
+image_fetch_err_def image_fetch(const std::string &url, const std::string &path, const std::string &sha256);
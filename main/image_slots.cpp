@@ -0,0 +1,483 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "image_slots.h"
+#include "esp_log.h"
+#include "kernels.h"
+#include "storage_sched.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#define TAG "image_slots"
+#define ALIGN_UP(value, boundary) (((value) + (boundary)-1) / (boundary) * (boundary))
+
+ImageSlots::ImageSlots()
+    : _partition(nullptr),
+      _mutex(xSemaphoreCreateMutex()),
+      _pinned(_none),
+      _write_offset(_none),
+      _written(0),
+      _erased_end(0),
+      _sha(HashEngine::HASH_SHA256)
+{
+    memset(&_header, 0xFF, sizeof(_header));
+}
+
+ImageSlots &ImageSlots::get_instance()
+{
+    static ImageSlots instance;
+    return instance;
+}
+
+bool ImageSlots::init(void)
+{
+    _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "images");
+
+    if (!_partition)
+    {
+        ESP_LOGW(TAG, "No images partition, slots disabled");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Images partition at 0x%lx, %ld bytes", _partition->address, _partition->size);
+
+    return true;
+}
+
+// true if a slot header sits at offset, false at the end of the chain
+bool ImageSlots::read_slot(uint32_t offset, header_t &header)
+{
+    if ((offset + _sector_size) > _partition->size)
+    {
+        return false;
+    }
+
+    if (esp_partition_read(_partition, offset, &header, sizeof(header)) != ESP_OK)
+    {
+        return false;
+    }
+
+    return (header.magic == _magic) && (header.span >= _sector_size) && ((header.span % _sector_size) == 0) && (header.span <= (_partition->size - offset));
+}
+
+uint32_t ImageSlots::header_crc(const header_t &header)
+{
+    return kernel_crc32(0, reinterpret_cast<const uint8_t *>(&header.size), offsetof(header_t, crc) - offsetof(header_t, size));
+}
+
+bool ImageSlots::set_state(uint32_t offset, uint32_t state)
+{
+    return flash_write(offset + offsetof(header_t, state), &state, sizeof(state));
+}
+
+/* Partition writes go through the storage scheduler, they stop both cores while they run */
+bool ImageSlots::flash_write(uint32_t offset, const void *data, uint32_t len)
+{
+    int64_t start = storage_write_begin();
+    esp_err_t err = esp_partition_write(_partition, offset, data, len);
+
+    storage_write_end(start);
+
+    return (err == ESP_OK);
+}
+
+bool ImageSlots::flash_erase(uint32_t offset, uint32_t len)
+{
+    int64_t start = storage_write_begin();
+    esp_err_t err = esp_partition_erase_range(_partition, offset, len);
+
+    storage_write_end(start);
+
+    return (err == ESP_OK);
+}
+
+/*
+ * First fit over runs of deleted or unfinished slots, the free tail last. The
+ * rest of a run gets a deleted header so the chain stays intact, a slot at the
+ * tail erases the sector behind it to end the chain there.
+ */
+bool ImageSlots::allocate(uint32_t span, uint32_t &offset)
+{
+    header_t header;
+    uint32_t pos = 0;
+    uint32_t run = _none;
+    uint32_t run_span = 0;
+    bool tail = false;
+
+    while ((pos + _sector_size) <= _partition->size)
+    {
+        if (!read_slot(pos, header))
+        {
+            if (run == _none)
+            {
+                run = pos;
+                run_span = 0;
+            }
+
+            run_span += _partition->size - pos;
+            tail = true;
+            break;
+        }
+
+        if ((header.state == _state_valid) || (pos == _pinned))
+        {
+            run = _none;
+            run_span = 0;
+        }
+        else
+        {
+            if (run == _none)
+            {
+                run = pos;
+                run_span = 0;
+            }
+
+            run_span += header.span;
+
+            if (run_span >= span)
+            {
+                break;
+            }
+        }
+
+        pos += header.span;
+    }
+
+    if ((run == _none) || (run_span < span))
+    {
+        return false;
+    }
+
+    if (run_span > span)
+    {
+        uint32_t rest = run + span;
+
+        if (!flash_erase(rest, _sector_size))
+        {
+            return false;
+        }
+
+        if (!tail)
+        {
+            memset(&header, 0xFF, sizeof(header));
+            header.magic = _magic;
+            header.state = _state_deleted;
+            header.span = run_span - span;
+
+            if (!flash_write(rest, &header, offsetof(header_t, size)))
+            {
+                return false;
+            }
+        }
+    }
+
+    offset = run;
+
+    return true;
+}
+
+uint32_t ImageSlots::find(const std::string &name, header_t &header)
+{
+    for (uint32_t pos = 0; read_slot(pos, header); pos += header.span)
+    {
+        if ((header.state == _state_valid) && (header_crc(header) == header.crc) && !strncmp(header.name, name.c_str(), sizeof(header.name)))
+        {
+            return pos;
+        }
+    }
+
+    return _none;
+}
+
+bool ImageSlots::write_begin(const std::string &name, uint32_t size, image_slot_format_def format)
+{
+    uint32_t offset = 0;
+    bool ret = false;
+
+    if (!_partition || name.empty() || (name.length() >= IMAGE_SLOT_NAME_LEN) || (size == 0))
+    {
+        return false;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    // One upload at a time
+    if ((_write_offset == _none) && allocate(ALIGN_UP(IMAGE_SLOT_HEADER_SIZE + size, _sector_size), offset) &&
+        flash_erase(offset, _sector_size))
+    {
+        memset(&_header, 0xFF, sizeof(_header));
+        _header.magic = _magic;
+        _header.state = _state_writing;
+        _header.span = ALIGN_UP(IMAGE_SLOT_HEADER_SIZE + size, _sector_size);
+
+        // Claim the span now, the rest of the header is written by write_end()
+        ret = flash_write(offset, &_header, offsetof(header_t, size));
+    }
+
+    if (ret)
+    {
+        _header.size = size;
+        _header.format = format;
+        memset(_header.name, 0, sizeof(_header.name));
+        strncpy(_header.name, name.c_str(), sizeof(_header.name) - 1);
+        _write_offset = offset;
+        _written = 0;
+        _erased_end = offset + _sector_size;
+        _sha.begin();
+    }
+
+    xSemaphoreGive(_mutex);
+
+    if (!ret)
+    {
+        ESP_LOGE(TAG, "No room for %s, %ld bytes", name.c_str(), size);
+    }
+
+    return ret;
+}
+
+bool ImageSlots::write(const uint8_t *data, uint32_t len)
+{
+    uint32_t addr = 0;
+    uint32_t end = 0;
+
+    if ((_write_offset == _none) || ((_written + len) > _header.size))
+    {
+        return false;
+    }
+
+    addr = _write_offset + IMAGE_SLOT_HEADER_SIZE + _written;
+    end = ALIGN_UP(addr + len, _sector_size);
+
+    // Sectors are erased as the data reaches them, uploads do not stall on a large erase
+    if (end > _erased_end)
+    {
+        if (!flash_erase(_erased_end, end - _erased_end))
+        {
+            return false;
+        }
+
+        _erased_end = end;
+    }
+
+    if (!flash_write(addr, data, len))
+    {
+        return false;
+    }
+
+    _sha.update(data, len);
+    _written += len;
+
+    return true;
+}
+
+bool ImageSlots::write_end(const image_slot_extent_t *extents, uint32_t extent_num)
+{
+    header_t header;
+    bool ret = false;
+
+    if ((_write_offset == _none) || (_written != _header.size) || (extent_num > IMAGE_SLOT_EXTENT_MAX))
+    {
+        write_abort();
+        return false;
+    }
+
+    _sha.finish(_header.sha256);
+    _header.extent_num = extent_num;
+    if (extent_num)
+    {
+        memcpy(_header.extents, extents, extent_num * sizeof(image_slot_extent_t));
+    }
+    _header.crc = header_crc(_header);
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    ret = flash_write(_write_offset + offsetof(header_t, size), &_header.size, sizeof(header_t) - offsetof(header_t, size)) &&
+          set_state(_write_offset, _state_valid);
+
+    if (ret)
+    {
+        // The new slot replaces older ones of the same name
+        for (uint32_t pos = 0; read_slot(pos, header); pos += header.span)
+        {
+            if ((pos != _write_offset) && (header.state == _state_valid) && !strncmp(header.name, _header.name, sizeof(header.name)))
+            {
+                set_state(pos, _state_deleted);
+            }
+        }
+
+        ESP_LOGI(TAG, "%s stored at 0x%lx, sha256 %s", _header.name, _write_offset, HashEngine::to_hex(_header.sha256, sizeof(_header.sha256)).c_str());
+    }
+    else
+    {
+        set_state(_write_offset, _state_deleted);
+    }
+
+    _write_offset = _none;
+
+    xSemaphoreGive(_mutex);
+
+    return ret;
+}
+
+void ImageSlots::write_abort(void)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    if (_write_offset != _none)
+    {
+        set_state(_write_offset, _state_deleted);
+        _write_offset = _none;
+    }
+
+    xSemaphoreGive(_mutex);
+}
+
+bool ImageSlots::open(const std::string &name, image_slot_t &slot)
+{
+    header_t header;
+    uint32_t offset = _none;
+    const void *ptr = nullptr;
+    bool ret = false;
+
+    if (!_partition)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    offset = find(name, header);
+
+    if ((offset != _none) && (_pinned == _none) &&
+        (esp_partition_mmap(_partition, offset + IMAGE_SLOT_HEADER_SIZE, header.size, ESP_PARTITION_MMAP_DATA, &ptr, &slot.handle) == ESP_OK))
+    {
+        slot.data = static_cast<const uint8_t *>(ptr);
+        slot.size = header.size;
+        slot.format = static_cast<image_slot_format_def>(header.format);
+        slot.extent_num = (header.extent_num <= IMAGE_SLOT_EXTENT_MAX) ? (header.extent_num) : (0);
+        slot.offset = offset;
+        memcpy(slot.extents, header.extents, sizeof(slot.extents));
+        memcpy(slot.sha256, header.sha256, sizeof(slot.sha256));
+        _pinned = offset;
+        ret = true;
+    }
+
+    xSemaphoreGive(_mutex);
+
+    return ret;
+}
+
+void ImageSlots::close(image_slot_t &slot)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    if (_pinned == slot.offset)
+    {
+        esp_partition_munmap(slot.handle);
+        _pinned = _none;
+    }
+
+    slot.data = nullptr;
+
+    xSemaphoreGive(_mutex);
+}
+
+bool ImageSlots::remove(const std::string &name)
+{
+    header_t header;
+    uint32_t offset = _none;
+
+    if (!_partition)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    // An open slot is only marked, its span is not reused before close()
+    offset = find(name, header);
+    if (offset != _none)
+    {
+        set_state(offset, _state_deleted);
+    }
+
+    xSemaphoreGive(_mutex);
+
+    return (offset != _none);
+}
+
+void ImageSlots::list(std::vector<std::string> &names)
+{
+    header_t header;
+
+    names.clear();
+
+    if (!_partition)
+    {
+        return;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    for (uint32_t pos = 0; read_slot(pos, header); pos += header.span)
+    {
+        if ((header.state == _state_valid) && (header_crc(header) == header.crc))
+        {
+            names.emplace_back(header.name, strnlen(header.name, sizeof(header.name)));
+        }
+    }
+
+    xSemaphoreGive(_mutex);
+}
+
+void ImageSlots::get_status(char *buf, int size, int &encode_len)
+{
+    header_t header;
+    uint32_t pos = 0;
+    uint32_t free_size = 0;
+    int len = 0;
+    bool first = true;
+
+    if (!_partition)
+    {
+        encode_len = snprintf(buf, size, "{\"size\": 0, \"free\": 0, \"slots\": []}");
+        return;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    encode_len = snprintf(buf, size, "{\"size\": %ld, \"slots\": [", _partition->size);
+
+    for (pos = 0; read_slot(pos, header); pos += header.span)
+    {
+        if ((header.state != _state_valid) || (header_crc(header) != header.crc))
+        {
+            free_size += header.span;
+            continue;
+        }
+
+        // Leave room for the closing fields, a full list is cut short
+        len = snprintf(buf + encode_len, size - encode_len, "%s{\"name\": \"%.*s\", \"size\": %ld, \"format\": \"%s\", \"sha256\": \"%s\"}",
+                       first ? "" : ", ", IMAGE_SLOT_NAME_LEN, header.name, header.size, (header.format == IMAGE_SLOT_HEX) ? "hex" : ((header.format == IMAGE_SLOT_CONTAINER) ? "dapi" : "bin"),
+                       HashEngine::to_hex(header.sha256, sizeof(header.sha256)).c_str());
+
+        if ((len > 0) && ((encode_len + len) < (size - 32)))
+        {
+            encode_len += len;
+            first = false;
+        }
+    }
+
+    free_size += _partition->size - pos;
+    encode_len += snprintf(buf + encode_len, size - encode_len, "], \"free\": %ld}", free_size);
+
+    xSemaphoreGive(_mutex);
+}
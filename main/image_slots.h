@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "hash_engine.h"
+
+/*
+ * Raw image slots in the "images" data partition.
+ *
+ * A slot is a 256 byte header followed by the image, its span is rounded up to
+ * the flash sector size. Slots are chained by their span from offset 0, the
+ * first offset without a header magic ends the chain. The state word only ever
+ * clears bits: FREE -> WRITING -> VALID -> DELETED, so a slot interrupted by a
+ * reset stays WRITING and is reused like a deleted one.
+ *
+ * Images are read through esp_partition_mmap, no filesystem and no copy.
+ */
+#define IMAGE_SLOT_NAME_LEN 48
+#define IMAGE_SLOT_EXTENT_MAX 8
+#define IMAGE_SLOT_HEADER_SIZE 256
+
+typedef enum
+{
+    IMAGE_SLOT_BIN,
+    IMAGE_SLOT_HEX,
+    IMAGE_SLOT_CONTAINER // .dapi, addresses come from its extent table
+} image_slot_format_def;
+
+typedef struct
+{
+    uint32_t addr;   // target address
+    uint32_t offset; // in the image
+    uint32_t size;
+} image_slot_extent_t;
+
+typedef struct
+{
+    const uint8_t *data; // memory mapped image
+    uint32_t size;
+    image_slot_format_def format;
+    uint32_t extent_num;
+    image_slot_extent_t extents[IMAGE_SLOT_EXTENT_MAX];
+    uint8_t sha256[32];
+    uint32_t offset;
+    esp_partition_mmap_handle_t handle;
+} image_slot_t;
+
+class ImageSlots
+{
+private:
+    typedef struct
+    {
+        uint32_t magic;
+        uint32_t state;
+        uint32_t span; // partition bytes taken, header included
+        uint32_t size;
+        uint32_t format;
+        uint32_t extent_num;
+        uint8_t sha256[32];
+        char name[IMAGE_SLOT_NAME_LEN];
+        image_slot_extent_t extents[IMAGE_SLOT_EXTENT_MAX];
+        uint32_t crc; // from size to here
+    } header_t;
+
+    static_assert(sizeof(header_t) <= IMAGE_SLOT_HEADER_SIZE, "slot header too large");
+
+    static constexpr uint32_t _magic = 0x534c4f54; // "SLOT"
+    static constexpr uint32_t _state_writing = 0xFFFF0000;
+    static constexpr uint32_t _state_valid = 0xFF000000;
+    static constexpr uint32_t _state_deleted = 0x00000000;
+    static constexpr uint32_t _sector_size = 4096;
+    static constexpr uint32_t _none = 0xFFFFFFFF;
+
+    const esp_partition_t *_partition;
+    SemaphoreHandle_t _mutex;
+    uint32_t _pinned; // slot opened for programming, never reused
+    header_t _header; // of the slot being written
+    uint32_t _write_offset;
+    uint32_t _written;
+    uint32_t _erased_end;
+    HashEngine _sha;
+
+    ImageSlots();
+    bool read_slot(uint32_t offset, header_t &header);
+    uint32_t header_crc(const header_t &header);
+    bool set_state(uint32_t offset, uint32_t state);
+    bool flash_write(uint32_t offset, const void *data, uint32_t len);
+    bool flash_erase(uint32_t offset, uint32_t len);
+    bool allocate(uint32_t span, uint32_t &offset);
+    uint32_t find(const std::string &name, header_t &header);
+
+public:
+    static ImageSlots &get_instance();
+    bool init(void);
+    bool write_begin(const std::string &name, uint32_t size, image_slot_format_def format);
+    bool write(const uint8_t *data, uint32_t len);
+    bool write_end(const image_slot_extent_t *extents, uint32_t extent_num);
+    void write_abort(void);
+    bool open(const std::string &name, image_slot_t &slot);
+    void close(image_slot_t &slot);
+    bool remove(const std::string &name);
+    void list(std::vector<std::string> &names);
+    void get_status(char *buf, int size, int &encode_len);
+};
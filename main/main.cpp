@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <errno.h>
 #include <dirent.h>
 #include <esp_wifi.h>
@@ -29,9 +30,17 @@
 #include "esp_netif.h"
 #include "web_handler.h"
 #include "usb_cdc_handler.h"
+#include "usb_net.h"
 #include "esp_http_server.h"
 #include "web_server.h"
 #include "programmer.h"
+#include "watch.h"
+#include "image_slots.h"
+#include "swd_bus.h"
+#include "swd_host.h"
+#include "mem_tier.h"
+#include "storage_sched.h"
+#include "dap_trace.h"
 #include "protocol_examples_common.h"
 
 static const char *TAG = "main";
@@ -46,30 +55,57 @@ extern "C" void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_r
 {
     static uint8_t s_tx_buf[CFG_TUD_HID_EP_BUFSIZE];
 
-    DAP_ProcessCommand(buffer, s_tx_buf);
+    /* The port may be owned by a programming job or a watch tick, answer with an error instead of stalling USB */
+    if (swd_bus_lock(10))
+    {
+        storage_stat_t before;
+        storage_stat_t after;
+        int64_t start = 0;
+
+        storage_hold_begin();
+        storage_get_stat(&before);
+        start = esp_timer_get_time();
+        DAP_ProcessCommand(buffer, s_tx_buf);
+        storage_get_stat(&after);
+        // a flash write was in flight when the command began or started during it
+        dap_trace_record((uint32_t)(esp_timer_get_time() - start), after.started != before.writes);
+        storage_hold_end();
+        swd_invalidate();
+        swd_bus_unlock();
+    }
+    else
+    {
+        s_tx_buf[0] = buffer[0];
+        s_tx_buf[1] = DAP_ERROR;
+    }
+
     tud_hid_report(0, s_tx_buf, sizeof(s_tx_buf));
 }
 
+// The server listens on all interfaces, it keeps serving the USB network without Wi-Fi
 static void disconnect_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
-    web_server_stop((httpd_handle_t *)arg);
+    if (*(httpd_handle_t *)arg && !usb_net_is_up())
+        web_server_stop((httpd_handle_t *)arg);
 }
 
 static void connect_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
-    web_server_init((httpd_handle_t *)arg);
+    if (!*(httpd_handle_t *)arg)
+        web_server_init((httpd_handle_t *)arg);
 }
 
 extern "C" void app_main(void)
 {
     bool ret = false;
 
+    mem_tier_init();
+    storage_sched_init();
     ESP_ERROR_CHECK(nvs_flash_init());
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, connect_handler, &http_server));
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, disconnect_handler, &http_server));
-    ESP_ERROR_CHECK(example_connect());
 
     tinyusb_config_t tusb_cfg = {
         .device_descriptor = nullptr,
@@ -80,6 +116,7 @@ extern "C" void app_main(void)
         .self_powered = false,
         .vbus_monitor_io = 0};
 
+#if !CFG_TUD_NCM
     tinyusb_config_cdcacm_t acm_cfg = {
         .usb_dev = TINYUSB_USBDEV_0,
         .cdc_port = TINYUSB_CDC_ACM_0,
@@ -88,7 +125,9 @@ extern "C" void app_main(void)
         .callback_rx_wanted_char = NULL,
         .callback_line_state_changed = NULL,
         .callback_line_coding_changed = usb_cdc_set_line_codinig};
+#endif
 
+    swd_bus_init();
     DAP_Setup();
 
     ESP_LOGI(TAG, "USB initialization");
@@ -100,11 +139,37 @@ extern "C" void app_main(void)
     tusb_cfg.device_descriptor = get_device_descriptor();
 
     ESP_ERROR_CHECK(tinyusb_driver_install(&tusb_cfg));
+#if CFG_TUD_NCM
+    ret = usb_net_init();
+#else
     ESP_ERROR_CHECK(tusb_cdc_acm_init(&acm_cfg));
+#endif
 
     programmer_init();
-    cdc_uart_init(UART_NUM_1, GPIO_NUM_13, GPIO_NUM_14, 115200);
-    cdc_uart_register_rx_handler(CDC_UART_USB_HANDLER, usb_cdc_send_to_host, (void *)TINYUSB_CDC_ACM_0);
+    ImageSlots::get_instance().init();
+    watch_init();
+    cdc_uart_init(0, UART_NUM_1, (gpio_num_t)CONFIG_CDC_UART0_TX_PIN, (gpio_num_t)CONFIG_CDC_UART0_RX_PIN, CONFIG_CDC_UART0_BAUDRATE);
+#if CONFIG_CDC_UART_PORT_NUM > 1
+    cdc_uart_init(1, UART_NUM_2, (gpio_num_t)CONFIG_CDC_UART1_TX_PIN, (gpio_num_t)CONFIG_CDC_UART1_RX_PIN, CONFIG_CDC_UART1_BAUDRATE);
+#endif
+#if !CFG_TUD_NCM
+    cdc_uart_register_rx_handler(CDC_UART_USB_HANDLER, usb_cdc_send_to_host, NULL);
+#endif
+    web_serial_init();
     cdc_uart_register_rx_handler(CDC_UART_WEB_HANDLER, web_send_to_clients, &http_server);
+    cdc_uart_register_tx_handler(web_serial_tx_resume, &http_server);
     ESP_LOGI(TAG, "USB initialization DONE");
+
+#if CFG_TUD_NCM
+    if (ret)
+        web_server_init(&http_server);
+
+    // Wi-Fi is optional when the probe is reachable over USB
+    if (example_connect() != ESP_OK)
+        ESP_LOGW(TAG, "Wi-Fi not connected, serving the USB network only");
+#else
+    ESP_ERROR_CHECK(example_connect());
+#endif
+
+    mem_tier_report();
 }
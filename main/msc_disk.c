@@ -18,6 +18,7 @@
 #include "diskio_impl.h"
 #include "esp_check.h"
 #include "diskio_sdmmc.h"
+#include "storage_sched.h"
 
 static const char *TAG = "msc_disk";
 
@@ -114,6 +115,18 @@ clean:
 }
 #endif
 
+#ifdef CONFIG_MSC_STORAGE_MEDIA_SPIFLASH
+/* The host's sector writes wait for the write window before esp_tinyusb takes its locks, see main/CMakeLists.txt */
+int32_t __real_tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize);
+
+int32_t __wrap_tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
+{
+    storage_write_wait();
+
+    return __real_tud_msc_write10_cb(lun, lba, offset, buffer, bufsize);
+}
+#endif
+
 // mount the partition and show all the files in path
 bool msc_dick_mount(const char *path)
 {
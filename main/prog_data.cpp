@@ -3,6 +3,12 @@
 #include "esp_log.h"
 #include <cstring>
 #include "file_programmer.h"
+#include "container_program.h"
+#include "swd_bus.h"
+#include "flash_accessor.h"
+#include "target_swd.h"
+#include "mem_tier.h"
+#include "storage_sched.h"
 
 #define TAG "prog_data"
 #define MSG_BUF_SIZE 512
@@ -134,7 +140,7 @@ void ProgData::clean_algorithm()
 {
     if (_target.algo_blob)
     {
-        delete[] _target.algo_blob;
+        mem_tier_free(_target.algo_blob);
         _target.algo_blob = nullptr;
     }
 }
@@ -150,6 +156,107 @@ void ProgData::disable_timeout_timer()
     xTimerStop(_timer, portMAX_DELAY);
 }
 
+void ProgData::swd_session_begin(void)
+{
+    static const uint32_t calibrate_clocks[] = {20000000, 10000000, 8000000, 5000000, 4000000, 2000000, 1000000};
+    swd_config_t cfg;
+
+    /* The job owns the port until swd_session_end(), storage writes of other tasks are held off meanwhile */
+    swd_bus_lock(portMAX_DELAY);
+    storage_job_begin();
+
+    /* A debugger may have used the port, start the job from a clean transaction state */
+    TargetSWD::get_instance().get_engine().invalidate();
+    TargetSWD::get_instance().get_engine().reset_transfer_stat();
+
+    /* Keep the settings of an attached debugger, they are put back in swd_session_end() */
+    swd_config_save(&_debugger_swd_cfg);
+    swd_config_default(&cfg);
+
+    if (_request.swd_idle_cycles >= 0)
+        cfg.idle_cycles = _request.swd_idle_cycles;
+
+    if (_request.swd_retry >= 0)
+        cfg.retry_count = _request.swd_retry;
+
+    if (_request.swd_turnaround >= 0)
+        cfg.turnaround = _request.swd_turnaround;
+
+    if (_request.swd_clock == PROG_SWD_CLOCK_AUTO)
+    {
+        swd_config_apply(&cfg);
+        cfg.clock = swd_config_calibrate(calibrate_clocks, sizeof(calibrate_clocks) / sizeof(calibrate_clocks[0]));
+
+        if (cfg.clock == 0)
+        {
+            ESP_LOGW(TAG, "SWD clock calibration failed, use %d Hz", CONFIG_PROGRAMMER_SWD_CLOCK);
+            cfg.clock = CONFIG_PROGRAMMER_SWD_CLOCK;
+        }
+    }
+    else if (_request.swd_clock != 0)
+    {
+        cfg.clock = _request.swd_clock;
+    }
+    else
+    {
+        cfg.clock = CONFIG_PROGRAMMER_SWD_CLOCK;
+    }
+
+    ESP_LOGI(TAG, "SWD clock %ld Hz, idle %d, retry %d, turnaround %d", cfg.clock, cfg.idle_cycles, cfg.retry_count, cfg.turnaround);
+    swd_config_apply(&cfg);
+    _job_swd_cfg = cfg;
+
+    if (_request.core == PROG_CORE_CORTEX_A)
+    {
+        ESP_LOGI(TAG, "Cortex-A, AP %d, debug base 0x%lx", _request.ap, _request.debug_base);
+        TargetSWDCA::get_instance().configure(_request.ap, _request.debug_base);
+        FlashAccessor::get_instance().swd_init(TargetSWDCA::get_instance());
+    }
+    else
+    {
+        FlashAccessor::get_instance().swd_init(TargetSWD::get_instance());
+    }
+
+#if CONFIG_PROGRAMMER_PUSHED_VERIFY
+    FlashAccessor::get_instance().set_pushed_verify(true);
+#else
+    FlashAccessor::get_instance().set_pushed_verify(false);
+#endif
+
+#if CONFIG_PROGRAMMER_RECOVERY_SLOW_CLOCK
+    FlashAccessor::get_instance().set_recovery(CONFIG_PROGRAMMER_RECOVERY_RETRIES, [this]() { return swd_slow_down(); });
+#else
+    FlashAccessor::get_instance().set_recovery(CONFIG_PROGRAMMER_RECOVERY_RETRIES);
+#endif
+}
+
+/* Halve the clock of the job after a failed retry, the port stays locked by the job */
+bool ProgData::swd_slow_down(void)
+{
+    if (_job_swd_cfg.clock <= PROG_SWD_CLOCK_MIN)
+    {
+        return false;
+    }
+
+    _job_swd_cfg.clock = ((_job_swd_cfg.clock / 2) > PROG_SWD_CLOCK_MIN) ? (_job_swd_cfg.clock / 2) : (PROG_SWD_CLOCK_MIN);
+    ESP_LOGW(TAG, "SWD clock down to %ld Hz", _job_swd_cfg.clock);
+    swd_config_apply(&_job_swd_cfg);
+
+    return true;
+}
+
+void ProgData::swd_session_end(void)
+{
+    SWDEngine<DapTransport> &engine = TargetSWD::get_instance().get_engine();
+
+    engine.sync();
+    ESP_LOGI(TAG, "SWD transfers %ld, %ld saved", engine.get_transfer_stat().transfers, engine.get_transfer_stat().saved);
+
+    swd_config_apply(&_debugger_swd_cfg);
+    storage_job_end();
+    swd_bus_unlock();
+}
+
 prog_err_def ProgData::request_decode(prog_req_t &request, char *buf, int len)
 {
     cJSON *root = NULL;
@@ -160,6 +267,20 @@ prog_err_def ProgData::request_decode(prog_req_t &request, char *buf, int len)
     cJSON *program_mode_item = NULL;
     cJSON *format_item = NULL;
     cJSON *total_size_item = NULL;
+    cJSON *swd_clock_item = NULL;
+    cJSON *swd_idle_cycles_item = NULL;
+    cJSON *swd_retry_item = NULL;
+    cJSON *swd_turnaround_item = NULL;
+    cJSON *url_item = NULL;
+    cJSON *sha256_item = NULL;
+    cJSON *core_item = NULL;
+    cJSON *ap_item = NULL;
+    cJSON *debug_base_item = NULL;
+    cJSON *slot_item = NULL;
+    cJSON *version_addr_item = NULL;
+    cJSON *version_size_item = NULL;
+    cJSON *diff_item = NULL;
+    image_container_header_t container;
 
     root = cJSON_Parse(buf);
     if (!root)
@@ -170,11 +291,24 @@ prog_err_def ProgData::request_decode(prog_req_t &request, char *buf, int len)
 
     request.program.clear();
     request.algorithm.clear();
+    request.url.clear();
+    request.sha256.clear();
+    request.slot.clear();
     request.flash_addr = 0;
     request.total_size = 0;
+    request.swd_clock = 0;
+    request.swd_idle_cycles = -1;
+    request.swd_retry = -1;
+    request.swd_turnaround = -1;
     request.ram_addr = 0x20000000;
     request.mode = PROG_UNKNOWN_MODE;
     request.format = PROG_UNKNOWN_FORMAT;
+    request.core = PROG_CORE_CORTEX_M;
+    request.ap = 1;
+    request.debug_base = 0x80090000;
+    request.version_addr = 0;
+    request.version_size = 0;
+    request.diff = false;
     program_mode_item = cJSON_GetObjectItem(root, "program_mode");
     ram_addr_item = cJSON_GetObjectItem(root, "ram_addr");
     flash_addr_item = cJSON_GetObjectItem(root, "flash_addr");
@@ -182,6 +316,19 @@ prog_err_def ProgData::request_decode(prog_req_t &request, char *buf, int len)
     algorithm_item = cJSON_GetObjectItem(root, "algorithm");
     format_item = cJSON_GetObjectItem(root, "format");
     total_size_item = cJSON_GetObjectItem(root, "total_size");
+    swd_clock_item = cJSON_GetObjectItem(root, "swd_clock");
+    swd_idle_cycles_item = cJSON_GetObjectItem(root, "swd_idle_cycles");
+    swd_retry_item = cJSON_GetObjectItem(root, "swd_retry");
+    swd_turnaround_item = cJSON_GetObjectItem(root, "swd_turnaround");
+    url_item = cJSON_GetObjectItem(root, "url");
+    sha256_item = cJSON_GetObjectItem(root, "sha256");
+    core_item = cJSON_GetObjectItem(root, "core");
+    ap_item = cJSON_GetObjectItem(root, "ap");
+    debug_base_item = cJSON_GetObjectItem(root, "debug_base");
+    slot_item = cJSON_GetObjectItem(root, "slot");
+    version_addr_item = cJSON_GetObjectItem(root, "version_addr");
+    version_size_item = cJSON_GetObjectItem(root, "version_size");
+    diff_item = cJSON_GetObjectItem(root, "diff");
 
     if (algorithm_item && algorithm_item->type == cJSON_String)
         request.algorithm = std::string(CONFIG_PROGRAMMER_ALGORITHM_ROOT) + "/" + std::string(algorithm_item->valuestring);
@@ -189,6 +336,24 @@ prog_err_def ProgData::request_decode(prog_req_t &request, char *buf, int len)
     if (program_item && program_item->type == cJSON_String)
         request.program = std::string(CONFIG_PROGRAMMER_PROGRAM_ROOT) + "/" + std::string(program_item->valuestring);
 
+    if (url_item && url_item->type == cJSON_String)
+    {
+        /* Cache the image under the program root, named after the last path segment of the url */
+        request.url = url_item->valuestring;
+
+        if (request.program.empty())
+        {
+            std::string name = request.url.substr(0, request.url.find_first_of("?#"));
+            request.program = std::string(CONFIG_PROGRAMMER_PROGRAM_ROOT) + "/" + name.substr(name.find_last_of('/') + 1);
+        }
+    }
+
+    if (sha256_item && sha256_item->type == cJSON_String)
+        request.sha256 = sha256_item->valuestring;
+
+    if (slot_item && slot_item->type == cJSON_String)
+        request.slot = slot_item->valuestring;
+
     if (flash_addr_item && (flash_addr_item->type == cJSON_Number))
         request.flash_addr = flash_addr_item->valueint;
 
@@ -198,12 +363,58 @@ prog_err_def ProgData::request_decode(prog_req_t &request, char *buf, int len)
     if (total_size_item && (total_size_item->type == cJSON_Number))
         request.total_size = total_size_item->valueint;
 
+    if (swd_clock_item && (swd_clock_item->type == cJSON_Number) && (swd_clock_item->valuedouble > 0))
+        request.swd_clock = static_cast<uint32_t>(swd_clock_item->valuedouble);
+    else if (swd_clock_item && (swd_clock_item->type == cJSON_String) && !strcmp("auto", swd_clock_item->valuestring))
+        request.swd_clock = PROG_SWD_CLOCK_AUTO;
+
+    /* Out of range values keep the default, the widths are those of DAP_Data */
+    if (swd_idle_cycles_item && (swd_idle_cycles_item->type == cJSON_Number) && (swd_idle_cycles_item->valueint >= 0) && (swd_idle_cycles_item->valueint <= UINT8_MAX))
+        request.swd_idle_cycles = swd_idle_cycles_item->valueint;
+
+    if (swd_retry_item && (swd_retry_item->type == cJSON_Number) && (swd_retry_item->valueint >= 0) && (swd_retry_item->valueint <= UINT16_MAX))
+        request.swd_retry = swd_retry_item->valueint;
+
+    if (swd_turnaround_item && (swd_turnaround_item->type == cJSON_Number) && (swd_turnaround_item->valueint >= 1) && (swd_turnaround_item->valueint <= 4))
+        request.swd_turnaround = swd_turnaround_item->valueint;
+
+    if (core_item && (core_item->type == cJSON_String) && !strcmp("cortex-a", core_item->valuestring))
+        request.core = PROG_CORE_CORTEX_A;
+
+    if (ap_item && (ap_item->type == cJSON_Number))
+        request.ap = ap_item->valueint;
+
+    /* valueint saturates at INT_MAX, debug bases usually sit above it */
+    if (debug_base_item && (debug_base_item->type == cJSON_Number))
+        request.debug_base = static_cast<uint32_t>(debug_base_item->valuedouble);
+
+    if (version_addr_item && (version_addr_item->type == cJSON_Number))
+        request.version_addr = static_cast<uint32_t>(version_addr_item->valuedouble);
+
+    if (version_size_item && (version_size_item->type == cJSON_Number))
+        request.version_size = version_size_item->valueint;
+
+    request.diff = cJSON_IsTrue(diff_item);
+
+    /* A container names its algorithm and RAM address, the job may leave them out */
+    if (request.url.empty() && FileProgrammer::compare_extension(request.program.c_str(), ".dapi") &&
+        ContainerProgram::read_header(request.program, container))
+    {
+        if (request.algorithm.empty() && container.algorithm[0])
+            request.algorithm = std::string(CONFIG_PROGRAMMER_ALGORITHM_ROOT) + "/" + std::string(container.algorithm);
+
+        if (!ram_addr_item && container.ram_addr)
+            request.ram_addr = container.ram_addr;
+    }
+
     if (program_mode_item && (program_mode_item->type == cJSON_String))
     {
         if (!strcmp("online", program_mode_item->valuestring))
             request.mode = PROG_ONLINE_MODE;
         else if (!strcmp("offline", program_mode_item->valuestring))
             request.mode = PROG_OFFLINE_MODE;
+        else if (!strcmp("fingerprint", program_mode_item->valuestring))
+            request.mode = PROG_FINGERPRINT_MODE;
     }
 
     if (format_item && format_item->type == cJSON_String)
@@ -228,7 +439,28 @@ prog_err_def ProgData::request_decode(prog_req_t &request, char *buf, int len)
         return PROG_ERR_ALGORITHM_NOT_EXIST;
     }
 
-    if ((request.mode == PROG_OFFLINE_MODE) && (request.program.empty() || !FileProgrammer::is_exist(request.program.c_str())))
+    if (!request.url.empty() && ((request.mode != PROG_OFFLINE_MODE) || (request.url.compare(0, 7, "http://") && request.url.compare(0, 8, "https://"))))
+    {
+        ESP_LOGE(TAG, "Images can only be pulled by offline jobs over http(s)");
+        cJSON_Delete(root);
+        return PROG_ERR_MODE_INVALID;
+    }
+
+    if (!request.slot.empty() && ((request.mode != PROG_OFFLINE_MODE) || !request.url.empty()))
+    {
+        ESP_LOGE(TAG, "Slots are programmed by offline jobs without url");
+        cJSON_Delete(root);
+        return PROG_ERR_MODE_INVALID;
+    }
+
+    if (!request.sha256.empty() && (request.sha256.length() != 64))
+    {
+        ESP_LOGE(TAG, "Invalid sha256");
+        cJSON_Delete(root);
+        return PROG_ERR_JSON_FORMAT_INCORRECT;
+    }
+
+    if ((request.mode == PROG_OFFLINE_MODE) && request.url.empty() && request.slot.empty() && (request.program.empty() || !FileProgrammer::is_exist(request.program.c_str())))
     {
         ESP_LOGE(TAG, "Program is not exist");
         cJSON_Delete(root);
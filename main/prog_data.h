@@ -7,6 +7,10 @@
 #include "freertos/semphr.h"
 #include "freertos/message_buffer.h"
 #include "algo_extractor.h"
+#include "swd_host.h"
+
+#define PROG_SWD_CLOCK_AUTO 0xFFFFFFFF
+#define PROG_SWD_CLOCK_MIN 1000000 // floor of the recovery clock drops
 
 typedef enum
 {
@@ -22,6 +26,7 @@ typedef enum
     PROG_UNKNOWN_MODE,
     PROG_ONLINE_MODE,
     PROG_OFFLINE_MODE,
+    PROG_FINGERPRINT_MODE,
     PROG_IDLE_MODE
 } prog_mode_def;
 
@@ -32,6 +37,12 @@ typedef enum
     PROG_HEX_FORMAT
 } prog_format_def;
 
+typedef enum
+{
+    PROG_CORE_CORTEX_M,
+    PROG_CORE_CORTEX_A
+} prog_core_def;
+
 typedef enum
 {
     PROG_ERR_NONE,
@@ -54,8 +65,21 @@ typedef struct
     uint32_t flash_addr;
     uint32_t ram_addr;
     uint32_t total_size;
+    uint32_t swd_clock;
+    int32_t swd_idle_cycles; // -1: default of swd_config_default()
+    int32_t swd_retry;       // WAIT retries, -1: default
+    int32_t swd_turnaround;  // 1..4 cycles, -1: default
     std::string algorithm;
     std::string program;
+    std::string url;    // pull mode: fetched into program before an offline job
+    std::string sha256; // expected digest of the fetched image or the slot, hex
+    std::string slot;   // offline: program from this image slot instead of a file
+    prog_core_def core;
+    uint8_t ap;          // Cortex-A: APB-AP index
+    uint32_t debug_base; // Cortex-A: debug register base on the APB-AP
+    uint32_t version_addr; // fingerprint: version block compared before the app range
+    uint32_t version_size;
+    bool diff; // offline .dapi: program only the sectors that differ from the target
 } prog_req_t;
 
 typedef struct
@@ -86,6 +110,10 @@ private:
     AlgoExtractor _extractor;
     FlashIface::target_cfg_t _cfg;
     FlashIface::program_target_t _target;
+    swd_config_t _debugger_swd_cfg;
+    swd_config_t _job_swd_cfg;
+
+    bool swd_slow_down(void);
 
 public:
     ProgData();
@@ -107,6 +135,8 @@ public:
     void clean_algorithm();
     void enable_timeout_timer(uint32_t ms);
     void disable_timeout_timer();
+    void swd_session_begin(void);
+    void swd_session_end(void);
 
     static prog_err_def request_decode(prog_req_t &request, char *buf, int len);
 };
@@ -0,0 +1,309 @@
+#include "prog_fingerprint.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "flash_accessor.h"
+#include "image_slots.h"
+#include "kernels.h"
+#include <algorithm>
+#include <cstdio>
+
+#define TAG "prog_fingerprint"
+
+ProgFingerprint::ProgFingerprint()
+    : _mutex(xSemaphoreCreateMutex()),
+      _result("{\"status\": \"none\"}")
+{
+}
+
+/* Region CRCs of every binary slot, the target side is compared against these */
+void ProgFingerprint::build_index(const prog_req_t &request)
+{
+    std::vector<std::string> names;
+    ImageSlots &slots = ImageSlots::get_instance();
+
+    _index.clear();
+    slots.list(names);
+
+    for (auto &name : names)
+    {
+        image_slot_t slot;
+        image_slot_extent_t whole = {request.flash_addr, 0, 0};
+        const image_slot_extent_t *extents = nullptr;
+        uint32_t extent_num = 0;
+        entry_t entry;
+
+        if (!slots.open(name, slot))
+        {
+            continue;
+        }
+
+        whole.size = slot.size;
+        extents = slot.extent_num ? (slot.extents) : (&whole);
+        extent_num = slot.extent_num ? (slot.extent_num) : (request.flash_addr ? 1 : 0);
+
+        if ((slot.format != IMAGE_SLOT_BIN) || !extent_num)
+        {
+            ESP_LOGW(TAG, "%s skipped, only binary slots with an address are indexed", name.c_str());
+            slots.close(slot);
+            continue;
+        }
+
+        entry.name = name;
+        entry.version = {request.version_addr, 0, 0};
+        entry.vector = {extents[0].addr, 0, 0};
+        entry.total = 0;
+        entry.matched = 0;
+        entry.signature = false;
+
+        for (uint32_t i = 1; i < extent_num; i++)
+        {
+            entry.vector.addr = std::min(entry.vector.addr, extents[i].addr);
+        }
+
+        for (uint32_t i = 0; i < extent_num; i++)
+        {
+            const image_slot_extent_t &extent = extents[i];
+            const uint8_t *data = slot.data + extent.offset;
+
+            if ((extent.offset + extent.size) > slot.size)
+            {
+                continue;
+            }
+
+            /* The vector table sits at the start of the lowest extent */
+            if (extent.addr == entry.vector.addr)
+            {
+                entry.vector.size = std::min(extent.size, _vector_size);
+                entry.vector.crc = kernel_crc32(0, data, entry.vector.size);
+            }
+
+            if (request.version_size && (request.version_addr >= extent.addr) && ((request.version_addr + request.version_size) <= (extent.addr + extent.size)))
+            {
+                entry.version.size = request.version_size;
+                entry.version.crc = kernel_crc32(0, data + (request.version_addr - extent.addr), request.version_size);
+            }
+
+            for (uint32_t offset = 0; offset < extent.size; offset += _block_size)
+            {
+                region_t block = {extent.addr + offset, std::min(extent.size - offset, _block_size), 0};
+
+                block.crc = kernel_crc32(0, data + offset, block.size);
+                entry.blocks.push_back(block);
+                entry.total += block.size;
+            }
+        }
+
+        slots.close(slot);
+
+        if (entry.total)
+        {
+            _index.push_back(entry);
+        }
+    }
+
+    ESP_LOGI(TAG, "%d images indexed", static_cast<int>(_index.size()));
+}
+
+/* Target CRCs are shared by images with the same layout */
+bool ProgFingerprint::target_crc(const region_t &region, uint32_t &crc)
+{
+    uint64_t key = (static_cast<uint64_t>(region.addr) << 32) | region.size;
+    auto it = _target_crc.find(key);
+
+    if (it != _target_crc.end())
+    {
+        crc = it->second;
+        return true;
+    }
+
+    crc = 0;
+
+    if (FlashAccessor::get_instance().checksum(region.addr, region.size, crc) != FlashIface::ERR_NONE)
+    {
+        return false;
+    }
+
+    _target_crc[key] = crc;
+
+    return true;
+}
+
+bool ProgFingerprint::region_match(const region_t &region, bool &match)
+{
+    uint32_t crc = 0;
+
+    if (!target_crc(region, crc))
+    {
+        return false;
+    }
+
+    match = (crc == region.crc);
+
+    return true;
+}
+
+bool ProgFingerprint::compare(entry_t &entry)
+{
+    bool match = false;
+
+    entry.matched = 0;
+
+    for (auto &block : entry.blocks)
+    {
+        if (!region_match(block, match))
+        {
+            return false;
+        }
+
+        entry.matched += match ? (block.size) : (0);
+    }
+
+    return true;
+}
+
+void ProgFingerprint::set_result(const std::string &result)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _result = result;
+    xSemaphoreGive(_mutex);
+}
+
+void ProgFingerprint::program_start_handle(ProgData &obj)
+{
+    TickType_t start_time = xTaskGetTickCount();
+    prog_req_t &request = obj.get_request();
+    FlashIface::program_target_t *target = nullptr;
+    FlashIface::target_cfg_t *cfg = nullptr;
+    FlashAccessor &accessor = FlashAccessor::get_instance();
+    entry_t *best = nullptr;
+    bool any_signature = false;
+    bool ok = true;
+    bool opened = false;
+    uint32_t ranges = 0;
+    uint32_t range_addr = 0;
+    uint32_t range_size = 0;
+    char line[192];
+    std::string result;
+
+    set_result("{\"status\": \"busy\"}");
+    _target_crc.clear();
+    build_index(request);
+
+    if (_index.empty() || !obj.get_algorithm(request.algorithm, &target, &cfg, request.ram_addr))
+    {
+        ESP_LOGE(TAG, "Nothing to compare with");
+        set_result("{\"status\": \"failed\"}");
+        Prog::switch_mode(PROG_IDLE_MODE);
+        obj.set_busy_state(false);
+        return;
+    }
+
+    opened = (accessor.init(*cfg) == FlashIface::ERR_NONE);
+    ok = opened;
+
+    /* Signature regions first, they are small and tell most images apart */
+    for (auto &entry : _index)
+    {
+        bool vector = false;
+        bool version = true;
+
+        if (!ok)
+        {
+            break;
+        }
+
+        ok = (!entry.vector.size || region_match(entry.vector, vector)) && (!entry.version.size || region_match(entry.version, version));
+        entry.signature = vector && version;
+        any_signature = any_signature || entry.signature;
+    }
+
+    /* Full app range only where the signature matched, all images if none did */
+    for (size_t i = 0; ok && (i < _index.size()); i++)
+    {
+        entry_t &entry = _index[i];
+
+        if (entry.signature || !any_signature)
+        {
+            ok = compare(entry);
+
+            if (!best || (entry.signature > best->signature) ||
+                ((entry.signature == best->signature) && (static_cast<uint64_t>(entry.matched) * best->total > static_cast<uint64_t>(best->matched) * entry.total)))
+            {
+                best = &entry;
+            }
+        }
+
+        obj.set_progress((i + 1) * 100 / _index.size());
+    }
+
+    if (opened && (accessor.uninit() != FlashIface::ERR_NONE))
+    {
+        ESP_LOGW(TAG, "Flash uninit failed");
+    }
+
+    obj.clean_algorithm();
+
+    if (!ok || !best)
+    {
+        ESP_LOGE(TAG, "Fingerprint failed");
+        set_result("{\"status\": \"failed\"}");
+        Prog::switch_mode(PROG_IDLE_MODE);
+        obj.set_busy_state(false);
+        return;
+    }
+
+    snprintf(line, sizeof(line), "{\"status\": \"done\", \"match\": \"%s\", \"signature\": %s, \"matched\": %ld, \"total\": %ld, \"mismatch\": [",
+             best->name.c_str(), best->signature ? "true" : "false", best->matched, best->total);
+    result = line;
+
+    /* Adjacent mismatching blocks are merged into one range */
+    for (size_t i = 0; i <= best->blocks.size(); i++)
+    {
+        uint32_t crc = 0;
+        bool mismatch = (i < best->blocks.size()) && target_crc(best->blocks[i], crc) && (crc != best->blocks[i].crc);
+
+        if (mismatch && range_size && ((range_addr + range_size) == best->blocks[i].addr))
+        {
+            range_size += best->blocks[i].size;
+            continue;
+        }
+
+        if (range_size && (ranges < _mismatch_max))
+        {
+            snprintf(line, sizeof(line), "%s{\"addr\": %ld, \"size\": %ld}", ranges ? ", " : "", range_addr, range_size);
+            result += line;
+            ranges++;
+        }
+
+        range_size = 0;
+
+        if (mismatch)
+        {
+            range_addr = best->blocks[i].addr;
+            range_size = best->blocks[i].size;
+        }
+    }
+
+    result += "]}";
+    set_result(result);
+
+    ESP_LOGI(TAG, "Best match %s, %ld of %ld bytes, %ld ms", best->name.c_str(), best->matched, best->total, pdTICKS_TO_MS(xTaskGetTickCount() - start_time));
+
+    Prog::switch_mode(PROG_IDLE_MODE);
+    obj.set_busy_state(false);
+}
+
+void ProgFingerprint::get_result(char *buf, int size, int &encode_len)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    encode_len = snprintf(buf, size, "%s", _result.c_str());
+    xSemaphoreGive(_mutex);
+
+    encode_len = std::min(encode_len, size - 1);
+}
+
+const char *ProgFingerprint::name()
+{
+    return TAG;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "prog.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Tells which stored image a board runs without reading it back. The images
+ * in the slots are split into signature regions (vector table, version block)
+ * and app blocks, each with its CRC32. The same CRCs are computed on the
+ * target by a helper in its RAM, so only the results cross SWD.
+ */
+class ProgFingerprint : public Prog
+{
+private:
+    typedef struct
+    {
+        uint32_t addr;
+        uint32_t size;
+        uint32_t crc;
+    } region_t;
+
+    typedef struct
+    {
+        std::string name;
+        region_t vector;
+        region_t version; // size 0 when the image does not cover the version block
+        std::vector<region_t> blocks;
+        uint32_t total;
+        uint32_t matched;
+        bool signature;
+    } entry_t;
+
+    static constexpr uint32_t _vector_size = 512;
+    static constexpr uint32_t _block_size = 4096;
+    static constexpr uint32_t _mismatch_max = 16;
+
+    SemaphoreHandle_t _mutex;
+    std::string _result;
+    std::vector<entry_t> _index;
+    std::map<uint64_t, uint32_t> _target_crc; // by addr << 32 | size
+
+    void build_index(const prog_req_t &request);
+    bool target_crc(const region_t &region, uint32_t &crc);
+    bool region_match(const region_t &region, bool &match);
+    bool compare(entry_t &entry);
+    void set_result(const std::string &result);
+
+public:
+    ProgFingerprint();
+    virtual void program_start_handle(ProgData &obj) override;
+    virtual const char *name() override;
+    void get_result(char *buf, int size, int &encode_len);
+};
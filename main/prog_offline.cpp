@@ -2,14 +2,18 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "image_fetch.h"
+#include "image_slots.h"
+#include <strings.h>
 
 #define TAG "prog_offline"
 
 BinaryProgram ProgOffline::_bin_program;
 HexProgram ProgOffline::_hex_program;
+ContainerProgram ProgOffline::_container_program;
 
 ProgOffline::ProgOffline()
-    : _file_program(_bin_program, _hex_program)
+    : _file_program(_bin_program, _hex_program, _container_program)
 {
 }
 
@@ -23,10 +27,25 @@ void ProgOffline::program_start_handle(ProgData &obj)
     _file_program.register_progress_changed_callback(std::bind(&ProgData::set_progress, &obj, std::placeholders::_1));
     ESP_LOGI(TAG, "file: %s", request.program.c_str());
 
+    if (!request.url.empty())
+    {
+        image_fetch_err_def err = image_fetch(request.url, request.program, request.sha256);
+
+        if ((err != IMAGE_FETCH_OK) && (err != IMAGE_FETCH_NOT_MODIFIED))
+        {
+            ESP_LOGE(TAG, "Failed to fetch %s (%d)", request.url.c_str(), err);
+            Prog::switch_mode(PROG_IDLE_MODE);
+            obj.set_busy_state(false);
+            return;
+        }
+    }
+
+    _container_program.set_diff(request.diff);
+
     if (obj.get_algorithm(request.algorithm, &target, &cfg, request.ram_addr))
     {
         start_time = xTaskGetTickCount();
-        if (_file_program.program(request.program, *cfg, request.flash_addr))
+        if (request.slot.empty() ? _file_program.program(request.program, *cfg, request.flash_addr) : program_slot(request, *cfg))
             ESP_LOGI(TAG, "Elapsed time %ld ms", pdTICKS_TO_MS(xTaskGetTickCount() - start_time));
         else
             ESP_LOGE(TAG, "Program failed");
@@ -37,6 +56,55 @@ void ProgOffline::program_start_handle(ProgData &obj)
     obj.set_busy_state(false);
 }
 
+bool ProgOffline::program_slot(prog_req_t &request, FlashIface::target_cfg_t &cfg)
+{
+    image_slot_t slot;
+    bool ret = true;
+    ImageSlots &slots = ImageSlots::get_instance();
+
+    if (!slots.open(request.slot, slot))
+    {
+        ESP_LOGE(TAG, "Slot %s not found", request.slot.c_str());
+        return false;
+    }
+
+    ESP_LOGI(TAG, "slot: %s, %ld bytes", request.slot.c_str(), slot.size);
+
+    if (!request.sha256.empty() && strcasecmp(request.sha256.c_str(), HashEngine::to_hex(slot.sha256, sizeof(slot.sha256)).c_str()))
+    {
+        ESP_LOGE(TAG, "SHA-256 mismatch");
+        ret = false;
+    }
+    else if (slot.format == IMAGE_SLOT_HEX)
+    {
+        ret = _file_program.program(slot.data, slot.size, FileProgrammer::IMAGE_HEX, cfg);
+    }
+    else if (slot.format == IMAGE_SLOT_CONTAINER)
+    {
+        ret = _file_program.program(slot.data, slot.size, FileProgrammer::IMAGE_CONTAINER, cfg);
+    }
+    else if (request.flash_addr || !slot.extent_num)
+    {
+        if (!request.flash_addr)
+            ESP_LOGE(TAG, "The programming address must be provided for binary slots without extents");
+
+        ret = request.flash_addr && _file_program.program(slot.data, slot.size, FileProgrammer::IMAGE_BIN, cfg, request.flash_addr);
+    }
+    else
+    {
+        for (uint32_t i = 0; ret && (i < slot.extent_num); i++)
+        {
+            image_slot_extent_t &extent = slot.extents[i];
+
+            ret = ((extent.offset + extent.size) <= slot.size) && _file_program.program(slot.data + extent.offset, extent.size, FileProgrammer::IMAGE_BIN, cfg, extent.addr);
+        }
+    }
+
+    slots.close(slot);
+
+    return ret;
+}
+
 const char *ProgOffline::name()
 {
     return TAG;
@@ -3,6 +3,7 @@
 #include "prog.h"
 #include "bin_program.h"
 #include "hex_program.h"
+#include "container_program.h"
 #include "file_programmer.h"
 
 class ProgOffline : public Prog
@@ -10,10 +11,13 @@ class ProgOffline : public Prog
 protected:
     static BinaryProgram _bin_program;
     static HexProgram _hex_program;
+    static ContainerProgram _container_program;
 
 private:
     FileProgrammer _file_program;
 
+    bool program_slot(prog_req_t &request, FlashIface::target_cfg_t &cfg);
+
 public:
     ProgOffline();
     virtual void program_start_handle(ProgData &obj) override;
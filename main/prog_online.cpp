@@ -77,13 +77,25 @@ void ProgOnline::program_data_handle(ProgData &obj)
             obj.set_progress(_writed_offset * 100 / _total_size);
         else if (_writed_offset == _total_size)
         {
+            /* The last extents may still be on their way to the target */
+            bool flushed = _stream_program.flush();
+
             obj.clean_algorithm();
             Prog::switch_mode(PROG_IDLE_MODE);
             obj.disable_timeout_timer();
             obj.set_busy_state(false);
             obj.clean_algorithm();
-            obj.set_progress(100);
             _stream_program.clean();
+
+            if (!flushed)
+            {
+                obj.set_swap(reinterpret_cast<void *>(PROG_ERR_PROGRAM_FAILED));
+                obj.send_sync();
+                ESP_LOGE(TAG, "Write flash failed");
+                return;
+            }
+
+            obj.set_progress(100);
             ESP_LOGI(TAG, "Elapsed time %ld ms", pdTICKS_TO_MS((xTaskGetTickCount() - _start_time)));
         }
         else
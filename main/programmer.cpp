@@ -8,14 +8,26 @@
 #include "prog_idle.h"
 #include "prog_online.h"
 #include "prog_offline.h"
+#include "prog_fingerprint.h"
+#include "program_pipeline.h"
+#include "storage_sched.h"
 #include <sys/stat.h>
 #include <cstring>
 
 #define TAG "programmer"
 
+#if CONFIG_PROGRAMMER_PIPELINE && !CONFIG_FREERTOS_UNICORE
+#define PROGRAMMER_SWD_CORE CONFIG_PROGRAMMER_SWD_CORE
+#define PROGRAMMER_DECODE_CORE (!CONFIG_PROGRAMMER_SWD_CORE)
+#else
+#define PROGRAMMER_SWD_CORE 0
+#define PROGRAMMER_DECODE_CORE 0
+#endif
+
 static ProgData s_data;
 static Prog *s_prog = nullptr;
 static Prog *s_last_prog = nullptr;
+static ProgFingerprint s_prog_fingerprint;
 
 prog_err_def programmer_request_handle(char *buf, int len)
 {
@@ -49,6 +61,9 @@ static void programmer_switch_mode(prog_mode_def mode)
     case PROG_OFFLINE_MODE:
         s_prog = &prog_offline;
         break;
+    case PROG_FINGERPRINT_MODE:
+        s_prog = &s_prog_fingerprint;
+        break;
     case PROG_IDLE_MODE:
         s_prog = &prog_idle;
         break;
@@ -60,6 +75,16 @@ static void programmer_switch_mode(prog_mode_def mode)
     {
         ESP_LOGI(TAG, "%s--> %s", s_last_prog->name(), s_prog->name());
     }
+
+    /* A job owns the SWD settings from leaving idle until it returns to idle */
+    if ((s_last_prog == &prog_idle) && (s_prog != &prog_idle))
+    {
+        s_data.swd_session_begin();
+    }
+    else if ((s_last_prog != nullptr) && (s_last_prog != &prog_idle) && (s_prog == &prog_idle))
+    {
+        s_data.swd_session_end();
+    }
 }
 
 static void programmer_task(void *pvParameters)
@@ -103,12 +128,34 @@ void programmer_init(void)
         mkdir(CONFIG_PROGRAMMER_PROGRAM_ROOT, 0777);
 
     s_data.init();
+
+#if CONFIG_PROGRAMMER_PIPELINE
+    /* Decode on one core, drive SWD on the other, both on core 0 when there is one */
+    if (!ProgramPipeline::get_instance().start(PROGRAMMER_SWD_CORE))
+    {
+        ESP_LOGW(TAG, "Failed to start the SWD stage, program in a single task");
+    }
+
+    xTaskCreatePinnedToCore(programmer_task, "programmer", 1024 * 4, &s_data, 2, NULL, PROGRAMMER_DECODE_CORE);
+#else
     xTaskCreate(programmer_task, "programmer", 1024 * 4, &s_data, 2, NULL);
+#endif
 }
 
 void programmer_get_status(char *buf, int size, int &encode_len)
 {
-    encode_len = snprintf(buf, size, "{\"progress\": %d, \"status\": \"%s\"}", s_data.get_progress(), s_data.is_busy() ? ("busy") : ("idle"));
+    ProgramPipeline::stats_t stats = ProgramPipeline::get_instance().get_stats();
+    storage_stat_t storage;
+
+    storage_get_stat(&storage);
+    encode_len = snprintf(buf, size, "{\"progress\": %d, \"status\": \"%s\", \"decode_stall_ms\": %llu, \"swd_stall_ms\": %llu, \"wl_write_ms\": %llu}",
+                          s_data.get_progress(), s_data.is_busy() ? ("busy") : ("idle"), stats.decode_stall_us / 1000, stats.swd_stall_us / 1000,
+                          storage.job_busy_us / 1000);
+}
+
+void programmer_get_fingerprint(char *buf, int size, int &encode_len)
+{
+    s_prog_fingerprint.get_result(buf, size, encode_len);
 }
 
 prog_err_def programmer_write_data(uint8_t *data, int len)
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "serial_filter.h"
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include "esp_timer.h"
+
+#define SERIAL_FILTER_LEVELS "EWIDV"
+
+/* The bucket holds a quarter second but always a whole line */
+#define SERIAL_FILTER_CAPACITY(rate) (((rate) / 4 > SERIAL_FILTER_LINE_MAX) ? ((rate) / 4) : (SERIAL_FILTER_LINE_MAX))
+
+void serial_filter_init(serial_filter_t *filter)
+{
+    memset(filter, 0, sizeof(serial_filter_t));
+}
+
+static int serial_filter_hex(char c)
+{
+    return isdigit((unsigned char)c) ? (c - '0') : (toupper((unsigned char)c) - 'A' + 10);
+}
+
+/* ',' separates the patterns, a comma inside a pattern comes percent encoded */
+static bool serial_filter_set_list(char list[][SERIAL_FILTER_PATTERN_LEN], uint8_t *num, const char *src)
+{
+    size_t len = 0;
+    char c = 0;
+
+    *num = 0;
+
+    for (;;)
+    {
+        if ((*src == ',') || (*src == '\0'))
+        {
+            *num += (len > 0) ? 1 : 0;
+            len = 0;
+
+            if (*src++ == '\0')
+            {
+                return true;
+            }
+
+            continue;
+        }
+
+        if ((src[0] == '%') && isxdigit((unsigned char)src[1]) && isxdigit((unsigned char)src[2]))
+        {
+            c = (char)((serial_filter_hex(src[1]) << 4) | serial_filter_hex(src[2]));
+            src += 3;
+        }
+        else
+        {
+            c = (*src == '+') ? (' ') : (*src);
+            src++;
+        }
+
+        if ((*num >= SERIAL_FILTER_PATTERN_NUM) || (len >= (SERIAL_FILTER_PATTERN_LEN - 1)))
+        {
+            *num = 0;
+            return false;
+        }
+
+        list[*num][len++] = c;
+        list[*num][len] = '\0';
+    }
+}
+
+bool serial_filter_set_include(serial_filter_t *filter, const char *list)
+{
+    filter->lines = true;
+
+    return serial_filter_set_list(filter->include, &filter->include_num, list);
+}
+
+bool serial_filter_set_exclude(serial_filter_t *filter, const char *list)
+{
+    filter->lines = true;
+
+    return serial_filter_set_list(filter->exclude, &filter->exclude_num, list);
+}
+
+bool serial_filter_set_levels(serial_filter_t *filter, const char *levels)
+{
+    const char *pos = NULL;
+
+    filter->levels = 0;
+    filter->lines = true;
+
+    for (; *levels; levels++)
+    {
+        if (*levels == ',')
+        {
+            continue;
+        }
+
+        pos = strchr(SERIAL_FILTER_LEVELS, toupper((unsigned char)*levels));
+        if (!pos)
+        {
+            filter->levels = 0;
+            return false;
+        }
+
+        filter->levels |= 1 << (pos - SERIAL_FILTER_LEVELS);
+    }
+
+    return true;
+}
+
+void serial_filter_set_rate(serial_filter_t *filter, uint32_t rate)
+{
+    filter->rate = rate;
+    filter->tokens = SERIAL_FILTER_CAPACITY(rate);
+    filter->refill_us = esp_timer_get_time();
+}
+
+/* Matcher of Kernighan and Pike: c . * ^ $ */
+static bool serial_filter_match_here(const char *re, const char *text);
+
+static bool serial_filter_match_star(char c, const char *re, const char *text)
+{
+    do
+    {
+        if (serial_filter_match_here(re, text))
+        {
+            return true;
+        }
+    } while ((*text != '\0') && ((*text++ == c) || (c == '.')));
+
+    return false;
+}
+
+static bool serial_filter_match_here(const char *re, const char *text)
+{
+    if (re[0] == '\0')
+    {
+        return true;
+    }
+
+    if (re[1] == '*')
+    {
+        return serial_filter_match_star(re[0], re + 2, text);
+    }
+
+    if ((re[0] == '$') && (re[1] == '\0'))
+    {
+        return (*text == '\0');
+    }
+
+    if ((*text != '\0') && ((re[0] == '.') || (re[0] == *text)))
+    {
+        return serial_filter_match_here(re + 1, text + 1);
+    }
+
+    return false;
+}
+
+static bool serial_filter_match(const char *re, const char *text)
+{
+    if (re[0] == '^')
+    {
+        return serial_filter_match_here(re + 1, text);
+    }
+
+    do
+    {
+        if (serial_filter_match_here(re, text))
+        {
+            return true;
+        }
+    } while (*text++ != '\0');
+
+    return false;
+}
+
+/* Level bit of a tagged line, 0 without a tag */
+static uint8_t serial_filter_line_level(const char *text)
+{
+    static const char *zephyr_tags[] = {"<err>", "<wrn>", "<inf>", "<dbg>"};
+    // bracket tags, "[WiFi]" or "[Event]" are module names, not levels
+    static const char *bracket_tags[] = {"[E]", "[ERR]", "[ERROR]", "[W]", "[WRN]", "[WARN]", "[WARNING]",
+                                         "[I]", "[INF]", "[INFO]", "[D]", "[DBG]", "[DEBUG]", "[V]", "[VERBOSE]"};
+    const char *pos = NULL;
+    size_t len = 0;
+
+    // ESP-IDF: "E (123) tag: ..."
+    if (text[0] && (text[1] == ' ') && (text[2] == '('))
+    {
+        pos = strchr(SERIAL_FILTER_LEVELS, text[0]);
+    }
+    // "[E] ...", "[ERROR] ...", any case
+    else if (text[0] == '[')
+    {
+        for (int i = 0; !pos && (i < (int)(sizeof(bracket_tags) / sizeof(bracket_tags[0]))); i++)
+        {
+            len = strlen(bracket_tags[i]);
+            pos = strncasecmp(text, bracket_tags[i], len) ? (NULL) : (strchr(SERIAL_FILTER_LEVELS, bracket_tags[i][1]));
+        }
+    }
+
+    if (pos && *pos)
+    {
+        return 1 << (pos - SERIAL_FILTER_LEVELS);
+    }
+
+    // Zephyr: "[00:00:01.000,000] <err> module: ..."
+    for (int i = 0; i < (int)(sizeof(zephyr_tags) / sizeof(zephyr_tags[0])); i++)
+    {
+        if (strstr(text, zephyr_tags[i]))
+        {
+            return 1 << i;
+        }
+    }
+
+    return 0;
+}
+
+static bool serial_filter_pass_line(serial_filter_t *filter, const char *text)
+{
+    uint8_t level = serial_filter_line_level(text);
+    bool pass = (filter->include_num == 0);
+
+    filter->level = level ? (level) : (filter->level);
+
+    if (filter->levels && filter->level && !(filter->levels & filter->level))
+    {
+        return false;
+    }
+
+    for (int i = 0; (i < filter->include_num) && !pass; i++)
+    {
+        pass = serial_filter_match(filter->include[i], text);
+    }
+
+    for (int i = 0; (i < filter->exclude_num) && pass; i++)
+    {
+        pass = !serial_filter_match(filter->exclude[i], text);
+    }
+
+    return pass;
+}
+
+/* Rate cap, a token bucket of SERIAL_FILTER_CAPACITY() bytes */
+static void serial_filter_send(serial_filter_t *filter, const uint8_t *data, size_t size, serial_filter_emit_t emit, void *ctx)
+{
+    uint32_t capacity = 0;
+    uint64_t refill = 0;
+    int64_t now = 0;
+
+    if (filter->rate)
+    {
+        capacity = SERIAL_FILTER_CAPACITY(filter->rate);
+        now = esp_timer_get_time();
+        refill = (uint64_t)(now - filter->refill_us) * filter->rate / 1000000;
+
+        if (refill > 0)
+        {
+            filter->tokens = ((filter->tokens + refill) < capacity) ? (filter->tokens + refill) : (capacity);
+            filter->refill_us = now;
+        }
+
+        if (size > filter->tokens)
+        {
+            filter->stat.dropped_bytes += size;
+            filter->stat.dropped_lines += filter->lines ? 1 : 0;
+            filter->stat.dropped_chunks += filter->lines ? 0 : 1;
+            return;
+        }
+
+        filter->tokens -= size;
+    }
+
+    filter->stat.sent_bytes += size;
+    emit(ctx, data, size);
+}
+
+static void serial_filter_line(serial_filter_t *filter, serial_filter_emit_t emit, void *ctx)
+{
+    char *text = filter->line;
+    size_t end = filter->line_len;
+    char saved = 0;
+
+    // match on the text: without the line end and colour escapes
+    while ((end > 0) && ((filter->line[end - 1] == '\n') || (filter->line[end - 1] == '\r')))
+    {
+        end--;
+    }
+
+    saved = filter->line[end];
+    filter->line[end] = '\0';
+
+    while (((text + 1) < (filter->line + end)) && (text[0] == '\033') && (text[1] == '['))
+    {
+        for (text += 2; (text < (filter->line + end)) && !isalpha((unsigned char)*text); text++)
+            ;
+        text += (text < (filter->line + end)) ? 1 : 0;
+    }
+
+    if (serial_filter_pass_line(filter, text))
+    {
+        filter->line[end] = saved;
+        serial_filter_send(filter, (const uint8_t *)filter->line, filter->line_len, emit, ctx);
+    }
+    else
+    {
+        filter->stat.filtered_bytes += filter->line_len;
+    }
+
+    filter->line_len = 0;
+}
+
+void serial_filter_feed(serial_filter_t *filter, const uint8_t *data, size_t size, serial_filter_emit_t emit, void *ctx)
+{
+    filter->stat.in_bytes += size;
+
+    if (!filter->lines)
+    {
+        serial_filter_send(filter, data, size, emit, ctx);
+        return;
+    }
+
+    // lines are held until they are complete, a prompt without '\n' until serial_filter_flush()
+    for (size_t i = 0; i < size; i++)
+    {
+        filter->line[filter->line_len++] = (char)data[i];
+
+        if ((data[i] == '\n') || (filter->line_len == SERIAL_FILTER_LINE_MAX))
+        {
+            serial_filter_line(filter, emit, ctx);
+        }
+    }
+}
+
+void serial_filter_flush(serial_filter_t *filter, serial_filter_emit_t emit, void *ctx)
+{
+    if (filter->lines && filter->line_len)
+    {
+        serial_filter_line(filter, emit, ctx);
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Output filter of one web serial client, run on the probe before the UART
+ * output is sent, so a chatty target only costs Wi-Fi for what is wanted.
+ *
+ * Include, exclude and level filters work on lines: the output is framed at
+ * '\n' (or every SERIAL_FILTER_LINE_MAX bytes, or when the UART goes idle). A line passes when it matches
+ * one include pattern (or there are none), no exclude pattern, and its level
+ * is one of the wanted ones. Patterns are simple regular expressions:
+ * c . * ^ $, unanchored they match anywhere, a plain word is a substring
+ * search. Levels are the letters E W I D V, taken from ESP-IDF ("E (123)"),
+ * bracket ("[E]", "[ERR]", "[ERROR]", ... "[VERBOSE]") or Zephyr ("<err>")
+ * tags. Lines without a tag keep the level of the last tagged line, stack
+ * dumps stay with their error.
+ *
+ * The rate cap is a token bucket of rate bytes/s holding a quarter second
+ * of output. What does not fit is dropped whole: line by line with line
+ * filters, UART chunk by chunk without.
+ */
+#define SERIAL_FILTER_LINE_MAX 256
+#define SERIAL_FILTER_PATTERN_NUM 4
+#define SERIAL_FILTER_PATTERN_LEN 32
+
+typedef void (*serial_filter_emit_t)(void *ctx, const uint8_t *data, size_t size);
+
+typedef struct
+{
+    uint32_t in_bytes;
+    uint32_t sent_bytes;
+    uint32_t filtered_bytes; // dropped by the line filters
+    uint32_t dropped_bytes;  // dropped by the rate cap
+    uint32_t dropped_lines;  // with line filters
+    uint32_t dropped_chunks; // without, output is not framed then
+} serial_filter_stat_t;
+
+typedef struct
+{
+    bool lines;
+    uint8_t levels; // mask of the wanted levels, 0: all
+    uint8_t level;  // of the last tagged line
+    uint8_t include_num;
+    uint8_t exclude_num;
+    char include[SERIAL_FILTER_PATTERN_NUM][SERIAL_FILTER_PATTERN_LEN];
+    char exclude[SERIAL_FILTER_PATTERN_NUM][SERIAL_FILTER_PATTERN_LEN];
+    uint32_t rate; // bytes/s, 0: unlimited
+    uint32_t tokens;
+    int64_t refill_us;
+    uint16_t line_len;
+    char line[SERIAL_FILTER_LINE_MAX + 1];
+    serial_filter_stat_t stat;
+} serial_filter_t;
+
+void serial_filter_init(serial_filter_t *filter);
+
+/* Arguments as they come in a URI query: comma separated, percent encoded patterns */
+bool serial_filter_set_include(serial_filter_t *filter, const char *list);
+bool serial_filter_set_exclude(serial_filter_t *filter, const char *list);
+bool serial_filter_set_levels(serial_filter_t *filter, const char *levels);
+void serial_filter_set_rate(serial_filter_t *filter, uint32_t rate);
+
+/* emit is called for every run of output that passes */
+void serial_filter_feed(serial_filter_t *filter, const uint8_t *data, size_t size, serial_filter_emit_t emit, void *ctx);
+
+/* Filters and sends a held partial line, e.g. a prompt, once the UART is idle */
+void serial_filter_flush(serial_filter_t *filter, serial_filter_emit_t emit, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "storage_sched.h"
+#include <stdbool.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#ifdef CONFIG_MSC_STORAGE_MEDIA_SPIFLASH
+#include "wear_levelling.h"
+#endif
+
+static const char *TAG = "storage_sched";
+
+#define STORAGE_SCHED_MAX_HOLDERS 4
+
+typedef struct
+{
+    TaskHandle_t task;
+    uint32_t depth;
+} storage_holder_t;
+
+static storage_holder_t s_holders[STORAGE_SCHED_MAX_HOLDERS];
+static storage_stat_t s_stat;
+static int64_t s_window_end = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void storage_sched_init(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    memset(s_holders, 0, sizeof(s_holders));
+    memset(&s_stat, 0, sizeof(s_stat));
+    s_window_end = 0;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void storage_hold_begin(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    storage_holder_t *slot = NULL;
+
+    taskENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < STORAGE_SCHED_MAX_HOLDERS; i++)
+    {
+        if (s_holders[i].task == self)
+        {
+            slot = &s_holders[i];
+            break;
+        }
+
+        slot = (!slot && !s_holders[i].task) ? (&s_holders[i]) : (slot);
+    }
+
+    if (slot)
+    {
+        slot->task = self;
+        slot->depth++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (!slot)
+    {
+        ESP_LOGW(TAG, "Too many holders, writes of %s are not held off", pcTaskGetName(self));
+    }
+}
+
+void storage_hold_end(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    taskENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < STORAGE_SCHED_MAX_HOLDERS; i++)
+    {
+        if ((s_holders[i].task == self) && (--s_holders[i].depth == 0))
+        {
+            s_holders[i].task = NULL;
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+/* Called with s_lock held */
+static bool storage_sched_blocked(TaskHandle_t self, int64_t now)
+{
+    if (now < s_window_end)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < STORAGE_SCHED_MAX_HOLDERS; i++)
+    {
+        if (s_holders[i].task && (s_holders[i].task != self))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void storage_write_wait(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + CONFIG_STORAGE_HOLD_MAX_MS * 1000LL;
+    int64_t now = start;
+    bool blocked = false;
+
+    for (;;)
+    {
+        taskENTER_CRITICAL(&s_lock);
+        blocked = storage_sched_blocked(self, now);
+
+        if (blocked && (now >= deadline))
+        {
+            // open a window, the other deferred writers go in it as well
+            s_window_end = now + CONFIG_STORAGE_WRITE_WINDOW_MS * 1000LL;
+            s_stat.forced++;
+            blocked = false;
+        }
+
+        if (!blocked && (now > start))
+        {
+            s_stat.deferred++;
+            s_stat.wait_us += now - start;
+        }
+        taskEXIT_CRITICAL(&s_lock);
+
+        if (!blocked)
+        {
+            return;
+        }
+
+        vTaskDelay(1);
+        now = esp_timer_get_time();
+    }
+}
+
+/* Time a flash operation, its caller has waited for the window */
+static int64_t storage_write_start(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_stat.started++;
+    taskEXIT_CRITICAL(&s_lock);
+
+    return esp_timer_get_time();
+}
+
+int64_t storage_write_begin(void)
+{
+    storage_write_wait();
+
+    return storage_write_start();
+}
+
+void storage_write_end(int64_t start)
+{
+    uint32_t busy = (uint32_t)(esp_timer_get_time() - start);
+
+    taskENTER_CRITICAL(&s_lock);
+    s_stat.writes++;
+    s_stat.busy_us += busy;
+    s_stat.max_us = (busy > s_stat.max_us) ? (busy) : (s_stat.max_us);
+    s_stat.job_writes++;
+    s_stat.job_busy_us += busy;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void storage_job_begin(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_stat.job_writes = 0;
+    s_stat.job_busy_us = 0;
+    taskEXIT_CRITICAL(&s_lock);
+
+    storage_hold_begin();
+}
+
+void storage_job_end(void)
+{
+    storage_stat_t stat;
+
+    storage_hold_end();
+    storage_get_stat(&stat);
+
+    ESP_LOGI(TAG, "Storage writes %ld in the job, %llu us in flash writes, %ld deferred in total, longest %ld us",
+             stat.job_writes, stat.job_busy_us, stat.deferred, stat.max_us);
+}
+
+void storage_get_stat(storage_stat_t *stat)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *stat = s_stat;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+#ifdef CONFIG_MSC_STORAGE_MEDIA_SPIFLASH
+/*
+ * FATFS and the MSC class write the storage partition through wear levelling,
+ * see main/CMakeLists.txt. FATFS holds its volume lock here, so the wraps only
+ * time the write, the callers wait for the window before taking the lock.
+ */
+esp_err_t __real_wl_write(wl_handle_t handle, size_t dest_addr, const void *src, size_t size);
+esp_err_t __real_wl_erase_range(wl_handle_t handle, size_t start_addr, size_t size);
+
+esp_err_t __wrap_wl_write(wl_handle_t handle, size_t dest_addr, const void *src, size_t size)
+{
+    int64_t start = storage_write_start();
+    esp_err_t ret = __real_wl_write(handle, dest_addr, src, size);
+
+    storage_write_end(start);
+
+    return ret;
+}
+
+esp_err_t __wrap_wl_erase_range(wl_handle_t handle, size_t start_addr, size_t size)
+{
+    int64_t start = storage_write_start();
+    esp_err_t ret = __real_wl_erase_range(handle, start_addr, size);
+
+    storage_write_end(start);
+
+    return ret;
+}
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Scheduler of the internal flash writes. A flash write or erase disables
+ * the cache and stops every task on both cores while it runs.
+ *
+ * Time critical phases (a DAP command, a programming job) take a hold,
+ * writes of other tasks then wait until the holds are gone. A writer never
+ * waits longer than CONFIG_STORAGE_HOLD_MAX_MS, when it runs out it opens a
+ * write window of CONFIG_STORAGE_WRITE_WINDOW_MS and every deferred write goes
+ * in that window, writes come in batches instead of spreading over the job.
+ * The holder's own writes are never deferred. Holds nest per task.
+ *
+ * The FATFS and MSC writes of the storage partition are timed by wrapping
+ * wl_write() and wl_erase_range(). FATFS holds its volume lock in there, so
+ * the writers call storage_write_wait() before FATFS or wear levelling takes
+ * a lock: the upload handler and the image fetch before fwrite(), the MSC
+ * WRITE10 callback before the sector write. Image slots bracket their
+ * partition writes with storage_write_begin()/storage_write_end().
+ */
+typedef struct
+{
+    uint32_t started;  // flash writes and erases begun, writes is those done
+    uint32_t writes;   // flash writes and erases
+    uint32_t deferred; // writes that waited for a hold
+    uint32_t forced;   // windows opened by an expired wait
+    uint64_t wait_us;
+    uint64_t busy_us;  // time in wl_write/wl_erase_range and image slot writes
+    uint32_t max_us;   // longest single operation
+    uint32_t job_writes;
+    uint64_t job_busy_us;
+} storage_stat_t;
+
+void storage_sched_init(void);
+
+void storage_hold_begin(void);
+void storage_hold_end(void);
+
+/* Wait for the write window, call before taking locks other holders may need */
+void storage_write_wait(void);
+int64_t storage_write_begin(void);
+void storage_write_end(int64_t start);
+
+/* The job counters cover the writes between these two calls */
+void storage_job_begin(void);
+void storage_job_end(void);
+
+void storage_get_stat(storage_stat_t *stat);
+
+#ifdef __cplusplus
+}
+#endif
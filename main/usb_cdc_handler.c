@@ -13,14 +13,15 @@
 
 #define TAG "usb_cdc_handler"
 
-void usb_cdc_send_to_host(void *context, uint8_t *data, size_t size)
+void usb_cdc_send_to_host(void *context, int port, uint8_t *data, size_t size)
 {
-    ESP_LOGD(TAG, "data %p, size %d", data, size);
+    ESP_LOGD(TAG, "port %d, data %p, size %d", port, data, size);
 
-    if (tud_cdc_n_connected((int)context))
+    // ports beyond the CDC interfaces of the descriptor are web serial only
+    if (size && (port < CFG_TUD_CDC) && tud_cdc_n_connected(port))
     {
-        tinyusb_cdcacm_write_queue((tinyusb_cdcacm_itf_t)context, data, size);
-        tinyusb_cdcacm_write_flush((tinyusb_cdcacm_itf_t)context, 1);
+        tinyusb_cdcacm_write_queue((tinyusb_cdcacm_itf_t)port, data, size);
+        tinyusb_cdcacm_write_flush((tinyusb_cdcacm_itf_t)port, 1);
     }
 }
 
@@ -29,9 +30,9 @@ void usb_cdc_set_line_codinig(int itf, cdcacm_event_t *event)
     cdc_line_coding_t const *coding = event->line_coding_changed_data.p_line_coding;
     uint32_t baudrate = 0;
 
-    if (cdc_uart_get_baudrate(&baudrate) && (baudrate != coding->bit_rate))
+    if (cdc_uart_get_baudrate(itf, &baudrate) && (baudrate != coding->bit_rate))
     {
-        cdc_uart_set_baudrate(coding->bit_rate);
+        cdc_uart_set_baudrate(itf, coding->bit_rate);
     }
 }
 
@@ -43,6 +44,6 @@ void usb_cdc_send_to_uart(int itf, cdcacm_event_t *event)
 
     if (ret == ESP_OK)
     {
-        cdc_uart_write(buf, rx_size);
+        cdc_uart_write(itf, buf, rx_size);
     }
 }
\ No newline at end of file
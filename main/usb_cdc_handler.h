@@ -16,7 +16,8 @@
 extern "C" {
 #endif
 
-void usb_cdc_send_to_host(void *context, uint8_t *data, size_t size);
+/* CDC ACM n bridges cdc_uart port n */
+void usb_cdc_send_to_host(void *context, int port, uint8_t *data, size_t size);
 void usb_cdc_send_to_uart(int itf, cdcacm_event_t *event);
 void usb_cdc_set_line_codinig(int itf, cdcacm_event_t *event);
 
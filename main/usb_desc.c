@@ -1,12 +1,55 @@
 #include "usb_desc.h"
 #include "tusb_cdc_acm.h"
-
-#define TUSB_DESC_WITH_MSC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_MSC_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
-#define TUSB_DESC_WITHOUT_MSC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+#include "usb_net.h"
+#include <stdio.h>
 
 static uint8_t const desc_hid_dap_report[] = {
     TUD_HID_REPORT_DESC_GENERIC_INOUT(CFG_TUD_HID_EP_BUFSIZE)};
 
+#if CFG_TUD_NCM
+
+#define TUSB_DESC_WITH_MSC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_INOUT_DESC_LEN + TUD_CDC_NCM_DESC_LEN + TUD_MSC_DESC_LEN)
+#define TUSB_DESC_WITHOUT_MSC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_INOUT_DESC_LEN + TUD_CDC_NCM_DESC_LEN)
+
+static char s_net_mac_string[13];
+
+static uint8_t const desc_configuration_with_msc[] = {
+    // Config number, interface count, string index, total length, attribute, power in mA
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, TUSB_DESC_WITH_MSC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+    // Interface number, string index, protocol, report descriptor len, EP In & Out address, size & polling interval
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_HID, STRID_HID_INTERFACE, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_dap_report), EDPT_HID_OUT, EDPT_HID_IN, CFG_TUD_HID_EP_BUFSIZE, 1),
+    // Interface number, string index, MAC string index, EP notification address and size, EP data address (out, in), size and max segment size
+    TUD_CDC_NCM_DESCRIPTOR(ITF_NUM_NET, STRID_NET_INTERFACE, STRID_NET_MAC, EDPT_NET_NOTIFY, 64, EDPT_NET_OUT, EDPT_NET_IN, 64, CFG_TUD_NET_MTU),
+    // Interface number, string index, EP Out & EP In address, EP size
+    TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, STRID_MSC_INTERFACE, EDPT_MSC_OUT, EDPT_MSC_IN, TUD_OPT_HIGH_SPEED ? 512 : 64)};
+
+static uint8_t const desc_configuration_without_msc[] = {
+    // Config number, interface count, string index, total length, attribute, power in mA
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_MSC, 0, TUSB_DESC_WITHOUT_MSC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+    // Interface number, string index, protocol, report descriptor len, EP In & Out address, size & polling interval
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_HID, STRID_HID_INTERFACE, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_dap_report), EDPT_HID_OUT, EDPT_HID_IN, CFG_TUD_HID_EP_BUFSIZE, 1),
+    // Interface number, string index, MAC string index, EP notification address and size, EP data address (out, in), size and max segment size
+    TUD_CDC_NCM_DESCRIPTOR(ITF_NUM_NET, STRID_NET_INTERFACE, STRID_NET_MAC, EDPT_NET_NOTIFY, 64, EDPT_NET_OUT, EDPT_NET_IN, 64, CFG_TUD_NET_MTU)};
+
+// Both layouts share the string table, the MSC string is not referenced without MSC
+static char const *string_desc_arr_with_msc[] = {
+    (const char[]){0x09, 0x04},              // 0: is supported language is English (0x0409)
+    CONFIG_TINYUSB_DESC_MANUFACTURER_STRING, // 1: Manufacturer
+    CONFIG_TINYUSB_DESC_PRODUCT_STRING,      // 2:  The value of this macro _must_ include the string "CMSIS-DAP". Otherwise debuggers will not recognizethe USB device
+    CONFIG_TINYUSB_DESC_SERIAL_STRING,       // 3. SN
+    CONFIG_USB_NET_DESC_STRING,              // 4. NCM
+    CONFIG_TINYUSB_DESC_HID_STRING,          // 5. HID
+    CONFIG_TINYUSB_DESC_MSC_STRING,          // 6. MSC
+    s_net_mac_string                         // 7. MAC of the host end, 12 hex digits
+};
+
+#define string_desc_arr_without_msc string_desc_arr_with_msc
+
+#else
+
+#define TUSB_DESC_WITH_MSC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_MSC_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+#define TUSB_DESC_WITHOUT_MSC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+
 static uint8_t const desc_configuration_with_msc[] = {
     // Config number, interface count, string index, total length, attribute, power in mA
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, TUSB_DESC_WITH_MSC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
@@ -29,7 +72,7 @@ static char const *string_desc_arr_with_msc[] = {
 
 static uint8_t const desc_configuration_without_msc[] = {
     // Config number, interface count, string index, total length, attribute, power in mA
-    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, TUSB_DESC_WITHOUT_MSC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_MSC, 0, TUSB_DESC_WITHOUT_MSC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
     // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, STRID_CDC_INTERFACE, EDPT_CDC_NOTIFY, 8, EDPT_CDC_OUT, EDPT_CDC_IN, CFG_TUD_CDC_EP_BUFSIZE),
     // Interface number, string index, protocol, report descriptor len, EP In & Out address, size & polling interval
@@ -44,6 +87,8 @@ static char const *string_desc_arr_without_msc[] = {
     CONFIG_TINYUSB_DESC_HID_STRING,          // 5. HID
 };
 
+#endif
+
 static tusb_desc_device_t descriptor_config = {
     .bLength = sizeof(descriptor_config),
     .bDescriptorType = TUSB_DESC_DEVICE,
@@ -72,6 +117,13 @@ tusb_desc_device_t *get_device_descriptor(void)
 
 const char **get_string_descriptor(bool with_msc)
 {
+#if CFG_TUD_NCM
+    uint8_t mac[6];
+
+    usb_net_host_mac(mac);
+    snprintf(s_net_mac_string, sizeof(s_net_mac_string), "%02X%02X%02X%02X%02X%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+#endif
+
     return with_msc ? string_desc_arr_with_msc : string_desc_arr_without_msc;
 }
 
@@ -17,11 +17,26 @@ extern "C"
 {
 #endif
 
+    /*
+     * Besides EP0 the controller has four IN endpoints: CDC takes two, HID and
+     * MSC one each. With CDC-NCM the network takes the place of CDC, the UART
+     * is then reached over the network (web serial). There is no room for a
+     * second CDC interface, UART ports past the first are web serial only.
+     */
+#if !CFG_TUD_NCM && (CFG_TUD_CDC > 1)
+#error "One CDC interface fits the IN endpoints, set TINYUSB_CDC_COUNT to 1"
+#endif
     enum
     {
+#if CFG_TUD_NCM
+        ITF_NUM_HID = 0,
+        ITF_NUM_NET,
+        ITF_NUM_NET_DATA,
+#else
         ITF_NUM_CDC = 0,
         ITF_NUM_CDC_DATA,
         ITF_NUM_HID,
+#endif
         ITF_NUM_MSC,
         ITF_NUM_TOTAL
     };
@@ -34,7 +49,9 @@ extern "C"
         STRID_SERIAL_NUMBER,
         STRID_CDC_INTERFACE,
         STRID_HID_INTERFACE,
-        STRID_MSC_INTERFACE
+        STRID_MSC_INTERFACE,
+        STRID_NET_MAC,
+        STRID_NET_INTERFACE = STRID_CDC_INTERFACE // NCM takes the place of CDC
     };
 
     enum
@@ -48,6 +65,9 @@ extern "C"
         EDPT_HID_IN = 0x83,
         EDPT_MSC_OUT = 0x04,
         EDPT_MSC_IN = 0x84,
+        EDPT_NET_NOTIFY = 0x85,
+        EDPT_NET_OUT = 0x06,
+        EDPT_NET_IN = 0x86,
     };
 
     tusb_desc_device_t *get_device_descriptor(void);
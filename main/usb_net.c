@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "usb_net.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#include "tinyusb.h"
+
+#if CFG_TUD_NCM
+#include "tinyusb_net.h"
+#endif
+
+static const char *TAG = "usb_net";
+
+#if CFG_TUD_NCM
+static esp_netif_t *s_netif = NULL;
+
+/* Both ends derive from the Ethernet MAC, the host end is locally administered */
+void usb_net_host_mac(uint8_t mac[6])
+{
+    esp_read_mac(mac, ESP_MAC_ETH);
+    mac[0] |= 0x02;
+    mac[5] ^= 0x55;
+}
+
+/* Frames from the host are copied, the USB buffer is reused as soon as this returns */
+static esp_err_t usb_net_recv(void *buffer, uint16_t len, void *ctx)
+{
+    void *frame = NULL;
+
+    if (!s_netif)
+    {
+        return ESP_OK;
+    }
+
+    frame = malloc(len);
+    if (!frame)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(frame, buffer, len);
+
+    return esp_netif_receive(s_netif, frame, len, NULL);
+}
+
+static void usb_net_free_rx(void *h, void *buffer)
+{
+    free(buffer);
+}
+
+static esp_err_t usb_net_transmit(void *h, void *buffer, size_t len)
+{
+    // dropped frames are retransmitted by TCP
+    if (tinyusb_net_send_sync(buffer, len, NULL, pdMS_TO_TICKS(100)) != ESP_OK)
+    {
+        ESP_LOGD(TAG, "Frame of %u bytes dropped", len);
+    }
+
+    return ESP_OK;
+}
+
+bool usb_net_init(void)
+{
+    static esp_netif_ip_info_t s_ip_info;
+    uint8_t mac[6] = {0};
+    tinyusb_net_config_t net_cfg = {0};
+    esp_netif_inherent_config_t base_cfg = {0};
+    esp_netif_driver_ifconfig_t driver_cfg = {
+        .handle = (void *)1,
+        .transmit = usb_net_transmit,
+        .driver_free_rx_buffer = usb_net_free_rx};
+    esp_netif_config_t cfg = {
+        .base = &base_cfg,
+        .driver = &driver_cfg,
+        .stack = ESP_NETIF_NETSTACK_DEFAULT_ETH};
+
+    if (s_netif)
+    {
+        return true;
+    }
+
+    usb_net_host_mac(net_cfg.mac_addr);
+    net_cfg.on_recv = usb_net_recv;
+
+    if (tinyusb_net_init(TINYUSB_USBDEV_0, &net_cfg) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to init the NCM driver");
+        return false;
+    }
+
+    esp_netif_str_to_ip4(CONFIG_USB_NET_IP_ADDR, &s_ip_info.ip);
+    esp_netif_str_to_ip4(CONFIG_USB_NET_IP_ADDR, &s_ip_info.gw);
+    esp_netif_str_to_ip4("255.255.255.0", &s_ip_info.netmask);
+
+    base_cfg.flags = ESP_NETIF_DHCP_SERVER | ESP_NETIF_FLAG_AUTOUP;
+    base_cfg.ip_info = &s_ip_info;
+    base_cfg.if_key = "USB_NCM";
+    base_cfg.if_desc = "usb ncm";
+    base_cfg.route_prio = 10; // below Wi-Fi, the host is not a gateway
+
+    s_netif = esp_netif_new(&cfg);
+    if (!s_netif)
+    {
+        ESP_LOGE(TAG, "Failed to create the netif");
+        return false;
+    }
+
+    esp_read_mac(mac, ESP_MAC_ETH);
+    esp_netif_set_mac(s_netif, mac);
+
+    // the USB driver is running already, start the interface by hand
+    esp_netif_action_start(s_netif, 0, 0, 0);
+
+    ESP_LOGI(TAG, "USB network at %s", CONFIG_USB_NET_IP_ADDR);
+
+    return true;
+}
+
+bool usb_net_is_up(void)
+{
+    return (s_netif != NULL);
+}
+
+#else
+
+bool usb_net_init(void)
+{
+    ESP_LOGI(TAG, "USB network disabled");
+    return false;
+}
+
+bool usb_net_is_up(void)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * CDC-NCM network interface over the USB cable (CONFIG_TINYUSB_NET_MODE_NCM).
+ * The probe sits at CONFIG_USB_NET_IP_ADDR and leases the host an address
+ * from its DHCP server, every TCP service bound to all interfaces is reachable.
+ */
+bool usb_net_init(void);
+bool usb_net_is_up(void);
+void usb_net_host_mac(uint8_t mac[6]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,513 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "watch.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include "swd_bus.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "target_swd.h"
+#include "symbol_resolver.h"
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <map>
+
+#define TAG "watch"
+#define WATCH_FRAME_SIZE 1024
+#define WATCH_FRAME_INTERVAL_US 20000
+#define WATCH_MAX_RATE 20000
+
+typedef struct
+{
+    uint8_t word;   // index into the word list
+    uint8_t offset; // byte offset in the word
+    uint8_t size;
+    char type[4];
+} watch_var_t;
+
+typedef struct
+{
+    bool running;
+    uint32_t rate;
+    uint32_t var_count;
+    uint32_t word_count;
+    watch_var_t vars[WATCH_MAX_VARS];
+    uint32_t words[WATCH_MAX_VARS];
+} watch_cfg_t;
+
+typedef struct
+{
+    uint32_t samples;
+    uint32_t missed;
+    uint32_t debugger; // of missed: skipped while a host had the port connected
+    int64_t start_us;
+    int64_t last_us;
+    uint64_t jitter_sum_us;
+    uint32_t jitter_max_us;
+} watch_stat_t;
+
+static watch_cfg_t s_cfg;
+static watch_stat_t s_stat;
+static SemaphoreHandle_t s_mutex = nullptr;
+static TaskHandle_t s_task = nullptr;
+static esp_timer_handle_t s_timer = nullptr;
+static httpd_handle_t s_server = nullptr;
+static int s_clients[CONFIG_HTTPD_MAX_OPENED_SOCKETS];
+static uint8_t s_frame[WATCH_FRAME_SIZE];
+
+/* DAP_Connect from a host up to its DAP_Disconnect, the port state is the host's */
+static bool watch_debugger_active(void)
+{
+    return (DAP_Data.debug_port != DAP_PORT_DISABLED);
+}
+
+static void watch_tick(void *arg)
+{
+    xTaskNotifyGive(s_task);
+}
+
+static void watch_send_frame(uint8_t *frame, size_t len)
+{
+    httpd_ws_frame_t ws_pkt = {true, false, HTTPD_WS_TYPE_BINARY, frame, len};
+
+    for (int i = 0; i < CONFIG_HTTPD_MAX_OPENED_SOCKETS; i++)
+    {
+        if (s_clients[i] < 0)
+            continue;
+
+        if ((httpd_ws_get_fd_info(s_server, s_clients[i]) != HTTPD_WS_CLIENT_WEBSOCKET) ||
+            (httpd_ws_send_frame_async(s_server, s_clients[i], &ws_pkt) != ESP_OK))
+        {
+            s_clients[i] = -1;
+        }
+    }
+}
+
+static void watch_update_stat(int64_t now)
+{
+    uint32_t period = 1000000 / s_cfg.rate;
+    uint32_t jitter = 0;
+
+    if (s_stat.samples > 0)
+    {
+        int64_t delta = now - s_stat.last_us;
+        jitter = (delta > period) ? (delta - period) : (period - delta);
+        s_stat.jitter_sum_us += jitter;
+
+        if (jitter > s_stat.jitter_max_us)
+        {
+            s_stat.jitter_max_us = jitter;
+        }
+    }
+    else
+    {
+        s_stat.start_us = now;
+    }
+
+    s_stat.last_us = now;
+    s_stat.samples++;
+}
+
+static void watch_task(void *pvParameters)
+{
+    uint32_t values[WATCH_MAX_VARS];
+    uint32_t sample_size = 0;
+    uint32_t offset = 0;
+    int64_t frame_start = 0;
+    int64_t now = 0;
+    bool ok = false;
+    watch_frame_hdr_t *hdr = reinterpret_cast<watch_frame_hdr_t *>(s_frame);
+    SWDIface &swd = TargetSWD::get_instance();
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+        if (!s_cfg.running)
+        {
+            offset = 0;
+            xSemaphoreGive(s_mutex);
+            continue;
+        }
+
+        /* Never wait for the bus, a busy port (debugger, programming job) costs one sample */
+        ok = swd_bus_lock(0);
+        now = esp_timer_get_time();
+
+        if (ok && watch_debugger_active())
+        {
+            s_stat.debugger++;
+            swd_bus_unlock();
+            ok = false;
+        }
+        else if (ok)
+        {
+            ok = swd.read_words(s_cfg.words, values, s_cfg.word_count);
+            swd_bus_unlock();
+        }
+
+        if (!ok)
+        {
+            s_stat.missed++;
+            xSemaphoreGive(s_mutex);
+            continue;
+        }
+
+        watch_update_stat(now);
+
+        sample_size = sizeof(uint32_t);
+        for (uint32_t i = 0; i < s_cfg.var_count; i++)
+        {
+            sample_size += s_cfg.vars[i].size;
+        }
+
+        if (offset == 0)
+        {
+            offset = sizeof(watch_frame_hdr_t);
+            frame_start = now;
+            hdr->magic[0] = 'W';
+            hdr->magic[1] = 'T';
+            hdr->version = 1;
+            hdr->var_count = s_cfg.var_count;
+            hdr->sample_count = 0;
+            hdr->sample_size = sample_size;
+        }
+
+        uint32_t timestamp = static_cast<uint32_t>(now);
+        memcpy(&s_frame[offset], &timestamp, sizeof(timestamp));
+        offset += sizeof(timestamp);
+
+        for (uint32_t i = 0; i < s_cfg.var_count; i++)
+        {
+            const watch_var_t &var = s_cfg.vars[i];
+            uint32_t value = values[var.word] >> (var.offset * 8);
+
+            memcpy(&s_frame[offset], &value, var.size);
+            offset += var.size;
+        }
+
+        hdr->sample_count++;
+
+        if ((offset + sample_size > sizeof(s_frame)) || (now - frame_start >= WATCH_FRAME_INTERVAL_US))
+        {
+            watch_send_frame(s_frame, offset);
+            offset = 0;
+        }
+
+        xSemaphoreGive(s_mutex);
+    }
+}
+
+/* Map each variable onto the aligned word that holds it, words are shared between variables */
+static bool watch_add_var(watch_cfg_t &cfg, uint32_t address, uint32_t size, const char *type)
+{
+    uint32_t word = address & ~0x03U;
+    uint32_t index = 0;
+
+    if (((size != 1) && (size != 2) && (size != 4)) || ((address & 0x03) + size > 4) || (cfg.var_count >= WATCH_MAX_VARS))
+    {
+        return false;
+    }
+
+    for (index = 0; index < cfg.word_count; index++)
+    {
+        if (cfg.words[index] == word)
+            break;
+    }
+
+    if (index == cfg.word_count)
+    {
+        cfg.words[cfg.word_count++] = word;
+    }
+
+    watch_var_t &var = cfg.vars[cfg.var_count++];
+    var.word = index;
+    var.offset = address & 0x03;
+    var.size = size;
+    strncpy(var.type, type, sizeof(var.type) - 1);
+    var.type[sizeof(var.type) - 1] = '\0';
+
+    return true;
+}
+
+/* Sort the word list so that adjacent words are read without a TAR write */
+static void watch_sort_words(watch_cfg_t &cfg)
+{
+    uint32_t words[WATCH_MAX_VARS];
+
+    memcpy(words, cfg.words, sizeof(words));
+    std::sort(cfg.words, cfg.words + cfg.word_count);
+
+    for (uint32_t i = 0; i < cfg.var_count; i++)
+    {
+        watch_var_t &var = cfg.vars[i];
+
+        var.word = std::lower_bound(cfg.words, cfg.words + cfg.word_count, words[var.word]) - cfg.words;
+    }
+}
+
+static watch_err_def watch_decode(watch_cfg_t &cfg, cJSON *root)
+{
+    cJSON *rate_item = cJSON_GetObjectItem(root, "rate");
+    cJSON *elf_item = cJSON_GetObjectItem(root, "elf");
+    cJSON *vars_item = cJSON_GetObjectItem(root, "vars");
+    cJSON *var_item = NULL;
+    std::map<std::string, SymbolResolver::symbol_t> symbols;
+    SymbolResolver resolver;
+
+    memset(&cfg, 0, sizeof(cfg));
+
+    if (!rate_item || (rate_item->type != cJSON_Number) || (rate_item->valueint <= 0) || (rate_item->valueint > WATCH_MAX_RATE))
+        return WATCH_ERR_RATE_INVALID;
+
+    if (!vars_item || (vars_item->type != cJSON_Array) || (cJSON_GetArraySize(vars_item) == 0))
+        return WATCH_ERR_VARS_INVALID;
+
+    cfg.rate = rate_item->valueint;
+
+    /* Resolve all symbols with one pass over the ELF symbol table */
+    cJSON_ArrayForEach(var_item, vars_item)
+    {
+        cJSON *symbol_item = cJSON_GetObjectItem(var_item, "symbol");
+
+        if (symbol_item && (symbol_item->type == cJSON_String))
+            symbols[symbol_item->valuestring] = SymbolResolver::symbol_t{0, 0};
+    }
+
+    if (!symbols.empty())
+    {
+        if (!elf_item || (elf_item->type != cJSON_String) ||
+            !resolver.resolve(std::string(CONFIG_PROGRAMMER_PROGRAM_ROOT) + "/" + std::string(elf_item->valuestring), symbols))
+            return WATCH_ERR_SYMBOL_NOT_EXIST;
+    }
+
+    cJSON_ArrayForEach(var_item, vars_item)
+    {
+        cJSON *symbol_item = cJSON_GetObjectItem(var_item, "symbol");
+        cJSON *address_item = cJSON_GetObjectItem(var_item, "address");
+        cJSON *size_item = cJSON_GetObjectItem(var_item, "size");
+        cJSON *type_item = cJSON_GetObjectItem(var_item, "type");
+        uint32_t address = 0;
+        uint32_t size = 4;
+
+        if (symbol_item && (symbol_item->type == cJSON_String))
+        {
+            SymbolResolver::symbol_t &sym = symbols[symbol_item->valuestring];
+
+            if (sym.size == 0)
+            {
+                ESP_LOGE(TAG, "Symbol %s is not exist", symbol_item->valuestring);
+                return WATCH_ERR_SYMBOL_NOT_EXIST;
+            }
+
+            address = sym.address;
+            size = (sym.size < 4) ? (sym.size) : (4);
+        }
+        else if (address_item && (address_item->type == cJSON_Number))
+        {
+            address = static_cast<uint32_t>(address_item->valuedouble);
+        }
+        else
+        {
+            return WATCH_ERR_VARS_INVALID;
+        }
+
+        if (size_item && (size_item->type == cJSON_Number))
+            size = size_item->valueint;
+
+        if (!watch_add_var(cfg, address, size, (type_item && (type_item->type == cJSON_String)) ? (type_item->valuestring) : ("u32")))
+            return WATCH_ERR_VARS_INVALID;
+    }
+
+    watch_sort_words(cfg);
+
+    return WATCH_ERR_NONE;
+}
+
+static void watch_stop(void)
+{
+    esp_timer_stop(s_timer);
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_cfg.running = false;
+    xSemaphoreGive(s_mutex);
+}
+
+static watch_err_def watch_start(watch_cfg_t &cfg)
+{
+    bool connected = false;
+
+    watch_stop();
+
+    /* Power up the debug port without halting the core, reads go through the MEM-AP only */
+    if (swd_bus_lock(1000))
+    {
+        if (watch_debugger_active())
+        {
+            swd_bus_unlock();
+            ESP_LOGE(TAG, "A debugger has the port connected");
+            return WATCH_ERR_DEBUGGER_ACTIVE;
+        }
+
+        connected = TargetSWD::get_instance().init_debug();
+        swd_bus_unlock();
+    }
+
+    if (!connected)
+    {
+        ESP_LOGE(TAG, "Target is not connected");
+        return WATCH_ERR_TARGET_NOT_CONNECTED;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_cfg = cfg;
+    s_cfg.running = true;
+    memset(&s_stat, 0, sizeof(s_stat));
+    xSemaphoreGive(s_mutex);
+
+    esp_timer_start_periodic(s_timer, 1000000 / cfg.rate);
+    ESP_LOGI(TAG, "Watch %ld vars in %ld words at %ld Hz", cfg.var_count, cfg.word_count, cfg.rate);
+
+    return WATCH_ERR_NONE;
+}
+
+void watch_init(void)
+{
+    const esp_timer_create_args_t timer_args = {watch_tick, nullptr, ESP_TIMER_TASK, "watch", true};
+
+    for (int i = 0; i < CONFIG_HTTPD_MAX_OPENED_SOCKETS; i++)
+    {
+        s_clients[i] = -1;
+    }
+
+    s_mutex = xSemaphoreCreateMutex();
+    esp_timer_create(&timer_args, &s_timer);
+    xTaskCreate(watch_task, "watch", 1024 * 4, nullptr, 3, &s_task);
+}
+
+watch_err_def watch_request_handle(char *buf, int len)
+{
+    watch_err_def ret = WATCH_ERR_NONE;
+    cJSON *root = NULL;
+    cJSON *action_item = NULL;
+    static watch_cfg_t cfg;
+
+    root = cJSON_ParseWithLength(buf, len);
+    if (!root)
+    {
+        ESP_LOGI(TAG, "JSON format error");
+        return WATCH_ERR_JSON_FORMAT_INCORRECT;
+    }
+
+    action_item = cJSON_GetObjectItem(root, "action");
+
+    if (action_item && (action_item->type == cJSON_String) && !strcmp("stop", action_item->valuestring))
+    {
+        watch_stop();
+    }
+    else if (action_item && (action_item->type == cJSON_String) && !strcmp("start", action_item->valuestring))
+    {
+        ret = watch_decode(cfg, root);
+
+        if (ret == WATCH_ERR_NONE)
+            ret = watch_start(cfg);
+    }
+    else
+    {
+        ret = WATCH_ERR_JSON_FORMAT_INCORRECT;
+    }
+
+    cJSON_Delete(root);
+    return ret;
+}
+
+void watch_get_status(char *buf, int size, int &encode_len)
+{
+    uint32_t achieved = 0;
+    uint32_t jitter_avg = 0;
+    int64_t elapsed = 0;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    elapsed = s_stat.last_us - s_stat.start_us;
+    if ((s_stat.samples > 1) && (elapsed > 0))
+    {
+        achieved = static_cast<uint32_t>((static_cast<uint64_t>(s_stat.samples - 1) * 1000000) / elapsed);
+        jitter_avg = static_cast<uint32_t>(s_stat.jitter_sum_us / (s_stat.samples - 1));
+    }
+
+    encode_len = snprintf(buf, size, "{\"status\": \"%s\", \"rate\": %ld, \"achieved_rate\": %ld, \"samples\": %ld, \"missed\": %ld, \"debugger\": %ld, \"jitter_avg_us\": %ld, \"jitter_max_us\": %ld}",
+                          s_cfg.running ? ("running") : ("idle"), s_cfg.rate, achieved, s_stat.samples, s_stat.missed, s_stat.debugger, jitter_avg, s_stat.jitter_max_us);
+
+    xSemaphoreGive(s_mutex);
+}
+
+void watch_add_client(httpd_handle_t server, int fd)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    s_server = server;
+
+    for (int i = 0; i < CONFIG_HTTPD_MAX_OPENED_SOCKETS; i++)
+    {
+        if ((s_clients[i] < 0) || (s_clients[i] == fd))
+        {
+            s_clients[i] = fd;
+            break;
+        }
+    }
+
+    xSemaphoreGive(s_mutex);
+}
+
+void watch_remove_client(int fd)
+{
+    if (!s_mutex)
+        return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    for (int i = 0; i < CONFIG_HTTPD_MAX_OPENED_SOCKETS; i++)
+    {
+        if (s_clients[i] == fd)
+            s_clients[i] = -1;
+    }
+
+    xSemaphoreGive(s_mutex);
+}
+
+bool watch_is_client(int fd)
+{
+    bool ret = false;
+
+    if (!s_mutex)
+        return false;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    for (int i = 0; i < CONFIG_HTTPD_MAX_OPENED_SOCKETS; i++)
+    {
+        if (s_clients[i] == fd)
+        {
+            ret = true;
+            break;
+        }
+    }
+
+    xSemaphoreGive(s_mutex);
+
+    return ret;
+}
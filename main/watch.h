@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <cstdint>
+#include "esp_http_server.h"
+
+/*
+ * Live variable watch. Samples target memory while the core runs and streams
+ * the samples to the /watch_socket websocket clients as binary frames:
+ *
+ *   watch_frame_hdr_t, then sample_count samples of
+ *   uint32_t timestamp (us, esp_timer) + the values of all variables in request order,
+ *   each var_size[i] bytes, little endian, packed.
+ *
+ * Ticks take the SWD bus without waiting, so a busy port costs a sample
+ * instead of stalling the debugger. A tick rewrites DP SELECT and the MEM-AP
+ * CSW and TAR, which a host caches across HID reports and SELECT cannot be
+ * read back. So the watch does not start while a host has the port connected
+ * (DAP_Connect up to DAP_Disconnect) and ticks in that window are skipped.
+ */
+#define WATCH_MAX_VARS 32
+
+typedef enum
+{
+    WATCH_ERR_NONE,
+    WATCH_ERR_JSON_FORMAT_INCORRECT,
+    WATCH_ERR_RATE_INVALID,
+    WATCH_ERR_VARS_INVALID,
+    WATCH_ERR_SYMBOL_NOT_EXIST,
+    WATCH_ERR_TARGET_NOT_CONNECTED,
+    WATCH_ERR_DEBUGGER_ACTIVE
+} watch_err_def;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t magic[2]; // 'W', 'T'
+    uint8_t version;
+    uint8_t var_count;
+    uint16_t sample_count;
+    uint16_t sample_size; // bytes per sample, timestamp included
+} watch_frame_hdr_t;
+
+void watch_init(void);
+watch_err_def watch_request_handle(char *buf, int len);
+void watch_get_status(char *buf, int size, int &encode_len);
+void watch_add_client(httpd_handle_t server, int fd);
+void watch_remove_client(int fd);
+bool watch_is_client(int fd);
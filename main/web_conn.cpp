@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "web_conn.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <cstdio>
+#include <unistd.h>
+
+#define TAG "web_conn"
+#define WEB_CONN_SLOTS CONFIG_HTTPD_MAX_OPENED_SOCKETS
+
+typedef struct
+{
+    int fd; // -1: free slot
+    web_conn_class_def cls;
+    int64_t last_active;
+} web_conn_t;
+
+typedef struct
+{
+    uint32_t opened;
+    uint32_t evicted;
+    uint32_t refused; // no slot at accept
+    uint32_t rejected[WEB_CONN_CLASS_NUM];
+} web_conn_stat_t;
+
+static web_conn_t s_conns[WEB_CONN_SLOTS];
+static web_conn_stat_t s_stat;
+static uint8_t s_limit[WEB_CONN_CLASS_NUM];
+
+static const char *s_class_name[WEB_CONN_CLASS_NUM] = {"http", "control", "stream", "bulk"};
+
+static web_conn_t *web_conn_find(int fd)
+{
+    for (int i = 0; i < WEB_CONN_SLOTS; i++)
+    {
+        if (s_conns[i].fd == fd)
+        {
+            return &s_conns[i];
+        }
+    }
+
+    return nullptr;
+}
+
+static int web_conn_count(int cls)
+{
+    int count = 0;
+
+    for (int i = 0; i < WEB_CONN_SLOTS; i++)
+    {
+        if ((s_conns[i].fd >= 0) && ((cls < 0) || (s_conns[i].cls == cls)))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* Close the least recently used keep-alive connection, streams are left alone */
+static void web_conn_evict(httpd_handle_t hd, int keep_fd)
+{
+    web_conn_t *lru = nullptr;
+
+    for (int i = 0; i < WEB_CONN_SLOTS; i++)
+    {
+        web_conn_t *conn = &s_conns[i];
+
+        if ((conn->fd < 0) || (conn->fd == keep_fd) || (conn->cls == WEB_CONN_STREAM))
+        {
+            continue;
+        }
+
+        if (!lru || (conn->last_active < lru->last_active))
+        {
+            lru = conn;
+        }
+    }
+
+    if (lru && (httpd_sess_trigger_close(hd, lru->fd) == ESP_OK))
+    {
+        ESP_LOGI(TAG, "Evict idle %s connection %d", s_class_name[lru->cls], lru->fd);
+        s_stat.evicted++;
+    }
+}
+
+static esp_err_t web_conn_open(httpd_handle_t hd, int sockfd)
+{
+    web_conn_t *conn = web_conn_find(-1);
+
+    if (!conn)
+    {
+        s_stat.refused++;
+        return ESP_FAIL;
+    }
+
+    conn->fd = sockfd;
+    conn->cls = WEB_CONN_HTTP;
+    conn->last_active = esp_timer_get_time();
+    s_stat.opened++;
+
+    /* httpd stops accepting at max_open_sockets, keep the reserve free */
+    if ((WEB_CONN_SLOTS - web_conn_count(-1)) < CONFIG_WEB_CONN_RESERVED_SLOTS)
+    {
+        web_conn_evict(hd, sockfd);
+    }
+
+    return ESP_OK;
+}
+
+/* With a close_fn installed httpd leaves closing the socket to us */
+static void web_conn_close(httpd_handle_t hd, int sockfd)
+{
+    web_conn_t *conn = web_conn_find(sockfd);
+
+    if (conn)
+    {
+        conn->fd = -1;
+    }
+
+    close(sockfd);
+}
+
+void web_conn_config(httpd_config_t *config)
+{
+    int shared = WEB_CONN_SLOTS - CONFIG_WEB_CONN_RESERVED_SLOTS;
+
+    for (int i = 0; i < WEB_CONN_SLOTS; i++)
+    {
+        s_conns[i].fd = -1;
+    }
+
+    /* Streams and bulk transfers never take the reserved slots */
+    s_limit[WEB_CONN_HTTP] = WEB_CONN_SLOTS;
+    s_limit[WEB_CONN_CONTROL] = WEB_CONN_SLOTS;
+    s_limit[WEB_CONN_STREAM] = (CONFIG_WEB_CONN_MAX_STREAM < shared) ? CONFIG_WEB_CONN_MAX_STREAM : shared;
+    s_limit[WEB_CONN_BULK] = (CONFIG_WEB_CONN_MAX_BULK < shared) ? CONFIG_WEB_CONN_MAX_BULK : shared;
+
+    config->max_open_sockets = WEB_CONN_SLOTS;
+    config->lru_purge_enable = false;
+    config->open_fn = web_conn_open;
+    config->close_fn = web_conn_close;
+}
+
+bool web_conn_claim(httpd_req_t *req, web_conn_class_def cls)
+{
+    web_conn_t *conn = web_conn_find(httpd_req_to_sockfd(req));
+
+    if (!conn)
+    {
+        return true;
+    }
+
+    conn->last_active = esp_timer_get_time();
+
+    if (conn->cls == cls)
+    {
+        return true;
+    }
+
+    if (web_conn_count(cls) >= s_limit[cls])
+    {
+        ESP_LOGW(TAG, "Too many %s connections, reject %d", s_class_name[cls], conn->fd);
+        s_stat.rejected[cls]++;
+        return false;
+    }
+
+    conn->cls = cls;
+
+    return true;
+}
+
+esp_err_t web_conn_reject(httpd_req_t *req)
+{
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "5");
+    httpd_resp_sendstr(req, "Too many connections");
+
+    /* Closing the connection gives the slot back */
+    return ESP_FAIL;
+}
+
+void web_conn_get_status(char *buf, int size, int &encode_len)
+{
+    encode_len = snprintf(buf, size, "{\"sockets\": %d, \"max\": %d, \"reserved\": %d, \"http\": %d, \"control\": %d, \"stream\": %d, \"bulk\": %d, "
+                                     "\"opened\": %ld, \"evicted\": %ld, \"refused\": %ld, \"rejected_stream\": %ld, \"rejected_bulk\": %ld}",
+                          web_conn_count(-1), WEB_CONN_SLOTS, CONFIG_WEB_CONN_RESERVED_SLOTS,
+                          web_conn_count(WEB_CONN_HTTP), web_conn_count(WEB_CONN_CONTROL), web_conn_count(WEB_CONN_STREAM), web_conn_count(WEB_CONN_BULK),
+                          s_stat.opened, s_stat.evicted, s_stat.refused, s_stat.rejected[WEB_CONN_STREAM], s_stat.rejected[WEB_CONN_BULK]);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "esp_http_server.h"
+
+/*
+ * Socket budget of the web server.
+ *
+ * Every connection starts as WEB_CONN_HTTP and takes the class of the last
+ * handler that claimed it. Streams and bulk transfers have per-class limits,
+ * control requests are never refused. When fewer than
+ * CONFIG_WEB_CONN_RESERVED_SLOTS sockets are left, the least recently used
+ * keep-alive connection is closed so that a control request still gets in.
+ * Streams are never evicted. All calls run in the httpd task.
+ */
+typedef enum
+{
+    WEB_CONN_HTTP,    // pages and unclassified requests
+    WEB_CONN_CONTROL, // API requests, job submission, status polling
+    WEB_CONN_STREAM,  // WebSocket streams
+    WEB_CONN_BULK,    // uploads and online programming data
+    WEB_CONN_CLASS_NUM
+} web_conn_class_def;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void web_conn_config(httpd_config_t *config);
+    bool web_conn_claim(httpd_req_t *req, web_conn_class_def cls);
+    esp_err_t web_conn_reject(httpd_req_t *req);
+
+#ifdef __cplusplus
+}
+
+void web_conn_get_status(char *buf, int size, int &encode_len);
+#endif
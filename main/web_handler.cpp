@@ -8,10 +8,21 @@
  * 2023-9-8      lihongquan   add license declaration
  */
 #include <stdbool.h>
+#include <ctype.h>
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "web_handler.h"
 #include "cdc_uart.h"
 #include "programmer.h"
+#include "watch.h"
+#include "web_conn.h"
+#include "image_slots.h"
+#include "mem_tier.h"
+#include "storage_sched.h"
+#include "dap_trace.h"
+#include "serial_filter.h"
+#include "bench.h"
 #include "cJSON.h"
 #include <sys/types.h>
 #include <sys/param.h>
@@ -45,37 +56,343 @@ web_resource_map_t s_resource_map[WEB_RESOURCE_NUM] = {
     {"/data/httpd/program.html", program_html_start, program_html_end},
     {"/data/httpd/webserial.html", webserial_html_start, webserial_html_end}};
 
-void web_send_to_clients(void *context, uint8_t *data, size_t size)
+typedef struct
+{
+    int channel;
+    size_t credit; // bytes the client may still send
+} web_serial_conn_t;
+
+typedef struct
+{
+    httpd_handle_t server;
+    int fd;
+    size_t len;
+    uint8_t buf[512];
+} web_serial_out_t;
+
+#define WEB_SERIAL_URI "/webserial_socket"
+
+/* Socket and UART port of each UART TX channel, for the output and the credit frames */
+static int s_serial_fds[CDC_UART_TX_CHANNEL_NUM];
+static int s_serial_ports[CDC_UART_TX_CHANNEL_NUM];
+static httpd_handle_t s_serial_server;
+
+/* Output filter of each channel, set up from the handshake query, see serial_filter.h */
+static serial_filter_t s_serial_filters[CDC_UART_TX_CHANNEL_NUM];
+static SemaphoreHandle_t s_serial_filter_lock;
+
+static void web_serial_out_flush(web_serial_out_t *out)
+{
+    httpd_ws_frame_t ws_pkt = {false, false, HTTPD_WS_TYPE_TEXT, out->buf, out->len};
+
+    if (out->len)
+    {
+        httpd_ws_send_frame_async(out->server, out->fd, &ws_pkt);
+        out->len = 0;
+    }
+}
+
+/* Lines that pass are gathered, a chunk of UART output still goes out in one frame */
+static void web_serial_out_emit(void *ctx, const uint8_t *data, size_t size)
+{
+    web_serial_out_t *out = (web_serial_out_t *)ctx;
+    httpd_ws_frame_t ws_pkt = {false, false, HTTPD_WS_TYPE_TEXT, (uint8_t *)data, size};
+
+    if (out->len + size > sizeof(out->buf))
+    {
+        web_serial_out_flush(out);
+    }
+
+    if (size > sizeof(out->buf))
+    {
+        httpd_ws_send_frame_async(out->server, out->fd, &ws_pkt);
+        return;
+    }
+
+    memcpy(out->buf + out->len, data, size);
+    out->len += size;
+}
+
+/* Before the UART handlers are registered: no channel has a socket */
+void web_serial_init(void)
+{
+    for (int i = 0; i < CDC_UART_TX_CHANNEL_NUM; i++)
+    {
+        s_serial_fds[i] = -1;
+    }
+
+    if (!s_serial_filter_lock)
+    {
+        s_serial_filter_lock = xSemaphoreCreateMutex();
+    }
+}
+
+/* Output of a port goes to the web serial clients of that port only, size 0 flushes held partial lines */
+void web_send_to_clients(void *context, int port, uint8_t *data, size_t size)
 {
     httpd_handle_t http_server = *((httpd_handle_t *)context);
-    size_t clients = CONFIG_HTTPD_MAX_OPENED_SOCKETS;
-    static int client_fds[CONFIG_HTTPD_MAX_OPENED_SOCKETS] = {0};
-    httpd_ws_frame_t ws_pkt = {false, false, HTTPD_WS_TYPE_TEXT, data, size};
+    web_serial_out_t out;
 
-    if (!http_server)
+    if (!http_server || !s_serial_filter_lock)
         return;
 
-    if (httpd_get_client_list(http_server, &clients, client_fds) == ESP_OK)
+    out.server = http_server;
+    out.len = 0;
+
+    for (int i = 0; i < CDC_UART_TX_CHANNEL_NUM; i++)
     {
-        for (size_t i = 0; i < clients; ++i)
+        out.fd = s_serial_fds[i];
+
+        if ((out.fd >= 0) && (s_serial_ports[i] == port) && (httpd_ws_get_fd_info(http_server, out.fd) == HTTPD_WS_CLIENT_WEBSOCKET))
         {
-            if (httpd_ws_get_fd_info(http_server, client_fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET)
-            {
-                httpd_ws_send_frame_async(http_server, client_fds[i], &ws_pkt);
-            }
+            xSemaphoreTake(s_serial_filter_lock, portMAX_DELAY);
+            if (size)
+                serial_filter_feed(&s_serial_filters[i], data, size, web_serial_out_emit, &out);
+            else
+                serial_filter_flush(&s_serial_filters[i], web_serial_out_emit, &out);
+            web_serial_out_flush(&out);
+            xSemaphoreGive(s_serial_filter_lock);
+        }
+    }
+}
+
+/* /webserial_socket is port 0, /webserial_socket<n> port n */
+static int web_serial_port(httpd_req_t *req)
+{
+    const char *suffix = req->uri + strlen(WEB_SERIAL_URI);
+    int port = 0;
+
+    if (isdigit((unsigned char)*suffix))
+    {
+        port = atoi(suffix);
+    }
+
+    return (port < CDC_UART_PORT_NUM) ? (port) : (-1);
+}
+
+/*
+ * Web serial input is credit based: the client sends no more than it has
+ * been granted, and grants never exceed the free space of the connection's
+ * UART TX ring, so the httpd task never waits for the UART and nothing is
+ * dropped. Grants go out as binary frames {"credit":n}, text frames to the
+ * client stay UART output.
+ */
+static void web_serial_grant(httpd_handle_t server, int fd, web_serial_conn_t *conn)
+{
+    int len = 0;
+    char msg[32];
+    size_t free_size = cdc_uart_tx_free(conn->channel);
+    httpd_ws_frame_t ws_pkt = {true, false, HTTPD_WS_TYPE_BINARY, (uint8_t *)msg, 0};
+
+    if (free_size <= conn->credit)
+    {
+        return;
+    }
+
+    len = snprintf(msg, sizeof(msg), "{\"credit\":%u}", (unsigned int)(free_size - conn->credit));
+    ws_pkt.len = len;
+    conn->credit = free_size;
+
+    httpd_ws_send_frame_async(server, fd, &ws_pkt);
+}
+
+/* Runs in the httpd task, queued by web_serial_tx_resume() */
+static void web_serial_grant_work(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    web_serial_conn_t *conn = (web_serial_conn_t *)httpd_sess_get_ctx(s_serial_server, fd);
+
+    if (conn)
+    {
+        web_serial_grant(s_serial_server, fd, conn);
+    }
+}
+
+void web_serial_tx_resume(void *context, int channel)
+{
+    httpd_handle_t http_server = *((httpd_handle_t *)context);
+
+    if (http_server)
+    {
+        s_serial_server = http_server;
+        httpd_queue_work(http_server, web_serial_grant_work, (void *)(intptr_t)s_serial_fds[channel]);
+    }
+}
+
+static void web_serial_conn_free(void *ctx)
+{
+    web_serial_conn_t *conn = (web_serial_conn_t *)ctx;
+
+    s_serial_fds[conn->channel] = -1;
+    cdc_uart_tx_close(conn->channel);
+    free(conn);
+}
+
+/*
+ * Filters come with the handshake: /webserial_socket?include=boot,^E&exclude=wifi&levels=EW&rate=2000
+ * include and exclude are comma separated patterns, levels the wanted log levels,
+ * rate the cap in bytes/s. Without any the output goes out unchanged.
+ */
+static bool web_serial_filter_config(httpd_req_t *req, serial_filter_t *filter)
+{
+    bool ret = true;
+    size_t size = httpd_req_get_url_query_len(req) + 1;
+    char value[SERIAL_FILTER_PATTERN_NUM * SERIAL_FILTER_PATTERN_LEN * 3];
+    char *query = NULL;
+
+    serial_filter_init(filter);
+
+    if (size <= 1)
+    {
+        return true;
+    }
+
+    query = (char *)malloc(size);
+    if (!query || (httpd_req_get_url_query_str(req, query, size) != ESP_OK))
+    {
+        free(query);
+        return false;
+    }
+
+    if (httpd_query_key_value(query, "include", value, sizeof(value)) == ESP_OK)
+    {
+        ret = ret && serial_filter_set_include(filter, value);
+    }
+
+    if (httpd_query_key_value(query, "exclude", value, sizeof(value)) == ESP_OK)
+    {
+        ret = ret && serial_filter_set_exclude(filter, value);
+    }
+
+    if (httpd_query_key_value(query, "levels", value, sizeof(value)) == ESP_OK)
+    {
+        ret = ret && serial_filter_set_levels(filter, value);
+    }
+
+    if (httpd_query_key_value(query, "rate", value, sizeof(value)) == ESP_OK)
+    {
+        serial_filter_set_rate(filter, strtoul(value, NULL, 10));
+    }
+
+    free(query);
+
+    return ret;
+}
+
+/* Per connection state, released by httpd when the socket closes */
+static web_serial_conn_t *web_serial_conn_get(httpd_req_t *req)
+{
+    web_serial_conn_t *conn = (web_serial_conn_t *)req->sess_ctx;
+    int port = web_serial_port(req);
+
+    if (conn)
+    {
+        return conn;
+    }
+
+    if (port < 0)
+    {
+        return NULL;
+    }
+
+    conn = (web_serial_conn_t *)malloc(sizeof(web_serial_conn_t));
+    if (!conn)
+    {
+        return NULL;
+    }
+
+    conn->credit = 0;
+    conn->channel = cdc_uart_tx_open(port, CONFIG_WEB_SERIAL_TX_RING_SIZE);
+    if (conn->channel < 0)
+    {
+        free(conn);
+        return NULL;
+    }
+
+    /* The channel has no socket yet, nobody else touches its filter */
+    if (!s_serial_filter_lock || !web_serial_filter_config(req, &s_serial_filters[conn->channel]))
+    {
+        ESP_LOGE(TAG, "Bad web serial filter in %s", req->uri);
+        cdc_uart_tx_close(conn->channel);
+        free(conn);
+        return NULL;
+    }
+
+    s_serial_ports[conn->channel] = port;
+    s_serial_fds[conn->channel] = httpd_req_to_sockfd(req);
+    req->sess_ctx = conn;
+    req->free_ctx = web_serial_conn_free;
+
+    return conn;
+}
+
+/* Per client counters, saved_bytes is what the filters and the rate cap kept off the air */
+static void web_serial_get_status(char *buf, int size, int *encode_len)
+{
+    int len = snprintf(buf, size, "{\"clients\": [");
+    const char *sep = "";
+    serial_filter_stat_t stat;
+    uint32_t rate = 0;
+    int fd = -1;
+
+    for (int i = 0; s_serial_filter_lock && (i < CDC_UART_TX_CHANNEL_NUM) && (len < size); i++)
+    {
+        xSemaphoreTake(s_serial_filter_lock, portMAX_DELAY);
+        fd = s_serial_fds[i];
+        stat = s_serial_filters[i].stat;
+        rate = s_serial_filters[i].rate;
+        xSemaphoreGive(s_serial_filter_lock);
+
+        if (fd < 0)
+        {
+            continue;
         }
+
+        len += snprintf(buf + len, size - len, "%s{\"fd\": %d, \"port\": %d, \"rate\": %ld, \"in_bytes\": %ld, \"sent_bytes\": %ld, "
+                                               "\"filtered_bytes\": %ld, \"dropped_bytes\": %ld, \"dropped_lines\": %ld, \"dropped_chunks\": %ld, \"saved_bytes\": %ld}",
+                        sep, fd, s_serial_ports[i], rate, stat.in_bytes, stat.sent_bytes,
+                        stat.filtered_bytes, stat.dropped_bytes, stat.dropped_lines, stat.dropped_chunks, stat.filtered_bytes + stat.dropped_bytes);
+        sep = ", ";
+    }
+
+    if (len < size)
+    {
+        len += snprintf(buf + len, size - len, "]}");
     }
+
+    *encode_len = (len < size) ? (len) : (size - 1);
 }
 
 esp_err_t web_send_to_uart(httpd_req_t *req)
 {
     esp_err_t ret = ESP_OK;
+    size_t queued = 0;
+    uint8_t *buf = NULL;
+    web_serial_conn_t *conn = NULL;
     web_data_t *data = (web_data_t *)req->user_ctx;
     httpd_ws_frame_t ws_pkt = {false, false, HTTPD_WS_TYPE_TEXT, NULL, 0};
 
     if (req->method == HTTP_GET)
     {
+        /* The upgrade already happened, closing is all that is left */
+        if (!web_conn_claim(req, WEB_CONN_STREAM))
+        {
+            return ESP_FAIL;
+        }
+
         ESP_LOGI(TAG, "Handshake done, the new connection was opened");
+        watch_remove_client(httpd_req_to_sockfd(req));
+
+        /* The first grant lets the client start sending, the connection also subscribes it to the port output */
+        conn = web_serial_conn_get(req);
+        if (!conn)
+        {
+            ESP_LOGE(TAG, "No UART port or TX channel for %s", req->uri);
+            return ESP_FAIL;
+        }
+
+        web_serial_grant(req->handle, httpd_req_to_sockfd(req), conn);
+
         return ESP_OK;
     }
 
@@ -84,17 +401,18 @@ esp_err_t web_send_to_uart(httpd_req_t *req)
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "httpd_ws_recv_frame failed to get frame len with %d", ret);
-        goto __exit;
+        return ret;
     }
 
-    if ((ws_pkt.len > CONFIG_HTTPD_RESP_BUF_SIZE))
+    /* The shared buffer takes typed input, pastes and binary frames get their own */
+    buf = (ws_pkt.len > sizeof(data->buf)) ? (uint8_t *)mem_tier_alloc(MEM_TIER_BULK, ws_pkt.len) : data->buf;
+    if (!buf)
     {
-        ESP_LOGE(TAG, "Frame length is over the limit(%d)", CONFIG_HTTPD_RESP_BUF_SIZE);
-        ret = ESP_ERR_INVALID_SIZE;
-        goto __exit;
+        ESP_LOGE(TAG, "No memory for a %d bytes frame", (int)ws_pkt.len);
+        return ESP_ERR_NO_MEM;
     }
 
-    ws_pkt.payload = data->buf;
+    ws_pkt.payload = buf;
     ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
     if (ret != ESP_OK)
     {
@@ -102,14 +420,40 @@ esp_err_t web_send_to_uart(httpd_req_t *req)
         goto __exit;
     }
 
-    if (ws_pkt.type == HTTPD_WS_TYPE_TEXT)
+    /* Text, binary and continuation frames all go to the UART, control frames do not */
+    if ((ws_pkt.type != HTTPD_WS_TYPE_TEXT) && (ws_pkt.type != HTTPD_WS_TYPE_BINARY) && (ws_pkt.type != HTTPD_WS_TYPE_CONTINUE))
     {
-        cdc_uart_write(data->buf, ws_pkt.len);
+        goto __exit;
     }
 
-    ret = ESP_OK;
+    conn = web_serial_conn_get(req);
+    if (!conn)
+    {
+        ESP_LOGE(TAG, "No UART TX channel");
+        ret = ESP_ERR_NO_MEM;
+        goto __exit;
+    }
+
+    /* Clients that ignore credits lose what does not fit */
+    queued = cdc_uart_tx_queue(conn->channel, buf, ws_pkt.len);
+    if (queued < ws_pkt.len)
+    {
+        ESP_LOGW(TAG, "UART TX ring full, %d bytes dropped", (int)(ws_pkt.len - queued));
+    }
+
+    conn->credit = (conn->credit > ws_pkt.len) ? (conn->credit - ws_pkt.len) : 0;
+
+    /* Grant more once the UART has drained the ring */
+    if (conn->credit < (CONFIG_WEB_SERIAL_TX_RING_SIZE / 4))
+    {
+        cdc_uart_tx_notify(conn->channel);
+    }
 
 __exit:
+    if (buf != data->buf)
+    {
+        mem_tier_free(buf);
+    }
 
     return ret;
 }
@@ -185,6 +529,8 @@ esp_err_t web_serial_handler(httpd_req_t *req)
 {
     web_data_t *data = (web_data_t *)req->user_ctx;
 
+    web_conn_claim(req, WEB_CONN_HTTP);
+
     if ((req->method == HTTP_GET) && web_resp_file(req, "/data/httpd/webserial.html", (char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE))
     {
         httpd_resp_send_chunk(req, NULL, 0);
@@ -199,6 +545,8 @@ esp_err_t web_index_handler(httpd_req_t *req)
     web_data_t *data = (web_data_t *)req->user_ctx;
     ESP_LOGI(TAG, "%d connected", httpd_req_to_sockfd(req));
 
+    web_conn_claim(req, WEB_CONN_HTTP);
+
     if (req->method == HTTP_GET && web_resp_file(req, "/data/httpd/root.html", (char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE))
     {
         httpd_resp_send_chunk(req, NULL, 0);
@@ -212,6 +560,8 @@ esp_err_t web_favicon_handler(httpd_req_t *req)
 {
     web_data_t *data = (web_data_t *)req->user_ctx;
 
+    web_conn_claim(req, WEB_CONN_HTTP);
+
     if (req->method == HTTP_GET && web_resp_file(req, "/data/httpd/favicon.ico", (char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE))
     {
         httpd_resp_send_chunk(req, NULL, 0);
@@ -288,6 +638,8 @@ esp_err_t web_program_handler(httpd_req_t *req)
 {
     web_data_t *data = (web_data_t *)req->user_ctx;
 
+    web_conn_claim(req, WEB_CONN_HTTP);
+
     if (req->method != HTTP_GET || !web_resp_file(req, "/data/httpd/program.html", (char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE))
     {
         return ESP_FAIL;
@@ -362,6 +714,8 @@ esp_err_t web_flash_handler(httpd_req_t *req)
     web_data_t *data = (web_data_t *)req->user_ctx;
     char *buf = (char *)data->buf;
 
+    web_conn_claim(req, WEB_CONN_CONTROL);
+
     if (req->method != HTTP_POST)
     {
         return ESP_FAIL;
@@ -405,6 +759,30 @@ esp_err_t web_flash_handler(httpd_req_t *req)
     }
 }
 
+/*
+ * Uploads are received in chunks of CONFIG_WEB_UPLOAD_BUF_SIZE from the bulk
+ * tier. The buffer is taken once and kept, httpd runs one handler at a time,
+ * so the PSRAM (or internal) heap does not churn with every upload.
+ */
+static uint8_t *web_upload_buf(web_data_t *data, size_t *size)
+{
+    static uint8_t *s_upload_buf = NULL;
+
+    if (!s_upload_buf)
+    {
+        s_upload_buf = (uint8_t *)mem_tier_alloc(MEM_TIER_BULK, CONFIG_WEB_UPLOAD_BUF_SIZE);
+    }
+
+    if (!s_upload_buf)
+    {
+        *size = CONFIG_HTTPD_RESP_BUF_SIZE;
+        return data->buf;
+    }
+
+    *size = CONFIG_WEB_UPLOAD_BUF_SIZE;
+    return s_upload_buf;
+}
+
 static esp_err_t web_upload_file(httpd_req_t *req, char *path, bool overwrite)
 {
 #define PROGRAM_MAX_SIZE 0xA00000
@@ -414,7 +792,8 @@ static esp_err_t web_upload_file(httpd_req_t *req, char *path, bool overwrite)
     int received = 0;
     struct stat file_stat;
     int remaining = req->content_len;
-    web_data_t *data = (web_data_t *)req->user_ctx;
+    size_t buf_size = 0;
+    uint8_t *buf = web_upload_buf((web_data_t *)req->user_ctx, &buf_size);
 
     ESP_LOGI(TAG, "File name : %s", path);
 
@@ -448,7 +827,7 @@ static esp_err_t web_upload_file(httpd_req_t *req, char *path, bool overwrite)
     while (remaining > 0)
     {
         ESP_LOGD(TAG, "Remaining size : %d", remaining);
-        received = httpd_req_recv(req, (char *)data->buf, (remaining <= CONFIG_HTTPD_RESP_BUF_SIZE) ? (remaining) : (CONFIG_HTTPD_RESP_BUF_SIZE));
+        received = httpd_req_recv(req, (char *)buf, MIN((size_t)remaining, buf_size));
 
         if (received <= 0)
         {
@@ -464,7 +843,10 @@ static esp_err_t web_upload_file(httpd_req_t *req, char *path, bool overwrite)
             return ESP_FAIL;
         }
 
-        if (received && (received != fwrite((char *)data->buf, 1, received, fd)))
+        /* Wait for the write window here, not inside FATFS with its lock held */
+        storage_write_wait();
+
+        if (received && (received != fwrite((char *)buf, 1, received, fd)))
         {
             /* Couldn't write everything to file! Storage may be full? */
             fclose(fd);
@@ -485,6 +867,68 @@ static esp_err_t web_upload_file(httpd_req_t *req, char *path, bool overwrite)
     return ESP_OK;
 }
 
+/* Images stored in a slot replace older ones of the same name */
+static esp_err_t web_upload_slot(httpd_req_t *req, const char *name, uint32_t addr)
+{
+    int received = 0;
+    int remaining = req->content_len;
+    size_t buf_size = 0;
+    uint8_t *buf = web_upload_buf((web_data_t *)req->user_ctx, &buf_size);
+    image_slot_format_def format = IS_FILE_EXT(name, ".hex") ? (IMAGE_SLOT_HEX) : (IS_FILE_EXT(name, ".dapi") ? (IMAGE_SLOT_CONTAINER) : (IMAGE_SLOT_BIN));
+    image_slot_extent_t extent = {addr, 0, (uint32_t)req->content_len};
+    ImageSlots &slots = ImageSlots::get_instance();
+
+    ESP_LOGI(TAG, "Slot name : %s", name);
+
+    if (!slots.write_begin(name, req->content_len, format))
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No room for the image");
+        return ESP_FAIL;
+    }
+
+    while (remaining > 0)
+    {
+        received = httpd_req_recv(req, (char *)buf, MIN((size_t)remaining, buf_size));
+
+        if (received <= 0)
+        {
+            if (received == HTTPD_SOCK_ERR_TIMEOUT)
+            {
+                continue;
+            }
+
+            slots.write_abort();
+            ESP_LOGE(TAG, "Image reception failed!");
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to receive image");
+            return ESP_FAIL;
+        }
+
+        storage_write_wait();
+
+        if (!slots.write(buf, received))
+        {
+            slots.write_abort();
+            ESP_LOGE(TAG, "Image write failed!");
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to write image to slot");
+            return ESP_FAIL;
+        }
+
+        remaining -= received;
+    }
+
+    /* A binary uploaded with its address carries it as the only extent */
+    if (!slots.write_end(&extent, ((format == IMAGE_SLOT_BIN) && addr) ? (1) : (0)))
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to store image");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_hdr(req, "Connection", "close");
+    httpd_resp_sendstr(req, "Image stored successfully");
+
+    return ESP_OK;
+}
+
 esp_err_t web_upload_file_handler(httpd_req_t *req)
 {
     char *buf = NULL;
@@ -493,6 +937,11 @@ esp_err_t web_upload_file_handler(httpd_req_t *req)
     size_t location_offset = 0;
     static char location[CONFIG_PROGRAMMER_FILE_MAX_LEN] = {0};
 
+    if (!web_conn_claim(req, WEB_CONN_BULK))
+    {
+        return web_conn_reject(req);
+    }
+
     buf_size = httpd_req_get_url_query_len(req) + 1;
     if (buf_size == 1)
     {
@@ -525,6 +974,24 @@ esp_err_t web_upload_file_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
+    if (!strcmp(location + location_offset, "slot"))
+    {
+        char name[IMAGE_SLOT_NAME_LEN] = {0};
+        char addr[16] = {0};
+
+        if (httpd_query_key_value(buf, "name", name, sizeof(name)) != ESP_OK)
+        {
+            free(buf);
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Name is unknown");
+            return ESP_FAIL;
+        }
+
+        httpd_query_key_value(buf, "addr", addr, sizeof(addr));
+        free(buf);
+
+        return web_upload_slot(req, name, strtoul(addr, NULL, 0));
+    }
+
     /* Check the upload position */
     if (strcmp(location + location_offset, "algorithm") && strcmp(location + location_offset, "program"))
     {
@@ -563,6 +1030,8 @@ esp_err_t web_query_handler(httpd_req_t *req)
     int encode_len = 0;
     web_data_t *data = (web_data_t *)req->user_ctx;
 
+    web_conn_claim(req, WEB_CONN_CONTROL);
+
     buf_size = httpd_req_get_url_query_len(req) + 1;
     if (buf_size == 1)
     {
@@ -597,6 +1066,78 @@ esp_err_t web_query_handler(httpd_req_t *req)
         httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
         httpd_resp_send_chunk(req, NULL, 0);
     }
+    else if (!strcmp("watch-status", type))
+    {
+        watch_get_status((char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE, encode_len);
+        httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    else if (!strcmp("serial-status", type))
+    {
+        cdc_uart_get_status((char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE, &encode_len);
+        httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    else if (!strcmp("serial-clients", type))
+    {
+        web_serial_get_status((char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE, &encode_len);
+        httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    else if (!strcmp("conn-status", type))
+    {
+        web_conn_get_status((char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE, encode_len);
+        httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    else if (!strcmp("fingerprint", type))
+    {
+        programmer_get_fingerprint((char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE, encode_len);
+        httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    else if (!strcmp("dap-trace", type))
+    {
+        dap_trace_get_status((char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE, &encode_len);
+        httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    else if (!strcmp("dap-trace-reset", type))
+    {
+        dap_trace_reset();
+        httpd_resp_sendstr(req, "OK");
+    }
+    else if (!strcmp("bench-kernels", type))
+    {
+        bench_kernels((char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE, encode_len);
+        httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    else if (!strcmp("bench-hash", type))
+    {
+        bench_hashes((char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE, encode_len);
+        httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    else if (!strcmp("slot-status", type))
+    {
+        ImageSlots::get_instance().get_status((char *)data->buf, CONFIG_HTTPD_RESP_BUF_SIZE, encode_len);
+        httpd_resp_send_chunk(req, (char *)data->buf, encode_len);
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    else if (!strcmp("slot-remove", type))
+    {
+        char name[IMAGE_SLOT_NAME_LEN] = {0};
+
+        if ((httpd_query_key_value(buf, "name", name, sizeof(name)) != ESP_OK) || !ImageSlots::get_instance().remove(name))
+        {
+            free(buf);
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Slot is unknown");
+            return ESP_FAIL;
+        }
+
+        httpd_resp_sendstr(req, "OK");
+    }
     else
     {
         free(buf);
@@ -614,6 +1155,11 @@ esp_err_t web_online_program_handler(httpd_req_t *req)
     int remaining = req->content_len;
     web_data_t *data = (web_data_t *)req->user_ctx;
 
+    if (!web_conn_claim(req, WEB_CONN_BULK))
+    {
+        return web_conn_reject(req);
+    }
+
     while (remaining > 0)
     {
         ESP_LOGD(TAG, "Remaining size : %d", remaining);
@@ -650,4 +1196,79 @@ esp_err_t web_online_program_handler(httpd_req_t *req)
     httpd_resp_sendstr(req, "Target program successfully");
 
     return ESP_OK;
+}
+
+esp_err_t web_watch_handler(httpd_req_t *req)
+{
+    size_t offset = 0;
+    int ret = 0;
+    watch_err_def watch_err = WATCH_ERR_NONE;
+    web_data_t *data = (web_data_t *)req->user_ctx;
+    char *buf = (char *)data->buf;
+
+    web_conn_claim(req, WEB_CONN_CONTROL);
+
+    if (req->content_len >= CONFIG_HTTPD_RESP_BUF_SIZE)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Request too large");
+        return ESP_FAIL;
+    }
+
+    while (offset < req->content_len)
+    {
+        ret = httpd_req_recv(req, buf + offset, req->content_len - offset);
+        if (ret <= 0)
+        {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+            {
+                httpd_resp_send_408(req);
+            }
+
+            return ESP_FAIL;
+        }
+
+        offset += ret;
+    }
+
+    buf[offset] = '\0';
+
+    watch_err = watch_request_handle(buf, offset);
+
+    if (watch_err == WATCH_ERR_NONE)
+    {
+        httpd_resp_sendstr(req, "OK");
+        return ESP_OK;
+    }
+
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, (watch_err == WATCH_ERR_DEBUGGER_ACTIVE) ? ("A debugger has the port connected") : ("Watch request failed"));
+    return ESP_FAIL;
+}
+
+esp_err_t web_watch_socket_handler(httpd_req_t *req)
+{
+    esp_err_t ret = ESP_OK;
+    web_data_t *data = (web_data_t *)req->user_ctx;
+    httpd_ws_frame_t ws_pkt = {false, false, HTTPD_WS_TYPE_BINARY, NULL, 0};
+
+    if (req->method == HTTP_GET)
+    {
+        if (!web_conn_claim(req, WEB_CONN_STREAM))
+        {
+            return ESP_FAIL;
+        }
+
+        ESP_LOGI(TAG, "Watch client %d connected", httpd_req_to_sockfd(req));
+        watch_add_client(req->handle, httpd_req_to_sockfd(req));
+        return ESP_OK;
+    }
+
+    /* The stream is one way, drain whatever the client sends */
+    ret = httpd_ws_recv_frame(req, &ws_pkt, 0);
+    if ((ret != ESP_OK) || (ws_pkt.len > CONFIG_HTTPD_RESP_BUF_SIZE))
+    {
+        return ESP_FAIL;
+    }
+
+    ws_pkt.payload = data->buf;
+    return httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
 }
\ No newline at end of file
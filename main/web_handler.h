@@ -22,8 +22,10 @@ extern "C"
 {
 #endif
 
-    void web_send_to_clients(void *context, uint8_t *data, size_t size);
+    void web_serial_init(void);
+    void web_send_to_clients(void *context, int port, uint8_t *data, size_t size);
     esp_err_t web_serial_handler(httpd_req_t *req);
+    void web_serial_tx_resume(void *context, int channel);
     esp_err_t web_send_to_uart(httpd_req_t *req);
     esp_err_t web_index_handler(httpd_req_t *req);
     esp_err_t web_favicon_handler(httpd_req_t *req);
@@ -32,6 +34,8 @@ extern "C"
     esp_err_t web_upload_file_handler(httpd_req_t *req);
     esp_err_t web_query_handler(httpd_req_t *req);
     esp_err_t web_online_program_handler(httpd_req_t *req);
+    esp_err_t web_watch_handler(httpd_req_t *req);
+    esp_err_t web_watch_socket_handler(httpd_req_t *req);
 
 #ifdef __cplusplus
 }
@@ -11,19 +11,22 @@
 #include <stdbool.h>
 #include "esp_log.h"
 #include "web_handler.h"
+#include "web_conn.h"
 
 #define TAG "web_server"
 
 static web_data_t s_web_data = {0};
 static const httpd_uri_t s_index = {"/", HTTP_GET, web_index_handler, &s_web_data, false, false, NULL};
 static const httpd_uri_t s_webserial = {"/webserial", HTTP_GET, web_serial_handler, &s_web_data, true, true, NULL};
-static const httpd_uri_t s_webserial_send = {"/webserial_socket", HTTP_GET, web_send_to_uart, &s_web_data, true, true, NULL};
+static const httpd_uri_t s_webserial_send = {"/webserial_socket*", HTTP_GET, web_send_to_uart, &s_web_data, true, true, NULL};
 static const httpd_uri_t s_favicon = {"/favicon.ico", HTTP_GET, web_favicon_handler, &s_web_data, false, false, NULL};
 static const httpd_uri_t s_get_program = {"/program", HTTP_GET, web_program_handler, &s_web_data, false, false, NULL};
 static const httpd_uri_t s_post_program = {"/program", HTTP_POST, web_flash_handler, &s_web_data, false, false, NULL};
 static const httpd_uri_t s_query = {"/api/query*", HTTP_GET, web_query_handler, &s_web_data, false, false, NULL};
 static const httpd_uri_t s_upload_file = {"/api/upload*", HTTP_POST, web_upload_file_handler, &s_web_data, false, false, NULL};
 static const httpd_uri_t s_online_program = {"/api/online-program", HTTP_POST, web_online_program_handler, &s_web_data, false, false, NULL};
+static const httpd_uri_t s_watch = {"/api/watch", HTTP_POST, web_watch_handler, &s_web_data, false, false, NULL};
+static const httpd_uri_t s_watch_socket = {"/watch_socket", HTTP_GET, web_watch_socket_handler, &s_web_data, true, true, NULL};
 
 bool web_server_init(httpd_handle_t *server)
 {
@@ -37,6 +40,7 @@ bool web_server_init(httpd_handle_t *server)
 
     config.max_uri_handlers = 12;
     config.max_open_sockets = CONFIG_HTTPD_MAX_OPENED_SOCKETS;
+    web_conn_config(&config);
     config.uri_match_fn = httpd_uri_match_wildcard;
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
 
@@ -55,6 +59,8 @@ bool web_server_init(httpd_handle_t *server)
     httpd_register_uri_handler(s_web_data.server, &s_upload_file);
     httpd_register_uri_handler(s_web_data.server, &s_query);
     httpd_register_uri_handler(s_web_data.server, &s_online_program);
+    httpd_register_uri_handler(s_web_data.server, &s_watch);
+    httpd_register_uri_handler(s_web_data.server, &s_watch_socket);
     *server = s_web_data.server;
 
     return true;
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2023-2023, lihongquan
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Change Logs:
+# Date           Author       Notes
+# 2023-9-8      lihongquan   add license declaration
+#
+"""Fail the build when a symbol of the IRAM hot path is placed in flash.
+
+usage: check_iram.py --nm <nm> <elf> <pattern>...
+
+Patterns are fnmatch style symbol names. Static functions the compiler
+inlined have no symbol, a pattern without a match is only reported.
+"""
+
+import argparse
+import fnmatch
+import subprocess
+import sys
+
+# ESP32-S3 flash mapped through the cache: DROM (rodata) and IROM (text)
+FLASH_RANGES = ((0x3C000000, 0x3E000000), (0x42000000, 0x44000000))
+
+
+def in_flash(addr):
+    return any(lo <= addr < hi for lo, hi in FLASH_RANGES)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--nm', default='nm')
+    parser.add_argument('elf')
+    parser.add_argument('patterns', nargs='+')
+    args = parser.parse_args()
+
+    out = subprocess.run([args.nm, args.elf], check=True, capture_output=True, text=True).stdout
+    symbols = []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[1].lower() in 'tbdr':
+            symbols.append((fields[2], int(fields[0], 16)))
+
+    errors = 0
+    for pattern in args.patterns:
+        matched = [(name, addr) for name, addr in symbols if fnmatch.fnmatchcase(name, pattern)]
+        if not matched:
+            print('check_iram: no symbol for %s (inlined?)' % pattern)
+        for name, addr in matched:
+            if in_flash(addr):
+                print('check_iram: %s at 0x%08x is in flash' % (name, addr), file=sys.stderr)
+                errors += 1
+
+    if errors:
+        print('check_iram: %d hot path symbols in flash, check components/DAP/linker.lf' % errors, file=sys.stderr)
+        return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
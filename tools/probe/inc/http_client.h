@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+/*
+ * Caps the sockets open at once across all probes. Every request holds one
+ * for its whole exchange.
+ */
+class ConnLimit
+{
+private:
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    uint32_t _free;
+
+public:
+    explicit ConnLimit(uint32_t max);
+    void acquire(void);
+    void release(void);
+};
+
+/*
+ * Blocking HTTP/1.1 client, one connection per request. The probe closes
+ * most connections after the response, so nothing is kept alive.
+ */
+class HttpClient
+{
+public:
+    typedef struct
+    {
+        int status;
+        std::string body;
+    } response_t;
+
+    typedef std::function<size_t(uint8_t *buf, size_t size)> body_reader_t; // returns 0 at the end
+
+private:
+    std::string _host;
+    uint16_t _port;
+    uint32_t _timeout_ms;
+    ConnLimit *_limit;
+    std::string _error;
+
+    int connect_socket(void);
+    bool send_all(int fd, const void *data, size_t len);
+    bool read_response(int fd, response_t &resp);
+    bool request(const std::string &head, size_t length, const body_reader_t &reader, response_t &resp);
+
+public:
+    HttpClient(const std::string &host, uint16_t port, uint32_t timeout_ms = 10000, ConnLimit *limit = nullptr);
+    bool get(const std::string &path, response_t &resp);
+    bool post(const std::string &path, const std::string &body, response_t &resp);
+    bool post(const std::string &path, size_t length, const body_reader_t &reader, response_t &resp);
+    const std::string &last_error(void) const;
+    std::string address(void) const;
+
+    static std::string url_encode(const std::string &value);
+};
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "http_client.h"
+
+/*
+ * The probe's web API: /api/upload, /program and /api/query. All calls block,
+ * ProbePool runs them for many probes at once.
+ */
+class ProbeClient
+{
+public:
+    using progress_cb_t = std::function<void(const std::string &probe, int progress)>;
+
+    typedef struct
+    {
+        bool ok;
+        bool skipped; // same name and sha256 already on the probe
+        std::string sha256;
+        std::string error;
+    } upload_result_t;
+
+    typedef struct
+    {
+        bool ok;
+        int progress; // last progress, 100 when the job finished
+        std::string result;
+        std::string error;
+    } job_result_t;
+
+private:
+    HttpClient _http;
+    uint32_t _poll_ms;
+
+    bool slot_sha256(const std::string &name, std::string &sha256);
+
+public:
+    ProbeClient(const std::string &host, uint16_t port, ConnLimit *limit = nullptr, uint32_t poll_ms = 200);
+    std::string address(void) const;
+
+    upload_result_t upload(const std::string &path, const std::string &location, const std::string &name, uint32_t addr = 0);
+    bool submit(const std::string &job, std::string &error);
+    bool query(const std::string &type, std::string &body, std::string &error);
+    job_result_t wait(const progress_cb_t &progress = nullptr, uint32_t timeout_ms = 600000, const std::string &result_type = "");
+    job_result_t run(const std::string &job, const progress_cb_t &progress = nullptr, uint32_t timeout_ms = 600000, const std::string &result_type = "");
+
+    static std::string file_sha256(const std::string &path);
+    static std::string json_value(const std::string &json, const std::string &key, size_t from = 0);
+};
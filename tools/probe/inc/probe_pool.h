@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "http_client.h"
+
+/*
+ * Runs probe operations asynchronously. Workers pick tasks in submit order,
+ * the shared ConnLimit bounds the sockets open at once whatever the number
+ * of workers.
+ */
+class ProbePool
+{
+private:
+    std::vector<std::thread> _workers;
+    std::deque<std::function<void(void)>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _stop;
+    ConnLimit _limit;
+
+    void worker(void);
+
+public:
+    ProbePool(uint32_t workers, uint32_t max_connections);
+    ~ProbePool();
+    ProbePool(const ProbePool &) = delete;
+    ProbePool &operator=(const ProbePool &) = delete;
+
+    ConnLimit &conn_limit(void);
+
+    template <class F>
+    auto submit(F func) -> std::future<decltype(func())>
+    {
+        using result_t = decltype(func());
+        auto task = std::make_shared<std::packaged_task<result_t(void)>>(std::move(func));
+        std::future<result_t> result = task->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.emplace_back([task]() { (*task)(); });
+        }
+
+        _cond.notify_one();
+
+        return result;
+    }
+};
@@ -0,0 +1,590 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "image_container.h"
+#include "hash_engine.h"
+#include "hex_parser.h"
+#include "kernels.h"
+#include "lz4_block.h"
+#include "elf.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+/* Converts hex, elf and bin images into the probe's container format, see image_container.h */
+
+typedef struct
+{
+    uint32_t addr;
+    std::vector<uint8_t> data;
+} segment_t;
+
+typedef struct
+{
+    std::string output;
+    std::string algorithm;
+    uint32_t ram_addr;
+    uint32_t block_size;
+    bool compress;
+    std::vector<image_container_patch_t> patches;
+} options_t;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: dapi-pack [options] -o OUT INPUT...\n"
+            "       dapi-pack -i FILE\n"
+            "\n"
+            "inputs:\n"
+            "  FILE.hex, FILE.elf, FILE.bin@ADDR\n"
+            "\n"
+            "options:\n"
+            "  -o, --output FILE        container to write\n"
+            "  -a, --algorithm NAME     flash algorithm on the probe, used when a job names none\n"
+            "  -r, --ram-addr ADDR      RAM address of the algorithm\n"
+            "  -b, --block-size N       bytes per block, 256 to 4096 (4096)\n"
+            "  -z, --compress           store blocks as LZ4 where that is smaller\n"
+            "  -p, --patch ADDR=HEX     bytes replaced while programming, up to 8, repeatable\n"
+            "  -i, --info FILE          print a container and check it\n");
+}
+
+static bool read_file(const std::string &path, std::vector<uint8_t> &data)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        return false;
+    }
+
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    return true;
+}
+
+static void append(std::vector<segment_t> &segments, uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    if (segments.empty() || ((segments.back().addr + segments.back().data.size()) != addr))
+    {
+        segments.push_back({addr, {}});
+    }
+
+    segments.back().data.insert(segments.back().data.end(), data, data + size);
+}
+
+/* Fed in chunks no larger than the output buffer, like HexProgram, the parser does not bound its output */
+static bool load_hex(const std::vector<uint8_t> &file, std::vector<segment_t> &segments)
+{
+    hex_parser_t parser;
+    uint8_t bin[256];
+    uint32_t pos = 0;
+
+    reset_hex_parser(&parser);
+
+    while (pos < file.size())
+    {
+        const uint8_t *hex = file.data() + pos;
+        uint32_t size = std::min<uint32_t>(sizeof(bin), file.size() - pos);
+
+        pos += size;
+
+        for (;;)
+        {
+            uint32_t parsed = 0;
+            uint32_t bin_addr = 0;
+            uint32_t bin_size = 0;
+            hex_parse_status_t status = parse_hex_blob(&parser, hex, size, &parsed, bin, sizeof(bin), &bin_addr, &bin_size);
+
+            if ((status != HEX_PARSE_OK) && (status != HEX_PARSE_UNALIGNED) && (status != HEX_PARSE_EOF))
+            {
+                return false;
+            }
+
+            if (bin_size)
+            {
+                append(segments, bin_addr, bin, bin_size);
+            }
+
+            if (status == HEX_PARSE_EOF)
+            {
+                return true;
+            }
+
+            if (status == HEX_PARSE_OK)
+            {
+                break;
+            }
+
+            hex += parsed;
+            size -= parsed;
+        }
+    }
+
+    return true;
+}
+
+/* Loadable segments at their physical address, like a debugger loads them */
+static bool load_elf(const std::vector<uint8_t> &file, std::vector<segment_t> &segments)
+{
+    Elf32_Ehdr ehdr;
+    Elf32_Phdr phdr;
+
+    if (file.size() < sizeof(ehdr))
+    {
+        return false;
+    }
+
+    memcpy(&ehdr, file.data(), sizeof(ehdr));
+
+    if (!IS_ELF(ehdr) || (ehdr.e_ident[EI_CLASS] != ELFCLASS32) || (ehdr.e_phentsize != sizeof(phdr)))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < ehdr.e_phnum; i++)
+    {
+        uint64_t offset = ehdr.e_phoff + static_cast<uint64_t>(i) * sizeof(phdr);
+
+        if ((offset + sizeof(phdr)) > file.size())
+        {
+            return false;
+        }
+
+        memcpy(&phdr, file.data() + offset, sizeof(phdr));
+
+        if ((phdr.p_type != PT_LOAD) || (phdr.p_filesz == 0))
+        {
+            continue;
+        }
+
+        if ((static_cast<uint64_t>(phdr.p_offset) + phdr.p_filesz) > file.size())
+        {
+            return false;
+        }
+
+        append(segments, phdr.p_paddr, file.data() + phdr.p_offset, phdr.p_filesz);
+    }
+
+    return true;
+}
+
+static bool load_input(const std::string &arg, std::vector<segment_t> &segments)
+{
+    std::vector<uint8_t> file;
+    size_t at = arg.rfind('@');
+    std::string path = (at == std::string::npos) ? (arg) : (arg.substr(0, at));
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+
+    if (!read_file(path, file))
+    {
+        fprintf(stderr, "cannot read %s\n", path.c_str());
+        return false;
+    }
+
+    if (at != std::string::npos)
+    {
+        append(segments, strtoul(arg.c_str() + at + 1, nullptr, 0), file.data(), file.size());
+        return true;
+    }
+
+    if ((ext == "hex") && load_hex(file, segments))
+    {
+        return true;
+    }
+
+    if ((ext == "elf") || (ext == "axf") || (ext == "out"))
+    {
+        if (load_elf(file, segments))
+        {
+            return true;
+        }
+    }
+    else if (ext == "bin")
+    {
+        fprintf(stderr, "%s: binary inputs need an address, FILE.bin@ADDR\n", path.c_str());
+        return false;
+    }
+
+    fprintf(stderr, "%s: not a hex or elf image\n", path.c_str());
+
+    return false;
+}
+
+/* Sorted, adjacent segments joined into one extent, overlaps are an error */
+static bool merge(std::vector<segment_t> &segments)
+{
+    std::vector<segment_t> merged;
+
+    std::stable_sort(segments.begin(), segments.end(), [](const segment_t &a, const segment_t &b) { return a.addr < b.addr; });
+
+    for (auto &segment : segments)
+    {
+        uint64_t end = merged.empty() ? (0) : (merged.back().addr + static_cast<uint64_t>(merged.back().data.size()));
+
+        if (segment.data.empty())
+        {
+            continue;
+        }
+
+        if (!merged.empty() && (segment.addr < end))
+        {
+            fprintf(stderr, "inputs overlap at 0x%08x\n", segment.addr);
+            return false;
+        }
+
+        if (!merged.empty() && (segment.addr == end))
+        {
+            merged.back().data.insert(merged.back().data.end(), segment.data.begin(), segment.data.end());
+        }
+        else
+        {
+            merged.push_back(std::move(segment));
+        }
+    }
+
+    segments.swap(merged);
+
+    return !segments.empty();
+}
+
+static bool parse_patch(const char *arg, image_container_patch_t &patch)
+{
+    const char *eq = strchr(arg, '=');
+    std::string hex = eq ? (eq + 1) : ("");
+
+    memset(&patch, 0, sizeof(patch));
+
+    if (!eq || hex.empty() || (hex.size() % 2) || ((hex.size() / 2) > IMAGE_CONTAINER_PATCH_LEN))
+    {
+        return false;
+    }
+
+    patch.addr = strtoul(arg, nullptr, 0);
+    patch.size = hex.size() / 2;
+
+    for (uint32_t i = 0; i < patch.size; i++)
+    {
+        char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+        char *end = nullptr;
+
+        patch.data[i] = static_cast<uint8_t>(strtoul(byte, &end, 16));
+
+        if (*end)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t header_crc(const image_container_header_t &header, const uint8_t *tables, uint32_t size)
+{
+    uint32_t crc = kernel_crc32(0, reinterpret_cast<const uint8_t *>(&header), offsetof(image_container_header_t, crc));
+
+    return kernel_crc32(crc, tables, size);
+}
+
+static int pack(const options_t &opt, std::vector<segment_t> &segments)
+{
+    image_container_header_t header;
+    std::vector<image_container_extent_t> extents;
+    std::vector<image_container_block_t> blocks;
+    std::vector<uint8_t> tables;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> encoded(opt.block_size);
+    HashEngine sha(HashEngine::HASH_SHA256);
+    FILE *fp = nullptr;
+
+    memset(&header, 0, sizeof(header));
+
+    for (auto &segment : segments)
+    {
+        extents.push_back({segment.addr, static_cast<uint32_t>(segment.data.size()), static_cast<uint32_t>(blocks.size())});
+        sha.update(segment.data.data(), segment.data.size());
+        header.image_size += segment.data.size();
+
+        for (uint32_t offset = 0; offset < segment.data.size(); offset += opt.block_size)
+        {
+            const uint8_t *data = segment.data.data() + offset;
+            uint32_t size = std::min<uint32_t>(opt.block_size, segment.data.size() - offset);
+            uint32_t stored = opt.compress ? lz4_block_encode(data, size, encoded.data(), size - 1) : 0;
+
+            blocks.push_back({kernel_crc32(0, data, size), stored ? stored : size});
+
+            if (stored)
+            {
+                payload.insert(payload.end(), encoded.begin(), encoded.begin() + stored);
+                header.flags |= IMAGE_CONTAINER_FLAG_LZ4;
+            }
+            else
+            {
+                payload.insert(payload.end(), data, data + size);
+            }
+        }
+    }
+
+    for (auto &patch : opt.patches)
+    {
+        bool inside = false;
+
+        for (auto &extent : extents)
+        {
+            inside |= (patch.addr >= extent.addr) && ((patch.addr + patch.size) <= (extent.addr + extent.size));
+        }
+
+        if (!inside)
+        {
+            fprintf(stderr, "patch at 0x%08x is outside the image\n", patch.addr);
+            return 1;
+        }
+    }
+
+    tables.insert(tables.end(), reinterpret_cast<const uint8_t *>(extents.data()), reinterpret_cast<const uint8_t *>(extents.data() + extents.size()));
+    tables.insert(tables.end(), reinterpret_cast<const uint8_t *>(blocks.data()), reinterpret_cast<const uint8_t *>(blocks.data() + blocks.size()));
+    tables.insert(tables.end(), reinterpret_cast<const uint8_t *>(opt.patches.data()), reinterpret_cast<const uint8_t *>(opt.patches.data() + opt.patches.size()));
+
+    header.magic = IMAGE_CONTAINER_MAGIC;
+    header.version = IMAGE_CONTAINER_VERSION;
+    header.header_size = sizeof(header);
+    header.block_size = opt.block_size;
+    header.extent_num = extents.size();
+    header.block_num = blocks.size();
+    header.patch_num = opt.patches.size();
+    header.payload_size = payload.size();
+    header.ram_addr = opt.ram_addr;
+    strncpy(header.algorithm, opt.algorithm.c_str(), IMAGE_CONTAINER_ALGO_LEN - 1);
+    sha.finish(header.sha256);
+    header.crc = header_crc(header, tables.data(), tables.size());
+
+    fp = fopen(opt.output.c_str(), "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "cannot write %s\n", opt.output.c_str());
+        return 1;
+    }
+
+    fwrite(&header, 1, sizeof(header), fp);
+    fwrite(tables.data(), 1, tables.size(), fp);
+    fwrite(payload.data(), 1, payload.size(), fp);
+
+    if (fclose(fp) != 0)
+    {
+        fprintf(stderr, "cannot write %s\n", opt.output.c_str());
+        return 1;
+    }
+
+    printf("%s: %u bytes in %u extents, %u blocks, payload %u bytes\n",
+           opt.output.c_str(), header.image_size, header.extent_num, header.block_num, header.payload_size);
+
+    return 0;
+}
+
+/* Decodes every block like the probe does, nothing is trusted */
+static int info(const std::string &path)
+{
+    std::vector<uint8_t> file;
+    std::vector<uint8_t> decoded;
+    image_container_header_t header;
+    const image_container_extent_t *extents = nullptr;
+    const image_container_block_t *blocks = nullptr;
+    const image_container_patch_t *patches = nullptr;
+    HashEngine sha(HashEngine::HASH_SHA256);
+    uint8_t digest[32];
+    uint64_t tables_size = 0;
+    uint64_t offset = 0;
+    uint32_t compressed = 0;
+
+    if (!read_file(path, file) || (file.size() < sizeof(header)))
+    {
+        fprintf(stderr, "cannot read %s\n", path.c_str());
+        return 1;
+    }
+
+    memcpy(&header, file.data(), sizeof(header));
+    header.algorithm[IMAGE_CONTAINER_ALGO_LEN - 1] = '\0';
+    tables_size = static_cast<uint64_t>(header.extent_num) * sizeof(image_container_extent_t) +
+                  static_cast<uint64_t>(header.block_num) * sizeof(image_container_block_t) +
+                  static_cast<uint64_t>(header.patch_num) * sizeof(image_container_patch_t);
+
+    if ((header.magic != IMAGE_CONTAINER_MAGIC) || (header.version != IMAGE_CONTAINER_VERSION) || (header.header_size != sizeof(header)) ||
+        ((sizeof(header) + tables_size) > file.size()) || !header.block_size)
+    {
+        fprintf(stderr, "%s: not a version %d container\n", path.c_str(), IMAGE_CONTAINER_VERSION);
+        return 1;
+    }
+
+    if (header_crc(header, file.data() + sizeof(header), tables_size) != header.crc)
+    {
+        fprintf(stderr, "%s: header CRC mismatch\n", path.c_str());
+        return 1;
+    }
+
+    extents = reinterpret_cast<const image_container_extent_t *>(file.data() + sizeof(header));
+    blocks = reinterpret_cast<const image_container_block_t *>(extents + header.extent_num);
+    patches = reinterpret_cast<const image_container_patch_t *>(blocks + header.block_num);
+    offset = sizeof(header) + tables_size;
+    decoded.resize(header.block_size);
+
+    printf("algorithm   %s\n", header.algorithm[0] ? header.algorithm : "-");
+    printf("ram address 0x%08x\n", header.ram_addr);
+    printf("image       %u bytes, sha256 %s\n", header.image_size, HashEngine::to_hex(header.sha256, sizeof(header.sha256)).c_str());
+    printf("blocks      %u of %u bytes\n", header.block_num, header.block_size);
+
+    for (uint32_t e = 0; e < header.extent_num; e++)
+    {
+        const image_container_extent_t &extent = extents[e];
+
+        printf("extent      0x%08x - 0x%08x, block %u\n", extent.addr, extent.addr + extent.size, extent.block);
+
+        for (uint32_t b = extent.block; (b < header.block_num) && ((b - extent.block) * header.block_size < extent.size); b++)
+        {
+            uint32_t size = std::min(header.block_size, extent.size - (b - extent.block) * header.block_size);
+            const image_container_block_t &block = blocks[b];
+
+            if ((offset + block.stored_size) > file.size() || (block.stored_size > size))
+            {
+                fprintf(stderr, "block %u is truncated\n", b);
+                return 1;
+            }
+
+            if (block.stored_size == size)
+            {
+                memcpy(decoded.data(), file.data() + offset, size);
+            }
+            else if (lz4_block_decode(file.data() + offset, block.stored_size, decoded.data(), size) != static_cast<int32_t>(size))
+            {
+                fprintf(stderr, "block %u does not decode\n", b);
+                return 1;
+            }
+            else
+            {
+                compressed++;
+            }
+
+            if (kernel_crc32(0, decoded.data(), size) != block.crc)
+            {
+                fprintf(stderr, "block %u CRC mismatch\n", b);
+                return 1;
+            }
+
+            sha.update(decoded.data(), size);
+            offset += block.stored_size;
+        }
+    }
+
+    for (uint32_t p = 0; p < header.patch_num; p++)
+    {
+        printf("patch       0x%08x %s\n", patches[p].addr, HashEngine::to_hex(patches[p].data, std::min<uint32_t>(patches[p].size, IMAGE_CONTAINER_PATCH_LEN)).c_str());
+    }
+
+    sha.finish(digest);
+
+    if (memcmp(digest, header.sha256, sizeof(digest)))
+    {
+        fprintf(stderr, "SHA-256 mismatch\n");
+        return 1;
+    }
+
+    printf("payload     %u bytes, %u blocks compressed, ok\n", header.payload_size, compressed);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"output", required_argument, nullptr, 'o'},
+        {"algorithm", required_argument, nullptr, 'a'},
+        {"ram-addr", required_argument, nullptr, 'r'},
+        {"block-size", required_argument, nullptr, 'b'},
+        {"compress", no_argument, nullptr, 'z'},
+        {"patch", required_argument, nullptr, 'p'},
+        {"info", required_argument, nullptr, 'i'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+    options_t opt = {"", "", 0, 4096, false, {}};
+    std::vector<segment_t> segments;
+    image_container_patch_t patch;
+    int c = 0;
+
+    while ((c = getopt_long(argc, argv, "o:a:r:b:zp:i:h", long_options, nullptr)) != -1)
+    {
+        switch (c)
+        {
+        case 'o':
+            opt.output = optarg;
+            break;
+        case 'a':
+            opt.algorithm = optarg;
+            break;
+        case 'r':
+            opt.ram_addr = strtoul(optarg, nullptr, 0);
+            break;
+        case 'b':
+            opt.block_size = strtoul(optarg, nullptr, 0);
+            break;
+        case 'z':
+            opt.compress = true;
+            break;
+        case 'p':
+            if (!parse_patch(optarg, patch))
+            {
+                fprintf(stderr, "invalid patch %s\n", optarg);
+                return 2;
+            }
+            opt.patches.push_back(patch);
+            break;
+        case 'i':
+            return info(optarg);
+        default:
+            usage();
+            return (c == 'h') ? 0 : 2;
+        }
+    }
+
+    if (opt.output.empty() || (optind >= argc))
+    {
+        usage();
+        return 2;
+    }
+
+    if ((opt.block_size < 256) || (opt.block_size > 4096) || (opt.block_size & (opt.block_size - 1)))
+    {
+        fprintf(stderr, "block size must be a power of two from 256 to 4096\n");
+        return 2;
+    }
+
+    if (opt.algorithm.size() >= IMAGE_CONTAINER_ALGO_LEN)
+    {
+        fprintf(stderr, "algorithm name longer than %d\n", IMAGE_CONTAINER_ALGO_LEN - 1);
+        return 2;
+    }
+
+    for (int i = optind; i < argc; i++)
+    {
+        if (!load_input(argv[i], segments))
+        {
+            return 1;
+        }
+    }
+
+    if (!merge(segments))
+    {
+        return 1;
+    }
+
+    return pack(opt, segments);
+}
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "image_container.h"
+#include "lz4_block.h"
+#include "kernels.h"
+#include "hash_engine.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+
+/*
+ * Round trip of dapi-pack: packs a bin and a hex input, decodes the
+ * containers again with the firmware's LZ4 block decoder, table CRC, block
+ * CRCs and SHA-256, and compares the result with the input. Corrupted
+ * containers must be refused, by this decoder and by dapi-pack -i.
+ *
+ *   dapi-pack-check DAPI_PACK
+ *
+ * Files are written to the current directory, ctest runs it in the build tree.
+ */
+
+typedef struct
+{
+    uint32_t addr;
+    std::vector<uint8_t> data;
+} segment_t;
+
+static std::string s_pack;
+static int s_failed = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%-40s %s\n", what, ok ? "ok" : "FAIL");
+    s_failed += ok ? 0 : 1;
+}
+
+static bool write_file(const std::string &path, const std::vector<uint8_t> &data)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    bool ok = fp && (fwrite(data.data(), 1, data.size(), fp) == data.size());
+
+    return fp && (fclose(fp) == 0) && ok;
+}
+
+static bool read_file(const std::string &path, std::vector<uint8_t> &data)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    long size = 0;
+
+    if (!fp)
+        return false;
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data.resize(size);
+
+    if (fread(data.data(), 1, size, fp) != static_cast<size_t>(size))
+    {
+        fclose(fp);
+        return false;
+    }
+
+    return (fclose(fp) == 0);
+}
+
+/* Intel hex, 16 byte data records, an extended linear address record where the upper half changes */
+static bool write_hex(const std::string &path, const std::vector<segment_t> &segments)
+{
+    std::string text;
+    uint32_t upper = 0xFFFFFFFF;
+    char line[64];
+
+    auto record = [&](uint8_t type, uint16_t addr, const uint8_t *data, uint8_t count) {
+        uint8_t sum = count + (addr >> 8) + (addr & 0xFF) + type;
+        int len = snprintf(line, sizeof(line), ":%02X%04X%02X", count, addr, type);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            len += snprintf(line + len, sizeof(line) - len, "%02X", data[i]);
+            sum += data[i];
+        }
+
+        snprintf(line + len, sizeof(line) - len, "%02X\r\n", static_cast<uint8_t>(0x100 - sum));
+        text += line;
+    };
+
+    for (auto &segment : segments)
+    {
+        for (uint32_t offset = 0; offset < segment.data.size(); offset += 16)
+        {
+            uint32_t addr = segment.addr + offset;
+            uint8_t count = static_cast<uint8_t>(std::min<size_t>(16, segment.data.size() - offset));
+
+            if ((addr >> 16) != upper)
+            {
+                uint8_t ela[2] = {static_cast<uint8_t>(addr >> 24), static_cast<uint8_t>(addr >> 16)};
+
+                upper = addr >> 16;
+                record(0x04, 0, ela, 2);
+            }
+
+            record(0x00, addr & 0xFFFF, &segment.data[offset], count);
+        }
+    }
+
+    record(0x01, 0, nullptr, 0);
+
+    return write_file(path, std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+/* Exit code of dapi-pack with args */
+static int pack(const std::string &args)
+{
+    int status = std::system((s_pack + " " + args).c_str());
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* Decodes like the probe: header, table CRC, every block, SHA-256 of the image */
+static bool decode(const std::string &path, std::vector<segment_t> &segments, uint32_t *compressed)
+{
+    std::vector<uint8_t> file;
+    image_container_header_t header;
+    HashEngine sha(HashEngine::HASH_SHA256);
+    uint8_t digest[32];
+    uint64_t tables_size = 0;
+    uint64_t offset = 0;
+    uint32_t crc = 0;
+
+    segments.clear();
+    *compressed = 0;
+
+    if (!read_file(path, file) || (file.size() < sizeof(header)))
+        return false;
+
+    memcpy(&header, file.data(), sizeof(header));
+    tables_size = static_cast<uint64_t>(header.extent_num) * sizeof(image_container_extent_t) +
+                  static_cast<uint64_t>(header.block_num) * sizeof(image_container_block_t) +
+                  static_cast<uint64_t>(header.patch_num) * sizeof(image_container_patch_t);
+
+    if ((header.magic != IMAGE_CONTAINER_MAGIC) || (header.version != IMAGE_CONTAINER_VERSION) ||
+        (header.header_size != sizeof(header)) || !header.block_size || ((sizeof(header) + tables_size) > file.size()))
+        return false;
+
+    crc = kernel_crc32(0, reinterpret_cast<const uint8_t *>(&header), offsetof(image_container_header_t, crc));
+    if (kernel_crc32(crc, file.data() + sizeof(header), tables_size) != header.crc)
+        return false;
+
+    const image_container_extent_t *extents = reinterpret_cast<const image_container_extent_t *>(file.data() + sizeof(header));
+    const image_container_block_t *blocks = reinterpret_cast<const image_container_block_t *>(extents + header.extent_num);
+    offset = sizeof(header) + tables_size;
+
+    for (uint32_t e = 0; e < header.extent_num; e++)
+    {
+        segment_t segment = {extents[e].addr, std::vector<uint8_t>(extents[e].size)};
+
+        for (uint32_t done = 0, b = extents[e].block; done < extents[e].size; done += header.block_size, b++)
+        {
+            uint32_t size = std::min(header.block_size, extents[e].size - done);
+            uint8_t *out = &segment.data[done];
+
+            if ((b >= header.block_num) || (offset + blocks[b].stored_size > file.size()) || (blocks[b].stored_size > size))
+                return false;
+
+            if (blocks[b].stored_size == size)
+                memcpy(out, file.data() + offset, size);
+            else if (lz4_block_decode(file.data() + offset, blocks[b].stored_size, out, size) != static_cast<int32_t>(size))
+                return false;
+            else
+                (*compressed)++;
+
+            if (kernel_crc32(0, out, size) != blocks[b].crc)
+                return false;
+
+            offset += blocks[b].stored_size;
+        }
+
+        sha.update(segment.data.data(), segment.data.size());
+        segments.push_back(segment);
+    }
+
+    sha.finish(digest);
+
+    return !memcmp(digest, header.sha256, sizeof(digest)) && (offset - sizeof(header) - tables_size == header.payload_size);
+}
+
+static bool same(const std::vector<segment_t> &a, const std::vector<segment_t> &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if ((a[i].addr != b[i].addr) || (a[i].data != b[i].data))
+            return false;
+    }
+
+    return true;
+}
+
+/* Container with one byte flipped at offset, from the end when offset is negative */
+static bool corrupt(const std::string &from, const std::string &to, long offset)
+{
+    std::vector<uint8_t> file;
+
+    if (!read_file(from, file) || file.empty())
+        return false;
+
+    file[(offset < 0) ? (file.size() + offset) : (offset)] ^= 0x5A;
+
+    return write_file(to, file);
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<segment_t> bin_image(1);
+    std::vector<segment_t> hex_image(2);
+    std::vector<segment_t> decoded;
+    std::vector<uint8_t> file;
+    uint32_t compressed = 0;
+    uint32_t seed = 1;
+    bool ok = false;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: dapi-pack-check DAPI_PACK\n");
+        return 2;
+    }
+
+    s_pack = argv[1];
+
+    // compressible pattern, noise and an erased run: raw and LZ4 blocks, a short last block
+    bin_image[0].addr = 0x08000000;
+    for (uint32_t i = 0; i < 10000; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        bin_image[0].data.push_back((i < 4096) ? static_cast<uint8_t>(i / 64) : (i < 8192) ? static_cast<uint8_t>(seed >> 16) : 0xFF);
+    }
+
+    hex_image[0] = bin_image[0];
+    hex_image[1].addr = 0x08010000;
+    hex_image[1].data.assign(bin_image[0].data.begin() + 4000, bin_image[0].data.begin() + 4700);
+
+    ok = write_file("roundtrip.bin", bin_image[0].data) && write_hex("roundtrip.hex", hex_image);
+    check(ok, "write inputs");
+
+    ok = (pack("-z -o roundtrip_bin.dapi roundtrip.bin@0x08000000") == 0) && decode("roundtrip_bin.dapi", decoded, &compressed);
+    check(ok && same(decoded, bin_image) && (compressed > 0), "bin, LZ4, decodes to the input");
+    check(pack("-i roundtrip_bin.dapi") == 0, "bin, LZ4, dapi-pack -i");
+
+    ok = (pack("-b 256 -o roundtrip_raw.dapi roundtrip.bin@0x08000000") == 0) && decode("roundtrip_raw.dapi", decoded, &compressed);
+    check(ok && same(decoded, bin_image) && (compressed == 0), "bin, raw 256 byte blocks");
+
+    ok = (pack("-z -b 1024 -o roundtrip_hex.dapi roundtrip.hex") == 0) && decode("roundtrip_hex.dapi", decoded, &compressed);
+    check(ok && same(decoded, hex_image) && (compressed > 0), "hex, two extents, decodes to the input");
+    check(pack("-i roundtrip_hex.dapi") == 0, "hex, dapi-pack -i");
+
+    // the first block is the compressed pattern, a flipped payload byte breaks its decode or CRC
+    read_file("roundtrip_bin.dapi", file);
+    ok = corrupt("roundtrip_bin.dapi", "corrupt_block.dapi", file.size() - reinterpret_cast<image_container_header_t *>(file.data())->payload_size + 8);
+    check(ok && !decode("corrupt_block.dapi", decoded, &compressed), "corrupted LZ4 block, refused");
+    check(pack("-i corrupt_block.dapi") != 0, "corrupted LZ4 block, dapi-pack -i");
+
+    ok = corrupt("roundtrip_raw.dapi", "corrupt_raw.dapi", -1);
+    check(ok && !decode("corrupt_raw.dapi", decoded, &compressed), "corrupted raw block, refused");
+    check(pack("-i corrupt_raw.dapi") != 0, "corrupted raw block, dapi-pack -i");
+
+    ok = corrupt("roundtrip_hex.dapi", "corrupt_table.dapi", sizeof(image_container_header_t) + 4);
+    check(ok && !decode("corrupt_table.dapi", decoded, &compressed), "corrupted extent table, refused");
+    check(pack("-i corrupt_table.dapi") != 0, "corrupted extent table, dapi-pack -i");
+
+    file.resize(file.size() - 100);
+    ok = write_file("corrupt_short.dapi", file);
+    check(ok && !decode("corrupt_short.dapi", decoded, &compressed), "truncated container, refused");
+    check(pack("-i corrupt_short.dapi") != 0, "truncated container, dapi-pack -i");
+
+    printf("%s\n", s_failed ? "FAILED" : "PASSED");
+
+    return s_failed ? 1 : 0;
+}
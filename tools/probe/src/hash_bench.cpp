@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "hash_engine.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*
+ * Checks HashEngine against known digests and times SHA-256 and CRC32 over
+ * the update sizes the firmware feeds it: a hex record, an upload ring slot
+ * and a sector. hash-bench <KiB> sets the amount hashed per figure, ctest
+ * runs it with little. The device figures, peripheral against software
+ * SHA-256, come from the "bench-hash" query.
+ */
+
+static int s_failed = 0;
+
+static void check_digest(HashEngine::algo_t algo, const char *input, const char *expect)
+{
+    HashEngine hash(algo);
+    uint8_t digest[HashEngine::max_digest_size];
+    size_t len = 0;
+
+    hash.update(reinterpret_cast<const uint8_t *>(input), strlen(input));
+    len = hash.finish(digest);
+
+    if (HashEngine::to_hex(digest, len) != expect)
+    {
+        printf("FAIL \"%s\": %s, expected %s\n", input, HashEngine::to_hex(digest, len).c_str(), expect);
+        s_failed++;
+    }
+}
+
+/* MB/s of hashing total bytes in updates of chunk bytes */
+static double bench(HashEngine::algo_t algo, const std::vector<uint8_t> &data, size_t chunk)
+{
+    HashEngine hash(algo);
+    uint8_t digest[HashEngine::max_digest_size];
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t offset = 0; offset < data.size(); offset += chunk)
+    {
+        hash.update(&data[offset], ((data.size() - offset) < chunk) ? (data.size() - offset) : chunk);
+    }
+
+    hash.finish(digest);
+
+    return data.size() / std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    static const size_t chunks[] = {37, 1024, 4096};
+    size_t kib = (argc > 1) ? strtoul(argv[1], nullptr, 0) : 4096;
+    std::vector<uint8_t> data((kib ? kib : 1) * 1024);
+    std::string million(1000000, 'a');
+
+    check_digest(HashEngine::HASH_SHA256, "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    check_digest(HashEngine::HASH_SHA256, "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    check_digest(HashEngine::HASH_SHA256, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    check_digest(HashEngine::HASH_SHA256, million.c_str(), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    check_digest(HashEngine::HASH_SHA256_SOFT, "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    check_digest(HashEngine::HASH_CRC32, "123456789", "cbf43926");
+
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+
+    printf("%zu KiB per figure\n", data.size() / 1024);
+    printf("update     sha256 MB/s   crc32 MB/s\n");
+
+    for (size_t chunk : chunks)
+    {
+        printf("%6zu %14.1f %12.1f\n", chunk, bench(HashEngine::HASH_SHA256, data, chunk), bench(HashEngine::HASH_CRC32, data, chunk));
+    }
+
+    printf("%s\n", s_failed ? "FAILED" : "PASSED");
+
+    return s_failed ? 1 : 0;
+}
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "http_client.h"
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define HTTP_BUF_SIZE 4096
+#define HTTP_HEADER_MAX (16 * 1024)
+
+ConnLimit::ConnLimit(uint32_t max)
+    : _free(max ? max : 1)
+{
+}
+
+void ConnLimit::acquire(void)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _cond.wait(lock, [this]() { return _free > 0; });
+    _free--;
+}
+
+void ConnLimit::release(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free++;
+    }
+
+    _cond.notify_one();
+}
+
+HttpClient::HttpClient(const std::string &host, uint16_t port, uint32_t timeout_ms, ConnLimit *limit)
+    : _host(host), _port(port), _timeout_ms(timeout_ms), _limit(limit)
+{
+}
+
+const std::string &HttpClient::last_error(void) const
+{
+    return _error;
+}
+
+std::string HttpClient::address(void) const
+{
+    return _host + ":" + std::to_string(_port);
+}
+
+std::string HttpClient::url_encode(const std::string &value)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    std::string out;
+
+    for (unsigned char c : value)
+    {
+        if (isalnum(c) || (c == '-') || (c == '_') || (c == '.') || (c == '~'))
+        {
+            out.push_back(c);
+        }
+        else
+        {
+            out.push_back('%');
+            out.push_back(digits[c >> 4]);
+            out.push_back(digits[c & 0x0F]);
+        }
+    }
+
+    return out;
+}
+
+int HttpClient::connect_socket(void)
+{
+    int fd = -1;
+    struct addrinfo hints = {};
+    struct addrinfo *res = nullptr;
+    struct timeval tv = {static_cast<time_t>(_timeout_ms / 1000), static_cast<suseconds_t>((_timeout_ms % 1000) * 1000)};
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(_host.c_str(), std::to_string(_port).c_str(), &hints, &res) != 0)
+    {
+        _error = "cannot resolve " + _host;
+        return -1;
+    }
+
+    for (struct addrinfo *ai = res; ai; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        // On Linux the send timeout bounds connect() as well
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            break;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+
+    if (fd < 0)
+    {
+        _error = "cannot connect to " + address();
+    }
+
+    return fd;
+}
+
+bool HttpClient::send_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *ptr = static_cast<const uint8_t *>(data);
+
+    while (len > 0)
+    {
+        ssize_t sent = send(fd, ptr, len, MSG_NOSIGNAL);
+
+        if (sent <= 0)
+        {
+            _error = "send failed";
+            return false;
+        }
+
+        ptr += sent;
+        len -= sent;
+    }
+
+    return true;
+}
+
+/* Content-Length, chunked and read-until-close bodies */
+bool HttpClient::read_response(int fd, response_t &resp)
+{
+    char buf[HTTP_BUF_SIZE];
+    std::string data;
+    size_t header_end = std::string::npos;
+    size_t content_length = std::string::npos;
+    bool chunked = false;
+    ssize_t len = 0;
+
+    while ((header_end = data.find("\r\n\r\n")) == std::string::npos)
+    {
+        len = recv(fd, buf, sizeof(buf), 0);
+
+        if ((len <= 0) || (data.size() > HTTP_HEADER_MAX))
+        {
+            _error = "no response header";
+            return false;
+        }
+
+        data.append(buf, len);
+    }
+
+    if (sscanf(data.c_str(), "HTTP/%*d.%*d %d", &resp.status) != 1)
+    {
+        _error = "malformed status line";
+        return false;
+    }
+
+    for (size_t pos = data.find("\r\n") + 2; pos < header_end;)
+    {
+        size_t end = data.find("\r\n", pos);
+        std::string line = data.substr(pos, end - pos);
+
+        if (!strncasecmp(line.c_str(), "Content-Length:", 15))
+        {
+            content_length = strtoul(line.c_str() + 15, nullptr, 10);
+        }
+        else if (!strncasecmp(line.c_str(), "Transfer-Encoding:", 18) && strcasestr(line.c_str() + 18, "chunked"))
+        {
+            chunked = true;
+        }
+
+        pos = end + 2;
+    }
+
+    data.erase(0, header_end + 4);
+
+    // Read the rest of the body: a known length, the terminating chunk or the close
+    for (;;)
+    {
+        if (!chunked && (content_length != std::string::npos) && (data.size() >= content_length))
+        {
+            break;
+        }
+
+        // The last chunk has size 0 and no trailers follow it
+        if (chunked && ((data == "0\r\n\r\n") || ((data.size() > 7) && (data.compare(data.size() - 7, 7, "\r\n0\r\n\r\n") == 0))))
+        {
+            break;
+        }
+
+        len = recv(fd, buf, sizeof(buf), 0);
+
+        if (len < 0)
+        {
+            _error = "receive failed";
+            return false;
+        }
+
+        if (len == 0)
+        {
+            break;
+        }
+
+        data.append(buf, len);
+    }
+
+    resp.body.clear();
+
+    if (!chunked)
+    {
+        resp.body = (content_length != std::string::npos) ? (data.substr(0, content_length)) : (data);
+        return true;
+    }
+
+    for (size_t pos = 0; pos < data.size();)
+    {
+        size_t line_end = data.find("\r\n", pos);
+        size_t size = 0;
+
+        if (line_end == std::string::npos)
+        {
+            break;
+        }
+
+        size = strtoul(data.c_str() + pos, nullptr, 16);
+        if (size == 0)
+        {
+            break;
+        }
+
+        resp.body.append(data, line_end + 2, size);
+        pos = line_end + 2 + size + 2;
+    }
+
+    return true;
+}
+
+bool HttpClient::request(const std::string &head, size_t length, const body_reader_t &reader, response_t &resp)
+{
+    uint8_t buf[HTTP_BUF_SIZE];
+    size_t sent = 0;
+    bool ret = false;
+    int fd = -1;
+
+    resp.status = 0;
+    resp.body.clear();
+
+    if (_limit)
+    {
+        _limit->acquire();
+    }
+
+    fd = connect_socket();
+
+    if (fd >= 0)
+    {
+        ret = send_all(fd, head.data(), head.size());
+
+        while (ret && reader && (sent < length))
+        {
+            size_t len = reader(buf, ((length - sent) < sizeof(buf)) ? (length - sent) : (sizeof(buf)));
+
+            if (len == 0)
+            {
+                _error = "body shorter than announced";
+                ret = false;
+                break;
+            }
+
+            ret = send_all(fd, buf, len);
+            sent += len;
+        }
+
+        ret = ret && read_response(fd, resp);
+        close(fd);
+    }
+
+    if (_limit)
+    {
+        _limit->release();
+    }
+
+    if (ret && ((resp.status < 200) || (resp.status >= 300)))
+    {
+        _error = "HTTP " + std::to_string(resp.status) + ": " + resp.body;
+        ret = false;
+    }
+
+    return ret;
+}
+
+bool HttpClient::get(const std::string &path, response_t &resp)
+{
+    std::string head = "GET " + path + " HTTP/1.1\r\nHost: " + address() + "\r\nConnection: close\r\n\r\n";
+
+    return request(head, 0, nullptr, resp);
+}
+
+bool HttpClient::post(const std::string &path, const std::string &body, response_t &resp)
+{
+    size_t offset = 0;
+    std::string head = "POST " + path + " HTTP/1.1\r\nHost: " + address() + "\r\nConnection: close\r\nContent-Type: application/json\r\nContent-Length: " +
+                       std::to_string(body.size()) + "\r\n\r\n";
+
+    return request(head, body.size(), [&](uint8_t *buf, size_t size) {
+        size_t len = body.copy(reinterpret_cast<char *>(buf), size, offset);
+        offset += len;
+        return len;
+    },
+                   resp);
+}
+
+bool HttpClient::post(const std::string &path, size_t length, const body_reader_t &reader, response_t &resp)
+{
+    std::string head = "POST " + path + " HTTP/1.1\r\nHost: " + address() + "\r\nConnection: close\r\nContent-Type: application/octet-stream\r\nContent-Length: " +
+                       std::to_string(length) + "\r\n\r\n";
+
+    return request(head, length, reader, resp);
+}
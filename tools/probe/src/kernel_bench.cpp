@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "kernels.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Checks the firmware's byte loop kernels against plain byte loops and times
+ * both, at the sizes the programming path uses them: a hex record (37 bytes),
+ * a verify chunk (256) and a sector (4096), aligned and one byte off.
+ * kernel-bench <rounds> sets the repetitions, ctest runs it with few.
+ *
+ * This is the portable code only, the PIE path is timed on the device with
+ * the "bench-kernels" query.
+ */
+
+static constexpr uint32_t MAX_SIZE = 4096;
+
+static uint8_t s_a[MAX_SIZE + 16] KERNEL_ALIGN;
+static uint8_t s_b[MAX_SIZE + 16] KERNEL_ALIGN;
+static uint8_t s_hex[2 * MAX_SIZE + 16];
+static uint8_t s_bin[MAX_SIZE + 16];
+static int s_failed = 0;
+static volatile uint32_t s_sink = 0;
+
+static bool ref_is_blank(const uint8_t *data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (data[i] != 0xFF)
+            return false;
+    }
+
+    return true;
+}
+
+static bool ref_equal(const uint8_t *a, const uint8_t *b, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (a[i] != b[i])
+            return false;
+    }
+
+    return true;
+}
+
+static uint32_t ref_crc32(const uint8_t *data, uint32_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+        }
+    }
+
+    return ~crc;
+}
+
+static uint8_t ref_sum8(const uint8_t *data, uint32_t size)
+{
+    uint8_t sum = 0;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        sum += data[i];
+    }
+
+    return sum;
+}
+
+static void check(bool ok, const char *what, uint32_t size, uint32_t offset)
+{
+    if (!ok)
+    {
+        printf("FAIL %s, %u bytes at offset %u\n", what, size, offset);
+        s_failed++;
+    }
+}
+
+/* ns per call of fn, averaged over rounds */
+template <class Fn>
+static double bench(Fn fn, uint32_t rounds)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        s_sink += fn();
+    }
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+static void report(const char *what, uint32_t size, uint32_t offset, double kernel_ns, double ref_ns)
+{
+    printf("%-10s %5u +%u %9.1f ns %8.1f MB/s", what, size, offset, kernel_ns, size * 1000.0 / kernel_ns);
+    printf(ref_ns ? " %6.2fx\n" : "\n", ref_ns / kernel_ns);
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint32_t sizes[] = {37, 256, MAX_SIZE};
+    static const char digits[] = "0123456789ABCDEF";
+    uint32_t rounds = (argc > 1) ? (uint32_t)strtoul(argv[1], nullptr, 0) : 100;
+
+    rounds = rounds ? rounds : 1;
+
+    for (uint32_t i = 0; i < sizeof(s_a); i++)
+    {
+        s_a[i] = (uint8_t)(i * 13 + 5);
+    }
+
+    printf("kernel      size     per call   throughput  vs byte loop\n");
+
+    for (uint32_t size : sizes)
+    {
+        for (uint32_t offset = 0; offset < 2; offset++)
+        {
+            uint8_t *a = s_a + offset;
+            uint8_t *b = s_b + offset;
+            uint8_t saved = 0;
+
+            // blank: all 0xFF, the whole buffer is scanned
+            memset(s_b, 0xFF, sizeof(s_b));
+            check(kernel_is_blank(b, size) && ref_is_blank(b, size), "is_blank", size, offset);
+            b[size - 1] = 0xFE;
+            check(!kernel_is_blank(b, size), "is_blank, last byte", size, offset);
+            b[size - 1] = 0xFF;
+            report("is_blank", size, offset, bench([&] { return kernel_is_blank(b, size); }, rounds), bench([&] { return ref_is_blank(b, size); }, rounds));
+
+            // equal: identical buffers, the whole buffer is compared
+            memcpy(b, a, size);
+            check(kernel_equal(a, b, size), "equal", size, offset);
+            b[size - 1] ^= 0x01;
+            check(!kernel_equal(a, b, size), "equal, last byte", size, offset);
+            b[size - 1] ^= 0x01;
+            report("equal", size, offset, bench([&] { return kernel_equal(a, b, size); }, rounds), bench([&] { return ref_equal(a, b, size); }, rounds));
+
+            check(kernel_crc32(0, a, size) == ref_crc32(a, size), "crc32", size, offset);
+            check(kernel_crc32(kernel_crc32(0, a, size / 2), a + size / 2, size - size / 2) == ref_crc32(a, size), "crc32, chained", size, offset);
+            report("crc32", size, offset, bench([&] { return kernel_crc32(0, a, size); }, rounds), bench([&] { return ref_crc32(a, size); }, rounds));
+
+            check(kernel_sum8(a, size) == ref_sum8(a, size), "sum8", size, offset);
+            report("sum8", size, offset, bench([&] { return kernel_sum8(a, size); }, rounds), bench([&] { return ref_sum8(a, size); }, rounds));
+
+            for (uint32_t i = 0; i < size; i++)
+            {
+                s_hex[offset + 2 * i] = digits[a[i] >> 4];
+                s_hex[offset + 2 * i + 1] = ((i & 1) ? digits : "0123456789abcdef")[a[i] & 0x0F];
+            }
+
+            check((kernel_hex_decode(s_hex + offset, s_bin, size) == size) && !memcmp(s_bin, a, size), "hex_decode", size, offset);
+            saved = s_hex[offset + size];
+            s_hex[offset + size] = 'G';
+            check(kernel_hex_decode(s_hex + offset, s_bin, size) == size / 2, "hex_decode, bad digit", size, offset);
+            s_hex[offset + size] = saved;
+            report("hex_decode", size, offset, bench([&] { return kernel_hex_decode(s_hex + offset, s_bin, size); }, rounds), 0);
+        }
+    }
+
+    printf("%s\n", s_failed ? "FAILED" : "PASSED");
+
+    return s_failed ? 1 : 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "probe_client.h"
+#include "probe_pool.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#define DEFAULT_PORT 80
+
+typedef struct
+{
+    std::vector<std::string> probes;
+    uint32_t jobs;
+    uint32_t connections;
+    uint32_t timeout_s;
+    std::string location;
+    std::string name;
+    uint32_t addr;
+    bool quiet;
+} options_t;
+
+static std::mutex s_print_mutex;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: probe [options] <command> [args]\n"
+            "\n"
+            "commands:\n"
+            "  upload <file>        upload an image, slots already holding it are skipped\n"
+            "  program <job>        submit a job and wait for it, job is a JSON file or string\n"
+            "  fingerprint <job>    run a fingerprint job and print the match\n"
+            "  query <type>         print /api/query?type=<type>\n"
+            "\n"
+            "options:\n"
+            "  -p, --probe HOST[:PORT]   probe to drive, repeatable\n"
+            "  -f, --probes FILE         probes, one HOST[:PORT] per line\n"
+            "  -j, --jobs N              probes driven at once (16)\n"
+            "  -c, --connections N       sockets open at once over all probes (8)\n"
+            "  -t, --timeout S           job timeout in seconds (600)\n"
+            "  -l, --location L          upload to slot, program or algorithm (slot)\n"
+            "  -n, --name NAME           name on the probe, the file name by default\n"
+            "  -a, --addr ADDR           flash address of a binary slot\n"
+            "  -q, --quiet               no progress lines\n");
+}
+
+static void print_line(const std::string &probe, const std::string &text)
+{
+    std::lock_guard<std::mutex> lock(s_print_mutex);
+
+    printf("%s: %s\n", probe.c_str(), text.c_str());
+    fflush(stdout);
+}
+
+static bool load_probes(const std::string &path, std::vector<std::string> &probes)
+{
+    std::ifstream file(path);
+    std::string line;
+
+    if (!file)
+    {
+        return false;
+    }
+
+    while (std::getline(file, line))
+    {
+        line = line.substr(0, line.find('#'));
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+
+        if (!line.empty())
+        {
+            probes.push_back(line);
+        }
+    }
+
+    return true;
+}
+
+static std::unique_ptr<ProbeClient> make_client(const std::string &probe, ConnLimit &limit)
+{
+    size_t colon = probe.rfind(':');
+    std::string host = (colon == std::string::npos) ? (probe) : (probe.substr(0, colon));
+    uint16_t port = (colon == std::string::npos) ? (DEFAULT_PORT) : (static_cast<uint16_t>(atoi(probe.c_str() + colon + 1)));
+
+    return std::unique_ptr<ProbeClient>(new ProbeClient(host, port, &limit));
+}
+
+static std::string load_job(const std::string &arg)
+{
+    std::ifstream file(arg);
+    std::stringstream text;
+
+    if (!arg.empty() && (arg[0] == '{'))
+    {
+        return arg;
+    }
+
+    if (!file)
+    {
+        return "";
+    }
+
+    text << file.rdbuf();
+
+    return text.str();
+}
+
+/* One task per probe, the result of every probe is printed as it finishes */
+static int run_command(const options_t &opt, const std::string &command, const std::string &arg)
+{
+    ProbePool pool(opt.jobs, opt.connections);
+    std::vector<std::future<bool>> results;
+    std::string job;
+    int failed = 0;
+
+    if ((command == "program") || (command == "fingerprint"))
+    {
+        job = load_job(arg);
+
+        if (job.empty())
+        {
+            fprintf(stderr, "cannot read job %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    for (auto &probe : opt.probes)
+    {
+        results.push_back(pool.submit([&opt, &pool, &command, &arg, &job, probe]() {
+            std::unique_ptr<ProbeClient> client = make_client(probe, pool.conn_limit());
+            ProbeClient::progress_cb_t progress = nullptr;
+
+            if (!opt.quiet)
+            {
+                progress = [](const std::string &address, int value) { print_line(address, std::to_string(value) + "%"); };
+            }
+
+            if (command == "upload")
+            {
+                ProbeClient::upload_result_t result = client->upload(arg, opt.location, opt.name, opt.addr);
+
+                print_line(probe, result.ok ? ((result.skipped ? "unchanged " : "uploaded ") + result.sha256) : ("upload failed: " + result.error));
+                return result.ok;
+            }
+
+            if ((command == "program") || (command == "fingerprint"))
+            {
+                ProbeClient::job_result_t result = client->run(job, progress, opt.timeout_s * 1000, (command == "fingerprint") ? ("fingerprint") : (""));
+
+                print_line(probe, result.ok ? ((command == "fingerprint") ? (result.result) : ("done")) : ("failed: " + result.error + result.result));
+                return result.ok;
+            }
+
+            std::string body;
+            std::string error;
+            bool ok = client->query(arg, body, error);
+
+            print_line(probe, ok ? body : ("query failed: " + error));
+            return ok;
+        }));
+    }
+
+    for (auto &result : results)
+    {
+        failed += result.get() ? 0 : 1;
+    }
+
+    if (opt.probes.size() > 1)
+    {
+        fprintf(stderr, "%d of %d probes failed\n", failed, static_cast<int>(opt.probes.size()));
+    }
+
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"probe", required_argument, nullptr, 'p'},
+        {"probes", required_argument, nullptr, 'f'},
+        {"jobs", required_argument, nullptr, 'j'},
+        {"connections", required_argument, nullptr, 'c'},
+        {"timeout", required_argument, nullptr, 't'},
+        {"location", required_argument, nullptr, 'l'},
+        {"name", required_argument, nullptr, 'n'},
+        {"addr", required_argument, nullptr, 'a'},
+        {"quiet", no_argument, nullptr, 'q'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+    options_t opt = {{}, 16, 8, 600, "slot", "", 0, false};
+    std::string command;
+    std::string arg;
+    int c = 0;
+
+    while ((c = getopt_long(argc, argv, "p:f:j:c:t:l:n:a:qh", long_options, nullptr)) != -1)
+    {
+        switch (c)
+        {
+        case 'p':
+            opt.probes.push_back(optarg);
+            break;
+        case 'f':
+            if (!load_probes(optarg, opt.probes))
+            {
+                fprintf(stderr, "cannot read %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'j':
+            opt.jobs = strtoul(optarg, nullptr, 0);
+            break;
+        case 'c':
+            opt.connections = strtoul(optarg, nullptr, 0);
+            break;
+        case 't':
+            opt.timeout_s = strtoul(optarg, nullptr, 0);
+            break;
+        case 'l':
+            opt.location = optarg;
+            break;
+        case 'n':
+            opt.name = optarg;
+            break;
+        case 'a':
+            opt.addr = strtoul(optarg, nullptr, 0);
+            break;
+        case 'q':
+            opt.quiet = true;
+            break;
+        default:
+            usage();
+            return (c == 'h') ? 0 : 2;
+        }
+    }
+
+    if ((argc - optind) != 2 || opt.probes.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    command = argv[optind];
+    arg = argv[optind + 1];
+
+    if ((command != "upload") && (command != "program") && (command != "fingerprint") && (command != "query"))
+    {
+        usage();
+        return 2;
+    }
+
+    if ((command == "upload") && opt.name.empty())
+    {
+        opt.name = arg.substr(arg.find_last_of('/') + 1);
+    }
+
+    return run_command(opt, command, arg);
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "probe_client.h"
+#include "hash_engine.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+ProbeClient::ProbeClient(const std::string &host, uint16_t port, ConnLimit *limit, uint32_t poll_ms)
+    : _http(host, port, 10000, limit), _poll_ms(poll_ms)
+{
+}
+
+std::string ProbeClient::address(void) const
+{
+    return _http.address();
+}
+
+std::string ProbeClient::file_sha256(const std::string &path)
+{
+    uint8_t buf[4096];
+    uint8_t digest[32];
+    size_t len = 0;
+    HashEngine sha(HashEngine::HASH_SHA256);
+    FILE *fp = fopen(path.c_str(), "rb");
+
+    if (!fp)
+    {
+        return "";
+    }
+
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+        sha.update(buf, len);
+    }
+
+    fclose(fp);
+    sha.finish(digest);
+
+    return HashEngine::to_hex(digest, sizeof(digest));
+}
+
+/* Value of the first "key" at or after from, strings without their quotes. Enough for the probe's flat replies. */
+std::string ProbeClient::json_value(const std::string &json, const std::string &key, size_t from)
+{
+    size_t pos = json.find("\"" + key + "\"", from);
+    size_t end = 0;
+
+    if (pos == std::string::npos)
+    {
+        return "";
+    }
+
+    pos = json.find_first_not_of(" \t\r\n:", pos + key.size() + 2);
+    if (pos == std::string::npos)
+    {
+        return "";
+    }
+
+    if (json[pos] == '"')
+    {
+        end = json.find('"', pos + 1);
+        return (end == std::string::npos) ? ("") : (json.substr(pos + 1, end - pos - 1));
+    }
+
+    end = json.find_first_of(",}] \t\r\n", pos);
+
+    return json.substr(pos, end - pos);
+}
+
+bool ProbeClient::slot_sha256(const std::string &name, std::string &sha256)
+{
+    std::string body;
+    std::string error;
+    size_t pos = 0;
+
+    if (!query("slot-status", body, error))
+    {
+        return false;
+    }
+
+    pos = body.find("\"name\": \"" + name + "\"");
+    sha256 = (pos == std::string::npos) ? ("") : (json_value(body, "sha256", pos));
+
+    return true;
+}
+
+/* Slots report their sha256, an image that is already there is not sent again */
+ProbeClient::upload_result_t ProbeClient::upload(const std::string &path, const std::string &location, const std::string &name, uint32_t addr)
+{
+    upload_result_t result = {false, false, "", ""};
+    HttpClient::response_t resp;
+    std::string remote;
+    std::string uri;
+    long size = 0;
+    FILE *fp = fopen(path.c_str(), "rb");
+
+    if (!fp)
+    {
+        result.error = "cannot open " + path;
+        return result;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    result.sha256 = file_sha256(path);
+
+    if ((location == "slot") && slot_sha256(name, remote) && (remote == result.sha256))
+    {
+        fclose(fp);
+        result.ok = true;
+        result.skipped = true;
+        return result;
+    }
+
+    uri = "/api/upload?location=" + HttpClient::url_encode(location) + "&name=" + HttpClient::url_encode(name);
+
+    if (location == "slot")
+    {
+        uri += addr ? ("&addr=" + std::to_string(addr)) : ("");
+    }
+    else
+    {
+        uri += "&overwrite=true";
+    }
+
+    result.ok = _http.post(uri, size, [fp](uint8_t *buf, size_t len) { return fread(buf, 1, len, fp); }, resp);
+    fclose(fp);
+
+    if (!result.ok)
+    {
+        result.error = _http.last_error();
+    }
+
+    return result;
+}
+
+bool ProbeClient::submit(const std::string &job, std::string &error)
+{
+    HttpClient::response_t resp;
+
+    if (!_http.post("/program", job, resp))
+    {
+        error = _http.last_error();
+        return false;
+    }
+
+    return true;
+}
+
+bool ProbeClient::query(const std::string &type, std::string &body, std::string &error)
+{
+    HttpClient::response_t resp;
+
+    if (!_http.get("/api/query?type=" + HttpClient::url_encode(type), resp))
+    {
+        error = _http.last_error();
+        return false;
+    }
+
+    body = resp.body;
+
+    return true;
+}
+
+/* Poll program-status until the job is idle again, progress is reported on every change */
+ProbeClient::job_result_t ProbeClient::wait(const progress_cb_t &progress, uint32_t timeout_ms, const std::string &result_type)
+{
+    job_result_t result = {false, -1, "", ""};
+    std::string body;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    for (;;)
+    {
+        int value = 0;
+
+        if (!query("program-status", body, result.error))
+        {
+            return result;
+        }
+
+        value = atoi(json_value(body, "progress").c_str());
+
+        if ((value != result.progress) && progress)
+        {
+            progress(address(), value);
+        }
+
+        result.progress = value;
+
+        if (json_value(body, "status") == "idle")
+        {
+            break;
+        }
+
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            result.error = "timeout";
+            return result;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(_poll_ms));
+    }
+
+    result.ok = (result.progress == 100);
+
+    if (!result_type.empty() && !query(result_type, result.result, result.error))
+    {
+        result.ok = false;
+        return result;
+    }
+
+    if (!result_type.empty())
+    {
+        result.ok = (json_value(result.result, "status") != "failed");
+    }
+    else if (!result.ok)
+    {
+        result.error = "job stopped at " + std::to_string(result.progress) + "%";
+    }
+
+    return result;
+}
+
+ProbeClient::job_result_t ProbeClient::run(const std::string &job, const progress_cb_t &progress, uint32_t timeout_ms, const std::string &result_type)
+{
+    job_result_t result = {false, -1, "", ""};
+
+    if (!submit(job, result.error))
+    {
+        return result;
+    }
+
+    return wait(progress, timeout_ms, result_type);
+}
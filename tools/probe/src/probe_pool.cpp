@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "probe_pool.h"
+
+ProbePool::ProbePool(uint32_t workers, uint32_t max_connections)
+    : _stop(false), _limit(max_connections)
+{
+    for (uint32_t i = 0; i < (workers ? workers : 1); i++)
+    {
+        _workers.emplace_back(&ProbePool::worker, this);
+    }
+}
+
+ProbePool::~ProbePool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+
+    _cond.notify_all();
+
+    for (auto &worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+ConnLimit &ProbePool::conn_limit(void)
+{
+    return _limit;
+}
+
+// Queued tasks still run after the pool is asked to stop
+void ProbePool::worker(void)
+{
+    for (;;)
+    {
+        std::function<void(void)> task;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _cond.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+
+            if (_tasks.empty())
+            {
+                return;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+
+        task();
+    }
+}
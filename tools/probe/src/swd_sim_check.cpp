@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2023-2023, lihongquan
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2023-9-8      lihongquan   add license declaration
+ */
+#include "swd_sim_transport.h"
+#include "swd_iface.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Runs the firmware's SWD engine against the simulated target and prints the
+ * transfers each operation takes on the wire. Exits non-zero when a result is
+ * wrong, ctest runs it.
+ *
+ * Then times a 2 KiB write and read back three ways: the engine called
+ * directly, through SWDIface (SWDHost, one virtual call per operation) and
+ * over a transport with a virtual transfer() (one virtual call per word, the
+ * layout before SWDEngine). swd-sim-check <rounds> sets the repetitions.
+ */
+
+typedef SimTransport<0x20000000, 0x4000> sim_t;
+
+class SimPort
+{
+public:
+    virtual ~SimPort() = default;
+    virtual uint8_t transfer(uint32_t request, uint32_t *data) = 0;
+};
+
+class SimPortImpl : public SimPort
+{
+public:
+    sim_t sim;
+
+    virtual uint8_t transfer(uint32_t request, uint32_t *data) override
+    {
+        return sim.transfer(request, data);
+    }
+};
+
+/* Per word virtual dispatch, as SWDIface::transfer() was called before */
+class VirtualTransport
+{
+public:
+    SimPort *port = nullptr;
+
+    bool init(void) { return true; }
+    bool off(void) { return true; }
+    void swj_sequence(uint32_t count, const uint8_t *data)
+    {
+        (void)count;
+        (void)data;
+    }
+    void set_target_reset(uint8_t asserted)
+    {
+        (void)asserted;
+    }
+    void msleep(uint32_t ms)
+    {
+        (void)ms;
+    }
+    uint32_t retry_count(void) { return 100; }
+    uint8_t transfer(uint32_t request, uint32_t *data)
+    {
+        return port->transfer(request, data);
+    }
+};
+
+static constexpr uint32_t RAM_BASE = 0x20000000;
+static constexpr uint32_t BLOCK_SIZE = 2048;
+
+static int s_failed = 0;
+
+static uint8_t s_data[BLOCK_SIZE];
+static uint8_t s_back[BLOCK_SIZE];
+
+/* Write and read back 2 KiB rounds times, returns ns per round */
+template <class Host>
+static double bench(Host &host, uint32_t rounds)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        s_data[0] = (uint8_t)i;
+
+        if (!host.write_memory(RAM_BASE, s_data, BLOCK_SIZE) || !host.read_memory(RAM_BASE, s_back, BLOCK_SIZE) || (s_back[0] != s_data[0]))
+        {
+            s_failed++;
+            return 0;
+        }
+    }
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+static void bench_report(const char *what, double ns, uint32_t transfers, double base)
+{
+    printf("%-28s %8.0f ns/round %6.1f ns/transfer %5.2fx\n", what, ns, ns / transfers, base ? (ns / base) : (1.0));
+}
+
+static void check(bool ok, const char *what, sim_t &sim, uint32_t &last)
+{
+    printf("%-28s %-4s %6u transfers\n", what, ok ? "ok" : "FAIL", sim.transfer_count() - last);
+    last = sim.transfer_count();
+    s_failed += ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    SWDEngine<sim_t> engine;
+    sim_t &sim = engine.get_transport();
+    uint8_t data[BLOCK_SIZE];
+    uint8_t back[BLOCK_SIZE];
+    uint32_t addr[4] = {RAM_BASE + 0x10, RAM_BASE + 0x14, RAM_BASE + 0x400, RAM_BASE + 0x18};
+    uint32_t words[4] = {0};
+    uint32_t expect = 0;
+    uint32_t last = 0;
+    bool match = false;
+    bool ok = false;
+
+    for (uint32_t i = 0; i < BLOCK_SIZE; i++)
+    {
+        data[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    check(engine.init_debug(), "init_debug", sim, last);
+    check(engine.write_memory(RAM_BASE, data, BLOCK_SIZE), "write 2 KiB", sim, last);
+
+    ok = engine.read_memory(RAM_BASE, back, BLOCK_SIZE) && !memcmp(data, back, BLOCK_SIZE);
+    check(ok, "verify 2 KiB, readback", sim, last);
+
+    ok = engine.verify_memory_pushed(RAM_BASE, data, BLOCK_SIZE, &match) && match;
+    check(ok, "verify 2 KiB, pushed", sim, last);
+
+    sim.ram()[BLOCK_SIZE - 1] ^= 0xff;
+    ok = engine.verify_memory_pushed(RAM_BASE, data, BLOCK_SIZE, &match) && !match;
+    check(ok, "pushed verify, mismatch", sim, last);
+    sim.ram()[BLOCK_SIZE - 1] ^= 0xff;
+
+    ok = engine.read_words(addr, words, 4);
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        memcpy(&expect, &data[addr[i] - RAM_BASE], sizeof(expect));
+        ok = ok && (words[i] == expect);
+    }
+    check(ok, "read_words, 4 scattered", sim, last);
+
+    memcpy(&expect, &data[0x20], sizeof(expect));
+    check(engine.read_word(RAM_BASE + 0x20, &words[0]) && (words[0] == expect), "read_word", sim, last);
+
+    // the simulated core halts at once and returns R0 unchanged: 0 means success
+    program_syscall_t syscall = {RAM_BASE + 0x1001, RAM_BASE + 0x1000, RAM_BASE + 0x2000};
+    check(engine.flash_syscall_exec(&syscall, RAM_BASE + 0x1101, 0, 0, 0, 0), "flash_syscall_exec", sim, last);
+
+    engine.set_pushed_compare(true);
+    check(engine.flash_syscall_exec(&syscall, RAM_BASE + 0x1101, 0, 0, 0, 0), "flash_syscall_exec, pushed", sim, last);
+    engine.set_pushed_compare(false);
+
+    // WAIT is retried up to the configured count, then the access fails
+    sim.set_retry_count(3);
+    sim.set_wait(3);
+    check(engine.read_word(RAM_BASE + 0x20, &words[0]) && (words[0] == expect), "read_word, 3 WAITs, retry 3", sim, last);
+    sim.set_wait(4);
+    check(!engine.read_word(RAM_BASE + 0x20, &words[0]), "read_word, 4 WAITs, retry 3", sim, last);
+    sim.set_wait(0);
+    sim.set_retry_count(100);
+
+    uint32_t rounds = (argc > 1) ? (uint32_t)strtoul(argv[1], nullptr, 0) : 200;
+
+    rounds = rounds ? rounds : 1;
+    uint32_t per_round = 0;
+    double direct = 0;
+    double iface = 0;
+    double virt = 0;
+    SWDEngine<sim_t> bench_engine;
+    SWDHost<sim_t> bench_host(bench_engine);
+    SWDIface &bench_iface = bench_host;
+    SimPortImpl port;
+    SWDEngine<VirtualTransport> virt_engine;
+
+    virt_engine.get_transport().port = &port;
+    bench_engine.init_debug();
+    virt_engine.init_debug();
+    memcpy(s_data, data, sizeof(s_data));
+
+    last = bench_engine.get_transport().transfer_count();
+    direct = bench(bench_engine, rounds);
+    per_round = (bench_engine.get_transport().transfer_count() - last) / rounds;
+    iface = bench(bench_iface, rounds);
+    virt = bench(virt_engine, rounds);
+
+    printf("\n%u rounds of a 2 KiB write and read back, %u transfers each\n", rounds, per_round);
+    bench_report("SWDEngine, direct", direct, per_round, 0);
+    bench_report("SWDHost via SWDIface", iface, per_round, direct);
+    bench_report("virtual transfer()", virt, per_round, direct);
+
+    printf("%s\n", s_failed ? "FAILED" : "PASSED");
+
+    return s_failed ? 1 : 0;
+}